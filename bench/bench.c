@@ -0,0 +1,87 @@
+/*
+ * Benchmark Support
+ * Sample collection, percentiles and the result table.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void bench_sample_add(bench_samples_t *s, uint64_t ns)
+{
+    if (s->count == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 4096;
+        uint64_t *v = realloc(s->v, cap * sizeof(*v));
+        if (v == NULL) {
+            return;                   /* Drop the sample rather than the run */
+        }
+        s->v = v;
+        s->cap = cap;
+    }
+    s->v[s->count++] = ns;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+uint64_t bench_percentile(bench_samples_t *s, double q)
+{
+    if (s->count == 0) {
+        return 0;
+    }
+    qsort(s->v, s->count, sizeof(*s->v), compare_u64);
+    size_t i = (size_t)(q * (double)(s->count - 1) + 0.5);
+    return s->v[i < s->count ? i : s->count - 1];
+}
+
+void bench_samples_free(bench_samples_t *s)
+{
+    free(s->v);
+    s->v = NULL;
+    s->count = 0;
+    s->cap = 0;
+}
+
+/* "812 ns", "3.4 us", "12.0 ms" */
+static const char *format_ns(uint64_t ns, char *buf, size_t size)
+{
+    if (ns < 1000) {
+        snprintf(buf, size, "%llu ns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, size, "%.1f us", (double)ns / 1e3);
+    } else if (ns < 1000000000) {
+        snprintf(buf, size, "%.1f ms", (double)ns / 1e6);
+    } else {
+        snprintf(buf, size, "%.2f s", (double)ns / 1e9);
+    }
+    return buf;
+}
+
+void bench_report(const char *name, uint64_t ops, uint64_t elapsed_ns,
+                  bench_samples_t *lat, const char *note)
+{
+    char total[16], p50[16] = "-", p99[16] = "-";
+    double rate = elapsed_ns > 0 ? (double)ops * 1e9 / (double)elapsed_ns : 0;
+
+    if (lat != NULL && lat->count > 0) {
+        format_ns(bench_percentile(lat, 0.50), p50, sizeof(p50));
+        format_ns(bench_percentile(lat, 0.99), p99, sizeof(p99));
+    }
+    printf("%-16s %10llu %10s %12.0f %10s %10s  %s\n", name, (unsigned long long)ops,
+           format_ns(elapsed_ns, total, sizeof(total)), rate, p50, p99, note != NULL ? note : "");
+    fflush(stdout);
+}
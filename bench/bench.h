@@ -0,0 +1,93 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Benchmark Support
+ *
+ * Timing helpers and the simulated network the benchmarks run against.
+ * The simulation is spliced into the normal objects at link time
+ * (ld --wrap), so nothing in src/ knows about it:
+ * - snmp_open() to a simulated address is redirected to an in-process
+ *   agent on a loopback port, so the real SNMP client, BER codec and
+ *   UDP path are measured
+ * - ping_sweep_source() runs the real probe scheduler over a simulated
+ *   ICMP transport with configurable liveness, loss and latency
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "snmp.h"
+#include "probe.h"
+
+#define SIM_COMMUNITY "public"
+
+/* Latency samples in nanoseconds; not thread-safe */
+typedef struct {
+    uint64_t *v;
+    size_t count;
+    size_t cap;
+} bench_samples_t;
+
+uint64_t bench_now_ns(void);
+void bench_sample_add(bench_samples_t *s, uint64_t ns);
+
+/* Value at quantile q (0..1); sorts the samples, 0 if there are none */
+uint64_t bench_percentile(bench_samples_t *s, double q);
+void bench_samples_free(bench_samples_t *s);
+
+/* One result row: ops over elapsed_ns, latency percentiles of lat (may be NULL) */
+void bench_report(const char *name, uint64_t ops, uint64_t elapsed_ns,
+                  bench_samples_t *lat, const char *note);
+
+/* ------------------------------------------------------------------ */
+/* Simulated SNMP agents (sim_snmp.c)                                 */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Router index of a crawl graph of router_count routers: a binary tree
+ * (parent (i-1)/2, children 2i+1 and 2i+2) spread over its route table.
+ * ARP entries are hosts of the router's own /16.
+ */
+uint32_t sim_router_addr(int index);
+int sim_snmp_add_router(int index, int router_count, int routes, int arp_entries);
+
+/* Device with an IF-MIB ifTable/ifXTable of interfaces rows */
+int sim_snmp_add_device(uint32_t addr, int interfaces);
+
+/* Serve every agent added so far; returns 0 or -1 */
+int sim_snmp_start(void);
+
+/*
+ * Stop serving and forget all agents; spans (may be NULL) gets, per
+ * agent that was queried, the time from its first to its last request
+ */
+void sim_snmp_stop(bench_samples_t *spans);
+
+/* Requests answered since start */
+uint64_t sim_snmp_requests(void);
+
+int __real_snmp_open(snmp_session_t *session, const char *ip, uint16_t port, const char *community);
+int __wrap_snmp_open(snmp_session_t *session, const char *ip, uint16_t port, const char *community);
+
+/* ------------------------------------------------------------------ */
+/* Simulated ICMP responder (sim_icmp.c)                              */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    int alive_pct;        /* Share of addresses that answer, by address hash */
+    int loss_pct;         /* Probes dropped at random */
+    int latency_us;       /* Minimum reply delay */
+    int jitter_us;        /* Extra uniform delay */
+} sim_icmp_config_t;
+
+void sim_icmp_configure(const sim_icmp_config_t *cfg);
+int sim_icmp_is_alive(uint32_t addr);
+
+/* Send-to-delivery time of every reply since the last call; caller frees */
+void sim_icmp_take_latency(bench_samples_t *out);
+
+int __wrap_ping_sweep_source(const probe_config_t *cfg, probe_next_fn next, void *next_ctx,
+                             probe_result_cb cb, void *ctx, probe_stats_t *stats);
+
+#endif /* BENCH_H */
@@ -0,0 +1,389 @@
+/*
+ * Benchmark Runner
+ * Discovery and polling benchmarks against the simulated network.
+ * Usage: bench_runner [--quick] [--stats] [scan] [crawl] [dedup] [poll]
+ * With no names every benchmark runs. Exits non-zero if a benchmark
+ * did not find what the simulation holds. --stats adds netmon's own
+ * instrumentation (selfstat.h) accumulated over the run.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "bench.h"
+#include "host_index.h"
+#include "router_crawl.h"
+#include "cred_cache.h"
+#include "selfstat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#define SCAN_NETWORK 0x0a400000U      /* 10.64.0.0 */
+#define POLL_DEVICE_BASE 0x0ac80001U  /* 10.200.0.1 */
+#define POLL_THREADS 8
+#define DEDUP_BATCH 1024
+
+static int quick = 0;
+
+static void format_addr(uint32_t addr, char *ip)
+{
+    struct in_addr in;
+    in.s_addr = htonl(addr);
+    inet_ntop(AF_INET, &in, ip, MAX_IP_LEN);
+}
+
+/*
+ * scan_subnet() over a /16 (/20 with --quick): the probe scheduler,
+ * address iterator and host table, with a quarter of the addresses
+ * alive, 1% loss and 1-3 ms replies. Latency is send to reply delivery.
+ */
+static int bench_scan(void)
+{
+    int prefix_len = quick ? 20 : 16;
+    sim_icmp_config_t sim = { 25, 1, 1000, 2000 };
+    probe_config_t cfg, saved;
+    bench_samples_t lat;
+    char net_ip[MAX_IP_LEN], note[96];
+
+    /* Timeouts sized for the simulated RTT, not a WAN */
+    probe_config_default(&saved);
+    cfg = saved;
+    cfg.max_pps = 0;
+    cfg.max_inflight = 4096;
+    cfg.max_retries = 1;
+    cfg.initial_rto_ms = 20;
+    cfg.min_rto_ms = 10;
+    cfg.max_rto_ms = 100;
+    probe_set_defaults(&cfg);
+    sim_icmp_configure(&sim);
+
+    uint32_t hosts = (1U << (32 - prefix_len)) - 2;
+    uint32_t alive = 0;
+    for (uint32_t i = 1; i <= hosts; i++) {
+        alive += (uint32_t)sim_icmp_is_alive(SCAN_NETWORK + i);
+    }
+
+    format_addr(SCAN_NETWORK, net_ip);
+    cleanup_discovery();
+    uint64_t start = bench_now_ns();
+    int found = scan_subnet(net_ip, prefix_len);
+    uint64_t elapsed = bench_now_ns() - start;
+    sim_icmp_take_latency(&lat);
+
+    snprintf(note, sizeof(note), "/%d, %d of %u alive found", prefix_len, found, alive);
+    bench_report("scan_subnet", hosts, elapsed, &lat, note);
+
+    bench_samples_free(&lat);
+    cleanup_discovery();
+    probe_set_defaults(&saved);
+
+    /* Both attempts must be lost to miss a host: 1 in 10^4 */
+    return found >= 0 && (uint32_t)found >= alive - alive / 100 ? 0 : -1;
+}
+
+typedef struct {
+    host_index_t hosts;
+    pthread_mutex_t lock;
+} crawl_ctx_t;
+
+/* Merge like discovery does: one hash insert per reported address */
+static void crawl_cb(uint32_t addr, crawl_source_t source, uint32_t via, void *ctx)
+{
+    crawl_ctx_t *c = ctx;
+    (void)source;
+    (void)via;
+    pthread_mutex_lock(&c->lock);
+    host_index_insert(&c->hosts, addr, HOST_INDEX_NO_SLOT, NULL);
+    pthread_mutex_unlock(&c->lock);
+}
+
+/*
+ * The discover_automatic() router crawl over 50 routers, each with 200
+ * routes and 2000 ARP entries (500 with --quick). Latency is the time
+ * from an agent's first to its last request.
+ */
+static int bench_crawl(void)
+{
+    const int routers = 50, routes = 200;
+    int arp = quick ? 500 : 2000;
+    static const char *const communities[] = { "private", SIM_COMMUNITY, NULL };
+    crawl_config_t cfg;
+    crawl_stats_t stats;
+    crawl_ctx_t ctx;
+    bench_samples_t spans = { NULL, 0, 0 };
+    char note[96];
+
+    for (int i = 0; i < routers; i++) {
+        if (sim_snmp_add_router(i, routers, routes, arp) != 0) {
+            sim_snmp_stop(NULL);
+            return -1;
+        }
+    }
+    if (sim_snmp_start() != 0) {
+        return -1;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, NULL);
+    crawl_config_default(&cfg);
+    cfg.verbose = 0;
+    uint32_t seed = sim_router_addr(0);
+
+    uint64_t start = bench_now_ns();
+    int answered = router_crawl(&cfg, &seed, 1, communities, crawl_cb, &ctx, &stats);
+    uint64_t elapsed = bench_now_ns() - start;
+    uint64_t requests = sim_snmp_requests();
+    sim_snmp_stop(&spans);
+
+    uint32_t hosts = host_index_count(&ctx.hosts);
+    snprintf(note, sizeof(note), "%d/%d routers, %u hosts, ops = SNMP requests",
+             answered, routers, hosts);
+    bench_report("router_crawl", requests, elapsed, &spans, note);
+
+    bench_samples_free(&spans);
+    host_index_free(&ctx.hosts);
+    pthread_mutex_destroy(&ctx.lock);
+    cred_cache_free();
+
+    /* Every router, its LAN address and every ARP entry */
+    return answered == routers && hosts >= (uint32_t)(routers * (arp + 2)) ? 0 : -1;
+}
+
+static uint32_t xorshift(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/*
+ * Host deduplication: 100k distinct addresses, each reported twice in
+ * random order, through the host index discovery merges with. Latency
+ * is per insert, averaged over batches of DEDUP_BATCH.
+ */
+static int bench_dedup(void)
+{
+    const uint32_t distinct = 100000;
+    uint32_t total = distinct * 2;
+    uint32_t *stream = malloc(total * sizeof(*stream));
+    host_index_t idx;
+    bench_samples_t lat = { NULL, 0, 0 };
+    uint32_t state = 88172645U;
+    char note[96];
+
+    if (stream == NULL) {
+        return -1;
+    }
+    /* Multiplying by an odd constant is a bijection mod 2^24: no repeats */
+    for (uint32_t i = 0; i < distinct; i++) {
+        stream[i] = 0x0a000000U | ((i * 2654435761U) & 0x00ffffffU);
+    }
+    for (uint32_t i = 0; i < distinct; i++) {
+        stream[distinct + i] = stream[i];
+    }
+    for (uint32_t i = total - 1; i > 0; i--) {
+        uint32_t j = xorshift(&state) % (i + 1);
+        uint32_t t = stream[i];
+        stream[i] = stream[j];
+        stream[j] = t;
+    }
+
+    memset(&idx, 0, sizeof(idx));
+    uint32_t inserted = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < total; i += DEDUP_BATCH) {
+        uint32_t n = total - i < DEDUP_BATCH ? total - i : DEDUP_BATCH;
+        uint64_t t0 = bench_now_ns();
+        for (uint32_t k = 0; k < n; k++) {
+            inserted += host_index_insert(&idx, stream[i + k], (int32_t)inserted, NULL) == 1;
+        }
+        bench_sample_add(&lat, (bench_now_ns() - t0) / n);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    snprintf(note, sizeof(note), "%u distinct of %u reports", inserted, total);
+    bench_report("dedup", total, elapsed, &lat, note);
+
+    int rc = inserted == distinct && host_index_count(&idx) == distinct ? 0 : -1;
+    host_index_free(&idx);
+    bench_samples_free(&lat);
+    free(stream);
+    return rc;
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    int next;
+    int total;                        /* Polls to run */
+    int devices;
+    int failed;
+    bench_samples_t lat;
+} poll_run_t;
+
+static void *poll_worker(void *arg)
+{
+    poll_run_t *run = arg;
+    char hostname[MAX_HOSTNAME_LEN];
+
+    for (;;) {
+        pthread_mutex_lock(&run->lock);
+        int i = run->next < run->total ? run->next++ : -1;
+        pthread_mutex_unlock(&run->lock);
+        if (i < 0) break;
+
+        snprintf(hostname, sizeof(hostname), "bench-dev-%d", i % run->devices);
+        uint64_t t0 = bench_now_ns();
+        int rc = poll_device(hostname);
+        uint64_t ns = bench_now_ns() - t0;
+
+        pthread_mutex_lock(&run->lock);
+        bench_sample_add(&run->lat, ns);
+        run->failed += rc != NETMON_SUCCESS;
+        pthread_mutex_unlock(&run->lock);
+    }
+    return NULL;
+}
+
+/* Poll every device rounds times on POLL_THREADS workers */
+static uint64_t run_polls(poll_run_t *run, int devices, int rounds)
+{
+    pthread_t threads[POLL_THREADS];
+    int started = 0;
+
+    run->next = 0;
+    run->total = devices * rounds;
+    run->devices = devices;
+    run->failed = 0;
+    uint64_t start = bench_now_ns();
+    for (; started < POLL_THREADS; started++) {
+        if (pthread_create(&threads[started], NULL, poll_worker, run) != 0) break;
+    }
+    if (started == 0) {
+        poll_worker(run);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    return bench_now_ns() - start;
+}
+
+/*
+ * Steady-state polling of 10k interfaces (40 devices x 250; 1k with
+ * --quick). A first round discovers the interfaces, then every device
+ * is polled five times. Ops are interface readings; latency is per
+ * device poll.
+ */
+static int bench_poll(void)
+{
+    int devices = quick ? 10 : 40;
+    int interfaces = quick ? 100 : 250;
+    const int rounds = 5;
+    poll_run_t run;
+    char note[96];
+    int rc = 0;
+
+    memset(&run, 0, sizeof(run));
+    pthread_mutex_init(&run.lock, NULL);
+
+    for (int d = 0; d < devices && rc == 0; d++) {
+        network_device_t dev;
+        memset(&dev, 0, sizeof(dev));
+        snprintf(dev.hostname, sizeof(dev.hostname), "bench-dev-%d", d);
+        format_addr(POLL_DEVICE_BASE + (uint32_t)d, dev.ip_address);
+        snprintf(dev.snmp_community, sizeof(dev.snmp_community), "%s", SIM_COMMUNITY);
+        dev.port = DEFAULT_SNMP_PORT;
+        if (sim_snmp_add_device(POLL_DEVICE_BASE + (uint32_t)d, interfaces) != 0 ||
+            add_device(&dev) != NETMON_SUCCESS) {
+            rc = -1;
+        }
+    }
+    if (rc == 0 && sim_snmp_start() == 0) {
+        run_polls(&run, devices, 1);
+        int warmup_failed = run.failed;
+        bench_samples_free(&run.lat);
+
+        uint64_t elapsed = run_polls(&run, devices, rounds);
+        snprintf(note, sizeof(note), "%d devices x %d interfaces, %d failed polls",
+                 devices, interfaces, run.failed + warmup_failed);
+        bench_report("poll", (uint64_t)devices * (uint64_t)interfaces * (uint64_t)rounds,
+                     elapsed, &run.lat, note);
+        rc = run.failed + warmup_failed == 0 ? 0 : -1;
+    } else {
+        rc = -1;
+    }
+
+    sim_snmp_stop(NULL);
+    for (int d = 0; d < devices; d++) {
+        char hostname[MAX_HOSTNAME_LEN];
+        snprintf(hostname, sizeof(hostname), "bench-dev-%d", d);
+        remove_device(hostname);
+    }
+    bench_samples_free(&run.lat);
+    pthread_mutex_destroy(&run.lock);
+    return rc;
+}
+
+typedef struct {
+    const char *name;
+    int (*run)(void);
+} bench_t;
+
+static const bench_t benches[] = {
+    { "scan", bench_scan },
+    { "crawl", bench_crawl },
+    { "dedup", bench_dedup },
+    { "poll", bench_poll },
+};
+
+#define BENCH_COUNT ((int)(sizeof(benches) / sizeof(benches[0])))
+
+int main(int argc, char *argv[])
+{
+    int selected[BENCH_COUNT] = { 0 };
+    int any = 0;
+    int failed = 0;
+    int stats = 0;
+
+    for (int i = 1; i < argc; i++) {
+        int matched = 0;
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--stats") == 0) {
+            stats = 1;
+            continue;
+        }
+        for (int b = 0; b < BENCH_COUNT; b++) {
+            if (strcmp(argv[i], benches[b].name) == 0) {
+                selected[b] = matched = any = 1;
+            }
+        }
+        if (!matched) {
+            fprintf(stderr, "Usage: %s [--quick] [--stats] [scan] [crawl] [dedup] [poll]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    set_discovery_verbose(0);
+    printf("%-16s %10s %10s %12s %10s %10s\n", "Benchmark", "Ops", "Time", "Ops/s", "p50", "p99");
+    printf("%-16s %10s %10s %12s %10s %10s\n", "---------", "---", "----", "-----", "---", "---");
+    for (int b = 0; b < BENCH_COUNT; b++) {
+        if (any && !selected[b]) continue;
+        if (benches[b].run() != 0) {
+            printf("%-16s FAILED\n", benches[b].name);
+            failed++;
+        }
+    }
+    if (stats) {
+        printf("\n");
+        selfstat_dump(stdout);
+    }
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,175 @@
+/*
+ * Simulated ICMP Responder
+ * A probe transport whose replies come from a min-heap of due times.
+ * Whether an address answers is a hash of the address, so every run of
+ * a sweep sees the same live hosts.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    uint64_t due_ns;
+    uint64_t sent_ns;
+    uint32_t addr;
+    uint16_t slot;
+    uint16_t gen;
+} sim_reply_t;
+
+typedef struct {
+    sim_reply_t *heap;
+    size_t count;
+    size_t cap;
+    uint32_t rng;
+} sim_icmp_t;
+
+static sim_icmp_config_t icmp_cfg = { 50, 0, 1000, 0 };
+static bench_samples_t icmp_latency;
+
+void sim_icmp_configure(const sim_icmp_config_t *cfg)
+{
+    icmp_cfg = *cfg;
+}
+
+int sim_icmp_is_alive(uint32_t addr)
+{
+    /* murmur3 finalizer */
+    addr ^= addr >> 16;
+    addr *= 0x85ebca6bU;
+    addr ^= addr >> 13;
+    addr *= 0xc2b2ae35U;
+    addr ^= addr >> 16;
+    return (int)(addr % 100) < icmp_cfg.alive_pct;
+}
+
+void sim_icmp_take_latency(bench_samples_t *out)
+{
+    *out = icmp_latency;
+    memset(&icmp_latency, 0, sizeof(icmp_latency));
+}
+
+static uint32_t next_random(sim_icmp_t *sim)
+{
+    uint32_t x = sim->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->rng = x;
+    return x;
+}
+
+static int heap_push(sim_icmp_t *sim, const sim_reply_t *r)
+{
+    if (sim->count == sim->cap) {
+        size_t cap = sim->cap ? sim->cap * 2 : 1024;
+        sim_reply_t *heap = realloc(sim->heap, cap * sizeof(*heap));
+        if (heap == NULL) {
+            return -1;
+        }
+        sim->heap = heap;
+        sim->cap = cap;
+    }
+
+    size_t i = sim->count++;
+    while (i > 0 && sim->heap[(i - 1) / 2].due_ns > r->due_ns) {
+        sim->heap[i] = sim->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim->heap[i] = *r;
+    return 0;
+}
+
+static sim_reply_t heap_pop(sim_icmp_t *sim)
+{
+    sim_reply_t top = sim->heap[0];
+    sim_reply_t last = sim->heap[--sim->count];
+    size_t i = 0;
+
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= sim->count) break;
+        if (c + 1 < sim->count && sim->heap[c + 1].due_ns < sim->heap[c].due_ns) c++;
+        if (sim->heap[c].due_ns >= last.due_ns) break;
+        sim->heap[i] = sim->heap[c];
+        i = c;
+    }
+    if (sim->count > 0) {
+        sim->heap[i] = last;
+    }
+    return top;
+}
+
+static int sim_send(void *ctx, uint32_t addr, uint16_t slot, uint16_t gen)
+{
+    sim_icmp_t *sim = ctx;
+
+    if (!sim_icmp_is_alive(addr) ||
+        (icmp_cfg.loss_pct > 0 && (int)(next_random(sim) % 100) < icmp_cfg.loss_pct)) {
+        return 0;
+    }
+
+    sim_reply_t r;
+    r.sent_ns = bench_now_ns();
+    r.due_ns = r.sent_ns + (uint64_t)icmp_cfg.latency_us * 1000;
+    if (icmp_cfg.jitter_us > 0) {
+        r.due_ns += (uint64_t)(next_random(sim) % (uint32_t)icmp_cfg.jitter_us) * 1000;
+    }
+    r.addr = addr;
+    r.slot = slot;
+    r.gen = gen;
+    return heap_push(sim, &r) == 0 ? 0 : -1;
+}
+
+static void sim_wait(void *ctx, int timeout_ms)
+{
+    sim_icmp_t *sim = ctx;
+    uint64_t deadline = bench_now_ns() + (uint64_t)timeout_ms * 1000000;
+
+    if (sim->count > 0 && sim->heap[0].due_ns < deadline) {
+        deadline = sim->heap[0].due_ns;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline / 1000000000);
+    ts.tv_nsec = (long)(deadline % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+        /* EINTR: sleep out the rest */
+    }
+}
+
+static void sim_drain(void *ctx, probe_sched_t *sched)
+{
+    sim_icmp_t *sim = ctx;
+    uint64_t now = bench_now_ns();
+
+    while (sim->count > 0 && sim->heap[0].due_ns <= now) {
+        sim_reply_t r = heap_pop(sim);
+        bench_sample_add(&icmp_latency, now - r.sent_ns);
+        probe_reply(sched, r.slot, r.gen, r.addr);
+    }
+}
+
+int __wrap_ping_sweep_source(const probe_config_t *cfg, probe_next_fn next, void *next_ctx,
+                             probe_result_cb cb, void *ctx, probe_stats_t *stats)
+{
+    sim_icmp_t sim;
+    probe_config_t run_cfg;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.rng = 2463534242U;
+    if (cfg != NULL) {
+        run_cfg = *cfg;
+    } else {
+        probe_config_default(&run_cfg);
+    }
+
+    probe_transport_t tp = { &sim, sim_send, sim_wait, sim_drain };
+    int alive = probe_run(&run_cfg, &tp, next, next_ctx, cb, ctx, stats);
+    free(sim.heap);
+    return alive;
+}
@@ -0,0 +1,895 @@
+/*
+ * Simulated SNMP Agents
+ * Each agent owns a UDP socket on 127.0.0.1 and serves a virtual MIB:
+ * a sorted list of columns whose rows are computed on demand, so a
+ * router with a large route or ARP table costs no memory. A few threads
+ * poll all agent sockets and answer Get, GetNext and GetBulk.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "bench.h"
+#include "host_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define SIM_MAX_AGENTS 512
+#define SIM_THREADS 4
+#define SIM_POLL_MS 50
+#define SIM_MAX_SUFFIX 5
+#define SIM_MAX_VARBINDS 128
+#define SIM_MAX_REPLY 32768           /* GetBulk responses are cut here */
+#define SIM_BER_DEPTH 8
+
+#define SIM_ROUTER_BASE 0x0afa0001U   /* 10.250.0.1 */
+#define SIM_ROUTE_BASE 0xac100000U    /* 172.16.0.0, one /28 per route */
+#define SIM_MAX_ROUTES 65536
+#define SIM_MAX_ARP 65000
+#define SIM_IF_LAST_CHANGE 100
+
+typedef enum {
+    COL_SYS_OBJECT_ID,
+    COL_SYS_UPTIME,
+    COL_IP_AD_ENT_ADDR,
+    COL_IP_AD_ENT_NET_MASK,
+    COL_IP_ROUTE_NEXT_HOP,
+    COL_IP_NET_TO_MEDIA_NET_ADDRESS,
+    COL_IF_DESCR,
+    COL_IF_TYPE,
+    COL_IF_SPEED,
+    COL_IF_ADMIN_STATUS,
+    COL_IF_OPER_STATUS,
+    COL_IF_IN_OCTETS,
+    COL_IF_IN_ERRORS,
+    COL_IF_OUT_OCTETS,
+    COL_IF_OUT_ERRORS,
+    COL_IF_NAME,
+    COL_IF_HC_IN_OCTETS,
+    COL_IF_HC_OUT_OCTETS,
+    COL_IF_HIGH_SPEED,
+    COL_IF_ALIAS,
+    COL_IF_TABLE_LAST_CHANGE
+} column_id_t;
+
+typedef struct {
+    column_id_t id;
+    const char *text;
+    snmp_oid_t base;                  /* Parsed from text when the first agent is added */
+} column_t;
+
+static column_t router_columns[] = {
+    { COL_SYS_OBJECT_ID, "1.3.6.1.2.1.1.2", { { 0 }, 0 } },
+    { COL_SYS_UPTIME, "1.3.6.1.2.1.1.3", { { 0 }, 0 } },
+    { COL_IP_AD_ENT_ADDR, "1.3.6.1.2.1.4.20.1.1", { { 0 }, 0 } },
+    { COL_IP_AD_ENT_NET_MASK, "1.3.6.1.2.1.4.20.1.3", { { 0 }, 0 } },
+    { COL_IP_ROUTE_NEXT_HOP, "1.3.6.1.2.1.4.21.1.7", { { 0 }, 0 } },
+    { COL_IP_NET_TO_MEDIA_NET_ADDRESS, "1.3.6.1.2.1.4.22.1.3", { { 0 }, 0 } },
+};
+
+static column_t device_columns[] = {
+    { COL_SYS_OBJECT_ID, "1.3.6.1.2.1.1.2", { { 0 }, 0 } },
+    { COL_SYS_UPTIME, "1.3.6.1.2.1.1.3", { { 0 }, 0 } },
+    { COL_IF_DESCR, "1.3.6.1.2.1.2.2.1.2", { { 0 }, 0 } },
+    { COL_IF_TYPE, "1.3.6.1.2.1.2.2.1.3", { { 0 }, 0 } },
+    { COL_IF_SPEED, "1.3.6.1.2.1.2.2.1.5", { { 0 }, 0 } },
+    { COL_IF_ADMIN_STATUS, "1.3.6.1.2.1.2.2.1.7", { { 0 }, 0 } },
+    { COL_IF_OPER_STATUS, "1.3.6.1.2.1.2.2.1.8", { { 0 }, 0 } },
+    { COL_IF_IN_OCTETS, "1.3.6.1.2.1.2.2.1.10", { { 0 }, 0 } },
+    { COL_IF_IN_ERRORS, "1.3.6.1.2.1.2.2.1.14", { { 0 }, 0 } },
+    { COL_IF_OUT_OCTETS, "1.3.6.1.2.1.2.2.1.16", { { 0 }, 0 } },
+    { COL_IF_OUT_ERRORS, "1.3.6.1.2.1.2.2.1.20", { { 0 }, 0 } },
+    { COL_IF_NAME, "1.3.6.1.2.1.31.1.1.1.1", { { 0 }, 0 } },
+    { COL_IF_HC_IN_OCTETS, "1.3.6.1.2.1.31.1.1.1.6", { { 0 }, 0 } },
+    { COL_IF_HC_OUT_OCTETS, "1.3.6.1.2.1.31.1.1.1.10", { { 0 }, 0 } },
+    { COL_IF_HIGH_SPEED, "1.3.6.1.2.1.31.1.1.1.15", { { 0 }, 0 } },
+    { COL_IF_ALIAS, "1.3.6.1.2.1.31.1.1.1.18", { { 0 }, 0 } },
+    { COL_IF_TABLE_LAST_CHANGE, "1.3.6.1.2.1.31.1.5", { { 0 }, 0 } },
+};
+
+#define ROUTER_COLUMN_COUNT ((int)(sizeof(router_columns) / sizeof(router_columns[0])))
+#define DEVICE_COLUMN_COUNT ((int)(sizeof(device_columns) / sizeof(device_columns[0])))
+
+typedef struct {
+    uint32_t addr;                    /* Simulated address */
+    int fd;
+    uint16_t port;                    /* Loopback port it really listens on */
+    const column_t *columns;          /* Sorted by base OID */
+    int column_count;
+    int index;                        /* Router number */
+    int router_count;
+    int routes;
+    int arp_entries;
+    int interfaces;
+    uint64_t first_ns;                /* Only touched by the agent's serving thread */
+    uint64_t last_ns;
+} sim_agent_t;
+
+static sim_agent_t agents[SIM_MAX_AGENTS];
+static int agent_count = 0;
+static host_index_t agent_index;      /* Simulated address -> agent */
+static pthread_t threads[SIM_THREADS];
+static int thread_count = 0;
+static atomic_int stopping;
+static atomic_uint_fast64_t requests;
+static uint64_t start_ns;
+
+/* ------------------------------------------------------------------ */
+/* Virtual MIB                                                        */
+/* ------------------------------------------------------------------ */
+
+/* Values are computed into this before encoding */
+typedef struct {
+    uint8_t type;
+    uint64_t u;                       /* INTEGER, counters, TimeTicks, IpAddress */
+    char str[32];
+    const snmp_oid_t *oid;
+} sim_value_t;
+
+static const snmp_oid_t cisco_object_id = { { 1, 3, 6, 1, 4, 1, 9, 1, 1 }, 9 };
+
+uint32_t sim_router_addr(int index)
+{
+    return SIM_ROUTER_BASE + (uint32_t)index;
+}
+
+/* Hosts and the router's own LAN address live in 10.<index + 1>.0.0/16 */
+static uint32_t router_lan(const sim_agent_t *a)
+{
+    return 0x0a000000U | ((uint32_t)(a->index + 1) << 16);
+}
+
+static int column_rows(const sim_agent_t *a, column_id_t col)
+{
+    switch (col) {
+        case COL_SYS_OBJECT_ID:
+        case COL_SYS_UPTIME:
+        case COL_IF_TABLE_LAST_CHANGE:
+            return 1;
+        case COL_IP_AD_ENT_ADDR:
+        case COL_IP_AD_ENT_NET_MASK:
+            return 2;
+        case COL_IP_ROUTE_NEXT_HOP:
+            return a->routes;
+        case COL_IP_NET_TO_MEDIA_NET_ADDRESS:
+            return a->arp_entries;
+        default:
+            return a->interfaces;
+    }
+}
+
+static int put_addr(uint32_t addr, uint32_t *ids)
+{
+    ids[0] = addr >> 24;
+    ids[1] = (addr >> 16) & 0xff;
+    ids[2] = (addr >> 8) & 0xff;
+    ids[3] = addr & 0xff;
+    return 4;
+}
+
+/* Interface addresses in index order: the LAN gateway, then the router address */
+static uint32_t interface_addr(const sim_agent_t *a, int row)
+{
+    return row == 0 ? router_lan(a) + 1 : a->addr;
+}
+
+/* Index suffix of a row; rows are numbered in increasing suffix order */
+static int row_suffix(const sim_agent_t *a, column_id_t col, int row, uint32_t *ids)
+{
+    switch (col) {
+        case COL_SYS_OBJECT_ID:
+        case COL_SYS_UPTIME:
+        case COL_IF_TABLE_LAST_CHANGE:
+            ids[0] = 0;
+            return 1;
+        case COL_IP_AD_ENT_ADDR:
+        case COL_IP_AD_ENT_NET_MASK:
+            return put_addr(interface_addr(a, row), ids);
+        case COL_IP_ROUTE_NEXT_HOP:
+            return put_addr(SIM_ROUTE_BASE + (uint32_t)row * 16, ids);
+        case COL_IP_NET_TO_MEDIA_NET_ADDRESS:
+            ids[0] = 1;                   /* ifIndex */
+            return 1 + put_addr(router_lan(a) + 2 + (uint32_t)row, ids + 1);
+        default:
+            ids[0] = (uint32_t)row + 1;   /* ifIndex */
+            return 1;
+    }
+}
+
+/* Next hop of a route: the tree neighbours in turn */
+static uint32_t route_next_hop(const sim_agent_t *a, int row)
+{
+    int hops[3];
+    int n = 0;
+
+    if (a->index > 0) hops[n++] = (a->index - 1) / 2;
+    if (2 * a->index + 1 < a->router_count) hops[n++] = 2 * a->index + 1;
+    if (2 * a->index + 2 < a->router_count) hops[n++] = 2 * a->index + 2;
+    return n > 0 ? sim_router_addr(hops[row % n]) : a->addr;
+}
+
+static void row_value(const sim_agent_t *a, column_id_t col, int row, sim_value_t *v)
+{
+    uint64_t ticks = (bench_now_ns() - start_ns) / 10000000;
+    uint64_t rate = 1000 + (uint64_t)row * 10;  /* Bytes per tick */
+
+    v->u = 0;
+    v->str[0] = '\0';
+    switch (col) {
+        case COL_SYS_OBJECT_ID:
+            v->type = SNMP_TYPE_OID;
+            v->oid = &cisco_object_id;
+            break;
+        case COL_SYS_UPTIME:
+            v->type = SNMP_TYPE_TIMETICKS;
+            v->u = ticks + 1000;
+            break;
+        case COL_IF_TABLE_LAST_CHANGE:
+            v->type = SNMP_TYPE_TIMETICKS;
+            v->u = SIM_IF_LAST_CHANGE;
+            break;
+        case COL_IP_AD_ENT_ADDR:
+            v->type = SNMP_TYPE_IPADDRESS;
+            v->u = interface_addr(a, row);
+            break;
+        case COL_IP_AD_ENT_NET_MASK:
+            v->type = SNMP_TYPE_IPADDRESS;
+            v->u = row == 0 ? 0xffff0000U : 0xffffffffU;
+            break;
+        case COL_IP_ROUTE_NEXT_HOP:
+            v->type = SNMP_TYPE_IPADDRESS;
+            v->u = route_next_hop(a, row);
+            break;
+        case COL_IP_NET_TO_MEDIA_NET_ADDRESS:
+            v->type = SNMP_TYPE_IPADDRESS;
+            v->u = router_lan(a) + 2 + (uint32_t)row;
+            break;
+        case COL_IF_DESCR:
+        case COL_IF_NAME:
+            v->type = SNMP_TYPE_OCTET_STRING;
+            snprintf(v->str, sizeof(v->str), "Gi0/%d", row);
+            break;
+        case COL_IF_ALIAS:
+            v->type = SNMP_TYPE_OCTET_STRING;
+            break;
+        case COL_IF_TYPE:
+            v->type = SNMP_TYPE_INTEGER;
+            v->u = 6;                     /* ethernetCsmacd */
+            break;
+        case COL_IF_SPEED:
+            v->type = SNMP_TYPE_GAUGE32;
+            v->u = 1000000000;
+            break;
+        case COL_IF_HIGH_SPEED:
+            v->type = SNMP_TYPE_GAUGE32;
+            v->u = 1000;
+            break;
+        case COL_IF_ADMIN_STATUS:
+        case COL_IF_OPER_STATUS:
+            v->type = SNMP_TYPE_INTEGER;
+            v->u = 1;
+            break;
+        case COL_IF_IN_OCTETS:
+        case COL_IF_OUT_OCTETS:
+            v->type = SNMP_TYPE_COUNTER32;
+            v->u = (ticks * rate) & 0xffffffffU;
+            break;
+        case COL_IF_HC_IN_OCTETS:
+        case COL_IF_HC_OUT_OCTETS:
+            v->type = SNMP_TYPE_COUNTER64;
+            v->u = ticks * rate;
+            break;
+        case COL_IF_IN_ERRORS:
+        case COL_IF_OUT_ERRORS:
+            v->type = SNMP_TYPE_COUNTER32;
+            break;
+    }
+}
+
+static int compare_ids(const uint32_t *a, int alen, const uint32_t *b, int blen)
+{
+    int n = alen < blen ? alen : blen;
+    for (int i = 0; i < n; i++) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return alen == blen ? 0 : (alen < blen ? -1 : 1);
+}
+
+/* First row whose suffix is >= rem (> rem if strict) */
+static int lower_bound(const sim_agent_t *a, column_id_t col, const uint32_t *rem, int remlen, int strict)
+{
+    int lo = 0, hi = column_rows(a, col);
+    uint32_t ids[SIM_MAX_SUFFIX];
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = compare_ids(ids, row_suffix(a, col, mid, ids), rem, remlen);
+        if (c < 0 || (strict && c == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Exact object; returns 1 with *col and *row set, or 0 */
+static int find_object(const sim_agent_t *a, const snmp_oid_t *oid, int *col, int *row)
+{
+    uint32_t ids[SIM_MAX_SUFFIX];
+
+    for (int c = 0; c < a->column_count; c++) {
+        const snmp_oid_t *base = &a->columns[c].base;
+        if (!snmp_oid_is_prefix(base, oid)) continue;
+
+        const uint32_t *rem = oid->ids + base->len;
+        int remlen = oid->len - base->len;
+        int r = lower_bound(a, a->columns[c].id, rem, remlen, 0);
+        if (r < column_rows(a, a->columns[c].id) &&
+            compare_ids(ids, row_suffix(a, a->columns[c].id, r, ids), rem, remlen) == 0) {
+            *col = c;
+            *row = r;
+            return 1;
+        }
+        return 0;
+    }
+    return 0;
+}
+
+/* First object after oid; returns 1 with *col and *row set, or 0 at the end of the MIB */
+static int next_object(const sim_agent_t *a, const snmp_oid_t *oid, int *col, int *row)
+{
+    for (int c = 0; c < a->column_count; c++) {
+        const snmp_oid_t *base = &a->columns[c].base;
+        int rows = column_rows(a, a->columns[c].id);
+        if (rows == 0) continue;
+
+        if (snmp_oid_is_prefix(base, oid)) {
+            int r = lower_bound(a, a->columns[c].id, oid->ids + base->len, oid->len - base->len, 1);
+            if (r < rows) {
+                *col = c;
+                *row = r;
+                return 1;
+            }
+        } else if (snmp_oid_compare(base, oid) > 0) {
+            *col = c;
+            *row = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* (col, row) as a full OID */
+static void object_oid(const sim_agent_t *a, int col, int row, snmp_oid_t *oid)
+{
+    *oid = a->columns[col].base;
+    oid->len += row_suffix(a, a->columns[col].id, row, oid->ids + oid->len);
+}
+
+/* ------------------------------------------------------------------ */
+/* BER                                                                */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t pos;
+    size_t stack[SIM_BER_DEPTH];
+    int depth;
+    int error;
+} writer_t;
+
+static void put(writer_t *w, const void *data, size_t len)
+{
+    if (w->error || w->pos + len > w->size) {
+        w->error = 1;
+        return;
+    }
+    memcpy(w->buf + w->pos, data, len);
+    w->pos += len;
+}
+
+static void put_tl(writer_t *w, uint8_t tag, size_t len)
+{
+    uint8_t hdr[4] = { tag, 0, 0, 0 };
+    size_t n;
+
+    if (len < 0x80) {
+        hdr[1] = (uint8_t)len;
+        n = 2;
+    } else if (len <= 0xff) {
+        hdr[1] = 0x81;
+        hdr[2] = (uint8_t)len;
+        n = 3;
+    } else {
+        hdr[1] = 0x82;
+        hdr[2] = (uint8_t)(len >> 8);
+        hdr[3] = (uint8_t)len;
+        n = 4;
+    }
+    put(w, hdr, n);
+}
+
+/* Constructed values: content first, then the header is slid in front */
+static void begin(writer_t *w, uint8_t tag)
+{
+    if (w->depth >= SIM_BER_DEPTH) {
+        w->error = 1;
+        return;
+    }
+    put(w, &tag, 1);
+    w->stack[w->depth++] = w->pos;
+}
+
+static void end(writer_t *w)
+{
+    if (w->error) return;
+
+    size_t start = w->stack[--w->depth];
+    size_t content = w->pos - start;
+    uint8_t hdr[4];
+    writer_t hw = { hdr, sizeof(hdr), 0, { 0 }, 0, 0 };
+
+    put_tl(&hw, 0, content);
+    size_t lsize = hw.pos - 1;
+    if (w->pos + lsize > w->size) {
+        w->error = 1;
+        return;
+    }
+    memmove(w->buf + start + lsize, w->buf + start, content);
+    memcpy(w->buf + start, hdr + 1, lsize);
+    w->pos += lsize;
+}
+
+/* Minimal two's complement (signed) or unsigned big-endian content */
+static void put_number(writer_t *w, uint8_t tag, uint64_t v, int is_signed)
+{
+    uint8_t tmp[9];
+    int n = 0;
+
+    for (int i = 7; i >= 0; i--) {
+        tmp[n++] = (uint8_t)(v >> (i * 8));
+    }
+    int skip = 0;
+    while (skip < 7 && tmp[skip] == 0 && !(tmp[skip + 1] & 0x80)) skip++;
+    if (is_signed) {
+        while (skip < 7 && tmp[skip] == 0xff && (tmp[skip + 1] & 0x80)) skip++;
+    }
+    if (!is_signed && skip == 0 && (tmp[0] & 0x80)) {
+        put_tl(w, tag, 9);
+        put(w, "", 1);
+        put(w, tmp, 8);
+        return;
+    }
+    put_tl(w, tag, (size_t)(8 - skip));
+    put(w, tmp + skip, (size_t)(8 - skip));
+}
+
+static void put_oid(writer_t *w, const snmp_oid_t *oid)
+{
+    uint8_t tmp[SNMP_MAX_OID_LEN * 5];
+    size_t n = 0;
+
+    for (int i = 1; i < oid->len; i++) {
+        uint32_t v = i == 1 ? oid->ids[0] * 40 + oid->ids[1] : oid->ids[i];
+        uint8_t rev[5];
+        int k = 0;
+        do {
+            rev[k++] = v & 0x7f;
+            v >>= 7;
+        } while (v > 0);
+        while (k-- > 0) {
+            tmp[n++] = (uint8_t)(rev[k] | (k > 0 ? 0x80 : 0x00));
+        }
+    }
+    put_tl(w, SNMP_TYPE_OID, n);
+    put(w, tmp, n);
+}
+
+static void put_value(writer_t *w, const sim_value_t *v)
+{
+    switch (v->type) {
+        case SNMP_TYPE_INTEGER:
+            put_number(w, v->type, v->u, 1);
+            break;
+        case SNMP_TYPE_OCTET_STRING: {
+            size_t len = strlen(v->str);
+            put_tl(w, v->type, len);
+            put(w, v->str, len);
+            break;
+        }
+        case SNMP_TYPE_OID:
+            put_oid(w, v->oid);
+            break;
+        case SNMP_TYPE_IPADDRESS: {
+            uint8_t ip[4] = {
+                (uint8_t)(v->u >> 24), (uint8_t)(v->u >> 16), (uint8_t)(v->u >> 8), (uint8_t)v->u
+            };
+            put_tl(w, v->type, 4);
+            put(w, ip, 4);
+            break;
+        }
+        case SNMP_TYPE_COUNTER32:
+        case SNMP_TYPE_GAUGE32:
+        case SNMP_TYPE_TIMETICKS:
+        case SNMP_TYPE_COUNTER64:
+            put_number(w, v->type, v->u, 0);
+            break;
+        default:
+            put_tl(w, v->type, 0);    /* NULL and exceptions */
+            break;
+    }
+}
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} reader_t;
+
+static int read_tlv(reader_t *r, uint8_t *tag, reader_t *sub)
+{
+    if (r->end - r->p < 2) return -1;
+    *tag = *r->p++;
+    size_t len = *r->p++;
+    if (len & 0x80) {
+        size_t n = len & 0x7f;
+        if (n == 0 || n > 3 || (size_t)(r->end - r->p) < n) return -1;
+        len = 0;
+        while (n-- > 0) len = (len << 8) | *r->p++;
+    }
+    if ((size_t)(r->end - r->p) < len) return -1;
+    sub->p = r->p;
+    sub->end = r->p + len;
+    r->p += len;
+    return 0;
+}
+
+static int expect(reader_t *r, uint8_t want, reader_t *sub)
+{
+    uint8_t tag;
+    return read_tlv(r, &tag, sub) == 0 && tag == want ? 0 : -1;
+}
+
+static int64_t read_signed(const reader_t *v)
+{
+    int64_t x = (v->end > v->p && (v->p[0] & 0x80)) ? -1 : 0;
+    for (const uint8_t *p = v->p; p < v->end; p++) {
+        x = (int64_t)(((uint64_t)x << 8) | *p);
+    }
+    return x;
+}
+
+static int read_oid(const reader_t *v, snmp_oid_t *oid)
+{
+    uint64_t acc = 0;
+
+    oid->len = 0;
+    for (const uint8_t *p = v->p; p < v->end; p++) {
+        acc = (acc << 7) | (*p & 0x7f);
+        if (*p & 0x80) continue;
+        if (oid->len == 0) {
+            oid->ids[0] = acc < 80 ? (uint32_t)acc / 40 : 2;
+            oid->ids[1] = acc < 80 ? (uint32_t)acc % 40 : (uint32_t)acc - 80;
+            oid->len = 2;
+        } else {
+            if (oid->len >= SNMP_MAX_OID_LEN) return -1;
+            oid->ids[oid->len++] = (uint32_t)acc;
+        }
+        acc = 0;
+    }
+    return oid->len > 0 ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------ */
+/* Request handling                                                   */
+/* ------------------------------------------------------------------ */
+
+static void put_varbind(writer_t *w, const snmp_oid_t *oid, const sim_value_t *v)
+{
+    begin(w, 0x30);
+    put_oid(w, oid);
+    put_value(w, v);
+    end(w);
+}
+
+static void put_object(writer_t *w, const sim_agent_t *a, int col, int row)
+{
+    snmp_oid_t oid;
+    sim_value_t v;
+
+    object_oid(a, col, row, &oid);
+    row_value(a, a->columns[col].id, row, &v);
+    put_varbind(w, &oid, &v);
+}
+
+static void put_exception(writer_t *w, const snmp_oid_t *oid, uint8_t type)
+{
+    sim_value_t v = { type, 0, "", NULL };
+    put_varbind(w, oid, &v);
+}
+
+/* The next object after oid, or endOfMibView; advances oid to it */
+static void put_next(writer_t *w, const sim_agent_t *a, snmp_oid_t *oid)
+{
+    int col, row;
+
+    if (next_object(a, oid, &col, &row)) {
+        object_oid(a, col, row, oid);
+        put_object(w, a, col, row);
+    } else {
+        put_exception(w, oid, SNMP_TYPE_END_OF_MIB_VIEW);
+    }
+}
+
+/* Build the response to req; returns its length, or 0 to drop the request */
+static size_t handle_request(const sim_agent_t *a, const uint8_t *req, size_t len, uint8_t *out)
+{
+    static _Thread_local snmp_oid_t oids[SIM_MAX_VARBINDS];
+    reader_t r = { req, req + len }, msg, field, pdu, list, vb;
+    uint8_t pdu_type;
+    int count = 0;
+
+    if (expect(&r, 0x30, &msg) != 0 || expect(&msg, SNMP_TYPE_INTEGER, &field) != 0 ||
+        expect(&msg, SNMP_TYPE_OCTET_STRING, &field) != 0) {
+        return 0;
+    }
+    if ((size_t)(field.end - field.p) != strlen(SIM_COMMUNITY) ||
+        memcmp(field.p, SIM_COMMUNITY, strlen(SIM_COMMUNITY)) != 0) {
+        return 0;                     /* Agents ignore wrong communities */
+    }
+    if (read_tlv(&msg, &pdu_type, &pdu) != 0) return 0;
+
+    reader_t id_field, a_field, b_field;
+    if (expect(&pdu, SNMP_TYPE_INTEGER, &id_field) != 0 ||
+        expect(&pdu, SNMP_TYPE_INTEGER, &a_field) != 0 ||
+        expect(&pdu, SNMP_TYPE_INTEGER, &b_field) != 0 ||
+        expect(&pdu, 0x30, &list) != 0) {
+        return 0;
+    }
+    while (list.p < list.end && count < SIM_MAX_VARBINDS) {
+        if (expect(&list, 0x30, &vb) != 0 || expect(&vb, SNMP_TYPE_OID, &field) != 0 ||
+            read_oid(&field, &oids[count]) != 0) {
+            return 0;
+        }
+        count++;
+    }
+
+    writer_t w = { out, SNMP_MAX_MSG_SIZE, 0, { 0 }, 0, 0 };
+    begin(&w, 0x30);
+    put_number(&w, SNMP_TYPE_INTEGER, 1, 1);
+    put_tl(&w, SNMP_TYPE_OCTET_STRING, strlen(SIM_COMMUNITY));
+    put(&w, SIM_COMMUNITY, strlen(SIM_COMMUNITY));
+    begin(&w, SNMP_PDU_RESPONSE);
+    put_number(&w, SNMP_TYPE_INTEGER, (uint64_t)read_signed(&id_field), 1);
+    put_number(&w, SNMP_TYPE_INTEGER, 0, 1);
+    put_number(&w, SNMP_TYPE_INTEGER, 0, 1);
+    begin(&w, 0x30);
+
+    if (pdu_type == SNMP_PDU_GET) {
+        for (int i = 0; i < count; i++) {
+            int col, row;
+            if (find_object(a, &oids[i], &col, &row)) {
+                put_object(&w, a, col, row);
+            } else {
+                put_exception(&w, &oids[i], SNMP_TYPE_NO_SUCH_OBJECT);
+            }
+        }
+    } else if (pdu_type == SNMP_PDU_GETNEXT) {
+        for (int i = 0; i < count; i++) {
+            put_next(&w, a, &oids[i]);
+        }
+    } else if (pdu_type == SNMP_PDU_GETBULK) {
+        int non_repeaters = (int)read_signed(&a_field);
+        int max_repetitions = (int)read_signed(&b_field);
+        if (non_repeaters < 0) non_repeaters = 0;
+        if (non_repeaters > count) non_repeaters = count;
+
+        for (int i = 0; i < non_repeaters; i++) {
+            put_next(&w, a, &oids[i]);
+        }
+        for (int rep = 0; rep < max_repetitions && w.pos < SIM_MAX_REPLY; rep++) {
+            for (int i = non_repeaters; i < count; i++) {
+                put_next(&w, a, &oids[i]);
+            }
+        }
+    } else {
+        return 0;
+    }
+
+    end(&w);
+    end(&w);
+    end(&w);
+    return w.error ? 0 : w.pos;
+}
+
+static void *serve_main(void *arg)
+{
+    int first = (int)(intptr_t)arg;
+    struct pollfd pfds[SIM_MAX_AGENTS];
+    sim_agent_t *owners[SIM_MAX_AGENTS];
+    uint8_t req[SNMP_MAX_MSG_SIZE];
+    uint8_t *out = malloc(SNMP_MAX_MSG_SIZE);
+    int n = 0;
+
+    if (out == NULL) {
+        return NULL;
+    }
+    for (int i = first; i < agent_count; i += SIM_THREADS) {
+        pfds[n].fd = agents[i].fd;
+        pfds[n].events = POLLIN;
+        owners[n++] = &agents[i];
+    }
+
+    while (!atomic_load(&stopping)) {
+        if (poll(pfds, (nfds_t)n, SIM_POLL_MS) <= 0) continue;
+
+        for (int i = 0; i < n; i++) {
+            if (!(pfds[i].revents & POLLIN)) continue;
+            for (;;) {
+                struct sockaddr_in from;
+                socklen_t fromlen = sizeof(from);
+                ssize_t len = recvfrom(pfds[i].fd, req, sizeof(req), 0, (struct sockaddr *)&from, &fromlen);
+                if (len < 0) break;
+
+                sim_agent_t *a = owners[i];
+                uint64_t now = bench_now_ns();
+                if (a->first_ns == 0) a->first_ns = now;
+                size_t out_len = handle_request(a, req, (size_t)len, out);
+                if (out_len > 0) {
+                    sendto(pfds[i].fd, out, out_len, 0, (struct sockaddr *)&from, fromlen);
+                    atomic_fetch_add(&requests, 1);
+                }
+                a->last_ns = bench_now_ns();
+            }
+        }
+    }
+    free(out);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Setup                                                              */
+/* ------------------------------------------------------------------ */
+
+static int compare_columns(const void *a, const void *b)
+{
+    return snmp_oid_compare(&((const column_t *)a)->base, &((const column_t *)b)->base);
+}
+
+static void prepare_columns(column_t *cols, int count)
+{
+    for (int i = 0; i < count; i++) {
+        snmp_oid_parse(cols[i].text, &cols[i].base);
+    }
+    qsort(cols, (size_t)count, sizeof(*cols), compare_columns);
+}
+
+static sim_agent_t *new_agent(uint32_t addr)
+{
+    struct sockaddr_in sa;
+    socklen_t salen = sizeof(sa);
+
+    if (agent_count == SIM_MAX_AGENTS || host_index_find(&agent_index, addr, NULL)) {
+        return NULL;
+    }
+    if (agent_count == 0) {
+        prepare_columns(router_columns, ROUTER_COLUMN_COUNT);
+        prepare_columns(device_columns, DEVICE_COLUMN_COUNT);
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    int bufsize = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 ||
+        getsockname(fd, (struct sockaddr *)&sa, &salen) != 0 ||
+        host_index_insert(&agent_index, addr, agent_count, NULL) != 1) {
+        close(fd);
+        return NULL;
+    }
+
+    sim_agent_t *a = &agents[agent_count++];
+    memset(a, 0, sizeof(*a));
+    a->addr = addr;
+    a->fd = fd;
+    a->port = ntohs(sa.sin_port);
+    return a;
+}
+
+int sim_snmp_add_router(int index, int router_count, int routes, int arp_entries)
+{
+    if (index < 0 || index >= 250 || routes < 0 || routes > SIM_MAX_ROUTES ||
+        arp_entries < 0 || arp_entries > SIM_MAX_ARP) {
+        return -1;
+    }
+
+    sim_agent_t *a = new_agent(sim_router_addr(index));
+    if (a == NULL) {
+        return -1;
+    }
+    a->columns = router_columns;
+    a->column_count = ROUTER_COLUMN_COUNT;
+    a->index = index;
+    a->router_count = router_count;
+    a->routes = routes;
+    a->arp_entries = arp_entries;
+    return 0;
+}
+
+int sim_snmp_add_device(uint32_t addr, int interfaces)
+{
+    sim_agent_t *a = new_agent(addr);
+    if (a == NULL) {
+        return -1;
+    }
+    a->columns = device_columns;
+    a->column_count = DEVICE_COLUMN_COUNT;
+    a->interfaces = interfaces;
+    return 0;
+}
+
+int sim_snmp_start(void)
+{
+    atomic_store(&stopping, 0);
+    atomic_store(&requests, 0);
+    start_ns = bench_now_ns();
+
+    for (thread_count = 0; thread_count < SIM_THREADS && thread_count < agent_count; thread_count++) {
+        if (pthread_create(&threads[thread_count], NULL, serve_main,
+                           (void *)(intptr_t)thread_count) != 0) {
+            sim_snmp_stop(NULL);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void sim_snmp_stop(bench_samples_t *spans)
+{
+    atomic_store(&stopping, 1);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    thread_count = 0;
+    for (int i = 0; i < agent_count; i++) {
+        if (spans != NULL && agents[i].first_ns != 0) {
+            bench_sample_add(spans, agents[i].last_ns - agents[i].first_ns);
+        }
+        close(agents[i].fd);
+    }
+    agent_count = 0;
+    host_index_free(&agent_index);
+}
+
+uint64_t sim_snmp_requests(void)
+{
+    return atomic_load(&requests);
+}
+
+/* Sessions to a simulated address go to its agent's loopback port */
+int __wrap_snmp_open(snmp_session_t *session, const char *ip, uint16_t port, const char *community)
+{
+    struct in_addr in;
+    int32_t slot;
+
+    if (ip != NULL && inet_pton(AF_INET, ip, &in) == 1 &&
+        host_index_find(&agent_index, ntohl(in.s_addr), &slot)) {
+        return __real_snmp_open(session, "127.0.0.1", agents[slot].port, community);
+    }
+    return __real_snmp_open(session, ip, port, community);
+}
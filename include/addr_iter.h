@@ -0,0 +1,44 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * CIDR Address Iterator
+ *
+ * Walks every host address of an IPv4 prefix using 32-bit integer
+ * arithmetic, either in order or in a pseudo-random permutation so
+ * consecutive probes are spread across the range.
+ */
+
+#ifndef ADDR_ITER_H
+#define ADDR_ITER_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t first;       /* First host address (host byte order) */
+    uint64_t count;       /* Number of host addresses in the range */
+    uint64_t produced;    /* Addresses returned so far */
+    int randomize;
+    /* Full-period LCG over [0, modulus) with cycle-walking past count */
+    uint64_t modulus;
+    uint64_t mult;
+    uint64_t incr;
+    uint64_t state;
+} addr_iter_t;
+
+/*
+ * Prepare an iterator over the hosts of network/prefix_len.
+ * Network and broadcast addresses are skipped for prefixes up to /30;
+ * /31 yields both addresses (RFC 3021) and /32 the single host.
+ * Returns 0 on success, -1 for an invalid prefix length.
+ */
+int addr_iter_init(addr_iter_t *it, uint32_t network, int prefix_len, int randomize);
+
+/*
+ * Produce the next address; signature matches probe_next_fn
+ * Returns 1 if *addr was set, 0 when the range is exhausted
+ */
+int addr_iter_next(void *it, uint32_t *addr);
+
+/* Total number of addresses the iterator will produce */
+uint64_t addr_iter_count(const addr_iter_t *it);
+
+#endif /* ADDR_ITER_H */
@@ -0,0 +1,87 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Alert Manager
+ *
+ * Alerts are kept in a fixed ring of compact records behind the
+ * add_alert()/get_alerts() API in netmon.h. A record names its device
+ * by database handle and its text by an interned template id, so it
+ * is 40 bytes rather than a full alert_t. Any number of threads may
+ * raise alerts; producers claim a position with one atomic add and
+ * never wait for readers. When the ring is full the oldest alerts are
+ * overwritten in order. Readers walk the stream with their own cursor
+ * and learn how many alerts they missed.
+ */
+
+#ifndef ALERT_H
+#define ALERT_H
+
+#include <stdint.h>
+#include "netmon.h"
+#include "device_db.h"
+
+/* Records retained; a power of two */
+#define ALERT_RING_SIZE MAX_ALERTS
+
+/* Distinct template and host strings; alerts beyond it lose their text */
+#define ALERT_MAX_STRINGS 1024
+
+/* Template placeholder replaced by the alert's value */
+#define ALERT_VALUE_MARK "{}"
+
+typedef struct {
+    uint64_t seq;                 /* Position in the alert stream */
+    int64_t timestamp_ms;
+    double value;                 /* Substituted for ALERT_VALUE_MARK if has_value */
+    uint32_t device_id;           /* Database device, 0 = host_id names the source */
+    int32_t device_slot;
+    uint16_t template_id;
+    uint16_t host_id;             /* Interned hostname when device_id is 0 */
+    uint8_t severity;             /* alert_severity_t */
+    uint8_t has_value;
+} alert_event_t;
+
+/*
+ * Intern a string (template or hostname); equal strings get equal ids
+ * Returns the id, or 0 if the string table is full
+ */
+uint16_t alert_intern(const char *text);
+
+/* Text of an interned id; "" for 0 or unknown ids */
+const char *alert_string(uint16_t id);
+
+/*
+ * Store a complete record; seq is assigned, timestamp_ms 0 means now
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if the record was dropped
+ * because a stalled producer still held its ring slot
+ */
+int alert_publish(alert_event_t *event);
+
+/*
+ * Raise an alert for a database device; value may be NULL
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if the record was dropped
+ * because a stalled producer still held its ring slot
+ */
+int alert_raise(alert_severity_t severity, const device_ref_t *ref, uint16_t template_id,
+                const double *value);
+
+/*
+ * Copy up to max_count alerts starting at *cursor (0 = stream start)
+ * and advance the cursor past them. Alerts overwritten before they were
+ * read are skipped and added to *lost if it is not NULL.
+ * Returns the number of alerts written
+ */
+int alert_read(uint64_t *cursor, alert_event_t *events, int max_count, uint64_t *lost);
+
+/* Position the next alert will take; a cursor for "new alerts only" */
+uint64_t alert_head(void);
+
+/* Expand a record into the alert_t form (hostname, formatted message) */
+void alert_format(const alert_event_t *event, alert_t *alert);
+
+/* Alerts raised since the last clear_alerts(), overwritten ones included */
+uint32_t alert_count(void);
+
+/* Records dropped because their slot was still being written */
+uint64_t alert_dropped(void);
+
+#endif /* ALERT_H */
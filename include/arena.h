@@ -0,0 +1,98 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Chunked Arena and String Pool
+ *
+ * chunk_array_t stores fixed-size elements in chunks of
+ * CHUNK_ARRAY_CHUNK_LEN. Growing adds a chunk and never moves an
+ * element, so indices and element pointers stay valid until
+ * chunk_array_free(). The chunk directory is part of the struct and
+ * never reallocated either, which lets a reader index any element it
+ * knows is published (e.g. below a count stored after the element was
+ * written) without taking the writer's lock. Chunks are published with
+ * a release store, so chunk_array_get() may also probe an index that
+ * was never reserved.
+ *
+ * string_pool_t interns strings: each distinct string is copied once
+ * into large blocks and every intern of an equal string returns the
+ * same pointer, valid until string_pool_free().
+ *
+ * Both start zeroed (chunk arrays via CHUNK_ARRAY_INIT) and release
+ * everything in one call. Neither is thread-safe for writers.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHUNK_ARRAY_CHUNK_SHIFT 12                   /* 4096 elements per chunk */
+#define CHUNK_ARRAY_CHUNK_LEN (1u << CHUNK_ARRAY_CHUNK_SHIFT)
+#define CHUNK_ARRAY_MAX_CHUNKS 1024                  /* Up to 4M elements */
+#define CHUNK_ARRAY_MAX_LEN ((uint32_t)CHUNK_ARRAY_MAX_CHUNKS * CHUNK_ARRAY_CHUNK_LEN)
+
+#define STRING_POOL_BLOCK_SIZE (64 * 1024)
+
+typedef struct {
+    void *chunks[CHUNK_ARRAY_MAX_CHUNKS];
+    size_t elem_size;
+    uint32_t chunk_count;
+} chunk_array_t;
+
+#define CHUNK_ARRAY_INIT(type) { { NULL }, sizeof(type), 0 }
+
+typedef struct string_block string_block_t;
+
+typedef struct {
+    const char *str;
+    uint32_t hash;
+    uint32_t len;
+} string_pool_slot_t;
+
+typedef struct {
+    string_block_t *blocks;      /* Newest first */
+    size_t block_used;           /* Bytes used in blocks */
+    string_pool_slot_t *slots;   /* Open addressing, at most half full */
+    uint32_t capacity;           /* Power of two, or 0 before first intern */
+    uint32_t count;
+    size_t bytes;                /* Block memory held */
+} string_pool_t;
+
+/*
+ * Pointer to element index, allocating its chunk if needed; new chunks
+ * are zeroed
+ * Returns NULL past CHUNK_ARRAY_MAX_LEN or on allocation failure
+ */
+void *chunk_array_reserve(chunk_array_t *a, uint32_t index);
+
+/* Pointer to an element already reserved */
+void *chunk_array_at(const chunk_array_t *a, uint32_t index);
+
+/*
+ * Pointer to element index, or NULL if its chunk was never reserved;
+ * safe against a concurrent chunk_array_reserve()
+ */
+void *chunk_array_get(const chunk_array_t *a, uint32_t index);
+
+/* Bytes held by allocated chunks */
+size_t chunk_array_bytes(const chunk_array_t *a);
+
+/* Release every chunk; the array may be reused afterwards */
+void chunk_array_free(chunk_array_t *a);
+
+/*
+ * Pooled, NUL-terminated copy of s[0, len)
+ * Returns the same pointer for equal strings, or NULL on allocation failure
+ */
+const char *string_pool_intern(string_pool_t *p, const char *s, size_t len);
+
+/* Number of distinct strings */
+uint32_t string_pool_count(const string_pool_t *p);
+
+/* Block and table memory held */
+size_t string_pool_bytes(const string_pool_t *p);
+
+/* Release every string at once; the pool may be reused afterwards */
+void string_pool_free(string_pool_t *p);
+
+#endif /* ARENA_H */
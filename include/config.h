@@ -0,0 +1,59 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Configuration Loading
+ *
+ * devices.conf holds one device per line, hostname;ip_address;community
+ * with an optional ;port, and is the source of truth for the devices it
+ * names. Loading it compares the file with the live device table and
+ * applies only the difference: new hostnames are added, hostnames that
+ * disappeared from the file are removed, and devices whose settings
+ * changed are updated. Devices added some other way (discovery,
+ * add_device()) are never removed by a reload. The file is parsed in a
+ * single pass over a read-only mapping, with no allocation per line.
+ *
+ * A community or port change keeps the device's id, metrics and poll
+ * schedule; an address change replaces the device.
+ *
+ * Threshold rules (THRESHOLD_DEFAULT_FILE in the same directory) are
+ * recompiled on every load. config_watch_start() reloads both files
+ * whenever they are rewritten or replaced, via inotify on their
+ * directory.
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/* Quiet time after the last change event before a reload */
+#define CONFIG_RELOAD_SETTLE_MS 200
+
+typedef struct {
+    int added;
+    int removed;
+    int changed;              /* Settings updated or address replaced */
+    int unchanged;
+    int rejected;             /* Malformed lines, invalid addresses, duplicates */
+    int skipped;              /* Valid devices the table refused */
+} config_diff_t;
+
+/* Called on the watcher thread after each reload */
+typedef void (*config_reload_cb)(const char *filename, int rc, const config_diff_t *diff, void *ctx);
+
+/*
+ * Bring the device table in line with filename; diff may be NULL.
+ * Malformed lines and devices the table refuses are reported on
+ * stderr, with their line numbers, and skipped.
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if the file cannot be read
+ * or memory runs out (the device table is then left alone)
+ */
+int config_apply(const char *filename, config_diff_t *diff);
+
+/*
+ * Watch filename and its threshold rules and call config_apply() after
+ * every change; cb may be NULL. filename is copied.
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if already watching or the
+ * directory cannot be watched
+ */
+int config_watch_start(const char *filename, config_reload_cb cb, void *ctx);
+void config_watch_stop(void);
+
+#endif /* CONFIG_H */
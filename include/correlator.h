@@ -0,0 +1,117 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Alert Correlation
+ *
+ * Stage between alert sources and the alert ring (alert.h) that keeps
+ * alert volume bounded during incidents:
+ * - status changes are reported once per (device, condition); a
+ *   recovery is held down for a while, so a device that fails again
+ *   meanwhile produces no further alerts
+ * - a device whose status changes too often within a window is
+ *   reported as flapping once, and its status alerts are suppressed
+ *   until it settles
+ * - a device found down is held briefly; if the router it sits behind
+ *   (inventory upstream, learned by the router crawl) is down by then,
+ *   the alert is suppressed and counted in one summary for the router
+ * - other alerts are deduplicated per (device, template) for the
+ *   hold-down time
+ * A batcher thread evaluates the threshold rules (threshold.h) over new
+ * samples, applies the timers and hands new ring records to subscribers
+ * at a fixed cadence. All functions are thread-safe.
+ */
+
+#ifndef CORRELATOR_H
+#define CORRELATOR_H
+
+#include <stdint.h>
+#include "netmon.h"
+#include "alert.h"
+#include "device_db.h"
+
+/* Default correlation settings */
+#define CORRELATE_DEFAULT_HOLD_DOWN_MS 30000
+#define CORRELATE_DEFAULT_SETTLE_MS 15000     /* Covers one poll interval of the upstream */
+#define CORRELATE_DEFAULT_FLAP_WINDOW_MS 600000
+#define CORRELATE_DEFAULT_FLAP_HIGH 6          /* Changes in the window to start flapping */
+#define CORRELATE_DEFAULT_FLAP_LOW 3           /* ... and to stop */
+#define CORRELATE_DEFAULT_BATCH_MS 1000
+#define CORRELATE_DEFAULT_BATCH_MAX 256
+
+/* Status changes remembered per device; bounds flap_high */
+#define CORRELATE_FLAP_HISTORY 16
+
+#define CORRELATE_MAX_SUBSCRIBERS 8
+
+typedef struct {
+    int hold_down_ms;         /* Recovery hold-down and dedup window */
+    int settle_ms;            /* Wait for the upstream's status before reporting down */
+    int flap_window_ms;
+    int flap_high;
+    int flap_low;
+    int batch_ms;             /* Subscriber delivery cadence */
+    int batch_max;            /* Records per subscriber call */
+} correlate_config_t;
+
+typedef struct {
+    uint64_t passed;              /* Alerts stored in the ring */
+    uint64_t deduplicated;
+    uint64_t held;                /* Absorbed by a hold-down or settle timer */
+    uint64_t flap_suppressed;
+    uint64_t topology_suppressed;
+    uint64_t batches;             /* Subscriber calls */
+    uint64_t lost;                /* Overwritten before delivery */
+} correlate_stats_t;
+
+/*
+ * Receives new alert records in stream order, from the batcher thread
+ * lost counts records overwritten since the previous batch
+ */
+typedef void (*alert_batch_cb)(const alert_event_t *events, int count, uint64_t lost, void *ctx);
+
+/* Fill cfg with the default settings */
+void correlate_config_default(correlate_config_t *cfg);
+
+/*
+ * Replace the settings; only allowed while the batcher is stopped
+ * Returns NETMON_SUCCESS or NETMON_ERROR
+ */
+int correlate_configure(const correlate_config_t *cfg);
+
+/* Start/stop the batcher thread; the monitor does both */
+int correlate_start(void);
+void correlate_stop(void);
+
+/*
+ * Register a batch consumer; delivery starts with alerts raised after
+ * the call. Returns NETMON_SUCCESS, or NETMON_ERROR if the table is full
+ */
+int correlate_subscribe(alert_batch_cb cb, void *ctx);
+void correlate_unsubscribe(alert_batch_cb cb, void *ctx);
+
+/* A device's status changed from before to after */
+void correlate_status(const device_ref_t *ref, device_status_t before, device_status_t after);
+
+/*
+ * Pass one alert record through deduplication and suppression
+ * Returns NETMON_SUCCESS if it was stored or deliberately suppressed,
+ * NETMON_ERROR if the ring dropped it
+ */
+int correlate_event(alert_event_t *event);
+
+/*
+ * Like correlate_event() for a source that already raises one alert per
+ * transition, such as a threshold rule firing or clearing: suppression
+ * applies, the template hold-down does not, so fire and clear always
+ * alternate
+ */
+int correlate_edge(alert_event_t *event);
+
+/* Apply expired timers now; the batcher calls this every batch_ms */
+void correlate_tick(void);
+
+void correlate_get_stats(correlate_stats_t *stats);
+
+/* Drop the per-device state; the batcher must be stopped */
+void correlate_free(void);
+
+#endif /* CORRELATOR_H */
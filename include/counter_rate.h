@@ -0,0 +1,68 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Counter Rates
+ *
+ * Turns successive interface octet counter readings into bit rates.
+ * Each poll feeds one reading per interface; the engine keeps the
+ * previous reading and a smoothed (EWMA) rate per interface, so every
+ * sample costs O(1) and no history is needed. Elapsed time comes from
+ * the agent's sysUpTime, which also exposes agent restarts; 32-bit
+ * counters are unwrapped, 64-bit counters that go backwards are treated
+ * as reset. All functions are thread-safe.
+ */
+
+#ifndef COUNTER_RATE_H
+#define COUNTER_RATE_H
+
+#include <stdint.h>
+
+/* Smoothing time constant: a rate step is ~63% reflected after this long */
+#define COUNTER_RATE_EWMA_TAU_MS 30000
+
+/* One interface's counters from one poll */
+typedef struct {
+    uint32_t ifindex;
+    uint8_t width;                /* 32 (ifInOctets) or 64 (ifHCInOctets) */
+    uint64_t in_octets;
+    uint64_t out_octets;
+} counter_sample_t;
+
+typedef struct {
+    uint32_t ifindex;
+    uint8_t width;
+    uint8_t valid;                /* 0 until two readings were seen */
+    uint64_t in_bps;              /* Smoothed, bits per second */
+    uint64_t out_bps;
+    uint64_t last_in_bps;         /* Over the last poll interval only */
+    uint64_t last_out_bps;
+} interface_rate_t;
+
+/* Result of one device update */
+typedef struct {
+    uint64_t in_bps;              /* Sum of the smoothed interface rates */
+    uint64_t out_bps;
+    int interfaces;               /* Interfaces with a valid rate */
+    int restarted;                /* Agent restart detected; baselines were reset */
+    int wraps;                    /* 32-bit counter wraps unwrapped in this update */
+} device_rate_t;
+
+/*
+ * Feed one poll of device id in metrics slot slot
+ * samples must be sorted by ifindex (SNMP walk order); interfaces no
+ * longer present are dropped. uptime is sysUpTime in TimeTicks (1/100 s),
+ * 0 if unknown (wall time is used then); now_ms is a monotonic clock.
+ * Returns NETMON_SUCCESS and fills result, or NETMON_ERROR
+ */
+int counter_rate_update(int slot, uint32_t id, uint32_t uptime, uint64_t now_ms,
+                        const counter_sample_t *samples, int count, device_rate_t *result);
+
+/*
+ * Copy the per-interface rates of a device, in ifindex order
+ * Returns the number written, or 0 if the slot holds no state for id
+ */
+int counter_rate_interfaces(int slot, uint32_t id, interface_rate_t *rates, int max_count);
+
+/* Release every device's state; no update may be running */
+void counter_rate_free(void);
+
+#endif /* COUNTER_RATE_H */
@@ -0,0 +1,49 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * SNMP Credential Cache
+ *
+ * Remembers which community string each device answered to, persisted
+ * next to configs/devices.conf, so later discovery runs go straight to
+ * the right credential instead of guessing. All functions are
+ * thread-safe.
+ */
+
+#ifndef CRED_CACHE_H
+#define CRED_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Format: ip_address;snmp_community, one device per line */
+#define CRED_CACHE_DEFAULT_PATH "configs/snmp_credentials.conf"
+
+/*
+ * Merge entries from path into the cache
+ * Returns the number of entries read, 0 if the file does not exist,
+ * or NETMON_ERROR on allocation failure
+ */
+int cred_cache_load(const char *path);
+
+/*
+ * Write the cache to path if it changed since the last load/save
+ * The file is replaced atomically and created with mode 0600
+ * Returns NETMON_SUCCESS or NETMON_ERROR
+ */
+int cred_cache_save(const char *path);
+
+/*
+ * Look up the community for addr (host byte order)
+ * Returns 1 and copies it into community if known, 0 otherwise
+ */
+int cred_cache_lookup(uint32_t addr, char *community, size_t size);
+
+/* Record the community that addr answered to */
+int cred_cache_store(uint32_t addr, const char *community);
+
+/* Forget the entry for addr (e.g. the credential stopped working) */
+void cred_cache_forget(uint32_t addr);
+
+/* Release all entries */
+void cred_cache_free(void);
+
+#endif /* CRED_CACHE_H */
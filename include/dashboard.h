@@ -0,0 +1,44 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Live Dashboard
+ *
+ * Full-screen ncurses view of the monitored devices, network totals and
+ * recent alerts, run on its own thread behind the init_display()/
+ * update_display() API in netmon.h. Each frame reads the device
+ * snapshot and metrics store without locks, recomposes only table rows
+ * whose device published a new sample, and sends only the cells that
+ * differ from the previous frame to the terminal. Frames are capped at
+ * a fixed rate; with nothing new a frame costs no terminal output.
+ *
+ * The topology view draws the layer-3 graph (topology.h) once the router
+ * crawl has built one, else groups devices under their inventory
+ * upstream. Keys: up/down/PgUp/PgDn/Home/End scroll, t toggles the
+ * topology view, r repaints the screen, q quits.
+ *
+ * Builds without ncurses keep the API; dashboard_start() then fails.
+ */
+
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#define DASHBOARD_DEFAULT_FRAME_MS 250   /* At most 4 frames per second */
+
+/* Seconds between re-reading device upstreams for the topology view */
+#define DASHBOARD_TOPOLOGY_REFRESH 10
+
+/*
+ * Start the dashboard thread on the controlling terminal; frame_ms <= 0
+ * selects DASHBOARD_DEFAULT_FRAME_MS. The caller must not write to the
+ * terminal until dashboard_wait() returns.
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if it is already running or
+ * the build has no ncurses
+ */
+int dashboard_start(int frame_ms);
+
+/* Block until the user quits the dashboard or dashboard_stop() is called */
+void dashboard_wait(void);
+
+/* Ask the dashboard to exit and wait for it */
+void dashboard_stop(void);
+
+#endif /* DASHBOARD_H */
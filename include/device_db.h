@@ -0,0 +1,126 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Device Database
+ *
+ * Table of monitored devices behind the add_device()/get_device() API
+ * in netmon.h. Each device holds a slot, a small integer that indexes
+ * its row in per-device tables (metrics store, poll schedule, rule
+ * state, ...). Slots are reused after a remove and the slot range grows
+ * a chunk at a time, up to DEVICE_DB_MAX_SLOTS; modules size their
+ * per-slot tables the same way, reserving rows as slots appear.
+ *
+ * The device list is published RCU-style: readers take a snapshot
+ * pointer without locking or copying and release it when done; adds
+ * and removes build a new snapshot and retire the old one, which is
+ * freed once no reader can still hold it (epoch-based reclamation).
+ * Entries carry only the cold identity and config fields; polled
+ * metrics live in the struct-of-arrays metrics store (metrics_store.h),
+ * indexed by the entry's slot.
+ */
+
+#ifndef DEVICE_DB_H
+#define DEVICE_DB_H
+
+#include <stdint.h>
+#include "netmon.h"
+#include "metrics_store.h"
+#include "arena.h"
+
+/* Concurrent snapshot holders; further readers wait for a free slot */
+#define DEVICE_DB_MAX_READERS 64
+
+/* Device slots, bounded by one chunk array per per-slot table */
+#define DEVICE_DB_MAX_SLOTS ((int)CHUNK_ARRAY_MAX_LEN)
+
+/* Stable handle to one device */
+typedef struct {
+    int slot;
+    uint32_t id;
+} device_ref_t;
+
+/*
+ * One device as published in a snapshot; immutable once published.
+ * Read its metrics with device_db_read_metrics().
+ */
+typedef struct {
+    char hostname[MAX_HOSTNAME_LEN];
+    char ip_address[MAX_IP_LEN];
+    char snmp_community[MAX_COMMUNITY_LEN];
+    uint16_t port;
+    uint32_t poll_interval_ms;
+    uint32_t id;
+    int slot;
+} device_entry_t;
+
+/* Immutable view of the device list, allocated to fit its entries */
+typedef struct {
+    uint32_t generation;
+    int count;
+    const device_entry_t *entries[];
+} device_snapshot_t;
+
+/*
+ * Pin the current snapshot; never blocks writers
+ * Every acquire must be paired with device_db_snapshot_release()
+ */
+const device_snapshot_t *device_db_snapshot_acquire(void);
+void device_db_snapshot_release(const device_snapshot_t *snapshot);
+
+/*
+ * Consistent copy of a device's latest metrics
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if the slot now holds another device
+ */
+int device_db_read_metrics(device_ref_t ref, device_metrics_t *metrics);
+
+/* Number of devices currently stored */
+int device_db_count(void);
+
+/* Incremented on every add or remove */
+uint32_t device_db_generation(void);
+
+/*
+ * One past the highest slot handed out; per-slot tables cover slots
+ * below it. Only drops on device_db_clear()
+ */
+int device_db_slot_limit(void);
+
+/*
+ * Handles of all devices in a malloc()ed array the caller frees
+ * Returns how many, or NETMON_ERROR if memory is exhausted
+ */
+int device_db_list(device_ref_t **refs);
+
+/*
+ * Find a device by hostname
+ * Returns NETMON_SUCCESS and fills ref, or NETMON_ERROR if unknown
+ */
+int device_db_find(const char *hostname, device_ref_t *ref);
+
+/*
+ * Copy the device behind ref, metrics included
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if it was removed
+ */
+int device_db_read(device_ref_t ref, network_device_t *device);
+
+/*
+ * Publish poll results: status, last_seen, counters, cpu/memory and
+ * response time are taken from metrics; identity fields are ignored.
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if the device was removed
+ */
+int device_db_update_metrics(device_ref_t ref, const network_device_t *metrics);
+
+/*
+ * Replace the polling settings of the device behind ref (community,
+ * port, poll_interval_ms) in place: it keeps its slot, id, metrics and
+ * place in the poll schedule; hostname and address are not changed.
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if it was removed
+ */
+int device_db_set_config(device_ref_t ref, const network_device_t *device);
+
+/*
+ * Remove every device and free retired snapshots, the slot table and
+ * the metrics store; pollers and other readers must be stopped
+ */
+void device_db_clear(void);
+
+#endif /* DEVICE_DB_H */
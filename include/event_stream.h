@@ -0,0 +1,76 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Event Stream
+ *
+ * Machine-readable output for daemon mode: discovered hosts, device
+ * samples and alerts as newline-delimited JSON, one object per line,
+ * each with a "type" and a "ts" in milliseconds since the epoch:
+ *   {"type":"host","ts":..,"ip":"10.0.0.5","rtt_ms":3}
+ *   {"type":"discovery","ts":..,"hosts":42,"duration_ms":5120}
+ *   {"type":"sample","ts":..,"host":"r1","ip":"10.0.0.1","status":"UP",..}
+ *   {"type":"alert","ts":..,"seq":7,"severity":"WARNING","host":"r1","message":".."}
+ *   {"type":"alerts_lost","ts":..,"count":3}
+ *
+ * Records are appended to a memory buffer and written out by a flusher
+ * thread in one write() per batch, either to stdout or to every client
+ * of a listening Unix socket. The flusher also emits a sample for each
+ * device whose metrics store version moved since the last batch; alerts
+ * arrive through a correlator subscription (correlator.h).
+ *
+ * Producers wait for buffer space rather than drop records, so a slow
+ * stdout reader slows the producers down. A socket client that cannot
+ * take a whole batch is disconnected instead; clients see records from
+ * the batch after they connect.
+ */
+
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <stdint.h>
+
+/* Default stream settings */
+#define EVENT_STREAM_DEFAULT_FLUSH_MS 500
+#define EVENT_STREAM_BUFFER_SIZE (64 * 1024)   /* Per batch; a batch is flushed early at half */
+#define EVENT_STREAM_MAX_CLIENTS 16
+
+typedef struct {
+    const char *socket_path;  /* Listen here instead of writing stdout, NULL = stdout; not copied */
+    int flush_ms;             /* Longest a record waits in the buffer */
+} event_stream_config_t;
+
+typedef struct {
+    uint64_t records;         /* Lines produced */
+    uint64_t bytes;
+    uint64_t batches;         /* write() calls to stdout, or batches sent to clients */
+    uint64_t disconnects;     /* Socket clients dropped for falling behind */
+    int clients;              /* Socket clients connected now */
+} event_stream_stats_t;
+
+/* Fill cfg with the default settings */
+void event_stream_config_default(event_stream_config_t *cfg);
+
+/*
+ * Start the flusher and subscribe to alerts
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if it is already running or
+ * the socket cannot be bound
+ */
+int event_stream_start(const event_stream_config_t *cfg);
+
+/* Flush what is buffered, stop the flusher and close the output */
+void event_stream_stop(void);
+
+/* Non-zero once writing to stdout failed (the reader went away) */
+int event_stream_failed(void);
+
+/* A discovered host; the signature of host_found_cb for set_discovery_callback() */
+void event_stream_host(const char *ip, int response_time_ms, void *ctx);
+
+/* A discovery run finished */
+void event_stream_discovery(int hosts, int64_t duration_ms);
+
+/* A config reload finished with rc (NETMON_SUCCESS or an error) */
+void event_stream_reload(int rc, int added, int removed, int changed, int rejected);
+
+void event_stream_get_stats(event_stream_stats_t *stats);
+
+#endif /* EVENT_STREAM_H */
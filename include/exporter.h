@@ -0,0 +1,57 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Prometheus Exporter
+ *
+ * Embedded HTTP endpoint serving GET /metrics in the Prometheus text
+ * exposition format (0.0.4): per-device status, response time, traffic
+ * and error counters and per-interface counters, read straight from the
+ * metrics store (metrics_store.h) and the interface table (if_table.h),
+ * plus netmon's own latency summaries and counters (selfstat.h).
+ *
+ * A scrape never takes a lock a poller needs: the device list comes
+ * from an RCU snapshot, device metrics through the store's sequence
+ * counters and interface rows through if_table_read(). It renders into
+ * buffers that are kept between scrapes and only grow, so a steady
+ * scrape allocates nothing. One thread accepts and answers scrapes one
+ * at a time.
+ */
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EXPORTER_DEFAULT_PORT 9105
+#define EXPORTER_IO_TIMEOUT_MS 5000   /* Per request read and response write */
+
+typedef struct {
+    uint64_t scrapes;             /* /metrics responses sent */
+    uint64_t errors;              /* Bad requests and failed writes */
+    uint64_t series;              /* Samples in the last response */
+    uint64_t bytes;               /* Body size of the last response */
+    uint64_t render_us;           /* Time to render the last response */
+} exporter_stats_t;
+
+/*
+ * Listen on "host:port", ":port" (all addresses) or "port" and start
+ * the server thread
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if it is already running or
+ * the address cannot be parsed or bound
+ */
+int exporter_start(const char *listen_addr);
+
+/* Stop the server thread and close the socket */
+void exporter_stop(void);
+
+/*
+ * Render the current metrics into the exporter's reused buffer and
+ * point *body at it; valid until the next render. Only for the server
+ * thread, or for callers that run while the server is stopped.
+ * Returns the body length
+ */
+size_t exporter_render(const char **body);
+
+void exporter_get_stats(exporter_stats_t *stats);
+
+#endif /* EXPORTER_H */
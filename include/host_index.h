@@ -0,0 +1,48 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Host Index
+ *
+ * Open-addressing hash map from a binary IPv4 address to a table index,
+ * used to deduplicate discovered hosts in O(1).
+ */
+
+#ifndef HOST_INDEX_H
+#define HOST_INDEX_H
+
+#include <stdint.h>
+
+/* Value stored for addresses that are known but have no table slot */
+#define HOST_INDEX_NO_SLOT (-1)
+
+typedef struct {
+    uint32_t *keys;       /* 0 marks an empty bucket */
+    int32_t *values;
+    uint32_t capacity;    /* Power of two, or 0 before first insert */
+    uint32_t count;
+    int has_zero;         /* 0.0.0.0 cannot use the empty marker */
+    int32_t zero_value;
+} host_index_t;
+
+/* Release all memory; the index may be reused afterwards */
+void host_index_free(host_index_t *idx);
+
+/* Remove all entries but keep the allocated buckets */
+void host_index_clear(host_index_t *idx);
+
+/*
+ * Look up addr (host byte order)
+ * Returns 1 and sets *value if present, 0 if absent
+ */
+int host_index_find(const host_index_t *idx, uint32_t addr, int32_t *value);
+
+/*
+ * Insert addr with value unless it is already present
+ * Returns 1 if inserted, 0 if already present (*existing set if not NULL),
+ * -1 on allocation failure
+ */
+int host_index_insert(host_index_t *idx, uint32_t addr, int32_t value, int32_t *existing);
+
+/* Number of addresses stored */
+uint32_t host_index_count(const host_index_t *idx);
+
+#endif /* HOST_INDEX_H */
@@ -0,0 +1,44 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Interface Poller
+ *
+ * SNMP side of the interface table: discovers a device's interfaces
+ * from ifTable/ifXTable and reads all per-interface counters of a poll
+ * with one multi-column GetBulk walk, feeding the rate engine and the
+ * interface table in a single pass over the response.
+ */
+
+#ifndef IF_POLLER_H
+#define IF_POLLER_H
+
+#include <stdint.h>
+#include "snmp.h"
+#include "device_db.h"
+
+/* IF-MIB ifTableLastChange.0; read with sysUpTime on every poll */
+#define OID_IF_TABLE_LAST_CHANGE "1.3.6.1.2.1.31.1.5.0"
+
+/* Device-wide sums of one poll */
+typedef struct {
+    int interfaces;               /* Rows with octet counters */
+    uint64_t in_octets;
+    uint64_t out_octets;
+    uint64_t in_errors;
+    uint64_t out_errors;
+    uint64_t in_bps;              /* Smoothed rate sum; 0 without ref */
+    uint64_t out_bps;
+} if_poll_result_t;
+
+/*
+ * Poll the interface counters of the device on session
+ * With ref, the interface list is (re)discovered first when
+ * last_change (ifTableLastChange, 0 if unknown) moved, and rates and
+ * interface rows are updated; without ref only the sums are computed.
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if no interface counters
+ * could be read or a walk was cut short (interface rows and rate state
+ * are then left as they were)
+ */
+int if_poll(snmp_session_t *session, const device_ref_t *ref, uint32_t uptime,
+            uint32_t last_change, if_poll_result_t *result);
+
+#endif /* IF_POLLER_H */
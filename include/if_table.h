@@ -0,0 +1,115 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Interface Table
+ *
+ * Per-interface rows keyed by (device, ifIndex), discovered from the
+ * IF-MIB ifTable/ifXTable and refreshed by every poll. Each device's
+ * rows are two contiguous arrays sorted by ifIndex: descriptive fields
+ * that only change on rediscovery, and counters that every poll
+ * rewrites in one merge pass. Arrays grow per device, never per row.
+ * Devices are addressed by their device database handle (slot, id).
+ * All functions are thread-safe.
+ */
+
+#ifndef IF_TABLE_H
+#define IF_TABLE_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* Rows across all devices */
+#define IF_TABLE_MAX_ROWS 131072
+
+/* Devices without ifTableLastChange are rediscovered this often */
+#define IF_TABLE_REDISCOVER_S 3600
+
+#define IF_NAME_LEN 32
+#define IF_DESCR_LEN 64
+#define IF_ALIAS_LEN 64
+
+/* IF-MIB ifAdminStatus / ifOperStatus values */
+#define IF_STATUS_UP 1
+#define IF_STATUS_DOWN 2
+
+/* Descriptive fields, from discovery */
+typedef struct {
+    uint32_t ifindex;
+    uint32_t type;                  /* IANAifType */
+    uint64_t speed_bps;             /* ifHighSpeed where set, else ifSpeed */
+    uint8_t admin_status;
+    uint8_t has_hc;                 /* ifHCInOctets present */
+    char name[IF_NAME_LEN];         /* ifName */
+    char descr[IF_DESCR_LEN];       /* ifDescr */
+    char alias[IF_ALIAS_LEN];       /* ifAlias */
+} if_info_t;
+
+/* Per-poll fields */
+typedef struct {
+    uint32_t ifindex;
+    uint8_t oper_status;
+    uint8_t width;                  /* Counter width, 32 or 64 */
+    uint64_t in_octets;
+    uint64_t out_octets;
+    uint32_t in_errors;
+    uint32_t out_errors;
+    uint64_t in_bps;                /* Smoothed rates (counter_rate.h) */
+    uint64_t out_bps;
+    time_t updated;
+} if_counters_t;
+
+typedef struct {
+    if_info_t info;
+    if_counters_t counters;
+} if_entry_t;
+
+/*
+ * Replace a device's interface list with rows sorted by ifindex;
+ * counters of interfaces that are still present are kept. last_change
+ * is the agent's ifTableLastChange (0 if it has none).
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if IF_TABLE_MAX_ROWS would be
+ * exceeded or memory runs out
+ */
+int if_table_set_interfaces(int slot, uint32_t id, const if_info_t *rows, int count,
+                            uint32_t last_change, time_t now);
+
+/*
+ * When the device's list was discovered
+ * Returns the number of interfaces, or -1 if it has not been discovered
+ */
+int if_table_discovery_state(int slot, uint32_t id, uint32_t *last_change, time_t *discovered_at);
+
+/* Non-zero if any interface of the device has 64-bit counters */
+int if_table_has_hc(int slot, uint32_t id);
+
+/*
+ * Merge one poll's counters, sorted by ifindex, into the device's rows
+ * Returns the number of rows that matched no known interface (a sign
+ * the list should be rediscovered), or NETMON_ERROR
+ */
+int if_table_update_counters(int slot, uint32_t id, const if_counters_t *rows, int count);
+
+/*
+ * Look up one interface
+ * Returns NETMON_SUCCESS or NETMON_ERROR if unknown
+ */
+int if_table_get(int slot, uint32_t id, uint32_t ifindex, if_entry_t *entry);
+
+/* Copy a device's interfaces in ifindex order; returns how many were written */
+int if_table_list(int slot, uint32_t id, if_entry_t *entries, int max_count);
+
+/*
+ * Copy a device's interfaces in ifindex order without taking the lock
+ * pollers use; retries while a poll is merging counters, so it never
+ * waits on an SNMP exchange. info is as of the last discovery.
+ * Returns the device's interface count (only max_count rows are
+ * written), or -1 if the slot holds another device
+ */
+int if_table_read(int slot, uint32_t id, if_entry_t *entries, int max_count);
+
+/* Rows held for all devices */
+int if_table_total(void);
+
+/* Drop every device's rows; no other if_table call may be in progress */
+void if_table_free(void);
+
+#endif /* IF_TABLE_H */
@@ -0,0 +1,108 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Host Inventory
+ *
+ * Persistent record of every host, router and swept subnet seen by
+ * discovery, so a restart can confirm what it already knows instead of
+ * rediscovering from scratch. The file is a versioned header followed
+ * by fixed-width records and is read with a single mmap. All functions
+ * are thread-safe.
+ */
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define INVENTORY_DEFAULT_PATH "configs/host_inventory.db"
+#define INVENTORY_VERSION 1
+
+/* Hosts not seen for this long are dropped */
+#define INVENTORY_DEFAULT_MAX_AGE_S (7 * 24 * 3600)
+
+/* A subnet is fully swept again after this long even if nothing changed */
+#define INVENTORY_RESWEEP_S 3600
+
+typedef enum {
+    INVENTORY_HOST = 0,
+    INVENTORY_SUBNET = 1
+} inventory_kind_t;
+
+/* Record flags */
+#define INVENTORY_FLAG_ROUTER 0x0001      /* Answered SNMP as a crawled router */
+
+/*
+ * One record, in memory and on disk (native byte order)
+ * Hosts: addr, response_time_ms, first/last_seen
+ * Subnets: addr/prefix_len, digest of the neighbor table at the last
+ * full sweep, and swept_at
+ */
+typedef struct {
+    uint32_t addr;                /* Host byte order */
+    uint8_t kind;                 /* inventory_kind_t */
+    uint8_t prefix_len;
+    uint16_t flags;
+    int32_t response_time_ms;
+    uint32_t upstream;            /* Hosts: router it was learned from, 0 = unknown */
+    int64_t first_seen;
+    int64_t last_seen;
+    uint64_t digest;
+    int64_t swept_at;
+} inventory_record_t;
+
+/*
+ * Replace the in-memory inventory with the contents of path
+ * Returns the number of records read, 0 if the file does not exist or
+ * has another version (the inventory then starts empty), or
+ * NETMON_ERROR on allocation failure
+ */
+int inventory_load(const char *path);
+
+/*
+ * Write the inventory to path if it changed; replaced atomically
+ * Returns NETMON_SUCCESS or NETMON_ERROR
+ */
+int inventory_save(const char *path);
+
+/* Drop all records */
+void inventory_free(void);
+
+/* Record that a host was seen at now; rtt_ms <= 0 keeps the last value */
+int inventory_touch_host(uint32_t addr, int rtt_ms, uint16_t flags, time_t now);
+
+/* Record the router a host sits behind (router 0 clears it) */
+int inventory_set_upstream(uint32_t addr, uint32_t router);
+
+/* Router a host sits behind, 0 if unknown */
+uint32_t inventory_upstream(uint32_t addr);
+
+/*
+ * Copy addresses of hosts seen at or after since, those with all of
+ * flags set; returns how many were written
+ */
+int inventory_list_hosts(time_t since, uint16_t flags, uint32_t *addrs, int max_count);
+
+/* Same, restricted to network/prefix_len */
+int inventory_list_subnet_hosts(uint32_t network, int prefix_len, time_t since,
+                                uint32_t *addrs, int max_count);
+
+/*
+ * Look up the last full sweep of a subnet
+ * Returns 1 and fills digest/swept_at if known, 0 otherwise
+ */
+int inventory_get_subnet(uint32_t network, int prefix_len, uint64_t *digest, time_t *swept_at);
+
+/* Record a full sweep of a subnet */
+int inventory_set_subnet(uint32_t network, int prefix_len, uint64_t digest, time_t swept_at);
+
+/*
+ * Remove hosts last seen before cutoff
+ * Returns the number removed
+ */
+int inventory_age_out(time_t cutoff);
+
+/* Number of host records */
+int inventory_host_count(void);
+
+#endif /* INVENTORY_H */
@@ -0,0 +1,89 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Hot Metrics Store
+ *
+ * Struct-of-arrays storage for the per-device values every poll cycle
+ * writes and every statistics pass reads. Each metric is one column
+ * indexed by device slot, contiguous within chunks of
+ * CHUNK_ARRAY_CHUNK_LEN slots and grown as slots are claimed, so
+ * aggregating a field over all devices is a linear pass over a few
+ * cache lines instead of a stride through large device records. Per-slot sequence counters let a
+ * poller publish one device's values atomically.
+ */
+
+#ifndef METRICS_STORE_H
+#define METRICS_STORE_H
+
+#include <stdint.h>
+#include "netmon.h"
+
+/* Values written by each poll */
+typedef struct {
+    device_status_t status;
+    time_t last_seen;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t in_bps;
+    uint64_t out_bps;
+    uint32_t errors_in;
+    uint32_t errors_out;
+    float cpu_usage;
+    float memory_usage;
+    int response_time_ms;
+} device_metrics_t;
+
+/* Column sums over every occupied slot */
+typedef struct {
+    uint32_t devices;
+    uint32_t up;
+    uint32_t down;
+    uint32_t warning;
+    uint64_t bytes_in;          /* Since the last metrics_store_rebase() */
+    uint64_t bytes_out;
+    uint64_t in_bps;
+    uint64_t out_bps;
+    uint64_t errors_in;
+    uint64_t errors_out;
+    uint64_t response_time_sum; /* Over devices with a response time */
+    uint32_t response_time_count;
+    double cpu_sum;
+    double memory_sum;
+} metrics_totals_t;
+
+/*
+ * Give slot to device id with initial values (NULL = zeros), growing
+ * the columns to cover it
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if memory is exhausted
+ */
+int metrics_store_claim(int slot, uint32_t id, const device_metrics_t *initial);
+
+/* Mark slot free; readers holding the old id get NETMON_ERROR afterwards */
+void metrics_store_release(int slot);
+
+/*
+ * Publish or read one device's values
+ * Return NETMON_SUCCESS, or NETMON_ERROR if slot no longer belongs to id
+ */
+int metrics_store_write(int slot, uint32_t id, const device_metrics_t *metrics);
+int metrics_store_read(int slot, uint32_t id, device_metrics_t *metrics);
+int metrics_store_set_status(int slot, uint32_t id, device_status_t status);
+
+/*
+ * Write counter of slot; it changes whenever the slot's values are
+ * written, so a reader can tell a new poll from one it has seen
+ */
+uint32_t metrics_store_version(int slot);
+
+/*
+ * Sum every column in one pass. Each value is read whole, but under
+ * concurrent polls different devices may reflect different poll rounds.
+ */
+void metrics_store_aggregate(metrics_totals_t *totals);
+
+/* Make current byte counters the zero point for aggregated traffic */
+void metrics_store_rebase(void);
+
+/* Release every column; only once nothing reads or writes the store */
+void metrics_store_free(void);
+
+#endif /* METRICS_STORE_H */
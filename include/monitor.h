@@ -0,0 +1,62 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Polling Engine
+ *
+ * Continuous SNMP poller behind start_monitoring()/stop_monitoring().
+ * Every device's next poll deadline lives on a hierarchical timer wheel;
+ * first deadlines are spread evenly across the interval and each poll
+ * is re-armed with jitter, so the packet rate stays smooth instead of
+ * bursting once per interval. A small worker pool runs the polls.
+ */
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include "netmon.h"
+#include "tsdb.h"
+#include "if_table.h"
+
+/* Default engine settings */
+#define MONITOR_DEFAULT_INTERVAL_MS 10000
+#define MONITOR_DEFAULT_JITTER_PCT 10
+#define MONITOR_DEFAULT_WORKERS 8
+#define MONITOR_TICK_MS 10
+#define MONITOR_MAX_WORKERS 64
+
+typedef struct {
+    int workers;              /* Concurrent polls */
+    int interval_ms;          /* Default for devices with poll_interval_ms == 0 */
+    int jitter_pct;           /* +/- spread applied to each re-arm */
+    int snmp_timeout_ms;
+    int snmp_retries;
+    const char *history_dir;  /* Metric history (tsdb.h) directory, NULL = none; not copied */
+} monitor_config_t;
+
+/* Fill cfg with the default settings */
+void monitor_config_default(monitor_config_t *cfg);
+
+/*
+ * Replace the engine settings; only allowed while monitoring is stopped
+ * Returns NETMON_SUCCESS or NETMON_ERROR
+ */
+int monitor_configure(const monitor_config_t *cfg);
+
+/* Non-zero while the poller threads are running */
+int monitor_is_running(void);
+
+/*
+ * Poll one device once, outside the schedule, and store the results
+ * in metrics (identity fields are left untouched). Rates (in_bps/
+ * out_bps) are only tracked for polls of database devices.
+ * Returns NETMON_SUCCESS if the device answered SNMP, NETMON_NO_RESPONSE
+ * if only ICMP answered, NETMON_TIMEOUT if it is down
+ */
+int monitor_poll_once(network_device_t *metrics);
+
+/*
+ * Copy the interface table of a device as of its last scheduled poll
+ * Returns the number of entries written, or NETMON_ERROR if unknown
+ */
+int monitor_get_interfaces(const char *hostname, if_entry_t *entries, int max_count);
+
+#endif /* MONITOR_H */
@@ -18,11 +18,10 @@
 #define NETMON_VERSION_PATCH 0
 
 /* Configuration constants */
-#define MAX_DEVICES 256
 #define MAX_HOSTNAME_LEN 256
 #define MAX_IP_LEN 16
 #define MAX_COMMUNITY_LEN 64
-#define MAX_ALERTS 1000
+#define MAX_ALERTS 4096            /* Alerts retained by the alert ring */
 #define DEFAULT_SNMP_PORT 161
 #define DEFAULT_TIMEOUT 5
 
@@ -58,11 +57,14 @@ typedef struct {
     time_t last_seen;
     uint64_t bytes_in;
     uint64_t bytes_out;
+    uint64_t in_bps;              /* Smoothed rate over all interfaces, bits/s */
+    uint64_t out_bps;
     uint32_t errors_in;
     uint32_t errors_out;
     float cpu_usage;
     float memory_usage;
     int response_time_ms;
+    uint32_t poll_interval_ms;    /* 0 = monitor default */
 } network_device_t;
 
 /* Alert structure */
@@ -80,6 +82,8 @@ typedef struct {
     uint32_t inactive_devices;
     uint64_t total_bytes_in;
     uint64_t total_bytes_out;
+    uint64_t total_in_bps;        /* Current aggregate rate, bits/s */
+    uint64_t total_out_bps;
     uint32_t total_alerts;
     float avg_response_time;
 } network_stats_t;
@@ -119,6 +123,8 @@ int save_config(const char *filename);
 const char* status_to_string(device_status_t status);
 const char* severity_to_string(alert_severity_t severity);
 int is_valid_ip(const char *ip);
+int ipv4_parse(const char *text, size_t len, uint32_t *addr);  /* Host byte order; 1 = ok */
+int ipv4_is_host(uint32_t addr);
 time_t get_current_time(void);
 
 /* Network communication functions */
@@ -136,11 +142,19 @@ int discover_snmp_arp(const char *router_ip, const char *community);
 int discover_netstat(void);
 int discover_efficient(void);
 int discover_automatic(void);  /* Fully automatic - no input required */
+int discover_passive(int seconds);  /* Listen only: ARP, LLDP, CDP */
 int traceroute_discover(const char *target_ip, char gateways[][MAX_IP_LEN], int *gateway_count);
 int scan_subnet(const char *network_addr, int prefix_len);
+typedef void (*host_found_cb)(const char *ip, int response_time_ms, void *ctx);
+int scan_subnet_stream(const char *network_addr, int prefix_len, int randomize,
+                       host_found_cb cb, void *ctx);
+void set_discovery_callback(host_found_cb cb, void *ctx);  /* Streams hosts as found */
+void set_discovery_verbose(int verbose);  /* 0 = no progress or result printing */
 int get_local_network_info(char *local_ip, char *network_addr, char *netmask);
 int get_discovered_count(void);
 int get_discovered_host(int index, char *ip, int *response_time);
+int get_discovered_neighbor(int index, char *name, size_t name_size, char *port, size_t port_size);
+void cleanup_discovery(void);
 
 /* Visualization functions */
 int init_display(void);
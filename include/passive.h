@@ -0,0 +1,86 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Passive Listener
+ *
+ * Learns hosts and neighbor devices from traffic that is on the wire
+ * anyway: ARP requests/replies (including gratuitous ARP), LLDP and
+ * Cisco CDP advertisements. Frames are read from an AF_PACKET
+ * TPACKET_V3 ring behind a kernel BPF filter that only passes those
+ * protocols, and parsed in place; nothing is allocated per packet and
+ * no probe traffic is sent.
+ */
+
+#ifndef PASSIVE_H
+#define PASSIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Default ring geometry: 8 blocks of 256 KiB */
+#define PASSIVE_DEFAULT_BLOCK_SIZE (256 * 1024)
+#define PASSIVE_DEFAULT_BLOCK_COUNT 8
+#define PASSIVE_DEFAULT_BLOCK_TIMEOUT_MS 100
+
+/* What kind of frame produced an event */
+typedef enum {
+    PASSIVE_SOURCE_ARP,       /* ARP request or reply: sender binding */
+    PASSIVE_SOURCE_GARP,      /* Gratuitous ARP announcement */
+    PASSIVE_SOURCE_LLDP,      /* LLDP advertisement */
+    PASSIVE_SOURCE_CDP        /* Cisco Discovery Protocol advertisement */
+} passive_source_t;
+
+/*
+ * One learned binding. The name and port pointers reference the frame
+ * inside the ring and are only valid during the callback; they are not
+ * NUL-terminated.
+ */
+typedef struct {
+    passive_source_t source;
+    int ifindex;                  /* Interface the frame arrived on */
+    uint8_t mac[6];               /* Sender hardware address */
+    uint32_t addr;                /* IPv4, host byte order; 0 if not advertised */
+    const char *name;             /* LLDP system name / chassis id, CDP device id */
+    size_t name_len;
+    const char *port;             /* Neighbor's port id */
+    size_t port_len;
+} passive_event_t;
+
+/* Runs on the capture thread; must not block for long */
+typedef void (*passive_event_cb)(const passive_event_t *event, void *ctx);
+
+typedef struct {
+    const char *ifname;           /* Capture interface, NULL = all */
+    unsigned int block_size;      /* Ring block size, power-of-two multiple of the page size */
+    unsigned int block_count;
+    unsigned int block_timeout_ms;  /* Hand a partly filled block to us after this long */
+} passive_config_t;
+
+typedef struct {
+    uint64_t frames;              /* Frames that passed the filter */
+    uint64_t arp;
+    uint64_t lldp;
+    uint64_t cdp;
+    uint64_t malformed;
+    uint64_t kernel_drops;        /* Ring overruns reported by the kernel */
+} passive_stats_t;
+
+/* Fill cfg with the default settings */
+void passive_config_default(passive_config_t *cfg);
+
+/*
+ * Open the ring and start the capture thread
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if already running or the
+ * socket cannot be opened (needs CAP_NET_RAW)
+ */
+int passive_start(const passive_config_t *cfg, passive_event_cb cb, void *ctx);
+
+/* Stop the capture thread and unmap the ring; safe if not running */
+void passive_stop(void);
+
+/* Non-zero while the capture thread runs */
+int passive_is_running(void);
+
+/* Counters since the last passive_start() */
+void passive_get_stats(passive_stats_t *stats);
+
+#endif /* PASSIVE_H */
@@ -0,0 +1,40 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * ICMP Echo Engine
+ *
+ * In-process ICMP echo sweeps over a single socket. Used by the
+ * discovery module and by ping_device() instead of forking ping(8).
+ */
+
+#ifndef PING_H
+#define PING_H
+
+#include <stdint.h>
+#include "probe.h"
+
+/* Default per-probe timeout used by discovery sweeps (milliseconds) */
+#define PING_DEFAULT_TIMEOUT_MS 1000
+
+/*
+ * Called once for every target that answered.
+ * addr is the IPv4 address in host byte order, rtt_ms is >= 1.
+ */
+typedef probe_result_cb ping_result_cb;
+
+/*
+ * Probe every address in targets (host byte order) through the probe
+ * scheduler using the process-wide defaults, with timeout_ms as the
+ * initial timeout. Returns the number of targets that answered, or -1
+ * on socket error.
+ */
+int ping_sweep(const uint32_t *targets, int count, int timeout_ms,
+               ping_result_cb cb, void *ctx);
+
+/*
+ * Sweep targets pulled lazily from next() with an explicit scheduler
+ * configuration (NULL for defaults). stats may be NULL.
+ */
+int ping_sweep_source(const probe_config_t *cfg, probe_next_fn next, void *next_ctx,
+                      ping_result_cb cb, void *ctx, probe_stats_t *stats);
+
+#endif /* PING_H */
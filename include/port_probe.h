@@ -0,0 +1,67 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * TCP and SNMP Liveness Probes
+ *
+ * Liveness for hosts behind ICMP filters. Each probe opens a
+ * non-blocking TCP connect to every configured port and sends one
+ * SNMPv2c Get for sysUpTime.0 over a shared UDP socket. A host is alive
+ * if any connect completes or is refused (an RST comes from the host's
+ * own stack), if the agent answers, or if the host itself reports the
+ * SNMP port unreachable.
+ *
+ * All sockets are multiplexed through one epoll instance and driven by
+ * the probe scheduler (probe.h), so pacing, windowing, retries and the
+ * adaptive timeout are the same as for ICMP sweeps. A probe's token is
+ * one target, however many ports it tries.
+ */
+
+#ifndef PORT_PROBE_H
+#define PORT_PROBE_H
+
+#include <stdint.h>
+#include "probe.h"
+
+#define PORT_PROBE_MAX_TCP_PORTS 8
+#define PORT_PROBE_DEFAULT_TCP_PORTS { 22, 23, 443 }
+#define PORT_PROBE_DEFAULT_COMMUNITY "public"
+
+typedef struct {
+    uint16_t tcp_ports[PORT_PROBE_MAX_TCP_PORTS];
+    int tcp_port_count;               /* 0 disables TCP probes */
+    int snmp;                         /* Non-zero to send the SNMP Get */
+    uint16_t snmp_port;
+    char snmp_community[64];
+} port_probe_config_t;
+
+/* Fill cfg with the process-wide defaults */
+void port_probe_config_default(port_probe_config_t *cfg);
+
+/* Replace the process-wide defaults used by fallback sweeps and device checks */
+void port_probe_set_defaults(const port_probe_config_t *cfg);
+
+/*
+ * Parse a comma-separated port list ("22,23,443") into cfg
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if a port is invalid or
+ * there are more than PORT_PROBE_MAX_TCP_PORTS
+ */
+int port_probe_parse_ports(const char *list, port_probe_config_t *cfg);
+
+/*
+ * Probe targets pulled from next() with an explicit scheduler and probe
+ * configuration (NULL for defaults). The in-flight window is capped so
+ * every probe's sockets fit under RLIMIT_NOFILE, whose soft limit is
+ * raised towards the hard limit when needed. stats may be NULL.
+ * Returns the number of targets found alive, or -1 on socket error
+ */
+int port_probe_sweep_source(const probe_config_t *cfg, const port_probe_config_t *pcfg,
+                            probe_next_fn next, void *next_ctx,
+                            probe_result_cb cb, void *ctx, probe_stats_t *stats);
+
+/*
+ * Probe a single device with the defaults and one retry
+ * Returns NETMON_SUCCESS with response_time set (connect or reply
+ * time), NETMON_TIMEOUT if nothing answered, or NETMON_ERROR
+ */
+int port_probe_device(const char *ip, int *response_time);
+
+#endif /* PORT_PROBE_H */
@@ -0,0 +1,108 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Probe Scheduler
+ *
+ * Rate-limited, windowed scheduler that drives liveness probes over a
+ * pluggable transport: token-bucket packets-per-second cap, bounded
+ * number of outstanding probes, per-target retries with exponential
+ * backoff and an adaptive timeout derived from observed RTT
+ * (SRTT/RTTVAR as in RFC 6298).
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdint.h>
+
+/* Default scheduler settings */
+#define PROBE_DEFAULT_PPS 2000
+#define PROBE_DEFAULT_BURST 64
+#define PROBE_DEFAULT_MAX_INFLIGHT 1024
+#define PROBE_DEFAULT_RETRIES 2
+#define PROBE_DEFAULT_RTO_MS 1000
+#define PROBE_DEFAULT_MIN_RTO_MS 200
+#define PROBE_DEFAULT_MAX_RTO_MS 3000
+
+/* Hard limit imposed by the 16-bit slot number carried in each probe */
+#define PROBE_MAX_INFLIGHT_LIMIT 65535
+
+/* Scheduler tuning */
+typedef struct {
+    int max_pps;          /* Token bucket rate, 0 = unlimited */
+    int burst;            /* Token bucket depth */
+    int max_inflight;     /* Maximum outstanding probes */
+    int max_retries;      /* Retransmissions per target after the first probe */
+    int initial_rto_ms;   /* Timeout before the first RTT sample */
+    int min_rto_ms;       /* Lower clamp for the adaptive timeout */
+    int max_rto_ms;       /* Upper clamp, also caps backoff */
+} probe_config_t;
+
+/* Counters reported at the end of a run */
+typedef struct {
+    uint64_t sent;        /* Probes transmitted, including retries */
+    uint64_t retries;     /* Retransmissions */
+    uint64_t replies;     /* Targets that answered */
+    uint64_t timeouts;    /* Targets that never answered */
+    uint64_t send_errors; /* Targets dropped because send failed */
+    int srtt_ms;          /* Smoothed RTT at the end of the run */
+    int rto_ms;           /* Adaptive timeout at the end of the run */
+} probe_stats_t;
+
+typedef struct probe_sched probe_sched_t;
+
+/*
+ * Produce the next target address (host byte order)
+ * Returns 1 if *addr was set, 0 when the target list is exhausted
+ */
+typedef int (*probe_next_fn)(void *ctx, uint32_t *addr);
+
+/*
+ * Called once per target that answered; rtt_ms is >= 1
+ */
+typedef void (*probe_result_cb)(uint32_t addr, int rtt_ms, void *ctx);
+
+/*
+ * Transport operations. A probe is identified by (slot, gen): the slot is
+ * the scheduler's in-flight index and gen distinguishes retransmissions.
+ * Transports echo both back through probe_reply().
+ */
+typedef struct {
+    void *ctx;
+    /* Returns 0 on success, 1 if the send should be retried later, -1 to drop */
+    int (*send)(void *ctx, uint32_t addr, uint16_t slot, uint16_t gen);
+    /* Block until replies may be available or timeout_ms elapses */
+    void (*wait)(void *ctx, int timeout_ms);
+    /* Read all pending replies, calling probe_reply() for each */
+    void (*drain)(void *ctx, probe_sched_t *sched);
+} probe_transport_t;
+
+/* Fill cfg with the process-wide defaults */
+void probe_config_default(probe_config_t *cfg);
+
+/* Replace the process-wide defaults used by discovery sweeps */
+void probe_set_defaults(const probe_config_t *cfg);
+
+/*
+ * Report a reply from addr for probe (slot, gen)
+ * Stale, duplicate or mismatched replies are ignored
+ */
+void probe_reply(probe_sched_t *sched, uint16_t slot, uint16_t gen, uint32_t addr);
+
+/*
+ * Run the scheduler until every target has answered or exhausted its
+ * retries. Returns the number of targets that answered, -1 on error.
+ */
+int probe_run(const probe_config_t *cfg, const probe_transport_t *tp,
+              probe_next_fn next, void *next_ctx,
+              probe_result_cb cb, void *cb_ctx, probe_stats_t *stats);
+
+/* Target source over a plain array, for use with probe_run() */
+typedef struct {
+    const uint32_t *targets;
+    int count;
+    int pos;
+} probe_array_source_t;
+
+int probe_array_next(void *ctx, uint32_t *addr);
+
+#endif /* PROBE_H */
@@ -0,0 +1,66 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Router Crawler
+ *
+ * Concurrent breadth-first SNMP crawl over the next-hop graph. A pool
+ * of worker threads pulls per-router tasks (credential probe, interface,
+ * next-hop and ARP walks) from a shared queue, so walks on the same
+ * router overlap and many routers are queried at once. Next hops found
+ * on the way are appended to the graph while the crawl runs.
+ */
+
+#ifndef ROUTER_CRAWL_H
+#define ROUTER_CRAWL_H
+
+#include <stdint.h>
+
+/* Default crawler settings */
+#define CRAWL_DEFAULT_WORKERS 16
+#define CRAWL_DEFAULT_MAX_ROUTERS 0       /* 0 = no limit */
+
+/* Where a reported address was learned */
+typedef enum {
+    CRAWL_SOURCE_ROUTER,      /* A router reached by the crawl (seed or next hop) */
+    CRAWL_SOURCE_INTERFACE,   /* ipAdEntAddr on a router */
+    CRAWL_SOURCE_ARP          /* ipNetToMediaNetAddress on a router */
+} crawl_source_t;
+
+/*
+ * Called for every address learned, addr in host byte order. via is the
+ * router it was learned from (0 for seeds), which is the next hop
+ * towards addr as seen from the crawl's starting point.
+ * Calls are serialized; the callback never runs concurrently with itself.
+ */
+typedef void (*crawl_host_cb)(uint32_t addr, crawl_source_t source, uint32_t via, void *ctx);
+
+typedef struct {
+    int workers;          /* Concurrent SNMP tasks */
+    int max_routers;      /* Stop growing the graph after this many, 0 = unlimited */
+    int timeout_ms;       /* Per-request SNMP timeout */
+    int retries;          /* SNMP retransmissions per request */
+    int verbose;          /* Print per-router progress */
+} crawl_config_t;
+
+typedef struct {
+    int routers_seen;     /* Nodes in the next-hop graph */
+    int routers_snmp;     /* Routers that answered with some community */
+    int hosts_reported;   /* Callback invocations */
+} crawl_stats_t;
+
+/* Fill cfg with the default settings */
+void crawl_config_default(crawl_config_t *cfg);
+
+/*
+ * Crawl from the seed routers. Each router is tried with its cached
+ * credential (cred_cache.h), else with every entry of the NULL-terminated
+ * communities list in parallel; winners are stored in the cache.
+ * The topology graph (topology.h) is cleared first and rebuilt from
+ * this crawl alone.
+ * Returns the number of routers that answered SNMP, or -1 on failure
+ * to start.
+ */
+int router_crawl(const crawl_config_t *cfg, const uint32_t *seeds, int seed_count,
+                 const char *const *communities, crawl_host_cb cb, void *ctx,
+                 crawl_stats_t *stats);
+
+#endif /* ROUTER_CRAWL_H */
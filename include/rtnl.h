@@ -0,0 +1,69 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Kernel Neighbor and Route Tables
+ *
+ * Reads the IPv4 neighbor (ARP) cache and routing table straight from
+ * the kernel over rtnetlink, falling back to /proc/net/arp and
+ * /proc/net/route where netlink sockets are unavailable. Replaces
+ * parsing the output of ip(8), arp(8) and route(8).
+ */
+
+#ifndef RTNL_H
+#define RTNL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+
+#define RTNL_MAX_LLADDR 16
+
+/* One resolved neighbor cache entry */
+typedef struct {
+    uint32_t addr;                  /* IPv4, host byte order */
+    uint8_t lladdr[RTNL_MAX_LLADDR];
+    int lladdr_len;
+    int ifindex;
+    char ifname[IF_NAMESIZE];
+    uint16_t state;                 /* NUD_* from <linux/neighbour.h> */
+} rtnl_neigh_t;
+
+/* Return non-zero to stop the dump early */
+typedef int (*rtnl_neigh_cb)(const rtnl_neigh_t *neigh, void *ctx);
+
+/*
+ * Report every IPv4 neighbor that has a link-layer address and is not
+ * FAILED, INCOMPLETE or NOARP (the set `ip neigh show` lists)
+ * Returns the number of entries reported, or -1 if neither netlink nor
+ * /proc/net/arp could be read
+ */
+int rtnl_neigh_foreach(rtnl_neigh_cb cb, void *ctx);
+
+/*
+ * Find the IPv4 default gateway in the main routing table, preferring
+ * the lowest metric. ifindex may be NULL.
+ * Returns 1 and fills gateway (host byte order) on success, 0 if there
+ * is no default route
+ */
+int rtnl_default_gateway(uint32_t *gateway, int *ifindex);
+
+/* Receives each message of a dump; non-zero return stops the dump */
+typedef int (*netlink_msg_fn)(const struct nlmsghdr *nh, void *ctx);
+
+/*
+ * Send a dump request (NLM_F_DUMP) of the given type with body as its
+ * payload on a netlink socket of protocol, and feed every reply message
+ * to fn
+ * Returns 0 when the dump completed or fn stopped it, -1 on socket or
+ * kernel error
+ */
+int netlink_dump(int protocol, uint16_t type, const void *body, size_t body_len,
+                 netlink_msg_fn fn, void *ctx);
+
+/* "REACHABLE", "STALE", ... for a NUD_* state */
+const char *rtnl_neigh_state_name(uint16_t state);
+
+/* Format a link-layer address as aa:bb:cc:... into buf */
+void rtnl_format_lladdr(const uint8_t *lladdr, int len, char *buf, size_t buf_size);
+
+#endif /* RTNL_H */
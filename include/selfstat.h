@@ -0,0 +1,105 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Self Instrumentation
+ *
+ * Latency histograms and event counters for netmon's own work: probe
+ * RTT, SNMP request latency, discovery stage times and poll lag, plus
+ * timeouts, retries and drops. They answer "where did the time go"
+ * when discovery or polling is slow.
+ *
+ * Every thread writes to its own shard with relaxed atomic adds, so
+ * recording takes no lock and touches no cache line another thread
+ * writes. Readers sum the shards. Histograms are log-linear: exact
+ * below 32 us, then 16 buckets per power of two, so any value is
+ * within 1/16 of its bucket's bounds from 1 us up to 19 hours.
+ */
+
+#ifndef SELFSTAT_H
+#define SELFSTAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SELFSTAT_SUB_BITS 4
+#define SELFSTAT_MAX_BITS 36           /* Values are clamped to 2^36 - 1 us */
+#define SELFSTAT_BUCKETS (((SELFSTAT_MAX_BITS - SELFSTAT_SUB_BITS) + 1) << SELFSTAT_SUB_BITS)
+
+/* Shards threads are spread over; threads beyond this share a shard */
+#define SELFSTAT_SHARDS 32
+
+/* Histograms, in microseconds */
+typedef enum {
+    SELFSTAT_PROBE_RTT,                /* Liveness probe sent to answered */
+    SELFSTAT_SNMP_LATENCY,             /* SNMP request to response, retries included */
+    SELFSTAT_COMMUNITY_PROBE,          /* Community guess round to first answer */
+    SELFSTAT_POLL_LAG,                 /* Poll deadline to a worker starting it */
+    SELFSTAT_POLL_DURATION,            /* One device poll */
+    SELFSTAT_STAGE_SNMP,               /* Discovery stages, one label each */
+    SELFSTAT_STAGE_PING,
+    SELFSTAT_STAGE_ARP,
+    SELFSTAT_STAGE_CONN,
+    SELFSTAT_STAGE_GATEWAY,
+    SELFSTAT_STAGE_SWEEP,              /* Subnet sweep, ICMP and any port fallback */
+    SELFSTAT_HIST_COUNT
+} selfstat_hist_t;
+
+typedef enum {
+    SELFSTAT_PROBES_SENT,
+    SELFSTAT_PROBE_RETRIES,
+    SELFSTAT_PROBE_TIMEOUTS,           /* Targets that never answered */
+    SELFSTAT_PROBE_DROPS,              /* Probes the transport refused */
+    SELFSTAT_SNMP_REQUESTS,
+    SELFSTAT_SNMP_RETRIES,
+    SELFSTAT_SNMP_TIMEOUTS,
+    SELFSTAT_SNMP_ERRORS,              /* Send failures, refused ports, bad responses */
+    SELFSTAT_COMMUNITY_GUESSES,        /* Community strings sent */
+    SELFSTAT_COMMUNITY_FAILURES,       /* Agents that accepted none */
+    SELFSTAT_HOSTS_ADDED,
+    SELFSTAT_HOSTS_DUPLICATE,          /* Reports of a host already known */
+    SELFSTAT_HOSTS_DROPPED,            /* New hosts the table had no room for */
+    SELFSTAT_SWEEP_FALLBACKS,          /* Sweeps that fell back to port probes */
+    SELFSTAT_SUBPROCESSES,             /* Child processes spawned */
+    SELFSTAT_POLLS,
+    SELFSTAT_POLL_FAILURES,            /* Polls that did not succeed */
+    SELFSTAT_POLL_SKIPPED,             /* Rounds dropped because a device fell behind */
+    SELFSTAT_DEVICES_REFUSED,          /* Devices the full device table turned away */
+    SELFSTAT_COUNTER_COUNT
+} selfstat_counter_t;
+
+/* How a histogram or counter is exported */
+typedef struct {
+    const char *name;                  /* Prometheus family */
+    const char *label;                 /* Value of the stage label, NULL if none */
+    const char *help;
+} selfstat_desc_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t buckets[SELFSTAT_BUCKETS];
+} selfstat_snapshot_t;
+
+/* Hot path: lock-free, safe from any thread */
+void selfstat_record(selfstat_hist_t hist, uint64_t us);
+void selfstat_add(selfstat_counter_t counter, uint64_t n);
+
+/* Monotonic clock in microseconds, for callers timing a span */
+uint64_t selfstat_now_us(void);
+
+/*
+ * Sum of every shard; concurrent writers may land on either side of
+ * the read, but count always equals the sum of the buckets
+ */
+void selfstat_read(selfstat_hist_t hist, selfstat_snapshot_t *snap);
+uint64_t selfstat_counter(selfstat_counter_t counter);
+
+/* Upper bound of the bucket holding quantile q (0..1); 0 if empty */
+uint64_t selfstat_percentile(const selfstat_snapshot_t *snap, double q);
+
+const selfstat_desc_t *selfstat_hist_desc(selfstat_hist_t hist);
+const selfstat_desc_t *selfstat_counter_desc(selfstat_counter_t counter);
+
+/* Human-readable table of every histogram and counter */
+void selfstat_dump(FILE *out);
+
+#endif /* SELFSTAT_H */
@@ -0,0 +1,147 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * SNMP v2c Client
+ *
+ * Built-in SNMPv2c engine over UDP with its own BER encoder/decoder.
+ * Supports Get, GetNext and GetBulk, and subtree walks driven by
+ * GetBulk so large tables take a handful of round trips.
+ */
+
+#ifndef SNMP_H
+#define SNMP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SNMP_MAX_OID_LEN 128
+#define SNMP_DEFAULT_TIMEOUT_MS 1000
+#define SNMP_DEFAULT_RETRIES 1
+#define SNMP_DEFAULT_MAX_REPETITIONS 50
+#define SNMP_MAX_MSG_SIZE 65507
+
+/* PDU types */
+#define SNMP_PDU_GET 0xa0
+#define SNMP_PDU_GETNEXT 0xa1
+#define SNMP_PDU_RESPONSE 0xa2
+#define SNMP_PDU_GETBULK 0xa5
+
+/* Value types (universal and application tags) */
+#define SNMP_TYPE_INTEGER 0x02
+#define SNMP_TYPE_OCTET_STRING 0x04
+#define SNMP_TYPE_NULL 0x05
+#define SNMP_TYPE_OID 0x06
+#define SNMP_TYPE_IPADDRESS 0x40
+#define SNMP_TYPE_COUNTER32 0x41
+#define SNMP_TYPE_GAUGE32 0x42
+#define SNMP_TYPE_TIMETICKS 0x43
+#define SNMP_TYPE_OPAQUE 0x44
+#define SNMP_TYPE_COUNTER64 0x46
+#define SNMP_TYPE_NO_SUCH_OBJECT 0x80
+#define SNMP_TYPE_NO_SUCH_INSTANCE 0x81
+#define SNMP_TYPE_END_OF_MIB_VIEW 0x82
+
+/* Error statuses carried in a response PDU */
+#define SNMP_ERR_NOERROR 0
+#define SNMP_ERR_TOOBIG 1
+#define SNMP_ERR_NOSUCHNAME 2
+
+typedef struct {
+    uint32_t ids[SNMP_MAX_OID_LEN];
+    int len;
+} snmp_oid_t;
+
+/*
+ * One decoded variable binding. String values point into the
+ * response buffer and are only valid during the callback.
+ */
+typedef struct {
+    snmp_oid_t oid;
+    uint8_t type;
+    int64_t integer;            /* INTEGER */
+    uint64_t counter;           /* Counter32/Gauge32/TimeTicks/Counter64 */
+    uint32_t ipaddr;            /* IpAddress, host byte order */
+    const uint8_t *data;        /* OCTET STRING / Opaque contents */
+    size_t data_len;
+    snmp_oid_t oid_value;       /* OBJECT IDENTIFIER values */
+} snmp_varbind_t;
+
+/* Return non-zero to stop processing further varbinds */
+typedef int (*snmp_varbind_cb)(const snmp_varbind_t *vb, void *ctx);
+
+typedef struct {
+    int fd;
+    uint32_t peer;              /* Agent address, host byte order */
+    uint16_t port;
+    char community[64];
+    int32_t next_request_id;
+    int timeout_ms;
+    int retries;
+    int max_repetitions;
+    uint8_t *buf;               /* Receive buffer, SNMP_MAX_MSG_SIZE bytes */
+} snmp_session_t;
+
+/* Change the defaults applied to newly opened sessions */
+void snmp_set_defaults(int timeout_ms, int retries, int max_repetitions);
+
+/*
+ * Open a session to ip:port with the given community
+ * Returns NETMON_SUCCESS or NETMON_ERROR
+ */
+int snmp_open(snmp_session_t *session, const char *ip, uint16_t port, const char *community);
+void snmp_close(snmp_session_t *session);
+
+/* Parse "1.3.6.1..." (leading dot optional); returns 0 or -1 */
+int snmp_oid_parse(const char *str, snmp_oid_t *oid);
+void snmp_oid_format(const snmp_oid_t *oid, char *buf, size_t size);
+int snmp_oid_compare(const snmp_oid_t *a, const snmp_oid_t *b);
+int snmp_oid_is_prefix(const snmp_oid_t *prefix, const snmp_oid_t *oid);
+
+/* Render a varbind value the way snmpwalk does ("IpAddress: 10.0.0.1") */
+void snmp_value_format(const snmp_varbind_t *vb, char *buf, size_t size);
+
+/*
+ * Send one request and deliver the response varbinds to cb.
+ * For GetBulk, non_repeaters/max_repetitions are used; otherwise ignored.
+ * Returns the number of varbinds, NETMON_TIMEOUT if the agent never
+ * answered, or NETMON_ERROR on encode/decode failure or an error status.
+ */
+int snmp_request(snmp_session_t *session, uint8_t pdu_type,
+                 const snmp_oid_t *oids, int oid_count,
+                 int non_repeaters, int max_repetitions,
+                 snmp_varbind_cb cb, void *ctx);
+
+/*
+ * Try all count communities at once with parallel Gets of sysObjectID.0.
+ * On success the winning community is copied into the session and its
+ * index returned; otherwise returns NETMON_TIMEOUT, NETMON_NO_RESPONSE
+ * (port unreachable) or NETMON_ERROR.
+ */
+int snmp_probe_communities(snmp_session_t *session, const char *const *communities, int count);
+
+/*
+ * Walk the subtree under root with GetBulk, delivering every varbind.
+ * Returns the number of varbinds delivered or a negative NETMON code.
+ */
+int snmp_bulkwalk(snmp_session_t *session, const snmp_oid_t *root,
+                  snmp_varbind_cb cb, void *ctx);
+
+/* Columns one snmp_table_walk() can fetch together */
+#define SNMP_MAX_TABLE_COLUMNS 16
+
+/* Called per cell with the index of its column in the walk; non-zero stops */
+typedef int (*snmp_cell_cb)(int column, const snmp_varbind_t *vb, void *ctx);
+
+/*
+ * Walk several table columns with shared GetBulk requests, so each
+ * response carries rows of every column and a table of N rows takes
+ * about N / max_repetitions round trips in total rather than per column.
+ * Columns can end at different rows (sparse tables).
+ * Returns the number of cells delivered, or a negative NETMON code if
+ * the walk did not reach the end of every column (a timeout, an error
+ * status or an undecodable response part way); cells before the
+ * failure have already been passed to cb.
+ */
+int snmp_table_walk(snmp_session_t *session, const snmp_oid_t *columns, int column_count,
+                    snmp_cell_cb cb, void *ctx);
+
+#endif /* SNMP_H */
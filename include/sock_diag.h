@@ -0,0 +1,30 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Socket Table Reader
+ *
+ * Lists established TCP connections straight from the kernel through
+ * NETLINK_SOCK_DIAG (inet_diag), with /proc/net/tcp{,6} as fallback.
+ * The kernel applies the state filter, so only ESTABLISHED sockets are
+ * returned. Replaces parsing ss(8) / netstat(8) output.
+ */
+
+#ifndef SOCK_DIAG_H
+#define SOCK_DIAG_H
+
+#include <stdint.h>
+
+/*
+ * Called for each established connection with an IPv4 peer (IPv6
+ * sockets are included when the peer is v4-mapped). remote_addr is in
+ * host byte order. Return non-zero to stop.
+ */
+typedef int (*sock_diag_cb)(uint32_t remote_addr, uint16_t remote_port, void *ctx);
+
+/*
+ * Report every established TCP connection
+ * Returns the number of connections reported, or -1 if neither
+ * inet_diag nor /proc/net/tcp could be read
+ */
+int sock_diag_established(sock_diag_cb cb, void *ctx);
+
+#endif /* SOCK_DIAG_H */
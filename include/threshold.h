@@ -0,0 +1,76 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Threshold Rules
+ *
+ * Alert rules from a small rule language, one per line:
+ *
+ *     <metric> <op> <value> [for <n> samples] [severity <level>] [on <hostname>]
+ *
+ *     cpu_usage > 85 for 3 samples
+ *     response_time_ms >= 500 for 2 samples severity error on core-router
+ *     in_bps > 900M severity info
+ *
+ * Metrics are cpu_usage, memory_usage (percent), errors_in and
+ * errors_out (errors per second between polls), response_time_ms,
+ * in_bps and out_bps; values take k/M/G suffixes. Operators are
+ * > >= < <= == !=. Severity defaults to warning.
+ *
+ * Rules are compiled once into a flat array of comparator ops grouped
+ * by metric. Each evaluation reads only devices with a new sample from
+ * the metrics store and runs every op of a metric over its value.
+ * A rule fires once when it has held for n consecutive samples of a
+ * device and raises an info alert when it clears.
+ *
+ * The monitor evaluates each device as soon as a scheduled poll of it
+ * completes, so "for n samples" means n consecutive polls of that
+ * device, n poll intervals. Values written outside a poll are picked
+ * up by the correlator's batch_ms tick; several writes between two
+ * ticks then count as one sample.
+ */
+
+#ifndef THRESHOLD_H
+#define THRESHOLD_H
+
+#include <stddef.h>
+#include "device_db.h"
+
+/* Rule file read by load_config(), next to the devices file */
+#define THRESHOLD_DEFAULT_FILE "thresholds.conf"
+
+#define THRESHOLD_MAX_RULES 1024
+#define THRESHOLD_MAX_SAMPLES 255
+
+/*
+ * Compile the rules in path and make them the active set; lines that
+ * do not parse are reported on stderr and skipped
+ * Rules that also were in the old set keep their streaks and firing
+ * state; old rules that are gone raise a clear on every device they
+ * were firing for.
+ * Returns the number of rules compiled, or NETMON_ERROR if the file
+ * cannot be read (the active set is then left as it was)
+ */
+int threshold_load(const char *path);
+
+/* Compile rules from a string, same rules as threshold_load() */
+int threshold_load_text(const char *text);
+
+/* Drop all rules, clearing the ones that were firing, and all per-device state */
+void threshold_clear(void);
+
+/* Number of active rules */
+int threshold_rule_count(void);
+
+/*
+ * Run every rule over the devices polled since the last call
+ * Returns the number of alerts raised
+ */
+int threshold_evaluate(void);
+
+/*
+ * Run every rule over one device if it was polled since it was last
+ * evaluated; the monitor calls this when each poll completes
+ * Returns the number of alerts raised
+ */
+int threshold_evaluate_device(const device_ref_t *ref);
+
+#endif /* THRESHOLD_H */
@@ -0,0 +1,56 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Hierarchical Timer Wheel
+ *
+ * Four cascading levels of 64 slots each. Adding and cancelling a timer
+ * is O(1); advancing costs one slot per tick plus an occasional cascade.
+ * Times are expressed in caller-defined ticks.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define TW_LEVELS 4
+#define TW_SLOT_BITS 6
+#define TW_SLOTS (1 << TW_SLOT_BITS)
+
+/* Longest delay representable; later deadlines are clamped to it */
+#define TW_MAX_DELAY ((1ULL << (TW_LEVELS * TW_SLOT_BITS)) - 1)
+
+/* Intrusive timer, embedded in the owner's structure */
+typedef struct tw_timer {
+    struct tw_timer *next;
+    struct tw_timer *prev;
+    uint64_t expires;
+    void *data;
+} tw_timer_t;
+
+typedef struct {
+    uint64_t now;                          /* Next tick to be processed */
+    tw_timer_t slots[TW_LEVELS][TW_SLOTS]; /* List heads */
+    uint32_t count;
+} timer_wheel_t;
+
+/* Called for each expired timer; it may re-add the timer */
+typedef void (*tw_expire_fn)(tw_timer_t *timer, void *ctx);
+
+void tw_init(timer_wheel_t *wheel, uint64_t now);
+void tw_timer_init(tw_timer_t *timer, void *data);
+
+/* Arm timer to fire at tick expires (past ticks fire on the next advance) */
+void tw_add(timer_wheel_t *wheel, tw_timer_t *timer, uint64_t expires);
+
+/* Disarm timer if pending */
+void tw_cancel(timer_wheel_t *wheel, tw_timer_t *timer);
+
+int tw_pending(const tw_timer_t *timer);
+
+/*
+ * Process every tick up to and including now, calling fn for each
+ * expired timer. Returns the number of timers fired.
+ */
+int tw_advance(timer_wheel_t *wheel, uint64_t now, tw_expire_fn fn, void *ctx);
+
+#endif /* TIMER_WHEEL_H */
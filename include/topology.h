@@ -0,0 +1,88 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Layer-3 Topology Graph
+ *
+ * Process-wide graph of the routed network as learned by the router
+ * crawl: routers are nodes, ipRouteNextHop entries are links between
+ * them, and subnets from ipAdEntAddr/ipAdEntNetMask hang off the
+ * routers with an interface in them. A router's interface addresses
+ * are aliases of one node, so a router reached as the next hop of
+ * several neighbours shows up once.
+ *
+ * Adjacency is kept in compressed sparse rows plus a small per-node
+ * log of edges added since the last compaction; the rows are rebuilt
+ * in one linear pass once the log grows past a fraction of the graph.
+ *
+ * The layout is a breadth-first tree from the crawl seeds: every
+ * router sits under the neighbour that reaches it in the fewest hops,
+ * every subnet under its closest router. New edges only relax depths
+ * outwards from the nodes they touch, and per-subtree row counts let
+ * topo_rows() return any window of the laid-out tree without walking
+ * the rest of it. All functions are thread-safe.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdint.h>
+
+typedef enum {
+    TOPO_NODE_ROUTER = 0,
+    TOPO_NODE_SUBNET
+} topo_node_kind_t;
+
+/* One line of the laid-out tree */
+typedef struct {
+    int node;
+    topo_node_kind_t kind;
+    uint32_t addr;            /* Router: first address seen; subnet: network, host byte order */
+    uint8_t prefix_len;       /* Subnets */
+    uint8_t level;            /* Depth in the layout tree, 0 = top */
+    uint8_t seed;             /* Router the crawl started from */
+    uint8_t reached;          /* Connected to a seed */
+    uint16_t routers;         /* Router neighbours */
+    uint16_t subnets;         /* Attached subnets (routers) or routers (subnets) */
+} topo_row_t;
+
+typedef struct {
+    int routers;
+    int subnets;
+    int links;                /* Router-router adjacencies */
+    int attachments;          /* Router-subnet adjacencies */
+    int aliases;              /* Nodes merged into another router */
+    int pending;              /* Edges not yet compacted into the rows */
+    int compactions;
+    int relaxed;              /* Layout updates since topo_clear() */
+} topo_stats_t;
+
+/*
+ * Add a router by one of its addresses; seeds are layout roots
+ * Returns the node index or NETMON_ERROR
+ */
+int topo_add_router(uint32_t addr, int seed);
+
+/* from's next-hop table names to (both added as routers if new) */
+int topo_add_link(uint32_t from, uint32_t to);
+
+/*
+ * router has interface addr with netmask mask: addr becomes an alias
+ * of router (merging any node known by it) and the subnet is attached.
+ * Returns NETMON_SUCCESS or NETMON_ERROR
+ */
+int topo_add_interface(uint32_t router, uint32_t addr, uint32_t mask);
+
+/* Drop the whole graph and free its memory; router_crawl() starts with this */
+void topo_clear(void);
+
+/* Incremented on every change to the graph or its layout */
+uint32_t topo_generation(void);
+
+/* Lines in the laid-out tree */
+int topo_row_count(void);
+
+/* Copy up to max_count lines starting at line first; returns how many */
+int topo_rows(int first, topo_row_t *rows, int max_count);
+
+void topo_get_stats(topo_stats_t *stats);
+
+#endif /* TOPOLOGY_H */
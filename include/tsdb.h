@@ -0,0 +1,85 @@
+/*
+ * Network Monitoring and Visualization Tool
+ * Metric History
+ *
+ * Append-only time-series store for polled device metrics. Each device
+ * has one memory-mapped file under the history directory holding, per
+ * metric, a ring of Gorilla-compressed raw chunks (delta-of-delta
+ * timestamps, XOR-encoded doubles) and fixed-width 1 minute, 5 minute
+ * and 1 hour rollup rings that are maintained on every append. Range
+ * queries over long periods read the rollups instead of the samples.
+ * All functions are thread-safe.
+ */
+
+#ifndef TSDB_H
+#define TSDB_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define TSDB_DEFAULT_DIR "data/tsdb"
+#define TSDB_VERSION 1
+
+/* Raw retention: ring of 1 KiB compressed chunks per metric */
+#define TSDB_RAW_CHUNKS 256
+
+/* Rollup retention: 2 days of 1m, 2 weeks of 5m, a year of 1h */
+#define TSDB_1M_SLOTS 2880
+#define TSDB_5M_SLOTS 4032
+#define TSDB_1H_SLOTS 8784
+
+typedef enum {
+    TSDB_BYTES_IN = 0,
+    TSDB_BYTES_OUT,
+    TSDB_CPU_USAGE,
+    TSDB_RESPONSE_TIME,
+    TSDB_METRIC_COUNT
+} tsdb_metric_t;
+
+typedef enum {
+    TSDB_RES_RAW = 0,
+    TSDB_RES_1M,
+    TSDB_RES_5M,
+    TSDB_RES_1H,
+    TSDB_RES_AUTO             /* Finest rollup that covers the range in max_points */
+} tsdb_resolution_t;
+
+/* One query result: a raw sample (count 1) or a rollup bucket */
+typedef struct {
+    int64_t ts;               /* Sample time, or bucket start */
+    uint32_t count;           /* Samples in the bucket */
+    double min;
+    double max;
+    double avg;
+} tsdb_point_t;
+
+/*
+ * Enable the store; files live in dir (created if missing)
+ * Returns NETMON_SUCCESS or NETMON_ERROR
+ */
+int tsdb_open(const char *dir);
+
+/* Flush and unmap every series; safe if not open */
+void tsdb_close(void);
+
+/* Non-zero between tsdb_open() and tsdb_close() */
+int tsdb_is_open(void);
+
+/*
+ * Append one sample per metric for hostname at ts (seconds)
+ * NaN values are skipped. Samples not newer than the last one stored
+ * for a metric are dropped.
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if the store is closed, the
+ * file cannot be created or a sample was dropped
+ */
+int tsdb_append(const char *hostname, time_t ts, const double values[TSDB_METRIC_COUNT]);
+
+/*
+ * Read [from, to] of one metric, oldest first
+ * Returns the number of points written to out (at most max_points),
+ * 0 if there is no history, or NETMON_ERROR on bad arguments
+ */
+int tsdb_query(const char *hostname, tsdb_metric_t metric, time_t from, time_t to,
+               tsdb_resolution_t res, tsdb_point_t *out, int max_points);
+
+#endif /* TSDB_H */
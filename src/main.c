@@ -3,13 +3,42 @@
  * Main Program Entry Point
  * 
  * This is the main entry point for the network monitoring tool.
- * It provides a menu-based interface for monitoring Cisco network devices.
+ * It provides a menu-based interface for monitoring Cisco network devices,
+ * or with --daemon runs headless and streams results as NDJSON.
  */
 
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "dashboard.h"
+#include "monitor.h"
+#include "event_stream.h"
+#include "exporter.h"
+#include "config.h"
+#include "device_db.h"
+#include "cred_cache.h"
+#include "port_probe.h"
+#include "selfstat.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "netmon.h"
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+/* Command line settings */
+typedef struct {
+    int daemon;
+    int stats;                    /* Dump self instrumentation on exit */
+    int discover;                 /* Run automatic discovery at start-up */
+    int poll_ms;                  /* 0 = monitor default */
+    int flush_ms;                 /* 0 = stream default */
+    const char *config_path;
+    const char *socket_path;
+    const char *metrics_addr;     /* Prometheus listen address, NULL = none */
+} options_t;
 
 /* Function prototypes */
 static void display_menu(void);
@@ -17,16 +46,24 @@ static void handle_menu_choice(int choice);
 static void view_statistics(void);
 static void configure_devices(void);
 static void discover_automatic_menu(void);
+static void live_dashboard(void);
 static void clear_screen(void);
+static int parse_options(int argc, char *argv[], options_t *opts);
+static int run_daemon(const options_t *opts);
 
 int main(int argc, char *argv[])
 {
     int choice;
     int running = 1;
-    
-    /* Suppress unused parameter warnings */
-    (void)argc;
-    (void)argv;
+    options_t opts;
+
+    int rc = parse_options(argc, argv, &opts);
+    if (rc != NETMON_SUCCESS) {
+        return rc == NETMON_NO_RESPONSE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (opts.daemon) {
+        return run_daemon(&opts);
+    }
     
     printf("\n");
     printf("========================================\n");
@@ -36,6 +73,7 @@ int main(int argc, char *argv[])
     printf("\n");
     
     /* Initialize the monitoring system */
+    printf("Initializing network monitoring system...\n");
     if (init_netmon() != 0) {
         fprintf(stderr, "Error: Failed to initialize network monitor\n");
         return EXIT_FAILURE;
@@ -64,7 +102,11 @@ int main(int argc, char *argv[])
     }
     
     /* Cleanup and shutdown */
+    printf("Shutting down network monitoring system...\n");
     cleanup_netmon();
+    if (opts.stats) {
+        selfstat_dump(stderr);
+    }
     
     printf("\nThank you for using Network Monitor!\n");
     printf("Goodbye.\n\n");
@@ -72,6 +114,291 @@ int main(int argc, char *argv[])
     return EXIT_SUCCESS;
 }
 
+static void usage(const char *prog, FILE *out)
+{
+    fprintf(out,
+            "Usage: %s [--daemon [options]] [--stats]\n"
+            "Without --daemon the interactive menu starts.\n"
+            "\n"
+            "  --daemon            Run headless, streaming NDJSON records\n"
+            "                      (SIGUSR1 dumps the --stats table to stderr)\n"
+            "  --discover MODE     auto = automatic discovery at start-up, off (default)\n"
+            "  --poll DURATION     Poll interval, e.g. 10s, 500ms, 1m (default %ds)\n"
+            "  --config FILE       Load devices and threshold rules from FILE\n"
+            "  --socket PATH       Serve the stream on a Unix socket instead of stdout\n"
+            "  --flush DURATION    Longest a record is buffered (default %dms)\n"
+            "  --metrics ADDR      Serve Prometheus /metrics on [host]:port, e.g. :%d\n"
+            "  --tcp-ports LIST    Ports probed where ICMP is filtered, or none (default 22,23,443)\n"
+            "  --stats             Print latency histograms and counters to stderr on exit\n"
+            "  --help              Show this help\n",
+            prog, MONITOR_DEFAULT_INTERVAL_MS / 1000, EVENT_STREAM_DEFAULT_FLUSH_MS,
+            EXPORTER_DEFAULT_PORT);
+}
+
+/*
+ * Parse "10s", "500ms", "2m" or a bare number of seconds
+ * Returns milliseconds, or -1 if malformed or out of range
+ */
+static int parse_duration(const char *text)
+{
+    char *end;
+
+    errno = 0;
+    long long value = strtoll(text, &end, 10);
+    if (end == text || errno != 0 || value <= 0) {
+        return -1;
+    }
+    if (strcmp(end, "ms") == 0) {
+        /* Already milliseconds */
+    } else if (*end == '\0' || strcmp(end, "s") == 0) {
+        value *= 1000;
+    } else if (strcmp(end, "m") == 0) {
+        value *= 60000;
+    } else {
+        return -1;
+    }
+    return value <= 24LL * 3600 * 1000 ? (int)value : -1;
+}
+
+/*
+ * Returns NETMON_SUCCESS to run, NETMON_NO_RESPONSE after --help,
+ * NETMON_ERROR on a usage error (reported on stderr)
+ */
+static int parse_options(int argc, char *argv[], options_t *opts)
+{
+    static const struct option long_opts[] = {
+        { "daemon",   no_argument,       NULL, 'd' },
+        { "discover", required_argument, NULL, 'D' },
+        { "poll",     required_argument, NULL, 'p' },
+        { "config",   required_argument, NULL, 'c' },
+        { "socket",   required_argument, NULL, 's' },
+        { "flush",    required_argument, NULL, 'f' },
+        { "metrics",  required_argument, NULL, 'm' },
+        { "tcp-ports", required_argument, NULL, 't' },
+        { "stats",    no_argument,       NULL, 'S' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int c;
+
+    memset(opts, 0, sizeof(*opts));
+    while ((c = getopt_long(argc, argv, "dD:p:c:s:f:m:t:Sh", long_opts, NULL)) != -1) {
+        switch (c) {
+            case 'd':
+                opts->daemon = 1;
+                break;
+            case 'D':
+                if (strcmp(optarg, "auto") == 0) {
+                    opts->discover = 1;
+                } else if (strcmp(optarg, "off") == 0) {
+                    opts->discover = 0;
+                } else {
+                    fprintf(stderr, "%s: --discover expects auto or off\n", argv[0]);
+                    return NETMON_ERROR;
+                }
+                break;
+            case 'p':
+            case 'f': {
+                int ms = parse_duration(optarg);
+                if (ms < 0) {
+                    fprintf(stderr, "%s: invalid duration '%s'\n", argv[0], optarg);
+                    return NETMON_ERROR;
+                }
+                *(c == 'p' ? &opts->poll_ms : &opts->flush_ms) = ms;
+                break;
+            }
+            case 'c':
+                opts->config_path = optarg;
+                break;
+            case 's':
+                opts->socket_path = optarg;
+                break;
+            case 'm':
+                opts->metrics_addr = optarg;
+                break;
+            case 't': {
+                port_probe_config_t probe;
+                port_probe_config_default(&probe);
+                if (port_probe_parse_ports(optarg, &probe) != NETMON_SUCCESS) {
+                    fprintf(stderr, "%s: invalid port list '%s'\n", argv[0], optarg);
+                    return NETMON_ERROR;
+                }
+                port_probe_set_defaults(&probe);
+                break;
+            }
+            case 'S':
+                opts->stats = 1;
+                break;
+            case 'h':
+                usage(argv[0], stdout);
+                return NETMON_NO_RESPONSE;
+            default:
+                usage(argv[0], stderr);
+                return NETMON_ERROR;
+        }
+    }
+    if (optind < argc) {
+        fprintf(stderr, "%s: unexpected argument '%s'\n", argv[0], argv[optind]);
+        return NETMON_ERROR;
+    }
+    if (!opts->daemon && (opts->discover || opts->poll_ms || opts->flush_ms ||
+                          opts->config_path != NULL || opts->socket_path != NULL ||
+                          opts->metrics_addr != NULL)) {
+        fprintf(stderr, "%s: these options need --daemon\n", argv[0]);
+        return NETMON_ERROR;
+    }
+    return NETMON_SUCCESS;
+}
+
+static int64_t elapsed_ms_since(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/*
+ * Monitor every discovered host not yet in the device database, named
+ * by its address, with the SNMP community discovery learned for it
+ */
+static void monitor_discovered_hosts(void)
+{
+    char ip[MAX_IP_LEN];
+    int rtt;
+    network_device_t dev;
+    device_ref_t ref;
+    int refused = 0;
+
+    for (int i = 0; i < get_discovered_count(); i++) {
+        struct in_addr in;
+        if (get_discovered_host(i, ip, &rtt) != 0 || inet_pton(AF_INET, ip, &in) != 1) {
+            continue;
+        }
+        memset(&dev, 0, sizeof(dev));
+        snprintf(dev.hostname, sizeof(dev.hostname), "%s", ip);
+        snprintf(dev.ip_address, sizeof(dev.ip_address), "%s", ip);
+        if (cred_cache_lookup(ntohl(in.s_addr), dev.snmp_community,
+                              sizeof(dev.snmp_community)) != NETMON_SUCCESS) {
+            snprintf(dev.snmp_community, sizeof(dev.snmp_community), "public");
+        }
+        dev.port = DEFAULT_SNMP_PORT;
+        /* A host that is already a device is not a failure */
+        if (add_device(&dev) != NETMON_SUCCESS && device_db_find(dev.hostname, &ref) != NETMON_SUCCESS) {
+            refused++;
+        }
+    }
+    if (refused > 0) {
+        fprintf(stderr, "netmon: %d discovered host(s) not monitored (out of memory)\n", refused);
+    }
+}
+
+/* Config watcher callback: report each reload on the stream */
+static void stream_reload(const char *filename, int rc, const config_diff_t *diff, void *ctx)
+{
+    (void)ctx;
+    if (rc != NETMON_SUCCESS) {
+        fprintf(stderr, "netmon: cannot reload %s\n", filename);
+    }
+    event_stream_reload(rc, diff->added, diff->removed, diff->changed, diff->rejected);
+}
+
+/*
+ * Headless mode: nothing is printed to stdout except the event stream;
+ * errors go to stderr. Runs until SIGINT/SIGTERM or until the stdout
+ * reader goes away.
+ */
+static int run_daemon(const options_t *opts)
+{
+    sigset_t daemon_signals;
+    monitor_config_t mcfg;
+    event_stream_config_t scfg;
+    struct timespec start;
+    const struct timespec check = { 1, 0 };
+
+    /* Blocked before any thread starts, so only sigtimedwait() sees them */
+    sigemptyset(&daemon_signals);
+    sigaddset(&daemon_signals, SIGINT);
+    sigaddset(&daemon_signals, SIGTERM);
+    sigaddset(&daemon_signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &daemon_signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    set_discovery_verbose(0);
+    if (init_netmon() != NETMON_SUCCESS) {
+        fprintf(stderr, "netmon: cannot initialize\n");
+        return EXIT_FAILURE;
+    }
+    if (opts->config_path != NULL && load_config(opts->config_path) != NETMON_SUCCESS) {
+        fprintf(stderr, "netmon: cannot read %s\n", opts->config_path);
+        return EXIT_FAILURE;
+    }
+
+    monitor_config_default(&mcfg);
+    if (opts->poll_ms > 0) {
+        mcfg.interval_ms = opts->poll_ms;
+    }
+    monitor_configure(&mcfg);
+
+    event_stream_config_default(&scfg);
+    scfg.socket_path = opts->socket_path;
+    if (opts->flush_ms > 0) {
+        scfg.flush_ms = opts->flush_ms;
+    }
+    if (event_stream_start(&scfg) != NETMON_SUCCESS) {
+        fprintf(stderr, "netmon: cannot open the event stream%s%s\n",
+                opts->socket_path != NULL ? " on " : "",
+                opts->socket_path != NULL ? opts->socket_path : "");
+        return EXIT_FAILURE;
+    }
+    if (opts->metrics_addr != NULL && exporter_start(opts->metrics_addr) != NETMON_SUCCESS) {
+        fprintf(stderr, "netmon: cannot serve metrics on %s\n", opts->metrics_addr);
+        event_stream_stop();
+        return EXIT_FAILURE;
+    }
+    if (start_monitoring() != NETMON_SUCCESS) {
+        fprintf(stderr, "netmon: cannot start monitoring\n");
+        exporter_stop();
+        event_stream_stop();
+        return EXIT_FAILURE;
+    }
+
+    if (opts->config_path != NULL &&
+        config_watch_start(opts->config_path, stream_reload, NULL) != NETMON_SUCCESS) {
+        fprintf(stderr, "netmon: cannot watch %s, reload disabled\n", opts->config_path);
+    }
+
+    if (opts->discover) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        set_discovery_callback(event_stream_host, NULL);
+        int found = discover_automatic();
+        set_discovery_callback(NULL, NULL);
+        event_stream_discovery(found, elapsed_ms_since(&start));
+        monitor_discovered_hosts();
+    }
+
+    while (!event_stream_failed()) {
+        int sig = sigtimedwait(&daemon_signals, NULL, &check);
+        if (sig == SIGINT || sig == SIGTERM) {
+            break;
+        }
+        if (sig == SIGUSR1) {
+            selfstat_dump(stderr);
+        }
+    }
+
+    /* Pollers stop before the stream so their last events are flushed */
+    config_watch_stop();
+    stop_monitoring();
+    exporter_stop();
+    event_stream_stop();
+    cleanup_netmon();
+    if (opts->stats) {
+        selfstat_dump(stderr);
+    }
+    return EXIT_SUCCESS;
+}
+
 /*
  * Display the main menu
  */
@@ -82,6 +409,7 @@ static void display_menu(void)
     printf("1. AUTOMATIC DISCOVERY (Discovers all hosts including other subnets)\n");
     printf("2. View Network Statistics\n");
     printf("3. Configure Devices\n");
+    printf("4. Live Dashboard\n");
     printf("0. Exit\n");
     printf("\n");
 }
@@ -101,8 +429,11 @@ static void handle_menu_choice(int choice)
         case 3:
             configure_devices();
             break;
+        case 4:
+            live_dashboard();
+            break;
         default:
-            printf("\nInvalid choice. Please select 0-3.\n");
+            printf("\nInvalid choice. Please select 0-4.\n");
             printf("Press Enter to continue...");
             getchar();
             break;
@@ -131,18 +462,54 @@ static void discover_automatic_menu(void)
  */
 static void view_statistics(void)
 {
+    network_stats_t stats;
+
     clear_screen();
     printf("\n=== Network Statistics ===\n\n");
+    get_statistics(&stats);
     printf("Network Performance Metrics:\n");
-    printf("- Total Devices: 0\n");
-    printf("- Active Devices: 0\n");
-    printf("- Average Response Time: N/A\n");
-    printf("- Total Bandwidth: N/A\n");
-    printf("\n(This feature is under development)\n\n");
+    printf("- Total Devices: %u\n", stats.total_devices);
+    printf("- Active Devices: %u\n", stats.active_devices);
+    printf("- Inactive Devices: %u\n", stats.inactive_devices);
+    if (stats.avg_response_time > 0) {
+        printf("- Average Response Time: %.1f ms\n", stats.avg_response_time);
+    } else {
+        printf("- Average Response Time: N/A\n");
+    }
+    printf("- Total Traffic: %llu bytes in, %llu bytes out\n",
+           (unsigned long long)stats.total_bytes_in,
+           (unsigned long long)stats.total_bytes_out);
+    printf("- Current Throughput: %.2f Mb/s in, %.2f Mb/s out\n\n",
+           (double)stats.total_in_bps / 1e6, (double)stats.total_out_bps / 1e6);
     printf("Press Enter to return to main menu...");
     getchar();
 }
 
+/*
+ * Live dashboard; polls run meanwhile and stop again on exit if they
+ * were started here
+ */
+static void live_dashboard(void)
+{
+    int started = 0;
+
+    if (!monitor_is_running()) {
+        if (start_monitoring() != NETMON_SUCCESS) {
+            printf("\nCould not start monitoring.\n");
+            return;
+        }
+        started = 1;
+    }
+    if (dashboard_start(0) != NETMON_SUCCESS) {
+        printf("\nLive dashboard unavailable (needs ncurses and a terminal).\n");
+    } else {
+        dashboard_wait();
+    }
+    if (started) {
+        stop_monitoring();
+    }
+}
+
 /*
  * Configure network devices
  */
@@ -161,13 +528,10 @@ static void configure_devices(void)
 }
 
 /*
- * Clear the screen (cross-platform)
+ * Clear the screen with ANSI escapes instead of forking a shell
  */
 static void clear_screen(void)
 {
-#ifdef _WIN32
-    system("cls");
-#else
-    system("clear");
-#endif
+    fputs("\033[H\033[2J", stdout);
+    fflush(stdout);
 }
@@ -0,0 +1,638 @@
+/*
+ * Alert Correlator
+ * Per-slot correlation state (reported status, pending timer, flap
+ * history, recent templates) lives in a chunk array grown as slots
+ * appear, under one mutex; status changes are rare next to polls, and
+ * the ring itself stays lock-free. The batcher thread fires expired
+ * timers and forwards new ring records to the subscribers.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "correlator.h"
+#include "inventory.h"
+#include "threshold.h"
+#include "metrics_store.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+/* Recent templates per device for deduplication */
+#define DEDUP_KEYS 8
+
+/* Direct-mapped dedup slots for alerts about hosts outside the database */
+#define HOST_DEDUP_SLOTS 256
+
+typedef enum {
+    PENDING_NONE = 0,
+    PENDING_DOWN,             /* Settling: waiting for the upstream's status */
+    PENDING_RECOVERY          /* Hold-down before reporting the recovery */
+} pending_t;
+
+typedef struct {
+    uint16_t template_id;
+    uint64_t at_ms;
+} recent_t;
+
+typedef struct {
+    uint32_t id;                  /* Device the state belongs to, 0 = none */
+    uint8_t status;               /* Latest status seen */
+    uint8_t reported;             /* Status consumers were told; UNKNOWN = none */
+    uint8_t pending;
+    uint8_t flapping;
+    uint8_t suppressed;           /* Current failure hidden behind a down upstream */
+    device_ref_t upstream;        /* The upstream it is hidden behind */
+    uint64_t pending_ms;          /* When the pending timer fires */
+    uint64_t changes[CORRELATE_FLAP_HISTORY];
+    int change_head;
+    uint32_t children_down;       /* Suppressed downstream devices, not yet summarized */
+    recent_t recent[DEDUP_KEYS];
+} corr_state_t;
+
+typedef struct {
+    alert_batch_cb cb;
+    void *ctx;
+} subscriber_t;
+
+static correlate_config_t corr_cfg = {
+    CORRELATE_DEFAULT_HOLD_DOWN_MS, CORRELATE_DEFAULT_SETTLE_MS,
+    CORRELATE_DEFAULT_FLAP_WINDOW_MS, CORRELATE_DEFAULT_FLAP_HIGH,
+    CORRELATE_DEFAULT_FLAP_LOW, CORRELATE_DEFAULT_BATCH_MS,
+    CORRELATE_DEFAULT_BATCH_MAX
+};
+
+static pthread_mutex_t corr_lock = PTHREAD_MUTEX_INITIALIZER;
+static chunk_array_t states = CHUNK_ARRAY_INIT(corr_state_t);
+static int state_limit = 0;           /* One past the highest slot with state */
+static recent_t host_recent[HOST_DEDUP_SLOTS];
+static correlate_stats_t stats;
+
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_stop = PTHREAD_COND_INITIALIZER;
+static pthread_t batch_thread;
+static int batch_running = 0;
+static int batch_stopping = 0;
+static subscriber_t subscribers[CORRELATE_MAX_SUBSCRIBERS];
+static uint64_t sub_cursor[CORRELATE_MAX_SUBSCRIBERS];
+static int subscriber_count = 0;
+
+/* Templates, interned once */
+static uint16_t t_down, t_warning, t_recovered, t_flapping, t_settled, t_downstream;
+static pthread_once_t templates_once = PTHREAD_ONCE_INIT;
+
+static void intern_templates(void)
+{
+    t_down = alert_intern("Device down: no SNMP or ICMP response");
+    t_warning = alert_intern("SNMP not responding, host answers ICMP");
+    t_recovered = alert_intern("Device recovered");
+    t_flapping = alert_intern("Device flapping: {} status changes, status alerts suppressed");
+    t_settled = alert_intern("Device stopped flapping");
+    t_downstream = alert_intern("{} downstream device(s) unreachable behind this device");
+}
+
+void correlate_config_default(correlate_config_t *c)
+{
+    c->hold_down_ms = CORRELATE_DEFAULT_HOLD_DOWN_MS;
+    c->settle_ms = CORRELATE_DEFAULT_SETTLE_MS;
+    c->flap_window_ms = CORRELATE_DEFAULT_FLAP_WINDOW_MS;
+    c->flap_high = CORRELATE_DEFAULT_FLAP_HIGH;
+    c->flap_low = CORRELATE_DEFAULT_FLAP_LOW;
+    c->batch_ms = CORRELATE_DEFAULT_BATCH_MS;
+    c->batch_max = CORRELATE_DEFAULT_BATCH_MAX;
+}
+
+int correlate_configure(const correlate_config_t *c)
+{
+    if (c == NULL || c->hold_down_ms < 0 || c->settle_ms < 0 || c->flap_window_ms <= 0 ||
+        c->flap_high < 2 || c->flap_high > CORRELATE_FLAP_HISTORY ||
+        c->flap_low < 0 || c->flap_low >= c->flap_high ||
+        c->batch_ms <= 0 || c->batch_max <= 0) {
+        return NETMON_ERROR;
+    }
+    pthread_mutex_lock(&batch_lock);
+    int rc = NETMON_ERROR;
+    if (!batch_running) {
+        pthread_mutex_lock(&corr_lock);
+        corr_cfg = *c;
+        pthread_mutex_unlock(&corr_lock);
+        rc = NETMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&batch_lock);
+    return rc;
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* State of the device behind ref, reset if the slot changed hands; caller holds corr_lock */
+static corr_state_t *state_for(int slot, uint32_t id)
+{
+    if (slot < 0 || id == 0) {
+        return NULL;
+    }
+    corr_state_t *st = chunk_array_reserve(&states, (uint32_t)slot);
+    if (st == NULL) {
+        return NULL;
+    }
+    if (slot >= state_limit) {
+        state_limit = slot + 1;
+    }
+    if (st->id != id) {
+        memset(st, 0, sizeof(*st));
+        st->id = id;
+    }
+    return st;
+}
+
+static int is_failure(uint8_t status)
+{
+    return status == DEVICE_STATUS_DOWN || status == DEVICE_STATUS_WARNING;
+}
+
+/* ------------------------------------------------------------------ */
+/* Topology                                                           */
+/* ------------------------------------------------------------------ */
+
+static int entry_addr(const device_entry_t *e, uint32_t *addr)
+{
+    struct in_addr in;
+
+    if (inet_pton(AF_INET, e->ip_address, &in) != 1) {
+        return 0;
+    }
+    *addr = ntohl(in.s_addr);
+    return 1;
+}
+
+/*
+ * The monitored router a device sits behind, from the inventory's
+ * upstream records. Returns 1 and fills parent, 0 if unknown or the
+ * router is not a database device.
+ */
+static int upstream_device(uint32_t id, device_ref_t *parent)
+{
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    uint32_t router = 0;
+    int found = 0;
+
+    for (int i = 0; i < snap->count; i++) {
+        uint32_t addr;
+        if (snap->entries[i]->id == id && entry_addr(snap->entries[i], &addr)) {
+            router = inventory_upstream(addr);
+            break;
+        }
+    }
+    for (int i = 0; router != 0 && i < snap->count; i++) {
+        uint32_t addr;
+        const device_entry_t *e = snap->entries[i];
+        if (e->id != id && entry_addr(e, &addr) && addr == router) {
+            parent->slot = e->slot;
+            parent->id = e->id;
+            found = 1;
+            break;
+        }
+    }
+    device_db_snapshot_release(snap);
+    return found;
+}
+
+static int device_is_down(const device_ref_t *ref)
+{
+    device_metrics_t m;
+
+    return metrics_store_read(ref->slot, ref->id, &m) == NETMON_SUCCESS &&
+           m.status == DEVICE_STATUS_DOWN;
+}
+
+/* ------------------------------------------------------------------ */
+/* Status changes                                                     */
+/* ------------------------------------------------------------------ */
+
+/* Caller holds corr_lock */
+static void emit(const corr_state_t *st, int slot, alert_severity_t severity, uint16_t template_id,
+                 const double *value)
+{
+    device_ref_t ref = { slot, st->id };
+
+    if (alert_raise(severity, &ref, template_id, value) == NETMON_SUCCESS) {
+        __atomic_fetch_add(&stats.passed, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* Tell consumers about status, which differs from what they were told last */
+static void report_status(corr_state_t *st, int slot, uint8_t status)
+{
+    switch (status) {
+        case DEVICE_STATUS_DOWN:
+            emit(st, slot, ALERT_CRITICAL, t_down, NULL);
+            break;
+        case DEVICE_STATUS_WARNING:
+            emit(st, slot, ALERT_WARNING, t_warning, NULL);
+            break;
+        case DEVICE_STATUS_UP:
+            if (is_failure(st->reported)) {
+                emit(st, slot, ALERT_INFO, t_recovered, NULL);
+            }
+            break;
+        default:
+            break;
+    }
+    st->reported = status;
+    st->suppressed = 0;
+}
+
+/* The upstream is no longer down: report a failure it was hiding, and let alerts through */
+static void release_child(corr_state_t *st, int slot)
+{
+    if (is_failure(st->status)) {
+        report_status(st, slot, st->status);
+    } else {
+        st->reported = st->status;
+        st->suppressed = 0;
+    }
+}
+
+/* The upstream at slot/id left DOWN; caller holds corr_lock */
+static void release_children(int slot, uint32_t id)
+{
+    for (int i = 0; i < state_limit; i++) {
+        corr_state_t *c = chunk_array_get(&states, (uint32_t)i);
+        if (c != NULL && c->id != 0 && c->suppressed && c->upstream.slot == slot && c->upstream.id == id) {
+            release_child(c, i);
+        }
+    }
+}
+
+static int recent_changes(const corr_state_t *st, uint64_t now)
+{
+    int n = 0;
+
+    for (int i = 0; i < CORRELATE_FLAP_HISTORY; i++) {
+        if (st->changes[i] != 0 && now - st->changes[i] <= (uint64_t)corr_cfg.flap_window_ms) {
+            n++;
+        }
+    }
+    return n;
+}
+
+void correlate_status(const device_ref_t *ref, device_status_t before, device_status_t after)
+{
+    if (ref == NULL || before == after || after == DEVICE_STATUS_UNKNOWN) {
+        return;
+    }
+    pthread_once(&templates_once, intern_templates);
+    uint64_t now = now_ms();
+
+    pthread_mutex_lock(&corr_lock);
+    corr_state_t *st = state_for(ref->slot, ref->id);
+    if (st == NULL) {
+        pthread_mutex_unlock(&corr_lock);
+        return;
+    }
+    st->status = (uint8_t)after;
+    if (before == DEVICE_STATUS_DOWN) {
+        release_children(ref->slot, ref->id);
+    }
+
+    /* A device's first status is not a change */
+    if (before != DEVICE_STATUS_UNKNOWN) {
+        st->changes[st->change_head] = now;
+        st->change_head = (st->change_head + 1) % CORRELATE_FLAP_HISTORY;
+    }
+    if (!st->flapping && recent_changes(st, now) >= corr_cfg.flap_high) {
+        double n = recent_changes(st, now);
+        st->flapping = 1;
+        st->pending = PENDING_NONE;
+        emit(st, ref->slot, ALERT_WARNING, t_flapping, &n);
+    }
+    if (st->flapping) {
+        stats.flap_suppressed++;
+        pthread_mutex_unlock(&corr_lock);
+        return;
+    }
+
+    if (is_failure(after)) {
+        device_ref_t parent;
+        st->pending = PENDING_NONE;
+        if (st->reported == after) {
+            stats.held++;                   /* Failed again within the hold-down */
+        } else if (after == DEVICE_STATUS_DOWN && upstream_device(st->id, &parent)) {
+            st->pending = PENDING_DOWN;     /* Decide once the upstream has been polled */
+            st->pending_ms = now + (uint64_t)corr_cfg.settle_ms;
+        } else {
+            report_status(st, ref->slot, (uint8_t)after);
+        }
+    } else if (after == DEVICE_STATUS_UP) {
+        if (st->pending == PENDING_DOWN) {
+            st->pending = PENDING_NONE;     /* Never reported */
+            stats.held++;
+        } else if (st->suppressed) {
+            st->reported = DEVICE_STATUS_UP;
+            st->suppressed = 0;
+        } else if (is_failure(st->reported)) {
+            st->pending = PENDING_RECOVERY;
+            st->pending_ms = now + (uint64_t)corr_cfg.hold_down_ms;
+        }
+    }
+    pthread_mutex_unlock(&corr_lock);
+}
+
+/* Fire one device's expired timers; caller holds corr_lock */
+static void tick_state(int slot, corr_state_t *st, uint64_t now)
+{
+    /* Upstream removed, or its recovery was never seen */
+    if (st->suppressed && !device_is_down(&st->upstream)) {
+        release_child(st, slot);
+    }
+
+    if (st->flapping && recent_changes(st, now) <= corr_cfg.flap_low) {
+        st->flapping = 0;
+        emit(st, slot, ALERT_INFO, t_settled, NULL);
+        if (st->status != st->reported &&
+            (is_failure(st->status) || is_failure(st->reported))) {
+            report_status(st, slot, st->status);
+        }
+    }
+
+    if (st->pending != PENDING_NONE && now >= st->pending_ms) {
+        device_ref_t parent;
+        if (st->pending == PENDING_RECOVERY) {
+            report_status(st, slot, DEVICE_STATUS_UP);
+        } else if (upstream_device(st->id, &parent) && device_is_down(&parent)) {
+            corr_state_t *p = state_for(parent.slot, parent.id);
+            if (p != NULL) {
+                p->children_down++;
+            }
+            st->reported = DEVICE_STATUS_DOWN;
+            st->suppressed = 1;
+            st->upstream = parent;
+            stats.topology_suppressed++;
+        } else {
+            report_status(st, slot, DEVICE_STATUS_DOWN);
+        }
+        st->pending = PENDING_NONE;
+    }
+}
+
+void correlate_tick(void)
+{
+    pthread_once(&templates_once, intern_templates);
+    uint64_t now = now_ms();
+
+    pthread_mutex_lock(&corr_lock);
+    for (int slot = 0; slot < state_limit; slot++) {
+        corr_state_t *st = chunk_array_get(&states, (uint32_t)slot);
+        if (st != NULL && st->id != 0) {
+            tick_state(slot, st, now);
+        }
+    }
+    /* One summary per router instead of one alert per child */
+    for (int slot = 0; slot < state_limit; slot++) {
+        corr_state_t *st = chunk_array_get(&states, (uint32_t)slot);
+        if (st != NULL && st->id != 0 && st->children_down > 0) {
+            double n = st->children_down;
+            emit(st, slot, ALERT_ERROR, t_downstream, &n);
+            st->children_down = 0;
+        }
+    }
+    pthread_mutex_unlock(&corr_lock);
+}
+
+/* ------------------------------------------------------------------ */
+/* Other alerts                                                       */
+/* ------------------------------------------------------------------ */
+
+/* Non-zero if key was seen within the hold-down; records it otherwise */
+static int seen_recently(recent_t *r, uint16_t template_id, uint64_t now)
+{
+    if (r->template_id == template_id && r->at_ms != 0 &&
+        now - r->at_ms < (uint64_t)corr_cfg.hold_down_ms) {
+        return 1;
+    }
+    r->template_id = template_id;
+    r->at_ms = now;
+    return 0;
+}
+
+/* correlate_event(), with the template hold-down applied only if dedup */
+static int pass_event(alert_event_t *event, int dedup)
+{
+    recent_t *r = NULL;
+
+    if (event == NULL) {
+        return NETMON_ERROR;
+    }
+    uint64_t now = now_ms();
+
+    pthread_mutex_lock(&corr_lock);
+    if (event->device_id != 0) {
+        corr_state_t *st = state_for(event->device_slot, event->device_id);
+        if (st != NULL) {
+            if (event->severity >= ALERT_WARNING && st->suppressed) {
+                stats.topology_suppressed++;
+                pthread_mutex_unlock(&corr_lock);
+                return NETMON_SUCCESS;
+            }
+            /* Same template again, else the least recently used key */
+            for (int i = 0; dedup && i < DEDUP_KEYS; i++) {
+                if (st->recent[i].template_id == event->template_id) {
+                    r = &st->recent[i];
+                    break;
+                }
+                if (r == NULL || st->recent[i].at_ms < r->at_ms) {
+                    r = &st->recent[i];
+                }
+            }
+        }
+    } else if (dedup) {
+        uint32_t h = ((uint32_t)event->host_id * 2654435761u) ^ event->template_id;
+        r = &host_recent[h % HOST_DEDUP_SLOTS];
+        if (r->template_id != event->template_id) {
+            r->at_ms = 0;
+        }
+    }
+
+    if (r != NULL && event->template_id != 0 && seen_recently(r, event->template_id, now)) {
+        stats.deduplicated++;
+        pthread_mutex_unlock(&corr_lock);
+        return NETMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&corr_lock);
+
+    int rc = alert_publish(event);
+    if (rc == NETMON_SUCCESS) {
+        __atomic_fetch_add(&stats.passed, 1, __ATOMIC_RELAXED);
+    }
+    return rc;
+}
+
+int correlate_event(alert_event_t *event)
+{
+    return pass_event(event, 1);
+}
+
+int correlate_edge(alert_event_t *event)
+{
+    return pass_event(event, 0);
+}
+
+/* ------------------------------------------------------------------ */
+/* Batcher                                                            */
+/* ------------------------------------------------------------------ */
+
+int correlate_subscribe(alert_batch_cb cb, void *ctx)
+{
+    int rc = NETMON_ERROR;
+
+    if (cb == NULL) {
+        return NETMON_ERROR;
+    }
+    pthread_mutex_lock(&batch_lock);
+    if (subscriber_count < CORRELATE_MAX_SUBSCRIBERS) {
+        subscribers[subscriber_count].cb = cb;
+        subscribers[subscriber_count].ctx = ctx;
+        sub_cursor[subscriber_count] = alert_head();
+        subscriber_count++;
+        rc = NETMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&batch_lock);
+    return rc;
+}
+
+void correlate_unsubscribe(alert_batch_cb cb, void *ctx)
+{
+    pthread_mutex_lock(&batch_lock);
+    for (int i = 0; i < subscriber_count; i++) {
+        if (subscribers[i].cb == cb && subscribers[i].ctx == ctx) {
+            subscriber_count--;
+            subscribers[i] = subscribers[subscriber_count];
+            sub_cursor[i] = sub_cursor[subscriber_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&batch_lock);
+}
+
+/*
+ * Hand every subscriber at most batch_max new records; caller holds
+ * batch_lock, which (un)subscribe also take, so callbacks must not
+ */
+static void deliver(alert_event_t *buf)
+{
+    for (int i = 0; i < subscriber_count; i++) {
+        uint64_t lost = 0;
+        int n = alert_read(&sub_cursor[i], buf, corr_cfg.batch_max, &lost);
+        if (n > 0 || lost > 0) {
+            subscribers[i].cb(buf, n, lost, subscribers[i].ctx);
+            pthread_mutex_lock(&corr_lock);
+            stats.batches++;
+            stats.lost += lost;
+            pthread_mutex_unlock(&corr_lock);
+        }
+    }
+}
+
+static void *batch_main(void *arg)
+{
+    alert_event_t *buf = arg;
+
+    pthread_mutex_lock(&batch_lock);
+    while (!batch_stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += corr_cfg.batch_ms / 1000;
+        deadline.tv_nsec += (long)(corr_cfg.batch_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int rc = 0;
+        while (!batch_stopping && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&batch_stop, &batch_lock, &deadline);
+        }
+        if (batch_stopping) {
+            break;
+        }
+        threshold_evaluate();
+        correlate_tick();
+        deliver(buf);
+    }
+    pthread_mutex_unlock(&batch_lock);
+    return NULL;
+}
+
+int correlate_start(void)
+{
+    static alert_event_t *buf;
+
+    pthread_mutex_lock(&batch_lock);
+    if (batch_running) {
+        pthread_mutex_unlock(&batch_lock);
+        return NETMON_SUCCESS;
+    }
+    alert_event_t *grown = realloc(buf, (size_t)corr_cfg.batch_max * sizeof(*buf));
+    if (grown == NULL) {
+        pthread_mutex_unlock(&batch_lock);
+        return NETMON_ERROR;
+    }
+    buf = grown;
+    /* Topology comes from the inventory the discovery runs maintain */
+    if (inventory_host_count() == 0) {
+        inventory_load(INVENTORY_DEFAULT_PATH);
+    }
+    batch_stopping = 0;
+    if (pthread_create(&batch_thread, NULL, batch_main, buf) != 0) {
+        pthread_mutex_unlock(&batch_lock);
+        return NETMON_ERROR;
+    }
+    batch_running = 1;
+    pthread_mutex_unlock(&batch_lock);
+    return NETMON_SUCCESS;
+}
+
+void correlate_stop(void)
+{
+    pthread_mutex_lock(&batch_lock);
+    if (!batch_running) {
+        pthread_mutex_unlock(&batch_lock);
+        return;
+    }
+    batch_stopping = 1;
+    pthread_cond_signal(&batch_stop);
+    pthread_mutex_unlock(&batch_lock);
+    pthread_join(batch_thread, NULL);
+
+    pthread_mutex_lock(&batch_lock);
+    batch_running = 0;
+    pthread_mutex_unlock(&batch_lock);
+}
+
+void correlate_get_stats(correlate_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&corr_lock);
+    *out = stats;
+    out->passed = __atomic_load_n(&stats.passed, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&corr_lock);
+}
+
+void correlate_free(void)
+{
+    pthread_mutex_lock(&corr_lock);
+    chunk_array_free(&states);
+    state_limit = 0;
+    pthread_mutex_unlock(&corr_lock);
+}
@@ -0,0 +1,384 @@
+/*
+ * Alert Manager
+ * Multi-producer ring of 40-byte alert records. Each slot carries a
+ * state word holding its stream position, a dropped bit and a writing
+ * bit; producers claim it with a CAS after one fetch_add on the head and
+ * publish with a release store, readers validate a copy against the
+ * state word the way the metrics store's seqlock readers do.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "alert.h"
+#include "correlator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RELAXED __ATOMIC_RELAXED
+#define RING_MASK (ALERT_RING_SIZE - 1)
+#define EVENT_WORDS (sizeof(alert_event_t) / sizeof(uint64_t))
+
+_Static_assert((ALERT_RING_SIZE & RING_MASK) == 0, "ALERT_RING_SIZE must be a power of two");
+_Static_assert(sizeof(alert_event_t) == 40, "alert_event_t should stay five words");
+
+/*
+ * state = (position + 1) << 2 | dropped << 1 | writing; 0 = never written
+ * A dropped state is a tombstone for a position whose producer found the
+ * slot still held: readers skip it as lost instead of waiting a lap.
+ */
+typedef struct {
+    uint64_t state;
+    uint64_t words[EVENT_WORDS];
+} ring_slot_t;
+
+static ring_slot_t ring[ALERT_RING_SIZE];
+static uint64_t head = 0;             /* Next position */
+static uint64_t clear_mark = 0;       /* First position after clear_alerts() */
+static uint64_t dropped = 0;
+
+/* Interned strings, open addressing; id = index + 1 */
+static const char *strings[ALERT_MAX_STRINGS];
+
+#define STATE_WRITING 1u
+#define STATE_DROPPED 2u
+
+static uint64_t slot_state(uint64_t pos, int writing)
+{
+    return ((pos + 1) << 2) | (writing ? STATE_WRITING : 0);
+}
+
+static uint64_t state_pos1(uint64_t state)
+{
+    return state >> 2;
+}
+
+/* FNV-1a */
+static uint32_t hash_string(const char *s)
+{
+    uint32_t h = 2166136261u;
+
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Lock-free insert: the first thread to CAS its copy into an empty
+ * slot wins, losers compare against the winner and keep probing
+ */
+uint16_t alert_intern(const char *text)
+{
+    char *copy = NULL;
+
+    if (text == NULL) {
+        return 0;
+    }
+    uint32_t h = hash_string(text);
+    for (int probe = 0; probe < ALERT_MAX_STRINGS; probe++) {
+        int i = (int)((h + (uint32_t)probe) % ALERT_MAX_STRINGS);
+        const char *cur = __atomic_load_n(&strings[i], __ATOMIC_ACQUIRE);
+
+        if (cur == NULL) {
+            if (copy == NULL && (copy = strdup(text)) == NULL) {
+                return 0;
+            }
+            const char *expected = NULL;
+            if (__atomic_compare_exchange_n(&strings[i], &expected, copy, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+                return (uint16_t)(i + 1);
+            }
+            cur = expected;
+        }
+        if (strcmp(cur, text) == 0) {
+            free(copy);
+            return (uint16_t)(i + 1);
+        }
+    }
+    free(copy);
+    return 0;
+}
+
+const char *alert_string(uint16_t id)
+{
+    if (id == 0 || id > ALERT_MAX_STRINGS) {
+        return "";
+    }
+    const char *s = __atomic_load_n(&strings[id - 1], __ATOMIC_ACQUIRE);
+    return s != NULL ? s : "";
+}
+
+static int64_t wall_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Write ev at the next position. A slot still marked writing means a
+ * producer stalled for a whole lap: the record is dropped rather than
+ * waiting, and a tombstone for its position is left in the slot, keeping
+ * the writing bit, so readers count it lost and move on. A slot already
+ * taken by a newer position also drops the record; readers see it as
+ * overwritten. A stalled producer that finds its slot tombstoned drops
+ * its own record and hands the slot back by clearing the writing bit.
+ */
+int alert_publish(alert_event_t *ev)
+{
+    uint64_t words[EVENT_WORDS];
+
+    if (ev == NULL) {
+        return NETMON_ERROR;
+    }
+    if (ev->timestamp_ms == 0) {
+        ev->timestamp_ms = wall_ms();
+    }
+    uint64_t pos = __atomic_fetch_add(&head, 1, RELAXED);
+    ring_slot_t *slot = &ring[pos & RING_MASK];
+    uint64_t s = __atomic_load_n(&slot->state, RELAXED);
+    for (;;) {
+        if (state_pos1(s) > pos + 1) {
+            __atomic_fetch_add(&dropped, 1, RELAXED);
+            return NETMON_ERROR;
+        }
+        if (s & STATE_WRITING) {
+            uint64_t tomb = slot_state(pos, 1) | STATE_DROPPED;
+            if (__atomic_compare_exchange_n(&slot->state, &s, tomb, 0, __ATOMIC_RELEASE, RELAXED)) {
+                __atomic_fetch_add(&dropped, 1, RELAXED);
+                return NETMON_ERROR;
+            }
+        } else if (__atomic_compare_exchange_n(&slot->state, &s, slot_state(pos, 1), 0,
+                                               __ATOMIC_ACQUIRE, RELAXED)) {
+            break;
+        }
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    ev->seq = pos;
+    memcpy(words, ev, sizeof(words));
+    for (size_t i = 0; i < EVENT_WORDS; i++) {
+        __atomic_store_n(&slot->words[i], words[i], RELAXED);
+    }
+    s = slot_state(pos, 1);
+    if (__atomic_compare_exchange_n(&slot->state, &s, slot_state(pos, 0), 0,
+                                    __ATOMIC_RELEASE, RELAXED)) {
+        return NETMON_SUCCESS;
+    }
+    /* Tombstoned by a later lap: keep its position, release the slot */
+    while (!__atomic_compare_exchange_n(&slot->state, &s, s & ~(uint64_t)STATE_WRITING, 0,
+                                        __ATOMIC_RELEASE, RELAXED)) {
+    }
+    __atomic_fetch_add(&dropped, 1, RELAXED);
+    return NETMON_ERROR;
+}
+
+int alert_raise(alert_severity_t severity, const device_ref_t *ref, uint16_t template_id,
+                const double *value)
+{
+    alert_event_t ev;
+
+    if (ref == NULL || ref->id == 0) {
+        return NETMON_ERROR;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.device_id = ref->id;
+    ev.device_slot = ref->slot;
+    ev.template_id = template_id;
+    ev.severity = (uint8_t)severity;
+    if (value != NULL) {
+        ev.value = *value;
+        ev.has_value = 1;
+    }
+    return alert_publish(&ev);
+}
+
+/* 1 = copied, 0 = not yet published, -1 = overwritten or dropped */
+static int read_slot(uint64_t pos, alert_event_t *ev)
+{
+    uint64_t words[EVENT_WORDS];
+    const ring_slot_t *slot = &ring[pos & RING_MASK];
+    uint64_t want = slot_state(pos, 0);
+
+    uint64_t s1 = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+    if (s1 != want) {
+        if (state_pos1(s1) > pos + 1 || (state_pos1(s1) == pos + 1 && (s1 & STATE_DROPPED))) {
+            return -1;
+        }
+        return 0;
+    }
+    for (size_t i = 0; i < EVENT_WORDS; i++) {
+        words[i] = __atomic_load_n(&slot->words[i], RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->state, RELAXED) != want) {
+        return -1;
+    }
+    memcpy(ev, words, sizeof(words));
+    return 1;
+}
+
+int alert_read(uint64_t *cursor, alert_event_t *events, int max_count, uint64_t *lost)
+{
+    int n = 0;
+
+    if (cursor == NULL || events == NULL) {
+        return 0;
+    }
+    uint64_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    uint64_t c = *cursor;
+    uint64_t skipped = 0;
+
+    if (h > c && h - c > ALERT_RING_SIZE) {
+        skipped += h - ALERT_RING_SIZE - c;
+        c = h - ALERT_RING_SIZE;
+    }
+    while (c < h && n < max_count) {
+        int r = read_slot(c, &events[n]);
+        if (r == 0) {
+            break;      /* Producer still writing; ordered readers wait for it */
+        }
+        if (r > 0) {
+            n++;
+        } else {
+            skipped++;
+        }
+        c++;
+    }
+
+    *cursor = c;
+    if (lost != NULL) {
+        *lost += skipped;
+    }
+    return n;
+}
+
+uint64_t alert_head(void)
+{
+    return __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+}
+
+/* Hostname of a database device; removed devices fall back to their id */
+static void device_name(const alert_event_t *ev, char *out, size_t size)
+{
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+
+    snprintf(out, size, "device-%u", ev->device_id);
+    for (int i = 0; i < snap->count; i++) {
+        const device_entry_t *e = snap->entries[i];
+        if (e->id == ev->device_id) {
+            snprintf(out, size, "%s", e->hostname);
+            break;
+        }
+    }
+    device_db_snapshot_release(snap);
+}
+
+void alert_format(const alert_event_t *event, alert_t *alert)
+{
+    if (event == NULL || alert == NULL) {
+        return;
+    }
+    memset(alert, 0, sizeof(*alert));
+    alert->timestamp = (time_t)(event->timestamp_ms / 1000);
+    alert->severity = (alert_severity_t)event->severity;
+    if (event->device_id != 0) {
+        device_name(event, alert->device_hostname, sizeof(alert->device_hostname));
+    } else {
+        snprintf(alert->device_hostname, sizeof(alert->device_hostname), "%s",
+                 alert_string(event->host_id));
+    }
+
+    const char *tmpl = alert_string(event->template_id);
+    const char *mark = event->has_value ? strstr(tmpl, ALERT_VALUE_MARK) : NULL;
+    if (mark == NULL) {
+        snprintf(alert->message, sizeof(alert->message), "%s", tmpl);
+    } else {
+        snprintf(alert->message, sizeof(alert->message), "%.*s%g%s",
+                 (int)(mark - tmpl), tmpl, event->value, mark + strlen(ALERT_VALUE_MARK));
+    }
+}
+
+uint32_t alert_count(void)
+{
+    uint64_t n = __atomic_load_n(&head, RELAXED) - __atomic_load_n(&clear_mark, RELAXED);
+    return n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+}
+
+uint64_t alert_dropped(void)
+{
+    return __atomic_load_n(&dropped, RELAXED);
+}
+
+/* ------------------------------------------------------------------ */
+/* netmon.h alert API                                                 */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Record an alert through the correlation stage (correlator.h); the
+ * message is interned as a template, so it should be fixed text.
+ * Alerts for hosts that are not in the device database keep their
+ * hostname interned as well.
+ */
+int add_alert(const alert_t *alert)
+{
+    alert_event_t ev;
+    device_ref_t ref;
+
+    if (alert == NULL) {
+        return NETMON_ERROR;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.timestamp_ms = (int64_t)alert->timestamp * 1000;
+    ev.severity = (uint8_t)alert->severity;
+    ev.template_id = alert_intern(alert->message);
+    if (device_db_find(alert->device_hostname, &ref) == NETMON_SUCCESS) {
+        ev.device_id = ref.id;
+        ev.device_slot = ref.slot;
+    } else {
+        ev.host_id = alert_intern(alert->device_hostname);
+    }
+    return correlate_event(&ev);
+}
+
+/*
+ * Copy the most recent alerts since the last clear_alerts(), oldest first
+ * Returns the number of alerts written
+ */
+int get_alerts(alert_t *alerts, int max_count)
+{
+    alert_event_t batch[64];
+    int n = 0;
+
+    if (alerts == NULL || max_count <= 0) {
+        return 0;
+    }
+    uint64_t h = alert_head();
+    uint64_t cursor = __atomic_load_n(&clear_mark, RELAXED);
+    if (h - cursor > (uint64_t)max_count) {
+        cursor = h - (uint64_t)max_count;
+    }
+    while (n < max_count && cursor < h) {
+        uint64_t before = cursor;
+        int want = max_count - n < 64 ? max_count - n : 64;
+        int got = alert_read(&cursor, batch, want, NULL);
+        for (int i = 0; i < got; i++) {
+            alert_format(&batch[i], &alerts[n++]);
+        }
+        if (cursor == before) {
+            break;
+        }
+    }
+    return n;
+}
+
+/* Hide every alert raised so far from get_alerts(); readers' cursors are unaffected */
+int clear_alerts(void)
+{
+    __atomic_store_n(&clear_mark, alert_head(), RELAXED);
+    return NETMON_SUCCESS;
+}
@@ -0,0 +1,299 @@
+/*
+ * Counter Rates
+ * Per-slot interface state arrays sorted by ifindex; each update merges
+ * the new readings into a spare array and swaps, so a poll is one
+ * linear pass with no allocation once the arrays have grown. Slot
+ * states live in a chunk array grown as slots appear, guarded by a
+ * fixed set of striped locks.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "counter_rate.h"
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Agent and wall clocks may disagree by this much before we call it a restart */
+#define CLOCK_SLACK_MS 1000
+
+/* Slot s is guarded by locks[s % STATE_LOCKS] */
+#define STATE_LOCKS 64
+
+typedef struct {
+    uint32_t ifindex;
+    uint8_t width;
+    uint8_t valid;
+    uint64_t in;                  /* Previous raw readings */
+    uint64_t out;
+    double in_bps;                /* EWMA */
+    double out_bps;
+    double last_in_bps;
+    double last_out_bps;
+} iface_state_t;
+
+typedef struct {
+    uint32_t id;                  /* Device the state belongs to, 0 = none */
+    int have_baseline;
+    uint32_t uptime;
+    uint64_t last_ms;
+    iface_state_t *ifs;
+    iface_state_t *spare;
+    int count;
+    int cap;
+} device_state_t;
+
+static chunk_array_t states = CHUNK_ARRAY_INIT(device_state_t);
+static int state_limit = 0;           /* One past the highest slot with state */
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;   /* Growth only */
+static pthread_mutex_t locks[STATE_LOCKS];
+static pthread_once_t locks_once = PTHREAD_ONCE_INIT;
+
+static void locks_init(void)
+{
+    for (int i = 0; i < STATE_LOCKS; i++) {
+        pthread_mutex_init(&locks[i], NULL);
+    }
+}
+
+/* State of slot, grown into if create; NULL if absent or out of memory */
+static device_state_t *state_at(int slot, int create)
+{
+    device_state_t *st = chunk_array_get(&states, (uint32_t)slot);
+
+    if (create && (st == NULL || slot >= __atomic_load_n(&state_limit, __ATOMIC_RELAXED))) {
+        pthread_mutex_lock(&table_lock);
+        st = chunk_array_reserve(&states, (uint32_t)slot);
+        if (st != NULL && slot >= state_limit) {
+            __atomic_store_n(&state_limit, slot + 1, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&table_lock);
+    }
+    return st;
+}
+
+static void reset_state(device_state_t *st, uint32_t id)
+{
+    st->id = id;
+    st->have_baseline = 0;
+    st->count = 0;
+}
+
+static int reserve(device_state_t *st, int count)
+{
+    if (count <= st->cap) {
+        return NETMON_SUCCESS;
+    }
+    int cap = st->cap ? st->cap : 16;
+    while (cap < count) cap *= 2;
+
+    iface_state_t *ifs = realloc(st->ifs, (size_t)cap * sizeof(*ifs));
+    if (ifs == NULL) {
+        return NETMON_ERROR;
+    }
+    st->ifs = ifs;
+    iface_state_t *spare = realloc(st->spare, (size_t)cap * sizeof(*spare));
+    if (spare == NULL) {
+        return NETMON_ERROR;
+    }
+    st->spare = spare;
+    st->cap = cap;
+    return NETMON_SUCCESS;
+}
+
+/*
+ * Octets since the previous reading; 0 and *ok = 0 when the counter
+ * was reset. A 32-bit counter below its previous value wrapped (once;
+ * polls must be shorter than the wrap time, ~34 s at 1 Gb/s).
+ */
+static uint64_t counter_delta(uint64_t now, uint64_t prev, uint8_t width, int *ok, int *wraps)
+{
+    if (now >= prev) {
+        *ok = 1;
+        return now - prev;
+    }
+    if (width == 32 && prev <= UINT32_MAX && now <= UINT32_MAX) {
+        *ok = 1;
+        (*wraps)++;
+        return now + ((uint64_t)1 << 32) - prev;
+    }
+    *ok = 0;
+    return 0;
+}
+
+static double ewma(double avg, double sample, uint64_t dt_ms, int first)
+{
+    if (first) {
+        return sample;
+    }
+    /* First-order step response of dt/(tau+dt); close to 1-exp(-dt/tau) for dt << tau */
+    double alpha = (double)dt_ms / (double)(COUNTER_RATE_EWMA_TAU_MS + dt_ms);
+    return avg + alpha * (sample - avg);
+}
+
+/*
+ * Interval since the last update in ms, from the agent's clock when
+ * both readings have it. Sets *restarted when sysUpTime disagrees with
+ * the wall clock: it went backwards (other than its 497-day wrap) or
+ * advanced much less than real time (reboot between polls).
+ */
+static uint64_t elapsed_ms(const device_state_t *st, uint32_t uptime, uint64_t now_ms, int *restarted)
+{
+    uint64_t wall = now_ms > st->last_ms ? now_ms - st->last_ms : 0;
+
+    *restarted = 0;
+    if (uptime == 0 || st->uptime == 0) {
+        return wall;
+    }
+
+    uint64_t agent = (uint64_t)(uint32_t)(uptime - st->uptime) * 10;
+    if (agent * 2 + CLOCK_SLACK_MS < wall || agent > wall * 2 + CLOCK_SLACK_MS) {
+        *restarted = 1;
+        return 0;
+    }
+    return agent;
+}
+
+int counter_rate_update(int slot, uint32_t id, uint32_t uptime, uint64_t now_ms,
+                        const counter_sample_t *samples, int count, device_rate_t *result)
+{
+    double in_sum = 0.0, out_sum = 0.0;
+    int restarted = 0;
+
+    if (slot < 0 || id == 0 || count < 0 ||
+        (count > 0 && samples == NULL) || result == NULL) {
+        return NETMON_ERROR;
+    }
+    pthread_once(&locks_once, locks_init);
+
+    device_state_t *st = state_at(slot, 1);
+    if (st == NULL) {
+        return NETMON_ERROR;
+    }
+    pthread_mutex_t *lock = &locks[slot % STATE_LOCKS];
+    pthread_mutex_lock(lock);
+    if (st->id != id) {
+        reset_state(st, id);
+    }
+    if (reserve(st, count) != NETMON_SUCCESS) {
+        pthread_mutex_unlock(lock);
+        return NETMON_ERROR;
+    }
+
+    uint64_t dt = 0;
+    if (st->have_baseline) {
+        dt = elapsed_ms(st, uptime, now_ms, &restarted);
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->restarted = restarted;
+
+    /* Merge the sorted readings with the sorted previous state */
+    int j = 0;
+    for (int i = 0; i < count; i++) {
+        const counter_sample_t *s = &samples[i];
+        iface_state_t *n = &st->spare[i];
+
+        while (j < st->count && st->ifs[j].ifindex < s->ifindex) {
+            j++;
+        }
+        const iface_state_t *prev = j < st->count && st->ifs[j].ifindex == s->ifindex ? &st->ifs[j] : NULL;
+
+        if (prev != NULL) {
+            *n = *prev;
+        } else {
+            memset(n, 0, sizeof(*n));
+            n->ifindex = s->ifindex;
+        }
+
+        if (prev != NULL && prev->width == s->width && dt > 0) {
+            int in_ok, out_ok;
+            uint64_t din = counter_delta(s->in_octets, prev->in, s->width, &in_ok, &result->wraps);
+            uint64_t dout = counter_delta(s->out_octets, prev->out, s->width, &out_ok, &result->wraps);
+            if (in_ok && out_ok) {
+                n->last_in_bps = (double)din * 8000.0 / (double)dt;
+                n->last_out_bps = (double)dout * 8000.0 / (double)dt;
+                n->in_bps = ewma(n->in_bps, n->last_in_bps, dt, !n->valid);
+                n->out_bps = ewma(n->out_bps, n->last_out_bps, dt, !n->valid);
+                n->valid = 1;
+            }
+        }
+        /* Readings at time 0 of the current interval are the next baseline either way */
+        if (prev == NULL || dt > 0 || restarted || prev->width != s->width) {
+            n->in = s->in_octets;
+            n->out = s->out_octets;
+            n->width = s->width;
+        }
+
+        if (n->valid) {
+            in_sum += n->in_bps;
+            out_sum += n->out_bps;
+            result->interfaces++;
+        }
+    }
+
+    iface_state_t *swap = st->ifs;
+    st->ifs = st->spare;
+    st->spare = swap;
+    st->count = count;
+
+    /* A zero-length interval keeps the old baseline so the next one spans both */
+    if (!st->have_baseline || dt > 0 || restarted) {
+        st->uptime = uptime;
+        st->last_ms = now_ms;
+        st->have_baseline = 1;
+    }
+    pthread_mutex_unlock(lock);
+
+    result->in_bps = (uint64_t)(in_sum + 0.5);
+    result->out_bps = (uint64_t)(out_sum + 0.5);
+    return NETMON_SUCCESS;
+}
+
+int counter_rate_interfaces(int slot, uint32_t id, interface_rate_t *rates, int max_count)
+{
+    int n = 0;
+
+    if (slot < 0 || rates == NULL) {
+        return 0;
+    }
+    pthread_once(&locks_once, locks_init);
+
+    device_state_t *st = state_at(slot, 0);
+    if (st == NULL) {
+        return 0;
+    }
+    pthread_mutex_t *lock = &locks[slot % STATE_LOCKS];
+    pthread_mutex_lock(lock);
+    if (st->id == id) {
+        for (int i = 0; i < st->count && n < max_count; i++, n++) {
+            const iface_state_t *s = &st->ifs[i];
+            rates[n].ifindex = s->ifindex;
+            rates[n].width = s->width;
+            rates[n].valid = s->valid;
+            rates[n].in_bps = (uint64_t)(s->in_bps + 0.5);
+            rates[n].out_bps = (uint64_t)(s->out_bps + 0.5);
+            rates[n].last_in_bps = (uint64_t)(s->last_in_bps + 0.5);
+            rates[n].last_out_bps = (uint64_t)(s->last_out_bps + 0.5);
+        }
+    }
+    pthread_mutex_unlock(lock);
+    return n;
+}
+
+void counter_rate_free(void)
+{
+    pthread_mutex_lock(&table_lock);
+    for (int slot = 0; slot < state_limit; slot++) {
+        device_state_t *st = chunk_array_get(&states, (uint32_t)slot);
+        if (st != NULL) {
+            free(st->ifs);
+            free(st->spare);
+        }
+    }
+    chunk_array_free(&states);
+    state_limit = 0;
+    pthread_mutex_unlock(&table_lock);
+}
@@ -0,0 +1,785 @@
+/*
+ * Device Monitor
+ * Timer-wheel driven polling engine. A scheduler thread advances the
+ * wheel every MONITOR_TICK_MS and hands expired devices to a worker
+ * pool; each worker polls over SNMP, stores the metrics in the device
+ * database and re-arms the device for its next deadline. Schedule
+ * entries live in a chunk array indexed by device slot, so their timers
+ * never move as the table grows.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "monitor.h"
+#include "device_db.h"
+#include "timer_wheel.h"
+#include "snmp.h"
+#include "if_poller.h"
+#include "if_table.h"
+#include "correlator.h"
+#include "threshold.h"
+#include "port_probe.h"
+#include "selfstat.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/* MIB-II system uptime; interface columns are in if_poller.c */
+#define OID_SYS_UPTIME "1.3.6.1.2.1.1.3.0"
+
+/* CISCO-PROCESS-MIB cpmCPUTotal5minRev, CISCO-MEMORY-POOL-MIB used/free */
+#define OID_CISCO_CPU_5MIN "1.3.6.1.4.1.9.9.109.1.1.1.1.8"
+#define OID_CISCO_MEM_USED "1.3.6.1.4.1.9.9.48.1.1.1.5"
+#define OID_CISCO_MEM_FREE "1.3.6.1.4.1.9.9.48.1.1.1.6"
+
+/* HOST-RESOURCES-MIB fallbacks for non-Cisco agents */
+#define OID_HR_PROCESSOR_LOAD "1.3.6.1.2.1.25.3.3.1.2"
+#define OID_HR_STORAGE_TYPE "1.3.6.1.2.1.25.2.3.1.2"
+#define OID_HR_STORAGE_SIZE "1.3.6.1.2.1.25.2.3.1.5"
+#define OID_HR_STORAGE_USED "1.3.6.1.2.1.25.2.3.1.6"
+#define OID_HR_STORAGE_RAM "1.3.6.1.2.1.25.2.1.2"
+
+/* Scheduling state of one device slot */
+typedef struct {
+    tw_timer_t timer;
+    device_ref_t ref;
+    uint64_t nominal;       /* Jitter-free deadline, keeps the phase stable */
+    int scheduled;          /* Timer armed or poll queued/running */
+    uint32_t seen;          /* Last reconcile pass that found the device */
+} poll_entry_t;
+
+static monitor_config_t monitor_cfg = {
+    MONITOR_DEFAULT_WORKERS, MONITOR_DEFAULT_INTERVAL_MS, MONITOR_DEFAULT_JITTER_PCT,
+    SNMP_DEFAULT_TIMEOUT_MS, SNMP_DEFAULT_RETRIES, TSDB_DEFAULT_DIR
+};
+
+static pthread_mutex_t monitor_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t scheduler_thread;
+static pthread_t worker_threads[MONITOR_MAX_WORKERS];
+static int worker_count = 0;
+static int running = 0;
+static int stopping = 0;
+
+static timer_wheel_t wheel;
+static chunk_array_t entries = CHUNK_ARRAY_INIT(poll_entry_t);
+static int entry_limit = 0;       /* One past the highest slot with an entry */
+static uint32_t known_generation;
+static uint32_t reconcile_pass = 0;
+
+/* Ready ring of slots whose deadline passed; each slot is queued at most once */
+static int *ready = NULL;
+static int ready_cap = 0;
+static int ready_head = 0;
+static int ready_len = 0;
+
+static uint32_t jitter_state = 0x9e3779b9U;
+
+void monitor_config_default(monitor_config_t *cfg)
+{
+    cfg->workers = MONITOR_DEFAULT_WORKERS;
+    cfg->interval_ms = MONITOR_DEFAULT_INTERVAL_MS;
+    cfg->jitter_pct = MONITOR_DEFAULT_JITTER_PCT;
+    cfg->snmp_timeout_ms = SNMP_DEFAULT_TIMEOUT_MS;
+    cfg->snmp_retries = SNMP_DEFAULT_RETRIES;
+    cfg->history_dir = TSDB_DEFAULT_DIR;
+}
+
+int monitor_configure(const monitor_config_t *cfg)
+{
+    int rc = NETMON_ERROR;
+
+    if (cfg == NULL || cfg->workers <= 0 || cfg->workers > MONITOR_MAX_WORKERS ||
+        cfg->interval_ms < MONITOR_TICK_MS || cfg->jitter_pct < 0 || cfg->jitter_pct > 50) {
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&monitor_lock);
+    if (!running) {
+        monitor_cfg = *cfg;
+        rc = NETMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&monitor_lock);
+    return rc;
+}
+
+int monitor_is_running(void)
+{
+    pthread_mutex_lock(&monitor_lock);
+    int r = running;
+    pthread_mutex_unlock(&monitor_lock);
+    return r;
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+static uint64_t now_tick(void)
+{
+    return now_ms() / MONITOR_TICK_MS;
+}
+
+/* xorshift32; only used for jitter, caller holds monitor_lock */
+static uint32_t next_random(void)
+{
+    uint32_t x = jitter_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    jitter_state = x;
+    return x;
+}
+
+static uint64_t interval_ticks(const network_device_t *dev)
+{
+    uint64_t ms = dev->poll_interval_ms ? dev->poll_interval_ms : (uint64_t)monitor_cfg.interval_ms;
+    uint64_t ticks = ms / MONITOR_TICK_MS;
+    return ticks > 0 ? ticks : 1;
+}
+
+/* Arm a device's timer at nominal +/- jitter; caller holds monitor_lock */
+static void arm_entry(poll_entry_t *e, uint64_t interval)
+{
+    uint64_t expires = e->nominal;
+    uint64_t span = interval * (uint64_t)monitor_cfg.jitter_pct / 100;
+
+    if (span > 0) {
+        uint64_t offset = next_random() % (2 * span + 1);
+        expires = expires + offset >= span ? expires + offset - span : 0;
+    }
+    tw_add(&wheel, &e->timer, expires);
+    e->scheduled = 1;
+}
+
+/*
+ * Bring the schedule in line with the device database: arm new devices
+ * and drop entries whose device is gone. Caller holds monitor_lock.
+ * Returns NETMON_ERROR if memory ran out before every device was armed.
+ */
+static int reconcile_devices(uint64_t tick)
+{
+    device_ref_t *refs;
+    int n = device_db_list(&refs);
+    int rc = NETMON_SUCCESS;
+
+    if (n < 0) {
+        return NETMON_ERROR;
+    }
+    reconcile_pass++;
+    for (int i = 0; i < n; i++) {
+        poll_entry_t *e = chunk_array_reserve(&entries, (uint32_t)refs[i].slot);
+        if (e == NULL) {
+            rc = NETMON_ERROR;  /* Scheduled on a later pass */
+            continue;
+        }
+        if (refs[i].slot >= entry_limit) {
+            entry_limit = refs[i].slot + 1;
+        }
+        e->seen = reconcile_pass;
+
+        if (e->scheduled && e->ref.id == refs[i].id) {
+            continue;
+        }
+        if (e->scheduled) {
+            tw_cancel(&wheel, &e->timer);
+        }
+
+        network_device_t dev;
+        if (device_db_read(refs[i], &dev) != NETMON_SUCCESS) {
+            e->scheduled = 0;
+            continue;
+        }
+
+        /*
+         * First deadline: golden-ratio offset of the device id inside one
+         * interval. Devices added in any order end up evenly spaced.
+         */
+        uint64_t interval = interval_ticks(&dev);
+        uint64_t phase = (uint64_t)(((uint32_t)(refs[i].id * 2654435769U)) *
+                                    (double)interval / 4294967296.0);
+        e->ref = refs[i];
+        e->nominal = tick + phase;
+        tw_timer_init(&e->timer, e);
+        arm_entry(e, interval);
+    }
+
+    free(refs);
+
+    for (int s = 0; s < entry_limit; s++) {
+        poll_entry_t *e = chunk_array_get(&entries, (uint32_t)s);
+        if (e != NULL && e->seen != reconcile_pass && e->scheduled && tw_pending(&e->timer)) {
+            tw_cancel(&wheel, &e->timer);
+            e->scheduled = 0;
+        }
+        /* Queued or running entries of removed devices are dropped by the worker */
+    }
+    return rc;
+}
+
+/* Room for one more ready slot, unrolling the ring into a larger one; caller holds monitor_lock */
+static int ready_grow(void)
+{
+    int cap = ready_cap ? ready_cap * 2 : 256;
+    int *grown = malloc((size_t)cap * sizeof(*grown));
+
+    if (grown == NULL) {
+        return NETMON_ERROR;
+    }
+    for (int i = 0; i < ready_len; i++) {
+        grown[i] = ready[(ready_head + i) % ready_cap];
+    }
+    free(ready);
+    ready = grown;
+    ready_cap = cap;
+    ready_head = 0;
+    return NETMON_SUCCESS;
+}
+
+static void expire_cb(tw_timer_t *timer, void *ctx)
+{
+    poll_entry_t *e = timer->data;
+    (void)ctx;
+
+    if (ready_len == ready_cap && ready_grow() != NETMON_SUCCESS) {
+        tw_add(&wheel, &e->timer, wheel.now + 1);   /* Out of memory; retry */
+        return;
+    }
+    ready[(ready_head + ready_len) % ready_cap] = e->ref.slot;
+    ready_len++;
+    pthread_cond_signal(&work_ready);
+}
+
+static void *scheduler_main(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&monitor_lock);
+    while (!stopping) {
+        uint64_t tick = now_tick();
+        uint32_t gen = device_db_generation();
+
+        /* A pass cut short by allocation failure is retried next tick */
+        if (gen != known_generation && reconcile_devices(tick) == NETMON_SUCCESS) {
+            known_generation = gen;
+        }
+        tw_advance(&wheel, tick, expire_cb, NULL);
+
+        /* Sleep one tick or until a stop request (condvar uses the realtime clock) */
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += MONITOR_TICK_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&stop_cond, &monitor_lock, &ts);
+    }
+    pthread_mutex_unlock(&monitor_lock);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* SNMP polling                                                       */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    uint64_t sum;
+    int count;
+} column_sum_t;
+
+static int sum_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    column_sum_t *cs = ctx;
+
+    switch (vb->type) {
+        case SNMP_TYPE_INTEGER:
+            if (vb->integer > 0) cs->sum += (uint64_t)vb->integer;
+            break;
+        case SNMP_TYPE_COUNTER32:
+        case SNMP_TYPE_GAUGE32:
+        case SNMP_TYPE_COUNTER64:
+            cs->sum += vb->counter;
+            break;
+        default:
+            return 0;
+    }
+    cs->count++;
+    return 0;
+}
+
+/* Sum a numeric table column; returns the number of rows seen */
+static int walk_sum(snmp_session_t *s, const char *column, uint64_t *sum)
+{
+    snmp_oid_t root;
+    column_sum_t cs = { 0, 0 };
+
+    snmp_oid_parse(column, &root);
+    snmp_bulkwalk(s, &root, sum_cb, &cs);
+    *sum = cs.sum;
+    return cs.count;
+}
+
+/* Finds the first hrStorageRam row */
+static int ram_index_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    snmp_oid_t ram;
+    uint32_t *index = ctx;
+
+    snmp_oid_parse(OID_HR_STORAGE_RAM, &ram);
+    if (vb->type == SNMP_TYPE_OID && snmp_oid_compare(&vb->oid_value, &ram) == 0) {
+        *index = vb->oid.ids[vb->oid.len - 1];
+        return 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    uint64_t values[2];
+    int count;
+} pair_t;
+
+static int pair_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    pair_t *p = ctx;
+
+    if (p->count < 2 && vb->type == SNMP_TYPE_INTEGER && vb->integer >= 0) {
+        p->values[p->count++] = (uint64_t)vb->integer;
+    }
+    return 0;
+}
+
+/* HOST-RESOURCES RAM usage in percent, or -1 if unavailable */
+static float host_memory_usage(snmp_session_t *s)
+{
+    snmp_oid_t root, oids[2];
+    uint32_t index = 0;
+    pair_t p = { { 0, 0 }, 0 };
+
+    snmp_oid_parse(OID_HR_STORAGE_TYPE, &root);
+    snmp_bulkwalk(s, &root, ram_index_cb, &index);
+    if (index == 0) {
+        return -1.0f;
+    }
+
+    snmp_oid_parse(OID_HR_STORAGE_SIZE, &oids[0]);
+    snmp_oid_parse(OID_HR_STORAGE_USED, &oids[1]);
+    oids[0].ids[oids[0].len++] = index;
+    oids[1].ids[oids[1].len++] = index;
+
+    if (snmp_request(s, SNMP_PDU_GET, oids, 2, 0, 0, pair_cb, &p) < 0 ||
+        p.count < 2 || p.values[0] == 0) {
+        return -1.0f;
+    }
+    return (float)(100.0 * (double)p.values[1] / (double)p.values[0]);
+}
+
+static void poll_counters(snmp_session_t *s, network_device_t *m)
+{
+    uint64_t v, used, free_bytes;
+
+    /* CPU: average over all processors */
+    int n = walk_sum(s, OID_CISCO_CPU_5MIN, &v);
+    if (n == 0) {
+        n = walk_sum(s, OID_HR_PROCESSOR_LOAD, &v);
+    }
+    if (n > 0) {
+        m->cpu_usage = (float)v / (float)n;
+    }
+
+    /* Memory: used / (used + free) over all pools */
+    if (walk_sum(s, OID_CISCO_MEM_USED, &used) > 0 &&
+        walk_sum(s, OID_CISCO_MEM_FREE, &free_bytes) > 0 && used + free_bytes > 0) {
+        m->memory_usage = (float)(100.0 * (double)used / (double)(used + free_bytes));
+    } else {
+        float mem = host_memory_usage(s);
+        if (mem >= 0.0f) m->memory_usage = mem;
+    }
+}
+
+/* sysUpTime.0 and ifTableLastChange.0, in request order */
+typedef struct {
+    uint32_t ticks[2];
+    int seen;
+} uptime_t;
+
+static int uptime_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    uptime_t *u = ctx;
+
+    if (u->seen < 2) {
+        u->ticks[u->seen++] = vb->type == SNMP_TYPE_TIMETICKS ? (uint32_t)vb->counter : 0;
+    }
+    return 0;
+}
+
+/* Interface counters: device totals into m; rates and interface rows with a ref */
+static void poll_interfaces(snmp_session_t *s, network_device_t *m, const device_ref_t *ref,
+                            const uptime_t *u)
+{
+    if_poll_result_t r;
+
+    if (if_poll(s, ref, u->ticks[0], u->ticks[1], &r) != NETMON_SUCCESS) {
+        return;
+    }
+    m->bytes_in = r.in_octets;
+    m->bytes_out = r.out_octets;
+    m->errors_in = (uint32_t)r.in_errors;
+    m->errors_out = (uint32_t)r.out_errors;
+    if (ref != NULL) {
+        m->in_bps = r.in_bps;
+        m->out_bps = r.out_bps;
+    }
+}
+
+/* One poll; rates are only tracked for devices with a database handle */
+static int poll_metrics(network_device_t *m, const device_ref_t *ref)
+{
+    snmp_session_t s;
+    snmp_oid_t uptime[2];
+    uptime_t u = { { 0, 0 }, 0 };
+    int snmp_ok = 0;
+
+    snmp_oid_parse(OID_SYS_UPTIME, &uptime[0]);
+    snmp_oid_parse(OID_IF_TABLE_LAST_CHANGE, &uptime[1]);
+
+    if (snmp_open(&s, m->ip_address, m->port, m->snmp_community) == NETMON_SUCCESS) {
+        pthread_mutex_lock(&monitor_lock);
+        s.timeout_ms = monitor_cfg.snmp_timeout_ms;
+        s.retries = monitor_cfg.snmp_retries;
+        pthread_mutex_unlock(&monitor_lock);
+
+        uint64_t start = now_ms();
+        int rc = snmp_request(&s, SNMP_PDU_GET, uptime, 2, 0, 0, uptime_cb, &u);
+        if (rc == NETMON_ERROR) {
+            /* SNMPv1-style agents reject the whole Get over an unknown ifTableLastChange */
+            u.seen = 0;
+            rc = snmp_request(&s, SNMP_PDU_GET, uptime, 1, 0, 0, uptime_cb, &u);
+        }
+        if (rc >= 0) {
+            uint64_t rtt = now_ms() - start;
+            m->response_time_ms = rtt > 0 ? (int)rtt : 1;
+            snmp_ok = 1;
+            poll_interfaces(&s, m, ref, &u);
+            poll_counters(&s, m);
+        }
+        snmp_close(&s);
+    }
+
+    if (snmp_ok) {
+        m->status = DEVICE_STATUS_UP;
+        m->last_seen = time(NULL);
+        return NETMON_SUCCESS;
+    }
+
+    /* Without counters there is no current rate to report */
+    m->in_bps = 0;
+    m->out_bps = 0;
+
+    /*
+     * No SNMP: tell a reachable-but-silent agent apart from a dead device,
+     * trying TCP ports when ICMP is filtered or unavailable
+     */
+    int rtt = -1;
+    if (ping_device(m->ip_address, &rtt) == NETMON_SUCCESS ||
+        port_probe_device(m->ip_address, &rtt) == NETMON_SUCCESS) {
+        m->status = DEVICE_STATUS_WARNING;
+        m->response_time_ms = rtt;
+        m->last_seen = time(NULL);
+        return NETMON_NO_RESPONSE;
+    }
+
+    m->status = DEVICE_STATUS_DOWN;
+    m->response_time_ms = -1;
+    return NETMON_TIMEOUT;
+}
+
+int monitor_poll_once(network_device_t *m)
+{
+    return poll_metrics(m, NULL);
+}
+
+/* Append a poll result to the metric history; counters only exist when SNMP answered */
+static void record_history(const network_device_t *dev, int rc)
+{
+    double values[TSDB_METRIC_COUNT];
+
+    if (!tsdb_is_open()) {
+        return;
+    }
+    int snmp_ok = rc == NETMON_SUCCESS;
+    values[TSDB_BYTES_IN] = snmp_ok ? (double)dev->bytes_in : NAN;
+    values[TSDB_BYTES_OUT] = snmp_ok ? (double)dev->bytes_out : NAN;
+    values[TSDB_CPU_USAGE] = snmp_ok ? (double)dev->cpu_usage : NAN;
+    values[TSDB_RESPONSE_TIME] = dev->response_time_ms >= 0 ? (double)dev->response_time_ms : NAN;
+    tsdb_append(dev->hostname, time(NULL), values);
+}
+
+/* Poll the device behind ref and store the result; returns the poll status */
+static int poll_ref(device_ref_t ref)
+{
+    network_device_t dev;
+
+    if (device_db_read(ref, &dev) != NETMON_SUCCESS) {
+        return NETMON_ERROR;
+    }
+    device_status_t before = dev.status;
+    int rc = poll_metrics(&dev, &ref);
+    device_db_update_metrics(ref, &dev);
+    record_history(&dev, rc);
+    correlate_status(&ref, before, dev.status);
+    return rc;
+}
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&monitor_lock);
+    for (;;) {
+        while (ready_len == 0 && !stopping) {
+            pthread_cond_wait(&work_ready, &monitor_lock);
+        }
+        if (stopping) {
+            break;
+        }
+
+        int slot = ready[ready_head];
+        ready_head = (ready_head + 1) % ready_cap;
+        ready_len--;
+        poll_entry_t *e = chunk_array_at(&entries, (uint32_t)slot);
+        device_ref_t ref = e->ref;
+        uint64_t due_us = e->timer.expires * MONITOR_TICK_MS * 1000ULL;
+        pthread_mutex_unlock(&monitor_lock);
+
+        uint64_t start_us = selfstat_now_us();
+        selfstat_record(SELFSTAT_POLL_LAG, start_us > due_us ? start_us - due_us : 0);
+        int rc = poll_ref(ref);
+        selfstat_record(SELFSTAT_POLL_DURATION, selfstat_now_us() - start_us);
+        selfstat_add(SELFSTAT_POLLS, 1);
+        if (rc != NETMON_SUCCESS) {
+            selfstat_add(SELFSTAT_POLL_FAILURES, 1);
+        }
+        threshold_evaluate_device(&ref);
+
+        network_device_t dev;
+        int still_present = rc != NETMON_ERROR && device_db_read(ref, &dev) == NETMON_SUCCESS;
+
+        pthread_mutex_lock(&monitor_lock);
+        if (e->ref.id != ref.id) {
+            continue;   /* Slot was re-scheduled for a new device meanwhile */
+        }
+        if (!still_present) {
+            e->scheduled = 0;
+            continue;
+        }
+
+        /* Next deadline; a device that fell behind skips missed rounds */
+        uint64_t interval = interval_ticks(&dev);
+        uint64_t tick = now_tick();
+        e->nominal += interval;
+        if (e->nominal <= tick) {
+            selfstat_add(SELFSTAT_POLL_SKIPPED, (tick - e->nominal) / interval + 1);
+            e->nominal = tick + interval - (tick - e->nominal) % interval;
+        }
+        arm_entry(e, interval);
+    }
+    pthread_mutex_unlock(&monitor_lock);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* netmon.h monitoring API                                            */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Start continuous polling of every device in the database
+ * Devices added or removed later are picked up automatically
+ */
+int start_monitoring(void)
+{
+    pthread_mutex_lock(&monitor_lock);
+    if (running) {
+        pthread_mutex_unlock(&monitor_lock);
+        return NETMON_SUCCESS;
+    }
+
+    tw_init(&wheel, now_tick());
+    chunk_array_free(&entries);
+    entry_limit = 0;
+    ready_head = 0;
+    ready_len = 0;
+    known_generation = device_db_generation();
+    if (reconcile_devices(now_tick()) != NETMON_SUCCESS) {
+        known_generation--;     /* Force a retry from the dispatcher */
+    }
+    stopping = 0;
+
+    /* History is best effort; polling runs without it if the directory is unusable */
+    if (monitor_cfg.history_dir != NULL) {
+        tsdb_open(monitor_cfg.history_dir);
+    }
+    correlate_start();
+
+    if (pthread_create(&scheduler_thread, NULL, scheduler_main, NULL) != 0) {
+        pthread_mutex_unlock(&monitor_lock);
+        return NETMON_ERROR;
+    }
+    for (worker_count = 0; worker_count < monitor_cfg.workers; worker_count++) {
+        if (pthread_create(&worker_threads[worker_count], NULL, worker_main, NULL) != 0) {
+            break;
+        }
+    }
+    running = 1;
+    pthread_mutex_unlock(&monitor_lock);
+
+    if (worker_count == 0) {
+        stop_monitoring();
+        return NETMON_ERROR;
+    }
+    return NETMON_SUCCESS;
+}
+
+/*
+ * Stop the poller; polls in progress finish first
+ */
+int stop_monitoring(void)
+{
+    pthread_mutex_lock(&monitor_lock);
+    if (!running) {
+        pthread_mutex_unlock(&monitor_lock);
+        return NETMON_SUCCESS;
+    }
+    stopping = 1;
+    pthread_cond_broadcast(&work_ready);
+    pthread_cond_broadcast(&stop_cond);
+    pthread_mutex_unlock(&monitor_lock);
+
+    pthread_join(scheduler_thread, NULL);
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(worker_threads[i], NULL);
+    }
+
+    tsdb_close();
+    correlate_stop();
+
+    pthread_mutex_lock(&monitor_lock);
+    worker_count = 0;
+    running = 0;
+    stopping = 0;
+    chunk_array_free(&entries);
+    entry_limit = 0;
+    free(ready);
+    ready = NULL;
+    ready_cap = 0;
+    ready_len = 0;
+    pthread_mutex_unlock(&monitor_lock);
+    return NETMON_SUCCESS;
+}
+
+/*
+ * Poll a single device immediately
+ * Returns NETMON_SUCCESS, NETMON_NO_RESPONSE (ICMP only), NETMON_TIMEOUT
+ * (down) or NETMON_ERROR (unknown hostname)
+ */
+int poll_device(const char *hostname)
+{
+    device_ref_t ref;
+
+    if (device_db_find(hostname, &ref) != NETMON_SUCCESS) {
+        return NETMON_ERROR;
+    }
+    return poll_ref(ref);
+}
+
+int monitor_get_interfaces(const char *hostname, if_entry_t *entries, int max_count)
+{
+    device_ref_t ref;
+
+    if (hostname == NULL || device_db_find(hostname, &ref) != NETMON_SUCCESS) {
+        return NETMON_ERROR;
+    }
+    return if_table_list(ref.slot, ref.id, entries, max_count);
+}
+
+/* Shared cursor for poll_all_devices() workers */
+typedef struct {
+    pthread_mutex_t lock;
+    device_ref_t *refs;
+    int count;
+    int next;
+    int answered;
+} poll_batch_t;
+
+static void *batch_worker(void *arg)
+{
+    poll_batch_t *b = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        int i = b->next < b->count ? b->next++ : -1;
+        pthread_mutex_unlock(&b->lock);
+        if (i < 0) break;
+
+        if (poll_ref(b->refs[i]) == NETMON_SUCCESS) {
+            pthread_mutex_lock(&b->lock);
+            b->answered++;
+            pthread_mutex_unlock(&b->lock);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Poll every device once, in parallel on the configured number of workers
+ * Returns the number of devices that answered SNMP
+ */
+int poll_all_devices(void)
+{
+    poll_batch_t *b = calloc(1, sizeof(*b));
+    pthread_t threads[MONITOR_MAX_WORKERS];
+    int started = 0;
+
+    if (b == NULL) {
+        return NETMON_ERROR;
+    }
+    b->count = device_db_list(&b->refs);
+    if (b->count < 0) {
+        free(b);
+        return NETMON_ERROR;
+    }
+    pthread_mutex_init(&b->lock, NULL);
+
+    pthread_mutex_lock(&monitor_lock);
+    int workers = monitor_cfg.workers;
+    pthread_mutex_unlock(&monitor_lock);
+    if (workers > b->count) workers = b->count;
+
+    for (; started < workers; started++) {
+        if (pthread_create(&threads[started], NULL, batch_worker, b) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        batch_worker(b);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    int answered = b->answered;
+    pthread_mutex_destroy(&b->lock);
+    free(b->refs);
+    free(b);
+    threshold_evaluate();
+    return answered;
+}
@@ -0,0 +1,464 @@
+/*
+ * Interface Poller
+ * Multi-column table walks over IF-MIB. Cells arrive row-major per
+ * response and column by column in ifIndex order; the first column
+ * creates rows and every other column advances its own cursor, so the
+ * whole table is assembled in one pass without lookups.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "if_poller.h"
+#include "if_table.h"
+#include "counter_rate.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* ifTable / ifXTable columns */
+#define OID_IF_DESCR "1.3.6.1.2.1.2.2.1.2"
+#define OID_IF_TYPE "1.3.6.1.2.1.2.2.1.3"
+#define OID_IF_SPEED "1.3.6.1.2.1.2.2.1.5"
+#define OID_IF_ADMIN_STATUS "1.3.6.1.2.1.2.2.1.7"
+#define OID_IF_OPER_STATUS "1.3.6.1.2.1.2.2.1.8"
+#define OID_IF_IN_OCTETS "1.3.6.1.2.1.2.2.1.10"
+#define OID_IF_IN_ERRORS "1.3.6.1.2.1.2.2.1.14"
+#define OID_IF_OUT_OCTETS "1.3.6.1.2.1.2.2.1.16"
+#define OID_IF_OUT_ERRORS "1.3.6.1.2.1.2.2.1.20"
+#define OID_IF_NAME "1.3.6.1.2.1.31.1.1.1.1"
+#define OID_IF_HC_IN_OCTETS "1.3.6.1.2.1.31.1.1.1.6"
+#define OID_IF_HC_OUT_OCTETS "1.3.6.1.2.1.31.1.1.1.10"
+#define OID_IF_HIGH_SPEED "1.3.6.1.2.1.31.1.1.1.15"
+#define OID_IF_ALIAS "1.3.6.1.2.1.31.1.1.1.18"
+
+enum { DISC_DESCR, DISC_TYPE, DISC_SPEED, DISC_ADMIN, DISC_NAME, DISC_HIGH_SPEED,
+       DISC_ALIAS, DISC_HC_IN, DISC_COLUMNS };
+
+enum { CTR_IN, CTR_OUT, CTR_IN_ERRORS, CTR_OUT_ERRORS, CTR_OPER, CTR_COLUMNS };
+
+static const char *const discovery_columns[DISC_COLUMNS] = {
+    OID_IF_DESCR, OID_IF_TYPE, OID_IF_SPEED, OID_IF_ADMIN_STATUS,
+    OID_IF_NAME, OID_IF_HIGH_SPEED, OID_IF_ALIAS, OID_IF_HC_IN_OCTETS
+};
+
+static const char *const hc_columns[CTR_COLUMNS] = {
+    OID_IF_HC_IN_OCTETS, OID_IF_HC_OUT_OCTETS, OID_IF_IN_ERRORS, OID_IF_OUT_ERRORS,
+    OID_IF_OPER_STATUS
+};
+
+static const char *const low_columns[CTR_COLUMNS] = {
+    OID_IF_IN_OCTETS, OID_IF_OUT_OCTETS, OID_IF_IN_ERRORS, OID_IF_OUT_ERRORS,
+    OID_IF_OPER_STATUS
+};
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+static uint32_t cell_index(const snmp_varbind_t *vb)
+{
+    return vb->oid.ids[vb->oid.len - 1];
+}
+
+static int cell_number(const snmp_varbind_t *vb, uint64_t *value)
+{
+    switch (vb->type) {
+        case SNMP_TYPE_INTEGER:
+            *value = vb->integer > 0 ? (uint64_t)vb->integer : 0;
+            return 1;
+        case SNMP_TYPE_COUNTER32:
+        case SNMP_TYPE_GAUGE32:
+        case SNMP_TYPE_TIMETICKS:
+        case SNMP_TYPE_COUNTER64:
+            *value = vb->counter;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void cell_string(const snmp_varbind_t *vb, char *buf, size_t size)
+{
+    size_t n = 0;
+
+    if (vb->type == SNMP_TYPE_OCTET_STRING) {
+        n = vb->data_len < size - 1 ? vb->data_len : size - 1;
+        memcpy(buf, vb->data, n);
+    }
+    buf[n] = '\0';
+}
+
+static void make_columns(const char *const *names, int count, snmp_oid_t *oids)
+{
+    for (int i = 0; i < count; i++) {
+        snmp_oid_parse(names[i], &oids[i]);
+    }
+}
+
+/* Array with room for want entries (doubling), or NULL with rows untouched */
+static void *grow(void *rows, int *cap, int want, size_t size)
+{
+    if (want <= *cap) {
+        return rows;
+    }
+    int n = *cap ? *cap : 64;
+    while (n < want) n *= 2;
+    void *p = realloc(rows, (size_t)n * size);
+    if (p != NULL) {
+        *cap = n;
+    }
+    return p;
+}
+
+/* ------------------------------------------------------------------ */
+/* Discovery                                                          */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    if_info_t *rows;
+    int count;
+    int cap;
+    int cursor[DISC_COLUMNS];
+    int failed;
+} discovery_t;
+
+static int discovery_cb(int column, const snmp_varbind_t *vb, void *ctx)
+{
+    discovery_t *d = ctx;
+    uint32_t ifindex = cell_index(vb);
+    uint64_t v = 0;
+
+    if (column == DISC_DESCR) {
+        if_info_t *rows = grow(d->rows, &d->cap, d->count + 1, sizeof(*d->rows));
+        if (rows == NULL) {
+            d->failed = 1;
+            return 1;
+        }
+        d->rows = rows;
+        if_info_t *r = &d->rows[d->count++];
+        memset(r, 0, sizeof(*r));
+        r->ifindex = ifindex;
+        cell_string(vb, r->descr, sizeof(r->descr));
+        return 0;
+    }
+
+    int *cur = &d->cursor[column];
+    while (*cur < d->count && d->rows[*cur].ifindex < ifindex) {
+        (*cur)++;
+    }
+    if (*cur >= d->count || d->rows[*cur].ifindex != ifindex) {
+        return 0;
+    }
+    if_info_t *r = &d->rows[*cur];
+
+    switch (column) {
+        case DISC_TYPE:
+            if (cell_number(vb, &v)) r->type = (uint32_t)v;
+            break;
+        case DISC_SPEED:
+            /* ifHighSpeed, when it arrives, overrides this */
+            if (cell_number(vb, &v) && r->speed_bps == 0) r->speed_bps = v;
+            break;
+        case DISC_ADMIN:
+            if (cell_number(vb, &v)) r->admin_status = (uint8_t)v;
+            break;
+        case DISC_NAME:
+            cell_string(vb, r->name, sizeof(r->name));
+            break;
+        case DISC_HIGH_SPEED:
+            if (cell_number(vb, &v) && v > 0) r->speed_bps = v * 1000000ULL;
+            break;
+        case DISC_ALIAS:
+            cell_string(vb, r->alias, sizeof(r->alias));
+            break;
+        case DISC_HC_IN:
+            r->has_hc = vb->type == SNMP_TYPE_COUNTER64;
+            break;
+    }
+    return 0;
+}
+
+/* One walk over the identity columns of ifTable and ifXTable */
+static int discover_interfaces(snmp_session_t *s, const device_ref_t *ref, uint32_t last_change)
+{
+    snmp_oid_t columns[DISC_COLUMNS];
+    discovery_t d;
+
+    memset(&d, 0, sizeof(d));
+    make_columns(discovery_columns, DISC_COLUMNS, columns);
+    int rc = snmp_table_walk(s, columns, DISC_COLUMNS, discovery_cb, &d);
+
+    if (rc < 0 || d.failed) {
+        free(d.rows);
+        return NETMON_ERROR;
+    }
+    rc = if_table_set_interfaces(ref->slot, ref->id, d.rows, d.count, last_change, time(NULL));
+    free(d.rows);
+    return rc;
+}
+
+static int needs_discovery(const device_ref_t *ref, uint32_t last_change)
+{
+    uint32_t known_change;
+    time_t discovered_at;
+
+    if (if_table_discovery_state(ref->slot, ref->id, &known_change, &discovered_at) < 0) {
+        return 1;
+    }
+    if (last_change != 0) {
+        return last_change != known_change;
+    }
+    return time(NULL) - discovered_at >= IF_TABLE_REDISCOVER_S;
+}
+
+/* ------------------------------------------------------------------ */
+/* Counters                                                           */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    if_counters_t *rows;
+    uint8_t *has_out;
+    int count;
+    int cap;
+    int flags_cap;
+    int cursor[CTR_COLUMNS];
+    int failed;
+} counter_walk_t;
+
+static int counter_cb(int column, const snmp_varbind_t *vb, void *ctx)
+{
+    counter_walk_t *w = ctx;
+    uint32_t ifindex = cell_index(vb);
+    uint64_t v;
+
+    if (!cell_number(vb, &v)) {
+        return 0;
+    }
+
+    if (column == CTR_IN) {
+        if_counters_t *rows = grow(w->rows, &w->cap, w->count + 1, sizeof(*w->rows));
+        if (rows != NULL) {
+            w->rows = rows;
+        }
+        uint8_t *flags = rows != NULL ? grow(w->has_out, &w->flags_cap, w->count + 1, 1) : NULL;
+        if (flags == NULL) {
+            w->failed = 1;
+            return 1;
+        }
+        w->has_out = flags;
+        if_counters_t *r = &w->rows[w->count];
+        memset(r, 0, sizeof(*r));
+        r->ifindex = ifindex;
+        r->width = vb->type == SNMP_TYPE_COUNTER64 ? 64 : 32;
+        r->in_octets = v;
+        w->has_out[w->count++] = 0;
+        return 0;
+    }
+
+    int *cur = &w->cursor[column];
+    while (*cur < w->count && w->rows[*cur].ifindex < ifindex) {
+        (*cur)++;
+    }
+    if (*cur >= w->count || w->rows[*cur].ifindex != ifindex) {
+        return 0;
+    }
+    if_counters_t *r = &w->rows[*cur];
+
+    switch (column) {
+        case CTR_OUT:
+            r->out_octets = v;
+            w->has_out[*cur] = 1;
+            break;
+        case CTR_IN_ERRORS:
+            r->in_errors = (uint32_t)v;
+            break;
+        case CTR_OUT_ERRORS:
+            r->out_errors = (uint32_t)v;
+            break;
+        case CTR_OPER:
+            r->oper_status = (uint8_t)v;
+            break;
+    }
+    return 0;
+}
+
+/*
+ * Walk the counter columns into w
+ * Returns the row count, or NETMON_ERROR if the walk was cut short:
+ * a partial table would read as interfaces that vanished
+ */
+static int walk_counters(snmp_session_t *s, const char *const *names, counter_walk_t *w)
+{
+    snmp_oid_t columns[CTR_COLUMNS];
+
+    w->count = 0;
+    memset(w->cursor, 0, sizeof(w->cursor));
+    make_columns(names, CTR_COLUMNS, columns);
+    if (snmp_table_walk(s, columns, CTR_COLUMNS, counter_cb, w) < 0 || w->failed) {
+        return NETMON_ERROR;
+    }
+    return w->count;
+}
+
+/*
+ * Add the rows of low whose ifindex hi lacks, keeping ifindex order;
+ * rows present in both keep hi's 64-bit counters
+ * Returns 0, or -1 if memory ran out (hi is then left as it was)
+ */
+static int merge_missing(counter_walk_t *hi, const counter_walk_t *low)
+{
+    int total = hi->count + low->count;
+    if (low->count == 0) {
+        return 0;
+    }
+
+    if_counters_t *rows = malloc((size_t)total * sizeof(*rows));
+    uint8_t *has_out = malloc((size_t)total);
+    if (rows == NULL || has_out == NULL) {
+        free(rows);
+        free(has_out);
+        return -1;
+    }
+
+    int i = 0, j = 0, n = 0;
+    while (i < hi->count || j < low->count) {
+        if (j >= low->count || (i < hi->count && hi->rows[i].ifindex <= low->rows[j].ifindex)) {
+            if (j < low->count && hi->rows[i].ifindex == low->rows[j].ifindex) {
+                j++;
+            }
+            rows[n] = hi->rows[i];
+            has_out[n++] = hi->has_out[i++];
+        } else {
+            rows[n] = low->rows[j];
+            has_out[n++] = low->has_out[j++];
+        }
+    }
+
+    free(hi->rows);
+    free(hi->has_out);
+    hi->rows = rows;
+    hi->has_out = has_out;
+    hi->count = n;
+    hi->cap = hi->flags_cap = total;
+    return 0;
+}
+
+/* Rate engine input: rows that have both octet counters */
+static int rate_samples(const counter_walk_t *w, counter_sample_t *samples)
+{
+    int n = 0;
+
+    for (int i = 0; i < w->count; i++) {
+        if (w->has_out[i]) {
+            samples[n].ifindex = w->rows[i].ifindex;
+            samples[n].width = w->rows[i].width;
+            samples[n].in_octets = w->rows[i].in_octets;
+            samples[n].out_octets = w->rows[i].out_octets;
+            n++;
+        }
+    }
+    return n;
+}
+
+/* Copy per-interface rates back into the rows; both lists are sorted */
+static void attach_rates(const device_ref_t *ref, counter_walk_t *w, interface_rate_t *rates, int max)
+{
+    int n = counter_rate_interfaces(ref->slot, ref->id, rates, max);
+    int j = 0;
+
+    for (int i = 0; i < w->count; i++) {
+        while (j < n && rates[j].ifindex < w->rows[i].ifindex) {
+            j++;
+        }
+        if (j < n && rates[j].ifindex == w->rows[i].ifindex && rates[j].valid) {
+            w->rows[i].in_bps = rates[j].in_bps;
+            w->rows[i].out_bps = rates[j].out_bps;
+        }
+    }
+}
+
+/* Feed the rate engine and store the rows; w holds a successful walk */
+static void publish_rows(snmp_session_t *s, const device_ref_t *ref, uint32_t uptime,
+                         uint32_t last_change, counter_walk_t *w, if_poll_result_t *result)
+{
+    /* One scratch allocation per poll for the rate engine's view */
+    size_t scratch = (size_t)w->count * (sizeof(counter_sample_t) + sizeof(interface_rate_t));
+    uint8_t *buf = malloc(scratch);
+    if (buf == NULL) {
+        return;
+    }
+    counter_sample_t *samples = (counter_sample_t *)buf;
+    interface_rate_t *rates = (interface_rate_t *)(buf + (size_t)w->count * sizeof(counter_sample_t));
+
+    device_rate_t rate;
+    int n = rate_samples(w, samples);
+    if (counter_rate_update(ref->slot, ref->id, uptime, now_ms(), samples, n, &rate) == NETMON_SUCCESS) {
+        result->in_bps = rate.in_bps;
+        result->out_bps = rate.out_bps;
+        attach_rates(ref, w, rates, w->count);
+    }
+    free(buf);
+
+    time_t now = time(NULL);
+    for (int i = 0; i < w->count; i++) {
+        w->rows[i].updated = now;
+    }
+    /* Interfaces the table does not know yet: the list changed under us */
+    if (if_table_update_counters(ref->slot, ref->id, w->rows, w->count) > 0 &&
+        discover_interfaces(s, ref, last_change) == NETMON_SUCCESS) {
+        if_table_update_counters(ref->slot, ref->id, w->rows, w->count);
+    }
+}
+
+int if_poll(snmp_session_t *s, const device_ref_t *ref, uint32_t uptime,
+            uint32_t last_change, if_poll_result_t *result)
+{
+    counter_walk_t w;
+
+    memset(result, 0, sizeof(*result));
+    memset(&w, 0, sizeof(w));
+
+    if (ref != NULL && needs_discovery(ref, last_change)) {
+        discover_interfaces(s, ref, last_change);
+    }
+
+    /*
+     * 64-bit counters where the agent has them; 32-bit ones wrap within
+     * a minute at 1 Gb/s. Agents may keep ifHCInOctets for only some
+     * interfaces, so the 32-bit columns fill in per row for every
+     * ifindex the HC walk did not return.
+     */
+    int known = ref != NULL ? if_table_discovery_state(ref->slot, ref->id, NULL, NULL) : -1;
+    int use_hc = known < 0 || if_table_has_hc(ref->slot, ref->id);
+    int n = walk_counters(s, use_hc ? hc_columns : low_columns, &w);
+    if (use_hc && n >= 0 && (n == 0 || n < known)) {
+        counter_walk_t low;
+        memset(&low, 0, sizeof(low));
+        if (walk_counters(s, low_columns, &low) > 0 && merge_missing(&w, &low) == 0) {
+            n = w.count;
+        }
+        free(low.rows);
+        free(low.has_out);
+    }
+
+    if (n > 0) {
+        for (int i = 0; i < w.count; i++) {
+            result->in_octets += w.rows[i].in_octets;
+            result->out_octets += w.rows[i].out_octets;
+            result->in_errors += w.rows[i].in_errors;
+            result->out_errors += w.rows[i].out_errors;
+        }
+        result->interfaces = w.count;
+        if (ref != NULL) {
+            publish_rows(s, ref, uptime, last_change, &w, result);
+        }
+    }
+
+    free(w.rows);
+    free(w.has_out);
+    return n > 0 ? NETMON_SUCCESS : NETMON_ERROR;
+}
@@ -0,0 +1,46 @@
+/*
+ * Network Statistics
+ * Totals and averages over all devices, computed from the columnar
+ * metrics store in a single pass.
+ */
+
+#include "netmon.h"
+#include "metrics_store.h"
+#include "alert.h"
+#include <string.h>
+
+/*
+ * Fill stats with the current network-wide figures
+ * Devices answering SNMP or ping count as active. Byte totals cover
+ * traffic since the last reset_statistics().
+ */
+int get_statistics(network_stats_t *stats)
+{
+    metrics_totals_t t;
+
+    if (stats == NULL) {
+        return NETMON_ERROR;
+    }
+
+    metrics_store_aggregate(&t);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->total_devices = t.devices;
+    stats->active_devices = t.up + t.warning;
+    stats->inactive_devices = t.devices - stats->active_devices;
+    stats->total_bytes_in = t.bytes_in;
+    stats->total_bytes_out = t.bytes_out;
+    stats->total_in_bps = t.in_bps;
+    stats->total_out_bps = t.out_bps;
+    stats->total_alerts = alert_count();
+    if (t.response_time_count > 0) {
+        stats->avg_response_time = (float)((double)t.response_time_sum / t.response_time_count);
+    }
+    return NETMON_SUCCESS;
+}
+
+int reset_statistics(void)
+{
+    metrics_store_rebase();
+    return NETMON_SUCCESS;
+}
@@ -0,0 +1,757 @@
+/*
+ * Threshold Rules
+ * Compiler from rule lines to 16-byte ops lowered into range-check
+ * lanes, and an evaluator that runs each freshly polled device over the
+ * lanes of every metric it reported, in fixed-size branch-free blocks.
+ * Per-(device, rule) streak and firing state lives in one byte row per
+ * device slot, in a chunk array owned by the rule set and grown as
+ * slots appear.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "threshold.h"
+#include "metrics_store.h"
+#include "device_db.h"
+#include "correlator.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <pthread.h>
+
+typedef enum {
+    METRIC_CPU_USAGE = 0,
+    METRIC_MEMORY_USAGE,
+    METRIC_ERRORS_IN,
+    METRIC_ERRORS_OUT,
+    METRIC_RESPONSE_TIME,
+    METRIC_IN_BPS,
+    METRIC_OUT_BPS,
+    METRIC_COUNT
+} metric_t;
+
+static const char *const metric_names[METRIC_COUNT] = {
+    "cpu_usage", "memory_usage", "errors_in", "errors_out",
+    "response_time_ms", "in_bps", "out_bps"
+};
+
+typedef enum { OP_GT = 0, OP_GE, OP_LT, OP_LE, OP_EQ, OP_NE, OP_COUNT } op_t;
+
+static const char *const op_names[OP_COUNT] = { ">", ">=", "<", "<=", "==", "!=" };
+
+/* One compiled rule */
+typedef struct {
+    float threshold;
+    uint8_t metric;
+    uint8_t op;
+    uint8_t samples;
+    uint8_t severity;
+    int16_t host;                 /* Index into rule_set_t.hosts, -1 = every device, -2 = padding */
+    uint16_t fire_template;
+    uint16_t clear_template;
+} rule_op_t;
+
+_Static_assert(sizeof(rule_op_t) == 16, "rule ops should stay 16 bytes");
+
+/*
+ * Rules are lowered into lanes grouped by metric, each group padded to
+ * a whole number of LANE_BLOCKs with lanes that never match, so every
+ * comparison is lo <= v <= hi (inverted for !=) over fixed-size blocks
+ */
+#define LANE_BLOCK 16
+
+typedef struct {
+    int count;
+    rule_op_t *ops;               /* Parsed rules, then one per lane */
+    int host_count;
+    char (*hosts)[MAX_HOSTNAME_LEN];
+    int lanes;
+    int group[METRIC_COUNT + 1];  /* Lanes of metric m: group[m] .. group[m + 1] */
+    float *lo;
+    float *hi;
+    uint8_t *invert;
+    uint8_t *samples;
+    int32_t *scope;               /* Slot of the rule's host, -1 = every device */
+    int scope_valid;              /* scope matches device table scope_generation */
+    uint32_t scope_generation;
+    chunk_array_t rows;           /* Per slot: lanes streak bytes, then lanes firing bytes */
+} rule_set_t;
+
+/* What the evaluator remembers per slot between calls */
+typedef struct {
+    uint32_t id;
+    uint32_t version;
+    int have_errors;
+    uint32_t errors_in;
+    uint32_t errors_out;
+    time_t errors_at;
+} slot_state_t;
+
+static pthread_mutex_t rules_lock = PTHREAD_MUTEX_INITIALIZER;
+static rule_set_t rules;
+static chunk_array_t slots = CHUNK_ARRAY_INIT(slot_state_t);
+static int slot_limit = 0;            /* One past the highest slot with state */
+
+/* Streak bytes of slot in set, then its firing bytes at + lanes; NULL if never grown */
+static uint8_t *slot_row(rule_set_t *set, int slot, int create)
+{
+    if (create) {
+        return chunk_array_reserve(&set->rows, (uint32_t)slot);
+    }
+    return chunk_array_get(&set->rows, (uint32_t)slot);
+}
+
+/* Evaluator state of slot, grown into if needed; caller holds rules_lock */
+static slot_state_t *slot_state(int slot)
+{
+    slot_state_t *st = chunk_array_reserve(&slots, (uint32_t)slot);
+
+    if (st != NULL && slot >= slot_limit) {
+        slot_limit = slot + 1;
+    }
+    return st;
+}
+
+/* ------------------------------------------------------------------ */
+/* Compiler                                                           */
+/* ------------------------------------------------------------------ */
+
+static int lookup(const char *word, const char *const *names, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(word, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static int parse_severity(const char *word)
+{
+    static const char *const names[] = { "info", "warning", "error", "critical" };
+    return lookup(word, names, 4);
+}
+
+/* Number with an optional k/M/G multiplier */
+static int parse_value(const char *word, float *value)
+{
+    char *end;
+    double v = strtod(word, &end);
+
+    if (end == word) return 0;
+    switch (*end) {
+        case 'k': case 'K': v *= 1e3; end++; break;
+        case 'M': v *= 1e6; end++; break;
+        case 'G': v *= 1e9; end++; break;
+        default: break;
+    }
+    if (*end != '\0' || !isfinite(v)) return 0;
+    *value = (float)v;
+    return 1;
+}
+
+/* Index of host in the set's host table, added if new */
+static int intern_host(rule_set_t *set, const char *host)
+{
+    for (int i = 0; i < set->host_count; i++) {
+        if (strcmp(set->hosts[i], host) == 0) return i;
+    }
+    char (*hosts)[MAX_HOSTNAME_LEN] = realloc(set->hosts, (size_t)(set->host_count + 1) * sizeof(*hosts));
+    if (hosts == NULL) return -1;
+    set->hosts = hosts;
+    snprintf(set->hosts[set->host_count], MAX_HOSTNAME_LEN, "%s", host);
+    return set->host_count++;
+}
+
+#define RULE_TEXT_LEN (MAX_HOSTNAME_LEN + 96)
+
+/* The rule in canonical form, as used in its alert texts */
+static void rule_text(const rule_set_t *set, const rule_op_t *op, char *text, size_t size)
+{
+    int len = snprintf(text, size, "%s %s %g", metric_names[op->metric], op_names[op->op],
+                       (double)op->threshold);
+    if (op->samples > 1) {
+        len += snprintf(text + len, size - (size_t)len, " for %d samples", op->samples);
+    }
+    if (op->host >= 0) {
+        snprintf(text + len, size - (size_t)len, " on %s", set->hosts[op->host]);
+    }
+}
+
+/*
+ * Compile one rule line into op; comments and blank lines give 0
+ * Returns 1 on success, 0 for nothing to compile, -1 with err filled
+ */
+static int compile_rule(rule_set_t *set, char *line, rule_op_t *op, char *err, size_t err_size)
+{
+    char *words[16];
+    int n = 0;
+    char *save = NULL;
+
+    char *hash = strchr(line, '#');
+    if (hash != NULL) *hash = '\0';
+    for (char *w = strtok_r(line, " \t\r\n", &save); w != NULL && n < 16;
+         w = strtok_r(NULL, " \t\r\n", &save)) {
+        words[n++] = w;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    if (n < 3) {
+        snprintf(err, err_size, "expected '<metric> <op> <value>'");
+        return -1;
+    }
+
+    memset(op, 0, sizeof(*op));
+    op->samples = 1;
+    op->severity = ALERT_WARNING;
+    op->host = -1;
+
+    int metric = lookup(words[0], metric_names, METRIC_COUNT);
+    int cmp = lookup(words[1], op_names, OP_COUNT);
+    if (metric < 0) {
+        snprintf(err, err_size, "unknown metric '%s'", words[0]);
+        return -1;
+    }
+    if (cmp < 0) {
+        snprintf(err, err_size, "unknown operator '%s'", words[1]);
+        return -1;
+    }
+    if (!parse_value(words[2], &op->threshold)) {
+        snprintf(err, err_size, "bad value '%s'", words[2]);
+        return -1;
+    }
+    op->metric = (uint8_t)metric;
+    op->op = (uint8_t)cmp;
+
+    for (int i = 3; i < n; i++) {
+        if (strcmp(words[i], "for") == 0 && i + 1 < n) {
+            long samples = strtol(words[++i], NULL, 10);
+            if (samples < 1 || samples > THRESHOLD_MAX_SAMPLES) {
+                snprintf(err, err_size, "sample count must be 1-%d", THRESHOLD_MAX_SAMPLES);
+                return -1;
+            }
+            op->samples = (uint8_t)samples;
+            if (i + 1 < n && (strcmp(words[i + 1], "samples") == 0 || strcmp(words[i + 1], "sample") == 0)) {
+                i++;
+            }
+        } else if (strcmp(words[i], "severity") == 0 && i + 1 < n) {
+            int severity = parse_severity(words[++i]);
+            if (severity < 0) {
+                snprintf(err, err_size, "unknown severity '%s'", words[i]);
+                return -1;
+            }
+            op->severity = (uint8_t)severity;
+        } else if (strcmp(words[i], "on") == 0 && i + 1 < n) {
+            int host = intern_host(set, words[++i]);
+            if (host < 0) {
+                snprintf(err, err_size, "out of memory");
+                return -1;
+            }
+            op->host = (int16_t)host;
+        } else {
+            snprintf(err, err_size, "unexpected '%s'", words[i]);
+            return -1;
+        }
+    }
+
+    /* Alert texts are the rule in canonical form */
+    char text[RULE_TEXT_LEN];
+    char msg[sizeof(text) + 32];
+    rule_text(set, op, text, sizeof(text));
+    snprintf(msg, sizeof(msg), "%s (now {})", text);
+    op->fire_template = alert_intern(msg);
+    snprintf(msg, sizeof(msg), "Cleared: %s (now {})", text);
+    op->clear_template = alert_intern(msg);
+    return 1;
+}
+
+static void free_set(rule_set_t *set)
+{
+    free(set->ops);
+    free(set->hosts);
+    free(set->lo);
+    free(set->hi);
+    free(set->invert);
+    free(set->samples);
+    free(set->scope);
+    chunk_array_free(&set->rows);
+    memset(set, 0, sizeof(*set));
+}
+
+/* Adjacent float towards +inf (up) or -inf; the build does not link libm */
+static float float_step(float x, int up)
+{
+    uint32_t bits;
+
+    if (isinf(x)) return x;
+    if (x == 0.0f) return up ? FLT_TRUE_MIN : -FLT_TRUE_MIN;
+    memcpy(&bits, &x, sizeof(bits));
+    bits = (x > 0.0f) == (up != 0) ? bits + 1 : bits - 1;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/* Matching range of an op as lo <= v <= hi, inverted for != */
+static void lane_range(const rule_op_t *op, float *lo, float *hi, uint8_t *invert)
+{
+    *lo = -INFINITY;
+    *hi = INFINITY;
+    *invert = 0;
+    switch ((op_t)op->op) {
+        case OP_GT: *lo = float_step(op->threshold, 1); break;
+        case OP_GE: *lo = op->threshold; break;
+        case OP_LT: *hi = float_step(op->threshold, 0); break;
+        case OP_LE: *hi = op->threshold; break;
+        case OP_NE: *invert = 1; /* fall through */
+        case OP_EQ: *lo = op->threshold; *hi = op->threshold; break;
+        default: break;
+    }
+}
+
+/* Sort the parsed ops by metric into padded lane groups */
+static int lower(rule_set_t *set)
+{
+    int per_metric[METRIC_COUNT] = { 0 };
+
+    for (int r = 0; r < set->count; r++) {
+        per_metric[set->ops[r].metric]++;
+    }
+    set->lanes = 0;
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        set->group[m] = set->lanes;
+        set->lanes += (per_metric[m] + LANE_BLOCK - 1) / LANE_BLOCK * LANE_BLOCK;
+    }
+    set->group[METRIC_COUNT] = set->lanes;
+
+    size_t lanes = (size_t)(set->lanes ? set->lanes : 1);
+    rule_op_t *ops = malloc(lanes * sizeof(*ops));
+    set->lo = malloc(lanes * sizeof(float));
+    set->hi = malloc(lanes * sizeof(float));
+    set->invert = malloc(lanes);
+    set->samples = malloc(lanes);
+    set->scope = malloc(lanes * sizeof(int32_t));
+    set->rows.elem_size = 2 * lanes;
+    if (ops == NULL || set->lo == NULL || set->hi == NULL || set->invert == NULL ||
+        set->samples == NULL || set->scope == NULL) {
+        free(ops);
+        return NETMON_ERROR;
+    }
+
+    int next[METRIC_COUNT];
+    memcpy(next, set->group, sizeof(next));
+    for (int r = 0; r < set->count; r++) {
+        ops[next[set->ops[r].metric]++] = set->ops[r];
+    }
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        for (int lane = next[m]; lane < set->group[m + 1]; lane++) {
+            memset(&ops[lane], 0, sizeof(ops[lane]));
+            ops[lane].metric = (uint8_t)m;
+            ops[lane].host = -2;
+        }
+    }
+    for (int lane = 0; lane < set->lanes; lane++) {
+        if (ops[lane].host == -2) {
+            set->lo[lane] = INFINITY;
+            set->hi[lane] = -INFINITY;
+            set->invert[lane] = 0;
+        } else {
+            lane_range(&ops[lane], &set->lo[lane], &set->hi[lane], &set->invert[lane]);
+        }
+        set->samples[lane] = ops[lane].samples;
+    }
+    free(set->ops);
+    set->ops = ops;
+    return NETMON_SUCCESS;
+}
+
+/* Clear a firing rule that is going away, for the device in slot */
+static void clear_removed(const rule_set_t *set, const rule_op_t *op, int slot)
+{
+    char text[RULE_TEXT_LEN];
+    char msg[sizeof(text) + 32];
+    alert_event_t ev;
+
+    rule_text(set, op, text, sizeof(text));
+    snprintf(msg, sizeof(msg), "Cleared: %s (rule removed)", text);
+    memset(&ev, 0, sizeof(ev));
+    ev.device_id = ((slot_state_t *)chunk_array_at(&slots, (uint32_t)slot))->id;
+    ev.device_slot = slot;
+    ev.severity = ALERT_INFO;
+    ev.template_id = alert_intern(msg);
+    correlate_edge(&ev);
+}
+
+/*
+ * Hand per-device state from the active set old to its replacement:
+ * a rule of next with the same text and severity as one of old keeps
+ * its streaks and firing bits; old rules left unmatched clear wherever
+ * they were firing, so consumers never keep their alerts open. Caller
+ * holds rules_lock.
+ */
+static void carry_over(rule_set_t *old, rule_set_t *next)
+{
+    size_t old_lanes = (size_t)old->lanes, next_lanes = (size_t)next->lanes;
+    uint8_t *matched;
+
+    if (old->lanes == 0 || (matched = calloc((size_t)old->lanes, 1)) == NULL) {
+        return;
+    }
+    for (int m = 0; m < METRIC_COUNT && next->lanes > 0; m++) {
+        for (int nl = next->group[m]; nl < next->group[m + 1]; nl++) {
+            const rule_op_t *op = &next->ops[nl];
+            if (op->host == -2) {
+                continue;
+            }
+            for (int ol = old->group[m]; ol < old->group[m + 1]; ol++) {
+                const rule_op_t *prev = &old->ops[ol];
+                if (matched[ol] || prev->host == -2 || prev->fire_template != op->fire_template ||
+                    prev->severity != op->severity) {
+                    continue;
+                }
+                matched[ol] = 1;
+                for (int slot = 0; slot < slot_limit; slot++) {
+                    const uint8_t *from = slot_row(old, slot, 0);
+                    uint8_t *to = from != NULL ? slot_row(next, slot, 1) : NULL;
+                    if (to != NULL) {
+                        to[nl] = from[ol];
+                        to[next_lanes + (size_t)nl] = from[old_lanes + (size_t)ol];
+                    }
+                }
+                break;
+            }
+        }
+    }
+    for (int ol = 0; ol < old->lanes; ol++) {
+        if (matched[ol] || old->ops[ol].host == -2) {
+            continue;
+        }
+        for (int slot = 0; slot < slot_limit; slot++) {
+            const uint8_t *row = slot_row(old, slot, 0);
+            const slot_state_t *st = chunk_array_get(&slots, (uint32_t)slot);
+            if (row != NULL && row[old_lanes + (size_t)ol] && st != NULL && st->id != 0) {
+                clear_removed(old, &old->ops[ol], slot);
+            }
+        }
+    }
+    free(matched);
+}
+
+/* Compile every line of text into a new set and swap it in */
+static int compile_text(const char *text, const char *origin)
+{
+    rule_set_t set;
+    char err[128];
+    int line_no = 0;
+
+    memset(&set, 0, sizeof(set));
+    set.ops = malloc(THRESHOLD_MAX_RULES * sizeof(*set.ops));
+    char *copy = strdup(text);
+    if (set.ops == NULL || copy == NULL) {
+        free(copy);
+        free_set(&set);
+        return NETMON_ERROR;
+    }
+
+    char *save = NULL;
+    for (char *line = strtok_r(copy, "\n", &save); line != NULL; line = strtok_r(NULL, "\n", &save)) {
+        line_no++;
+        if (set.count == THRESHOLD_MAX_RULES) {
+            fprintf(stderr, "%s: more than %d rules, rest ignored\n", origin, THRESHOLD_MAX_RULES);
+            break;
+        }
+        int rc = compile_rule(&set, line, &set.ops[set.count], err, sizeof(err));
+        if (rc > 0) {
+            set.count++;
+        } else if (rc < 0) {
+            fprintf(stderr, "%s:%d: %s, rule skipped\n", origin, line_no, err);
+        }
+    }
+    free(copy);
+
+    if (lower(&set) != NETMON_SUCCESS) {
+        free_set(&set);
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&rules_lock);
+    carry_over(&rules, &set);
+    free_set(&rules);
+    rules = set;
+    pthread_mutex_unlock(&rules_lock);
+    return set.count;
+}
+
+int threshold_load_text(const char *text)
+{
+    if (text == NULL) {
+        return NETMON_ERROR;
+    }
+    return compile_text(text, "rules");
+}
+
+int threshold_load(const char *path)
+{
+    FILE *f = path != NULL ? fopen(path, "r") : NULL;
+
+    if (f == NULL) {
+        return NETMON_ERROR;
+    }
+    char *text = NULL;
+    size_t size = 0;
+    FILE *mem = open_memstream(&text, &size);
+    char buf[4096];
+    size_t n;
+    while (mem != NULL && (n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        fwrite(buf, 1, n, mem);
+    }
+    fclose(f);
+    if (mem == NULL) {
+        return NETMON_ERROR;
+    }
+    fclose(mem);
+
+    int rc = compile_text(text, path);
+    free(text);
+    return rc;
+}
+
+void threshold_clear(void)
+{
+    rule_set_t none;
+
+    memset(&none, 0, sizeof(none));
+    pthread_mutex_lock(&rules_lock);
+    carry_over(&rules, &none);
+    free_set(&rules);
+    chunk_array_free(&slots);
+    slot_limit = 0;
+    pthread_mutex_unlock(&rules_lock);
+}
+
+int threshold_rule_count(void)
+{
+    pthread_mutex_lock(&rules_lock);
+    int n = rules.count;
+    pthread_mutex_unlock(&rules_lock);
+    return n;
+}
+
+/* ------------------------------------------------------------------ */
+/* Evaluator                                                          */
+/* ------------------------------------------------------------------ */
+
+/* Errors per second since the previous sample, NaN without one */
+static float error_rate(uint32_t now, uint32_t prev, time_t dt)
+{
+    if (dt <= 0 || now < prev) {
+        return NAN;
+    }
+    return (float)((double)(now - prev) / (double)dt);
+}
+
+/*
+ * Read the new sample of ref into one value per metric (NaN for metrics
+ * it did not report). Returns 0 if nothing changed since the last call
+ * or the device is not up; caller holds rules_lock
+ */
+static int sample(const device_ref_t *ref, float values[METRIC_COUNT])
+{
+    slot_state_t *st = slot_state(ref->slot);
+    uint8_t *row = slot_row(&rules, ref->slot, 1);
+    device_metrics_t m;
+
+    if (st == NULL || row == NULL) {
+        return 0;
+    }
+    if (st->id == ref->id && metrics_store_version(ref->slot) == st->version) {
+        return 0;
+    }
+    if (metrics_store_read(ref->slot, ref->id, &m) != NETMON_SUCCESS) {
+        return 0;
+    }
+    if (st->id != ref->id) {
+        memset(st, 0, sizeof(*st));
+        st->id = ref->id;
+        memset(row, 0, rules.rows.elem_size);
+    }
+    st->version = metrics_store_version(ref->slot);
+
+    int snmp = m.status == DEVICE_STATUS_UP;
+    if (!snmp && m.status != DEVICE_STATUS_WARNING) {
+        return 0;       /* Down devices are the correlator's business */
+    }
+
+    for (int mt = 0; mt < METRIC_COUNT; mt++) {
+        values[mt] = NAN;
+    }
+    values[METRIC_RESPONSE_TIME] = m.response_time_ms >= 0 ? (float)m.response_time_ms : NAN;
+    if (!snmp) {
+        return 1;
+    }
+    values[METRIC_CPU_USAGE] = m.cpu_usage;
+    values[METRIC_MEMORY_USAGE] = m.memory_usage;
+    values[METRIC_IN_BPS] = (float)m.in_bps;
+    values[METRIC_OUT_BPS] = (float)m.out_bps;
+    if (st->have_errors) {
+        time_t dt = m.last_seen - st->errors_at;
+        values[METRIC_ERRORS_IN] = error_rate(m.errors_in, st->errors_in, dt);
+        values[METRIC_ERRORS_OUT] = error_rate(m.errors_out, st->errors_out, dt);
+    }
+    if (!st->have_errors || m.last_seen > st->errors_at) {
+        st->errors_in = m.errors_in;
+        st->errors_out = m.errors_out;
+        st->errors_at = m.last_seen;
+        st->have_errors = 1;
+    }
+    return 1;
+}
+
+/*
+ * Run one block of lanes against value v of device slot, branch-free so
+ * the compiler can vectorize it. edge[j] gets 1 where a rule started
+ * firing and 2 where it cleared; returns non-zero if any edge was set.
+ */
+static uint8_t run_block(float v, int32_t slot,
+                         const float *restrict lo, const float *restrict hi,
+                         const uint8_t *restrict invert, const uint8_t *restrict samples,
+                         const int32_t *restrict scope,
+                         uint8_t *restrict streak, uint8_t *restrict firing,
+                         uint8_t *restrict edge)
+{
+    uint8_t any = 0;
+
+    for (int j = 0; j < LANE_BLOCK; j++) {
+        uint8_t match = (uint8_t)(((v >= lo[j]) & (v <= hi[j])) ^ invert[j]);
+        uint8_t mine = (uint8_t)((scope[j] < 0) | (scope[j] == slot));
+        uint8_t h = (uint8_t)(match & mine);
+        uint8_t s = streak[j];
+        uint8_t f = firing[j];
+        uint8_t ns = (uint8_t)((s + (s < THRESHOLD_MAX_SAMPLES)) & (uint8_t)-h);
+        uint8_t fire = (uint8_t)(h & (ns >= samples[j]) & (f ^ 1));
+        uint8_t clear = (uint8_t)((h ^ 1) & f);
+
+        streak[j] = ns;
+        firing[j] = (uint8_t)((f | fire) & (clear ^ 1));
+        edge[j] = (uint8_t)(fire | (clear << 1));
+        any |= edge[j];
+    }
+    return any;
+}
+
+static int raise_rule(const rule_op_t *op, const device_ref_t *ref, int fire, float value)
+{
+    alert_event_t ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.device_id = ref->id;
+    ev.device_slot = ref->slot;
+    ev.severity = fire ? op->severity : ALERT_INFO;
+    ev.template_id = fire ? op->fire_template : op->clear_template;
+    ev.value = value;
+    ev.has_value = 1;
+    return correlate_edge(&ev) == NETMON_SUCCESS;
+}
+
+/* Run every lane over one device's sample; returns alerts raised */
+static int run_device(const device_ref_t *ref, const float values[METRIC_COUNT])
+{
+    uint8_t edge[LANE_BLOCK];
+    uint8_t *streak = slot_row(&rules, ref->slot, 0);
+    uint8_t *firing = streak + rules.lanes;
+    int32_t slot = ref->slot;
+    int raised = 0;
+
+    for (int mt = 0; mt < METRIC_COUNT; mt++) {
+        float v = values[mt];
+        if (isnan(v)) {
+            continue;       /* No value: streaks and firing stay as they are */
+        }
+        for (int lane = rules.group[mt]; lane < rules.group[mt + 1]; lane += LANE_BLOCK) {
+            if (!run_block(v, slot, rules.lo + lane, rules.hi + lane, rules.invert + lane,
+                           rules.samples + lane, rules.scope + lane,
+                           streak + lane, firing + lane, edge)) {
+                continue;
+            }
+            for (int j = 0; j < LANE_BLOCK; j++) {
+                if (edge[j] != 0) {
+                    raised += raise_rule(&rules.ops[lane + j], ref, edge[j] == 1, v);
+                }
+            }
+        }
+    }
+    return raised;
+}
+
+/*
+ * Resolve scoped rules to slots; padding and unknown hosts match nothing
+ * Hostnames only move between slots when devices are added or removed,
+ * so the lookups rerun only when the device table generation changes
+ * (a new rule set starts unresolved). Caller holds rules_lock.
+ */
+static void resolve_scopes(void)
+{
+    /* Read before the lookups: a change made during them forces another pass */
+    uint32_t generation = device_db_generation();
+
+    if (rules.scope_valid && rules.scope_generation == generation) {
+        return;
+    }
+    for (int lane = 0; lane < rules.lanes; lane++) {
+        int host = rules.ops[lane].host;
+        device_ref_t ref;
+        rules.scope[lane] = host == -1 ? -1 : INT32_MAX;
+        if (host >= 0 && device_db_find(rules.hosts[host], &ref) == NETMON_SUCCESS) {
+            rules.scope[lane] = ref.slot;
+        }
+    }
+    rules.scope_generation = generation;
+    rules.scope_valid = 1;
+}
+
+int threshold_evaluate_device(const device_ref_t *ref)
+{
+    float values[METRIC_COUNT];
+    int raised = 0;
+
+    if (ref == NULL || ref->slot < 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&rules_lock);
+    if (rules.count > 0) {
+        resolve_scopes();
+        if (sample(ref, values)) {
+            raised = run_device(ref, values);
+        }
+    }
+    pthread_mutex_unlock(&rules_lock);
+    return raised;
+}
+
+int threshold_evaluate(void)
+{
+    device_ref_t *refs;
+    float values[METRIC_COUNT];
+    int raised = 0;
+
+    pthread_mutex_lock(&rules_lock);
+    if (rules.count == 0) {
+        pthread_mutex_unlock(&rules_lock);
+        return 0;
+    }
+
+    resolve_scopes();
+    int count = device_db_list(&refs);
+    for (int i = 0; i < count; i++) {
+        if (sample(&refs[i], values)) {
+            raised += run_device(&refs[i], values);
+        }
+    }
+    pthread_mutex_unlock(&rules_lock);
+    if (count >= 0) {
+        free(refs);
+    }
+    return raised;
+}
@@ -0,0 +1,161 @@
+/*
+ * Hierarchical Timer Wheel
+ * Level n slots each span 64^n ticks. When level 0 wraps, the matching
+ * slot of the next level is cascaded down, as in the classic kernel
+ * timer design.
+ */
+
+#include "timer_wheel.h"
+#include <stddef.h>
+
+#define TW_MASK (TW_SLOTS - 1)
+
+static void list_unlink(tw_timer_t *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+}
+
+static void list_append(tw_timer_t *head, tw_timer_t *t)
+{
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+void tw_init(timer_wheel_t *wheel, uint64_t now)
+{
+    wheel->now = now;
+    wheel->count = 0;
+    for (int l = 0; l < TW_LEVELS; l++) {
+        for (int i = 0; i < TW_SLOTS; i++) {
+            wheel->slots[l][i].next = &wheel->slots[l][i];
+            wheel->slots[l][i].prev = &wheel->slots[l][i];
+        }
+    }
+}
+
+void tw_timer_init(tw_timer_t *timer, void *data)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+    timer->data = data;
+}
+
+int tw_pending(const tw_timer_t *timer)
+{
+    return timer->next != NULL;
+}
+
+/* Place an unlinked timer by its distance from the current tick */
+static void place(timer_wheel_t *wheel, tw_timer_t *timer)
+{
+    uint64_t expires = timer->expires;
+
+    if (expires < wheel->now) {
+        expires = wheel->now;
+    }
+    uint64_t delta = expires - wheel->now;
+
+    int level = 0;
+    while (level < TW_LEVELS - 1 && delta >= (1ULL << ((level + 1) * TW_SLOT_BITS))) {
+        level++;
+    }
+
+    uint64_t idx = (expires >> (level * TW_SLOT_BITS)) & TW_MASK;
+    list_append(&wheel->slots[level][idx], timer);
+}
+
+void tw_add(timer_wheel_t *wheel, tw_timer_t *timer, uint64_t expires)
+{
+    if (tw_pending(timer)) {
+        tw_cancel(wheel, timer);
+    }
+    if (expires > wheel->now + TW_MAX_DELAY) {
+        expires = wheel->now + TW_MAX_DELAY;
+    }
+
+    timer->expires = expires;
+    place(wheel, timer);
+    wheel->count++;
+}
+
+void tw_cancel(timer_wheel_t *wheel, tw_timer_t *timer)
+{
+    if (tw_pending(timer)) {
+        list_unlink(timer);
+        wheel->count--;
+    }
+}
+
+/* Re-place every timer of one upper-level slot relative to the current tick */
+static void cascade(timer_wheel_t *wheel, int level, uint64_t idx)
+{
+    tw_timer_t *head = &wheel->slots[level][idx];
+    tw_timer_t pending;
+
+    /* Detach first: re-placed timers may land in this same slot */
+    if (head->next == head) {
+        return;
+    }
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    head->next = head;
+    head->prev = head;
+
+    while (pending.next != &pending) {
+        tw_timer_t *t = pending.next;
+        list_unlink(t);
+        place(wheel, t);
+    }
+}
+
+int tw_advance(timer_wheel_t *wheel, uint64_t now, tw_expire_fn fn, void *ctx)
+{
+    int fired = 0;
+
+    while (wheel->now <= now) {
+        uint64_t tick = wheel->now;
+        uint64_t idx = tick & TW_MASK;
+
+        /* Level 0 wrapped: pull the next span down from each level above */
+        for (int level = 1; level < TW_LEVELS; level++) {
+            if (((tick >> ((level - 1) * TW_SLOT_BITS)) & TW_MASK) != 0) {
+                break;
+            }
+            cascade(wheel, level, (tick >> (level * TW_SLOT_BITS)) & TW_MASK);
+        }
+
+        /* Detach this tick's timers, then move time forward before firing
+         * so timers re-armed from fn never land in the list being run */
+        tw_timer_t *head = &wheel->slots[0][idx];
+        tw_timer_t expired;
+        expired.next = &expired;
+        expired.prev = &expired;
+        if (head->next != head) {
+            expired.next = head->next;
+            expired.prev = head->prev;
+            expired.next->prev = &expired;
+            expired.prev->next = &expired;
+            head->next = head;
+            head->prev = head;
+        }
+        wheel->now = tick + 1;
+
+        while (expired.next != &expired) {
+            tw_timer_t *t = expired.next;
+            list_unlink(t);
+            wheel->count--;
+            fired++;
+            fn(t, ctx);
+        }
+    }
+
+    return fired;
+}
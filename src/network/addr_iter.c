@@ -0,0 +1,97 @@
+/*
+ * CIDR Address Iterator
+ * Sequential or randomized traversal of any IPv4 prefix length.
+ */
+
+#define _GNU_SOURCE
+
+#include "addr_iter.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* splitmix64 - turns a weak seed into well-mixed LCG parameters */
+static uint64_t mix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+int addr_iter_init(addr_iter_t *it, uint32_t network, int prefix_len, int randomize)
+{
+    if (it == NULL || prefix_len < 0 || prefix_len > 32) {
+        return -1;
+    }
+
+    memset(it, 0, sizeof(*it));
+
+    uint64_t size = 1ULL << (32 - prefix_len);
+    uint32_t mask = prefix_len == 0 ? 0 : (uint32_t)(0xffffffffU << (32 - prefix_len));
+    uint32_t base = network & mask;
+
+    if (prefix_len >= 31) {
+        it->first = base;
+        it->count = size;
+    } else {
+        it->first = base + 1;
+        it->count = size - 2;
+    }
+
+    it->randomize = randomize && it->count > 2;
+    if (it->randomize) {
+        /* Smallest power of two covering the range */
+        it->modulus = 1;
+        while (it->modulus < it->count) {
+            it->modulus <<= 1;
+        }
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t seed = mix64((uint64_t)ts.tv_nsec ^ ((uint64_t)ts.tv_sec << 32) ^
+                              (uint64_t)getpid() ^ network);
+
+        /*
+         * Hull-Dobell: with a power-of-two modulus the LCG has full period
+         * when the increment is odd and multiplier - 1 is divisible by 4.
+         */
+        it->mult = ((mix64(seed) << 2) | 1) & (it->modulus - 1);
+        it->incr = (mix64(seed + 1) | 1) & (it->modulus - 1);
+        it->state = mix64(seed + 2) & (it->modulus - 1);
+        if (it->modulus <= 2) {
+            it->mult = 1;
+        }
+    }
+
+    return 0;
+}
+
+int addr_iter_next(void *ctx, uint32_t *addr)
+{
+    addr_iter_t *it = ctx;
+
+    if (it->produced >= it->count) {
+        return 0;
+    }
+
+    uint64_t offset;
+    if (it->randomize) {
+        /* Cycle-walk: at most modulus/count (< 2) steps on average */
+        do {
+            it->state = (it->state * it->mult + it->incr) & (it->modulus - 1);
+        } while (it->state >= it->count);
+        offset = it->state;
+    } else {
+        offset = it->produced;
+    }
+
+    it->produced++;
+    *addr = it->first + (uint32_t)offset;
+    return 1;
+}
+
+uint64_t addr_iter_count(const addr_iter_t *it)
+{
+    return it->count;
+}
@@ -7,6 +7,19 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "netmon.h"
+#include "ping.h"
+#include "port_probe.h"
+#include "addr_iter.h"
+#include "host_index.h"
+#include "arena.h"
+#include "snmp.h"
+#include "router_crawl.h"
+#include "cred_cache.h"
+#include "rtnl.h"
+#include "sock_diag.h"
+#include "passive.h"
+#include "inventory.h"
+#include "selfstat.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,22 +35,88 @@
 #include <sys/time.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-/* Maximum number of discovered hosts */
-#define MAX_DISCOVERED_HOSTS 1024
-#define MAX_SUBNETS 32
+/* Traceroute hop limit */
 #define MAX_HOPS 30
 
+/* Neighbor names learned from LLDP/CDP are truncated to this */
+#define MAX_NEIGHBOR_NAME_LEN 64
+
+/* How a host was learned; a host found several ways has several bits */
+enum {
+    HOST_SOURCE_GATEWAY = 1 << 0,
+    HOST_SOURCE_PING = 1 << 1,        /* Answered an ICMP sweep */
+    HOST_SOURCE_ARP = 1 << 2,         /* Local neighbor cache */
+    HOST_SOURCE_CONN = 1 << 3,        /* Established connection */
+    HOST_SOURCE_SNMP = 1 << 4,        /* Router crawl: router, interface or router ARP */
+    HOST_SOURCE_PASSIVE = 1 << 5,     /* Heard ARP/LLDP/CDP */
+    HOST_SOURCE_PORT = 1 << 6         /* TCP connect or SNMP answer in a fallback sweep */
+};
+
+static const char *const host_source_names[] = {
+    "Gateway", "Ping", "ARP", "Conn", "SNMP", "Passive", "Port"
+};
+
 /* Structure to hold discovered host information */
 typedef struct {
     char ip_address[MAX_IP_LEN];
-    int response_time_ms;
+    int response_time_ms;             /* 0 until a ping answers */
     int is_reachable;
+    unsigned sources;                 /* HOST_SOURCE_* bits, updated under discovered_lock */
+    const char *neighbor_name;    /* LLDP/CDP device (interned), NULL if none */
+    const char *neighbor_port;    /* Its advertised port */
 } discovered_host_t;
 
-/* Global array of discovered hosts */
-static discovered_host_t discovered_hosts[MAX_DISCOVERED_HOSTS];
-static int discovered_count = 0;
+/*
+ * Discovered hosts, in a chunked arena whose entries never move. Hosts
+ * are appended under discovered_lock; an entry below discovered_count
+ * is complete, so readers on the discovery thread may index it without
+ * the lock while the passive listener keeps appending.
+ */
+static chunk_array_t discovered_hosts = CHUNK_ARRAY_INIT(discovered_host_t);
+static atomic_int discovered_count = 0;
+static pthread_mutex_t discovered_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Address -> discovered_hosts[] index, shared by every discovery path */
+static host_index_t discovered_index;
+
+/* Neighbor names and ports, one copy each; guarded by discovered_lock */
+static string_pool_t neighbor_strings;
+
+/* Inventory addresses to confirm; grows to the inventory size */
+static uint32_t *known_hosts = NULL;
+static int known_hosts_cap = 0;
+
+static discovered_host_t *host_at(int index)
+{
+    return chunk_array_at(&discovered_hosts, (uint32_t)index);
+}
+
+/* known_hosts with room for at least need addresses, or NULL */
+static uint32_t *known_buffer(int need)
+{
+    if (need > known_hosts_cap) {
+        uint32_t *grown = realloc(known_hosts, (size_t)need * sizeof(*grown));
+        if (grown == NULL) {
+            return NULL;
+        }
+        known_hosts = grown;
+        known_hosts_cap = need;
+    }
+    return known_hosts;
+}
+
+/*
+ * Progress messages and result tables; set_discovery_verbose(0) turns
+ * them off, arguments included, for callers that report results their
+ * own way
+ */
+static int discovery_verbose = 1;
+
+#define report(...) do { if (discovery_verbose) printf(__VA_ARGS__); } while (0)
+#define report_flush() do { if (discovery_verbose) fflush(stdout); } while (0)
 
 /*
  * Validate that a string contains only valid IP address characters
@@ -58,44 +137,358 @@ static int validate_ip_string(const char *ip_addr)
 }
 
 /*
- * Ping using system command (portable, works without root)
- * Returns response time in ms, or -1 if unreachable
+ * Check if SNMP community string is usable
+ * Communities go straight into the SNMP message, so any printable
+ * string that fits is accepted
  */
-static int ping_host_system(const char *ip_addr)
+static int validate_community_string(const char *community)
 {
-    char cmd[256];
-    FILE *fp;
-    char result[256];
-    int response_time = -1;
+    if (community == NULL || *community == '\0') return 0;
+    return strlen(community) < MAX_COMMUNITY_LEN;
+}
 
-    /* Validate IP address to prevent command injection */
-    if (!validate_ip_string(ip_addr)) {
-        return -1;
+/*
+ * Format a host-order IPv4 address as dotted quad
+ */
+static void format_ip(uint32_t addr, char *ip)
+{
+    struct in_addr in;
+    in.s_addr = htonl(addr);
+    inet_ntop(AF_INET, &in, ip, MAX_IP_LEN);
+}
+
+/*
+ * Parse a dotted quad into a host-order IPv4 address
+ * Returns 1 on success, 0 on failure
+ */
+static int parse_ip_addr(const char *ip, uint32_t *addr)
+{
+    struct in_addr in;
+    if (ip == NULL || inet_pton(AF_INET, ip, &in) != 1) {
+        return 0;
     }
+    *addr = ntohl(in.s_addr);
+    return 1;
+}
 
-    /* Use system ping with 1 packet, 1 second timeout */
-    snprintf(cmd, sizeof(cmd), "ping -c 1 -W 1 %s 2>/dev/null", ip_addr);
-    
-    fp = popen(cmd, "r");
-    if (fp == NULL) {
+/* Streaming consumer registered with set_discovery_callback() */
+static host_found_cb host_stream_cb = NULL;
+static void *host_stream_ctx = NULL;
+
+/*
+ * Register a callback that receives every host as discovery finds it
+ */
+void set_discovery_callback(host_found_cb cb, void *ctx)
+{
+    host_stream_cb = cb;
+    host_stream_ctx = ctx;
+}
+
+/*
+ * Print progress and results (the default) or run silently
+ */
+void set_discovery_verbose(int verbose)
+{
+    discovery_verbose = verbose;
+}
+
+/*
+ * Forward a newly found host to the streaming consumer, if any
+ */
+static void notify_host_found(const char *ip, int response_time_ms)
+{
+    if (host_stream_cb != NULL) {
+        host_stream_cb(ip, response_time_ms, host_stream_ctx);
+    }
+}
+
+/* Adapter state for scan_subnet_stream() */
+typedef struct {
+    host_found_cb cb;
+    void *ctx;
+} stream_ctx_t;
+
+static void stream_forward_cb(uint32_t addr, int rtt_ms, void *ctx)
+{
+    stream_ctx_t *sc = ctx;
+    char ip[MAX_IP_LEN];
+
+    format_ip(addr, ip);
+    if (sc->cb != NULL) {
+        sc->cb(ip, rtt_ms, sc->ctx);
+    }
+}
+
+/*
+ * Sweep every host address of network/prefix_len through the ICMP engine.
+ * If nothing answers or ICMP is unavailable, the prefix is swept again
+ * with TCP connect and SNMP probes, which reach hosts behind ICMP
+ * filters; *source (if non-NULL) says which sweep cb is hearing from.
+ * Returns the number of responding hosts, or -1 if neither sweep could run
+ */
+static int sweep_prefix(uint32_t network, int prefix_len, int randomize,
+                        unsigned *source, ping_result_cb cb, void *ctx)
+{
+    addr_iter_t it;
+    char net_ip[MAX_IP_LEN];
+
+    if (addr_iter_init(&it, network, prefix_len, randomize) != 0) {
         return -1;
     }
 
-    /* Read output and look for time= */
-    while (fgets(result, sizeof(result), fp) != NULL) {
-        char *time_ptr = strstr(result, "time=");
-        if (time_ptr != NULL) {
-            float time_ms;
-            if (sscanf(time_ptr, "time=%f", &time_ms) == 1) {
-                response_time = (int)(time_ms + 0.5);
-                if (response_time < 1) response_time = 1;
+    format_ip(network, net_ip);
+    report("Scanning %s/%d (%llu hosts%s)...\n", net_ip, prefix_len,
+           (unsigned long long)addr_iter_count(&it), randomize ? ", randomized" : "");
+    report_flush();
+
+    uint64_t start_us = selfstat_now_us();
+    if (source != NULL) *source = HOST_SOURCE_PING;
+    int found = ping_sweep_source(NULL, addr_iter_next, &it, cb, ctx, NULL);
+    if (found > 0) {
+        selfstat_record(SELFSTAT_STAGE_SWEEP, selfstat_now_us() - start_us);
+        return found;
+    }
+
+    report("%s; probing TCP ports and SNMP instead...\n",
+           found < 0 ? "ICMP unavailable" : "No ICMP replies");
+    report_flush();
+    selfstat_add(SELFSTAT_SWEEP_FALLBACKS, 1);
+    if (addr_iter_init(&it, network, prefix_len, randomize) != 0) {
+        return found;
+    }
+    if (source != NULL) *source = HOST_SOURCE_PORT;
+    int port_found = port_probe_sweep_source(NULL, NULL, addr_iter_next, &it, cb, ctx, NULL);
+    selfstat_record(SELFSTAT_STAGE_SWEEP, selfstat_now_us() - start_us);
+    return port_found < 0 ? found : port_found;
+}
+
+/*
+ * sweep_prefix() over an explicit address list: ICMP first, then TCP
+ * ports and SNMP if ICMP is unavailable or nothing answered
+ */
+static int sweep_addresses(const uint32_t *targets, int count,
+                           unsigned *source, ping_result_cb cb, void *ctx)
+{
+    probe_array_source_t src = { targets, count, 0 };
+
+    uint64_t start_us = selfstat_now_us();
+    if (source != NULL) *source = HOST_SOURCE_PING;
+    int found = ping_sweep_source(NULL, probe_array_next, &src, cb, ctx, NULL);
+    if (found > 0) {
+        selfstat_record(SELFSTAT_STAGE_SWEEP, selfstat_now_us() - start_us);
+        return found;
+    }
+
+    report("%s; probing TCP ports and SNMP instead...\n",
+           found < 0 ? "ICMP unavailable" : "No ICMP replies");
+    report_flush();
+    selfstat_add(SELFSTAT_SWEEP_FALLBACKS, 1);
+    src.pos = 0;
+    if (source != NULL) *source = HOST_SOURCE_PORT;
+    int port_found = port_probe_sweep_source(NULL, NULL, probe_array_next, &src, cb, ctx, NULL);
+    selfstat_record(SELFSTAT_STAGE_SWEEP, selfstat_now_us() - start_us);
+    return port_found < 0 ? found : port_found;
+}
+
+/*
+ * Forget all discovered hosts
+ */
+static void reset_discovered_hosts(void)
+{
+    pthread_mutex_lock(&discovered_lock);
+    discovered_count = 0;
+    host_index_clear(&discovered_index);
+    string_pool_free(&neighbor_strings);
+    pthread_mutex_unlock(&discovered_lock);
+}
+
+/*
+ * Merge a host from one discovery source: add it if it is new,
+ * otherwise record the extra source (and a first response time) on the
+ * existing entry. Every source stage merges through here, so a host
+ * found several ways is stored and streamed once.
+ * Returns 1 if added, 0 if already present, -1 if the host could not
+ * be stored (CHUNK_ARRAY_MAX_LEN hosts, or out of memory)
+ * New hosts are streamed to the registered consumer even when there is
+ * no room to store them.
+ */
+static int add_discovered_host(uint32_t addr, int response_time_ms, unsigned source)
+{
+    char ip[MAX_IP_LEN];
+    int32_t found;
+
+    pthread_mutex_lock(&discovered_lock);
+    if (host_index_find(&discovered_index, addr, &found)) {
+        if (found != HOST_INDEX_NO_SLOT) {
+            discovered_host_t *h = host_at(found);
+            h->sources |= source;
+            if (h->response_time_ms == 0) {
+                h->response_time_ms = response_time_ms;
             }
-            break;
         }
+        pthread_mutex_unlock(&discovered_lock);
+        selfstat_add(SELFSTAT_HOSTS_DUPLICATE, 1);
+        return 0;
+    }
+    int count = discovered_count;
+    discovered_host_t *h = chunk_array_reserve(&discovered_hosts, (uint32_t)count);
+    int slot = h != NULL ? count : HOST_INDEX_NO_SLOT;
+    if (host_index_insert(&discovered_index, addr, slot, NULL) < 0) {
+        pthread_mutex_unlock(&discovered_lock);
+        selfstat_add(SELFSTAT_HOSTS_DROPPED, 1);
+        return -1;
     }
 
-    pclose(fp);
-    return response_time;
+    format_ip(addr, ip);
+    if (h != NULL) {
+        memcpy(h->ip_address, ip, sizeof(h->ip_address));
+        h->response_time_ms = response_time_ms;
+        h->is_reachable = 1;
+        h->sources = source;
+        h->neighbor_name = NULL;
+        h->neighbor_port = NULL;
+        discovered_count = count + 1;
+    }
+    pthread_mutex_unlock(&discovered_lock);
+
+    /* Outside the lock so the consumer may call back into discovery */
+    notify_host_found(ip, response_time_ms);
+    selfstat_add(slot == HOST_INDEX_NO_SLOT ? SELFSTAT_HOSTS_DROPPED : SELFSTAT_HOSTS_ADDED, 1);
+    return slot == HOST_INDEX_NO_SLOT ? -1 : 1;
+}
+
+/*
+ * String form of add_discovered_host()
+ */
+static int add_discovered_ip(const char *ip, int response_time_ms, unsigned source)
+{
+    uint32_t addr;
+    if (!parse_ip_addr(ip, &addr)) {
+        return -1;
+    }
+    return add_discovered_host(addr, response_time_ms, source);
+}
+
+/*
+ * Sweep callback - record every responding host
+ * ctx is the sweep's source bit, or NULL for HOST_SOURCE_PING
+ */
+static void sweep_collect_cb(uint32_t addr, int rtt_ms, void *ctx)
+{
+    const unsigned *source = ctx;
+    add_discovered_host(addr, rtt_ms, source != NULL ? *source : HOST_SOURCE_PING);
+}
+
+/* Set once the inventory file has been read into memory */
+static int inventory_loaded = 0;
+
+/*
+ * Read the host inventory on first use
+ * Returns the number of known hosts
+ */
+static int load_inventory(void)
+{
+    if (!inventory_loaded) {
+        inventory_load(INVENTORY_DEFAULT_PATH);
+        inventory_loaded = 1;
+    }
+    return inventory_host_count();
+}
+
+/*
+ * Record every discovered host in the inventory, drop hosts not seen
+ * within INVENTORY_DEFAULT_MAX_AGE_S and save the file
+ */
+static void commit_inventory(void)
+{
+    time_t now = time(NULL);
+    int count = discovered_count;
+
+    load_inventory();
+    for (int i = 0; i < count; i++) {
+        uint32_t addr;
+        const discovered_host_t *h = host_at(i);
+        if (parse_ip_addr(h->ip_address, &addr)) {
+            inventory_touch_host(addr, h->response_time_ms, 0, now);
+        }
+    }
+    int aged = inventory_age_out(now - INVENTORY_DEFAULT_MAX_AGE_S);
+
+    if (inventory_save(INVENTORY_DEFAULT_PATH) != NETMON_SUCCESS) {
+        report("Warning: Could not save host inventory to %s\n", INVENTORY_DEFAULT_PATH);
+    } else {
+        report("Inventory: %d known host(s)", inventory_host_count());
+        if (aged > 0) {
+            report(", %d stale entr%s removed", aged, aged == 1 ? "y" : "ies");
+        }
+        report("\n");
+    }
+}
+
+/*
+ * Ping hosts already recorded in the inventory (restricted to
+ * network/prefix_len when prefix_len > 0) and add those that answer
+ * Returns the number of known hosts probed
+ */
+static int confirm_known_hosts(uint32_t network, int prefix_len)
+{
+    time_t since = time(NULL) - INVENTORY_DEFAULT_MAX_AGE_S;
+    int n;
+
+    load_inventory();
+    int max = inventory_host_count();
+    uint32_t *known = known_buffer(max);
+    if (known == NULL || max == 0) {
+        return 0;
+    }
+    if (prefix_len > 0) {
+        n = inventory_list_subnet_hosts(network, prefix_len, since, known, max);
+    } else {
+        n = inventory_list_hosts(since, 0, known, max);
+    }
+    if (n > 0) {
+        ping_sweep(known, n, PING_DEFAULT_TIMEOUT_MS, sweep_collect_cb, NULL);
+    }
+    return n;
+}
+
+/* Neighbor cache digest over one subnet; order-independent */
+typedef struct {
+    uint32_t network;
+    uint32_t mask;
+    uint64_t digest;
+} neigh_digest_t;
+
+static int neigh_digest_cb(const rtnl_neigh_t *neigh, void *ctx)
+{
+    neigh_digest_t *d = ctx;
+
+    if ((neigh->addr & d->mask) == d->network) {
+        /* splitmix64 finalizer, summed so entry order does not matter */
+        uint64_t z = neigh->addr + 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        d->digest += z ^ (z >> 31);
+    }
+    return 0;
+}
+
+/*
+ * Fingerprint the set of addresses the kernel has resolved in a subnet
+ * Returns 1 and sets *digest, or 0 if the neighbor table is unreadable
+ */
+static int subnet_neighbor_digest(uint32_t network, int prefix_len, uint64_t *digest)
+{
+    neigh_digest_t d;
+
+    d.mask = prefix_len <= 0 ? 0 : 0xffffffffu << (32 - prefix_len);
+    d.network = network & d.mask;
+    d.digest = (uint64_t)prefix_len;
+    if (rtnl_neigh_foreach(neigh_digest_cb, &d) < 0) {
+        return 0;
+    }
+    *digest = d.digest;
+    return 1;
 }
 
 /*
@@ -188,110 +581,80 @@ int discover_network(void)
     char local_ip[MAX_IP_LEN];
     char network_addr[MAX_IP_LEN];
     char netmask[MAX_IP_LEN];
-    int net_octets[4], mask_octets[4];
     
-    discovered_count = 0;
+    reset_discovered_hosts();
 
-    printf("\n=== Network Discovery ===\n\n");
+    report("\n=== Network Discovery ===\n\n");
 
     /* Get local network information */
     if (get_local_network_info(local_ip, network_addr, netmask) != 0) {
-        printf("Error: Could not get network interface information\n");
+        report("Error: Could not get network interface information\n");
         return -1;
     }
 
-    printf("Local IP Address: %s\n", local_ip);
-    printf("Network Address:  %s\n", network_addr);
-    printf("Subnet Mask:      %s\n", netmask);
-    printf("\n");
-
-    /* Parse addresses */
-    parse_ip(network_addr, net_octets);
-    parse_ip(netmask, mask_octets);
+    report("Local IP Address: %s\n", local_ip);
+    report("Network Address:  %s\n", network_addr);
+    report("Subnet Mask:      %s\n", netmask);
+    report("\n");
 
     /* Calculate scan range based on netmask */
-    int host_bits = get_host_bits(netmask);
-    int max_hosts = (1 << host_bits) - 2;  /* Exclude network and broadcast */
-    
-    /* Limit scan to reasonable size */
-    if (max_hosts > 254) {
-        max_hosts = 254;
-        printf("Note: Large network detected, limiting scan to %d hosts\n", max_hosts);
-    }
-
-    printf("Scanning %d potential hosts...\n", max_hosts);
-    printf("This may take a few minutes.\n\n");
-
-    /* Progress display */
-    printf("Progress: [");
-    fflush(stdout);
-
-    int progress_step = max_hosts / 20;
-    if (progress_step < 1) progress_step = 1;
-
-    /* Scan each IP in the range */
-    for (int i = 1; i <= max_hosts && discovered_count < MAX_DISCOVERED_HOSTS; i++) {
-        char target_ip[MAX_IP_LEN];
-        
-        /* Calculate target IP */
-        int target_octets[4];
-        target_octets[0] = net_octets[0];
-        target_octets[1] = net_octets[1];
-        target_octets[2] = net_octets[2];
-        target_octets[3] = (net_octets[3] & mask_octets[3]) + i;
-        
-        /* Handle octet overflow for larger subnets */
-        if (host_bits > 8) {
-            target_octets[2] = net_octets[2] + ((i - 1) / 256);
-            target_octets[3] = (net_octets[3] & mask_octets[3]) + ((i - 1) % 256) + 1;
-        }
-        
-        snprintf(target_ip, sizeof(target_ip), "%d.%d.%d.%d",
-                 target_octets[0], target_octets[1], 
-                 target_octets[2], target_octets[3]);
-
-        /* Try to ping the host */
-        int response_time = ping_host_system(target_ip);
-        
-        if (response_time > 0) {
-            strncpy(discovered_hosts[discovered_count].ip_address, 
-                    target_ip, MAX_IP_LEN - 1);
-            discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-            discovered_hosts[discovered_count].response_time_ms = response_time;
-            discovered_hosts[discovered_count].is_reachable = 1;
-            discovered_count++;
-        }
-
-        /* Update progress bar */
-        if (i % progress_step == 0) {
-            printf("=");
-            fflush(stdout);
+    uint32_t net_addr = 0;
+    parse_ip_addr(network_addr, &net_addr);
+    int prefix_len = 32 - get_host_bits(netmask);
+
+    /*
+     * Incremental rediscovery: if the kernel has resolved the same set of
+     * neighbors in this subnet as at the last full sweep, and that sweep
+     * is recent, only the hosts already known there are re-probed
+     */
+    uint64_t digest = 0, last_digest;
+    time_t swept_at;
+    time_t now = time(NULL);
+    int have_digest = subnet_neighbor_digest(net_addr, prefix_len, &digest);
+
+    load_inventory();
+    if (have_digest && inventory_get_subnet(net_addr, prefix_len, &last_digest, &swept_at) &&
+        last_digest == digest && now - swept_at < INVENTORY_RESWEEP_S) {
+        report("Neighbor table unchanged since the last sweep; confirming known hosts...\n");
+        report_flush();
+        int probed = confirm_known_hosts(net_addr, prefix_len);
+        report("Re-probed %d known host(s)\n", probed);
+    } else {
+        /* Randomized order spreads probes across access switches */
+        unsigned source;
+        if (sweep_prefix(net_addr, prefix_len, 1, &source, sweep_collect_cb, &source) < 0) {
+            report("Error: Could not open probe sockets\n");
+        } else if (have_digest) {
+            /* The sweep itself fills the neighbor table; fingerprint afterwards */
+            subnet_neighbor_digest(net_addr, prefix_len, &digest);
+            inventory_set_subnet(net_addr, prefix_len, digest, now);
         }
     }
 
-    printf("] Done!\n\n");
+    report("Done!\n\n");
 
     /* Display results */
-    printf("=== Discovery Results ===\n\n");
-    printf("Found %d reachable host(s):\n\n", discovered_count);
+    report("=== Discovery Results ===\n\n");
+    report("Found %d reachable host(s):\n\n", discovered_count);
 
     if (discovered_count > 0) {
-        printf("%-18s %s\n", "IP Address", "Response Time");
-        printf("%-18s %s\n", "----------", "-------------");
+        report("%-18s %s\n", "IP Address", "Response Time");
+        report("%-18s %s\n", "----------", "-------------");
         
         for (int i = 0; i < discovered_count; i++) {
-            printf("%-18s %d ms\n", 
-                   discovered_hosts[i].ip_address,
-                   discovered_hosts[i].response_time_ms);
+            report("%-18s %d ms\n", 
+                   host_at(i)->ip_address,
+                   host_at(i)->response_time_ms);
         }
     } else {
-        printf("No hosts found. This could be due to:\n");
-        printf("- Firewall blocking ICMP packets\n");
-        printf("- No other hosts on the network\n");
-        printf("- Network configuration issues\n");
+        report("No hosts found. This could be due to:\n");
+        report("- Firewall blocking ICMP and the probed TCP/SNMP ports\n");
+        report("- No other hosts on the network\n");
+        report("- Network configuration issues\n");
     }
 
-    printf("\n");
+    report("\n");
+    commit_inventory();
     return discovered_count;
 }
 
@@ -305,93 +668,87 @@ int discover_network_quick(void)
     char netmask[MAX_IP_LEN];
     int net_octets[4];
     
-    discovered_count = 0;
+    reset_discovered_hosts();
 
-    printf("\n=== Quick Network Discovery ===\n\n");
+    report("\n=== Quick Network Discovery ===\n\n");
 
     if (get_local_network_info(local_ip, network_addr, netmask) != 0) {
-        printf("Error: Could not get network interface information\n");
+        report("Error: Could not get network interface information\n");
         return -1;
     }
 
-    printf("Local IP: %s\n", local_ip);
-    printf("Scanning local machine and common host addresses...\n\n");
+    report("Local IP: %s\n", local_ip);
+    report("Scanning local machine and common host addresses...\n\n");
 
     parse_ip(network_addr, net_octets);
 
-    /* First check localhost */
-    printf("Checking 127.0.0.1 (localhost)... ");
-    fflush(stdout);
-    int response_time = ping_host_system("127.0.0.1");
-    if (response_time > 0) {
-        printf("REACHABLE (%d ms)\n", response_time);
-        strncpy(discovered_hosts[discovered_count].ip_address, 
-                "127.0.0.1", MAX_IP_LEN - 1);
-        discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-        discovered_hosts[discovered_count].response_time_ms = response_time;
-        discovered_hosts[discovered_count].is_reachable = 1;
-        discovered_count++;
-    } else {
-        printf("not reachable\n");
-    }
-
-    /* Check own IP */
-    printf("Checking %s (self)... ", local_ip);
-    fflush(stdout);
-    response_time = ping_host_system(local_ip);
-    if (response_time > 0) {
-        printf("REACHABLE (%d ms)\n", response_time);
-        strncpy(discovered_hosts[discovered_count].ip_address, 
-                local_ip, MAX_IP_LEN - 1);
-        discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-        discovered_hosts[discovered_count].response_time_ms = response_time;
-        discovered_hosts[discovered_count].is_reachable = 1;
-        discovered_count++;
-    } else {
-        printf("not reachable\n");
-    }
-
-    /* Quick scan targets */
+    /* Localhost, our own address, then common host addresses */
     int targets[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 
                      11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
                      100, 200, 254};
     int num_targets = (int)(sizeof(targets) / sizeof(targets[0]));
+    uint32_t sweep[2 + sizeof(targets) / sizeof(targets[0])];
+    int sweep_count = 0;
+    uint32_t self_addr = 0;
+
+    parse_ip_addr("127.0.0.1", &sweep[sweep_count++]);
+    if (parse_ip_addr(local_ip, &self_addr)) {
+        sweep[sweep_count++] = self_addr;
+    }
 
-    for (int i = 0; i < num_targets && discovered_count < MAX_DISCOVERED_HOSTS; i++) {
+    for (int i = 0; i < num_targets; i++) {
         char target_ip[MAX_IP_LEN];
+        uint32_t addr;
         
         snprintf(target_ip, sizeof(target_ip), "%d.%d.%d.%d",
                  net_octets[0], net_octets[1], net_octets[2], targets[i]);
 
         /* Skip if it's our own IP */
-        if (strcmp(target_ip, local_ip) == 0) {
+        if (!parse_ip_addr(target_ip, &addr) || addr == self_addr) {
             continue;
         }
+        sweep[sweep_count++] = addr;
+    }
 
-        printf("Checking %s... ", target_ip);
-        fflush(stdout);
+    report("Checking %d addresses...\n\n", sweep_count);
+    report_flush();
 
-        response_time = ping_host_system(target_ip);
-        
-        if (response_time > 0) {
-            printf("REACHABLE (%d ms)\n", response_time);
-            strncpy(discovered_hosts[discovered_count].ip_address, 
-                    target_ip, MAX_IP_LEN - 1);
-            discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-            discovered_hosts[discovered_count].response_time_ms = response_time;
-            discovered_hosts[discovered_count].is_reachable = 1;
-            discovered_count++;
-        } else {
-            printf("not reachable\n");
-        }
+    unsigned source;
+    if (sweep_addresses(sweep, sweep_count, &source, sweep_collect_cb, &source) < 0) {
+        report("Error: Could not open probe sockets\n");
+    }
+
+    for (int i = 0; i < discovered_count; i++) {
+        report("%-18s REACHABLE (%d ms)\n",
+               host_at(i)->ip_address,
+               host_at(i)->response_time_ms);
     }
 
-    printf("\n=== Results ===\n");
-    printf("Found %d reachable host(s)\n\n", discovered_count);
+    report("\n=== Results ===\n");
+    report("Found %d reachable host(s)\n\n", discovered_count);
 
     return discovered_count;
 }
 
+/*
+ * Release memory held by the discovery module
+ */
+void cleanup_discovery(void)
+{
+    passive_stop();
+    pthread_mutex_lock(&discovered_lock);
+    discovered_count = 0;
+    host_index_free(&discovered_index);
+    chunk_array_free(&discovered_hosts);
+    string_pool_free(&neighbor_strings);
+    free(known_hosts);
+    known_hosts = NULL;
+    known_hosts_cap = 0;
+    pthread_mutex_unlock(&discovered_lock);
+    inventory_free();
+    inventory_loaded = 0;
+}
+
 /*
  * Get the count of discovered hosts
  */
@@ -410,17 +767,40 @@ int get_discovered_host(int index, char *ip, int *response_time)
     }
     
     if (ip != NULL) {
-        strncpy(ip, discovered_hosts[index].ip_address, MAX_IP_LEN - 1);
+        strncpy(ip, host_at(index)->ip_address, MAX_IP_LEN - 1);
         ip[MAX_IP_LEN - 1] = '\0';
     }
     
     if (response_time != NULL) {
-        *response_time = discovered_hosts[index].response_time_ms;
+        *response_time = host_at(index)->response_time_ms;
     }
     
     return 0;
 }
 
+/*
+ * Get the LLDP/CDP neighbor identity recorded for a discovered host
+ * Returns 0 if the host was advertised by a neighbor protocol, -1 if
+ * not or if index is out of range
+ */
+int get_discovered_neighbor(int index, char *name, size_t name_size, char *port, size_t port_size)
+{
+    int rc = -1;
+
+    pthread_mutex_lock(&discovered_lock);
+    if (index >= 0 && index < discovered_count && host_at(index)->neighbor_name != NULL) {
+        if (name != NULL && name_size > 0) {
+            snprintf(name, name_size, "%s", host_at(index)->neighbor_name);
+        }
+        if (port != NULL && port_size > 0) {
+            snprintf(port, port_size, "%s", host_at(index)->neighbor_port);
+        }
+        rc = 0;
+    }
+    pthread_mutex_unlock(&discovered_lock);
+    return rc;
+}
+
 /*
  * Discover network path using traceroute
  * Returns routers/gateways in the path to a destination
@@ -437,12 +817,13 @@ int traceroute_discover(const char *target_ip, char gateways[][MAX_IP_LEN], int
         return -1;
     }
 
-    printf("Tracing route to %s...\n", target_ip);
+    report("Tracing route to %s...\n", target_ip);
 
     /* Use traceroute with limited hops */
     snprintf(cmd, sizeof(cmd), "traceroute -n -m %d -w 1 %s 2>/dev/null", MAX_HOPS, target_ip);
     
     fp = popen(cmd, "r");
+    selfstat_add(SELFSTAT_SUBPROCESSES, 1);
     if (fp == NULL) {
         return -1;
     }
@@ -458,7 +839,7 @@ int traceroute_discover(const char *target_ip, char gateways[][MAX_IP_LEN], int
             if (validate_ip_string(ip)) {
                 strncpy(gateways[*gateway_count], ip, MAX_IP_LEN - 1);
                 gateways[*gateway_count][MAX_IP_LEN - 1] = '\0';
-                printf("  Hop %d: %s\n", hop_num, ip);
+                report("  Hop %d: %s\n", hop_num, ip);
                 (*gateway_count)++;
             }
         }
@@ -468,82 +849,63 @@ int traceroute_discover(const char *target_ip, char gateways[][MAX_IP_LEN], int
     return *gateway_count;
 }
 
+/*
+ * Sweep callback for scan_subnet - add new hosts, skipping duplicates
+ */
+typedef struct {
+    int found;
+    unsigned source;                  /* Set by sweep_prefix() */
+} scan_ctx_t;
+
+static void scan_subnet_cb(uint32_t addr, int rtt_ms, void *ctx)
+{
+    scan_ctx_t *sc = ctx;
+
+    if (add_discovered_host(addr, rtt_ms, sc->source) != 0) {
+        char target_ip[MAX_IP_LEN];
+        format_ip(addr, target_ip);
+        report("  Found: %s (%d ms)\n", target_ip, rtt_ms);
+        sc->found++;
+    }
+}
+
 /*
  * Scan a specific subnet
  */
 int scan_subnet(const char *network_addr, int prefix_len)
 {
-    int net_octets[4];
-    int hosts_found = 0;
-    
-    parse_ip(network_addr, net_octets);
-    
-    /* Calculate number of hosts based on prefix length */
-    int host_bits = 32 - prefix_len;
-    int max_hosts = (1 << host_bits) - 2;  /* Exclude network and broadcast */
-    
-    /* Limit scan to reasonable size */
-    if (max_hosts > 254) {
-        max_hosts = 254;
-    }
+    uint32_t net_addr;
+    scan_ctx_t sc = { 0, HOST_SOURCE_PING };
     
-    if (max_hosts <= 0) {
+    if (!parse_ip_addr(network_addr, &net_addr)) {
         return 0;
     }
 
-    printf("\nScanning subnet %s/%d (%d hosts)...\n", network_addr, prefix_len, max_hosts);
+    if (sweep_prefix(net_addr, prefix_len, 1, &sc.source, scan_subnet_cb, &sc) < 0) {
+        return 0;
+    }
+    
+    return sc.found;
+}
 
-    /* Scan each IP in the subnet */
-    for (int i = 1; i <= max_hosts && discovered_count < MAX_DISCOVERED_HOSTS; i++) {
-        char target_ip[MAX_IP_LEN];
-        int target_octets[4];
-        
-        target_octets[0] = net_octets[0];
-        target_octets[1] = net_octets[1];
-        target_octets[2] = net_octets[2];
-        target_octets[3] = i;
-        
-        /* Handle larger subnets */
-        if (host_bits > 8) {
-            target_octets[2] = net_octets[2] + ((i - 1) / 256);
-            target_octets[3] = ((i - 1) % 256) + 1;
-        }
-        
-        snprintf(target_ip, sizeof(target_ip), "%d.%d.%d.%d",
-                 target_octets[0], target_octets[1], 
-                 target_octets[2], target_octets[3]);
+/*
+ * Scan a subnet and stream every responding host to cb as replies arrive.
+ * Hosts are not recorded in the discovered hosts table.
+ * Returns the number of responding hosts, or -1 on error
+ */
+int scan_subnet_stream(const char *network_addr, int prefix_len, int randomize,
+                       host_found_cb cb, void *ctx)
+{
+    uint32_t net_addr;
+    stream_ctx_t sc;
 
-        int response_time = ping_host_system(target_ip);
-        
-        if (response_time > 0) {
-            /* Check if already discovered */
-            int already_found = 0;
-            for (int j = 0; j < discovered_count; j++) {
-                if (strcmp(discovered_hosts[j].ip_address, target_ip) == 0) {
-                    already_found = 1;
-                    break;
-                }
-            }
-            
-            if (!already_found) {
-                strncpy(discovered_hosts[discovered_count].ip_address, 
-                        target_ip, MAX_IP_LEN - 1);
-                discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                discovered_hosts[discovered_count].response_time_ms = response_time;
-                discovered_hosts[discovered_count].is_reachable = 1;
-                discovered_count++;
-                hosts_found++;
-                printf("  Found: %s (%d ms)\n", target_ip, response_time);
-            }
-        }
-        
-        /* Show progress every 50 hosts */
-        if (i % 50 == 0) {
-            printf("  Progress: %d/%d hosts scanned...\n", i, max_hosts);
-        }
+    if (!parse_ip_addr(network_addr, &net_addr)) {
+        return -1;
     }
-    
-    return hosts_found;
+
+    sc.cb = cb;
+    sc.ctx = ctx;
+    return sweep_prefix(net_addr, prefix_len, randomize, NULL, stream_forward_cb, &sc);
 }
 
 /*
@@ -559,22 +921,22 @@ int discover_multi_subnet(void)
     int gateway_count = 0;
     int total_found = 0;
     
-    discovered_count = 0;
+    reset_discovered_hosts();
 
-    printf("\n=== Multi-Subnet Network Discovery ===\n\n");
+    report("\n=== Multi-Subnet Network Discovery ===\n\n");
 
     /* Get local network information */
     if (get_local_network_info(local_ip, network_addr, netmask) != 0) {
-        printf("Error: Could not get network interface information\n");
+        report("Error: Could not get network interface information\n");
         return -1;
     }
 
-    printf("Local IP Address: %s\n", local_ip);
-    printf("Local Network:    %s\n", network_addr);
-    printf("Subnet Mask:      %s\n\n", netmask);
+    report("Local IP Address: %s\n", local_ip);
+    report("Local Network:    %s\n", network_addr);
+    report("Subnet Mask:      %s\n\n", netmask);
 
     /* First, scan local subnet */
-    printf("Step 1: Scanning local subnet...\n");
+    report("Step 1: Scanning local subnet...\n");
     int local_prefix = 24;  /* Default to /24 */
     
     /* Calculate actual prefix from netmask */
@@ -591,7 +953,7 @@ int discover_multi_subnet(void)
     total_found += scan_subnet(network_addr, local_prefix);
 
     /* Try to discover gateway/router */
-    printf("\nStep 2: Discovering network gateways...\n");
+    report("\nStep 2: Discovering network gateways...\n");
     
     /* Try common gateway addresses */
     char common_gateways[][MAX_IP_LEN] = {
@@ -601,7 +963,7 @@ int discover_multi_subnet(void)
     
     for (int i = 0; i < 2; i++) {
         if (traceroute_discover(common_gateways[i], gateways, &gateway_count) > 0) {
-            printf("\nDiscovered %d gateways in path to %s\n", gateway_count, common_gateways[i]);
+            report("\nDiscovered %d gateways in path to %s\n", gateway_count, common_gateways[i]);
             
             /* For each gateway, try to determine its subnet and scan */
             for (int j = 0; j < gateway_count && j < 5; j++) {  /* Limit to first 5 hops */
@@ -629,7 +991,7 @@ int discover_multi_subnet(void)
                     }
                     
                     if (!already_scanned) {
-                        printf("\nStep 3: Scanning remote subnet %s/24 (via gateway %s)...\n", 
+                        report("\nStep 3: Scanning remote subnet %s/24 (via gateway %s)...\n", 
                                gw_network, gateways[j]);
                         total_found += scan_subnet(gw_network, 24);
                     }
@@ -640,24 +1002,49 @@ int discover_multi_subnet(void)
     }
 
     /* Display final results */
-    printf("\n=== Multi-Subnet Discovery Results ===\n\n");
-    printf("Total hosts discovered: %d\n\n", discovered_count);
+    report("\n=== Multi-Subnet Discovery Results ===\n\n");
+    report("Total hosts discovered: %d\n\n", discovered_count);
 
     if (discovered_count > 0) {
-        printf("%-18s %s\n", "IP Address", "Response Time");
-        printf("%-18s %s\n", "----------", "-------------");
+        report("%-18s %s\n", "IP Address", "Response Time");
+        report("%-18s %s\n", "----------", "-------------");
         
         for (int i = 0; i < discovered_count; i++) {
-            printf("%-18s %d ms\n", 
-                   discovered_hosts[i].ip_address,
-                   discovered_hosts[i].response_time_ms);
+            report("%-18s %d ms\n", 
+                   host_at(i)->ip_address,
+                   host_at(i)->response_time_ms);
         }
     }
 
-    printf("\n");
+    report("\n");
     return discovered_count;
 }
 
+/*
+ * Neighbor cache callback - record each resolved neighbor, printing it
+ * when *ctx is non-zero
+ */
+static int arp_cache_cb(const rtnl_neigh_t *neigh, void *ctx)
+{
+    const int *verbose = ctx;
+
+    int rc = add_discovered_host(neigh->addr, 0, HOST_SOURCE_ARP);
+    if (rc < 0) {
+        return 1;
+    }
+    if (rc > 0 && *verbose) {
+        char ip[MAX_IP_LEN];
+        char mac[3 * RTNL_MAX_LLADDR];
+        struct in_addr in = { htonl(neigh->addr) };
+
+        inet_ntop(AF_INET, &in, ip, sizeof(ip));
+        rtnl_format_lladdr(neigh->lladdr, neigh->lladdr_len, mac, sizeof(mac));
+        report("%-18s %-20s %-10s %s\n", ip, mac, neigh->ifname,
+               rtnl_neigh_state_name(neigh->state));
+    }
+    return 0;
+}
+
 /*
  * ARP-based discovery - Query local ARP cache for known hosts
  * This is much faster than ping scanning as it only shows hosts
@@ -665,60 +1052,90 @@ int discover_multi_subnet(void)
  */
 int discover_arp_cache(void)
 {
-    FILE *fp;
-    char result[512];
-    char ip[MAX_IP_LEN];
-    char mac[32];
-    char iface[32];
-    
-    discovered_count = 0;
+    reset_discovered_hosts();
 
-    printf("\n=== ARP Cache Discovery ===\n\n");
-    printf("Querying local ARP cache for known hosts...\n");
-    printf("(This shows hosts that have recently communicated with this machine)\n\n");
+    report("\n=== ARP Cache Discovery ===\n\n");
+    report("Querying local ARP cache for known hosts...\n");
+    report("(This shows hosts that have recently communicated with this machine)\n\n");
 
-    /* Try using 'ip neigh show' first (more modern) */
-    fp = popen("ip neigh show 2>/dev/null || arp -a 2>/dev/null", "r");
-    if (fp == NULL) {
-        printf("Error: Could not query ARP cache\n");
+    report("%-18s %-20s %-10s %s\n", "IP Address", "MAC Address", "Interface", "State");
+    report("%-18s %-20s %-10s %s\n", "----------", "-----------", "---------", "-----");
+
+    int verbose = 1;
+    if (rtnl_neigh_foreach(arp_cache_cb, &verbose) < 0) {
+        report("Error: Could not query ARP cache\n");
         return -1;
     }
 
-    printf("%-18s %-20s %s\n", "IP Address", "MAC Address", "State");
-    printf("%-18s %-20s %s\n", "----------", "-----------", "-----");
-
-    while (fgets(result, sizeof(result), fp) != NULL && discovered_count < MAX_DISCOVERED_HOSTS) {
-        /* Try to parse 'ip neigh' format: IP dev IFACE lladdr MAC STATE */
-        char state[32] = "";
-        if (sscanf(result, "%15s dev %31s lladdr %31s %31s", ip, iface, mac, state) >= 3) {
-            if (validate_ip_string(ip) && strcmp(state, "FAILED") != 0) {
-                printf("%-18s %-20s %s\n", ip, mac, state[0] ? state : "REACHABLE");
-                strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                discovered_hosts[discovered_count].response_time_ms = 0;
-                discovered_hosts[discovered_count].is_reachable = 1;
-                discovered_count++;
-            }
-        }
-        /* Try 'arp -a' format: hostname (IP) at MAC [ether] on iface */
-        else if (sscanf(result, "%*s (%15[^)]) at %31s", ip, mac) >= 2) {
-            if (validate_ip_string(ip) && strcmp(mac, "<incomplete>") != 0) {
-                printf("%-18s %-20s %s\n", ip, mac, "REACHABLE");
-                strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                discovered_hosts[discovered_count].response_time_ms = 0;
-                discovered_hosts[discovered_count].is_reachable = 1;
-                discovered_count++;
-            }
-        }
+    report("\n=== Results ===\n");
+    report("Found %d host(s) in ARP cache\n\n", discovered_count);
+    commit_inventory();
+
+    return discovered_count;
+}
+
+/* SNMP table columns holding IpAddress values */
+#define OID_IP_NET_TO_MEDIA_NET_ADDRESS "1.3.6.1.2.1.4.22.1.3"
+#define OID_IP_ROUTE_NEXT_HOP "1.3.6.1.2.1.4.21.1.7"
+#define OID_IP_AD_ENT_ADDR "1.3.6.1.2.1.4.20.1.1"
+
+/* Receives each IpAddress value found by walk_ipaddr_column */
+typedef void (*ipaddr_value_fn)(uint32_t addr, void *ctx);
+
+typedef struct {
+    ipaddr_value_fn fn;
+    void *ctx;
+} ipaddr_walk_t;
+
+static int ipaddr_walk_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    ipaddr_walk_t *walk = ctx;
+
+    if (vb->type == SNMP_TYPE_IPADDRESS) {
+        walk->fn(vb->ipaddr, walk->ctx);
     }
+    return 0;
+}
 
-    pclose(fp);
+/*
+ * Walk an IpAddress-valued table column on a router with GetBulk
+ * Returns the number of rows walked or a negative NETMON code
+ */
+static int walk_ipaddr_column(const char *router_ip, const char *community,
+                              const char *column, ipaddr_value_fn fn, void *ctx)
+{
+    snmp_session_t session;
+    snmp_oid_t root;
+    ipaddr_walk_t walk = { fn, ctx };
 
-    printf("\n=== Results ===\n");
-    printf("Found %d host(s) in ARP cache\n\n", discovered_count);
+    if (snmp_oid_parse(column, &root) != 0 ||
+        snmp_open(&session, router_ip, DEFAULT_SNMP_PORT, community) != NETMON_SUCCESS) {
+        return NETMON_ERROR;
+    }
 
-    return discovered_count;
+    int rc = snmp_bulkwalk(&session, &root, ipaddr_walk_cb, &walk);
+    snmp_close(&session);
+    return rc;
+}
+
+/* ARP table rows become discovered hosts */
+typedef struct {
+    int found;
+    int verbose;
+} snmp_arp_ctx_t;
+
+static void snmp_arp_collect(uint32_t addr, void *ctx)
+{
+    snmp_arp_ctx_t *arp = ctx;
+
+    if (add_discovered_host(addr, 0, HOST_SOURCE_SNMP) == 1) {
+        arp->found++;
+        if (arp->verbose) {
+            char ip[MAX_IP_LEN];
+            format_ip(addr, ip);
+            report("%-18s Router ARP\n", ip);
+        }
+    }
 }
 
 /*
@@ -728,817 +1145,561 @@ int discover_arp_cache(void)
  */
 int discover_snmp_arp(const char *router_ip, const char *community)
 {
-    char cmd[512];
-    FILE *fp;
-    char result[512];
-    int hosts_found = 0;
+    snmp_arp_ctx_t arp = { 0, 1 };
 
     /* Validate inputs */
     if (!validate_ip_string(router_ip)) {
-        printf("Error: Invalid router IP address\n");
+        report("Error: Invalid router IP address\n");
         return -1;
     }
 
-    /* Validate community string - only allow alphanumeric and basic chars */
-    for (const char *p = community; *p != '\0'; p++) {
-        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || 
-              (*p >= '0' && *p <= '9') || *p == '_' || *p == '-')) {
-            printf("Error: Invalid community string\n");
-            return -1;
-        }
+    if (!validate_community_string(community)) {
+        report("Error: Invalid community string\n");
+        return -1;
     }
 
-    printf("\n=== SNMP ARP Table Discovery ===\n\n");
-    printf("Querying ARP table on router %s...\n", router_ip);
-    printf("Community: %s\n\n", community);
+    report("\n=== SNMP ARP Table Discovery ===\n\n");
+    report("Querying ARP table on router %s...\n", router_ip);
+    report("Community: %s\n\n", community);
+
+    report("%-18s %s\n", "IP Address", "Source");
+    report("%-18s %s\n", "----------", "------");
 
-    /* Use snmpwalk to query ARP table */
     /* OID: 1.3.6.1.2.1.4.22.1.3 - ipNetToMediaNetAddress (IP addresses in ARP) */
-    snprintf(cmd, sizeof(cmd), 
-             "snmpwalk -v2c -c %s %s 1.3.6.1.2.1.4.22.1.3 2>/dev/null",
-             community, router_ip);
-    
-    fp = popen(cmd, "r");
-    if (fp == NULL) {
-        printf("Error: Could not execute SNMP query\n");
-        return -1;
+    int rc = walk_ipaddr_column(router_ip, community, OID_IP_NET_TO_MEDIA_NET_ADDRESS,
+                                snmp_arp_collect, &arp);
+
+    if (arp.found == 0) {
+        report("No hosts found. This could mean:\n");
+        report("- SNMP is not enabled on the router\n");
+        report("- Incorrect community string\n");
+        if (rc == NETMON_TIMEOUT || rc == NETMON_NO_RESPONSE) {
+            report("- The router did not answer on UDP port %d\n", DEFAULT_SNMP_PORT);
+        }
     }
 
-    printf("%-18s %s\n", "IP Address", "Source");
-    printf("%-18s %s\n", "----------", "------");
+    report("\n=== Results ===\n");
+    report("Found %d host(s) via SNMP\n\n", arp.found);
 
-    while (fgets(result, sizeof(result), fp) != NULL && discovered_count < MAX_DISCOVERED_HOSTS) {
-        /* Parse SNMP output - look for IP addresses */
-        char *ip_start = strstr(result, "IpAddress:");
-        if (ip_start != NULL) {
-            ip_start += 10;  /* Skip "IpAddress:" */
-            while (*ip_start == ' ') ip_start++;
-            
-            char ip[MAX_IP_LEN];
-            if (sscanf(ip_start, "%15s", ip) == 1 && validate_ip_string(ip)) {
-                /* Check if already discovered */
-                int already_found = 0;
-                for (int j = 0; j < discovered_count; j++) {
-                    if (strcmp(discovered_hosts[j].ip_address, ip) == 0) {
-                        already_found = 1;
-                        break;
-                    }
-                }
-                
-                if (!already_found) {
-                    printf("%-18s Router ARP\n", ip);
-                    strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                    discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                    discovered_hosts[discovered_count].response_time_ms = 0;
-                    discovered_hosts[discovered_count].is_reachable = 1;
-                    discovered_count++;
-                    hosts_found++;
-                }
-            }
-        }
-    }
+    return arp.found;
+}
 
-    pclose(fp);
+/*
+ * Socket table callback - record each remote peer outside 127/8, printing
+ * new ones when *ctx is non-zero
+ */
+static int connection_cb(uint32_t remote_addr, uint16_t remote_port, void *ctx)
+{
+    const int *verbose = ctx;
 
-    if (hosts_found == 0) {
-        printf("No hosts found. This could mean:\n");
-        printf("- SNMP is not enabled on the router\n");
-        printf("- Incorrect community string\n");
-        printf("- snmpwalk tool is not installed (install with: apt install snmp)\n");
+    if ((remote_addr >> 24) == 127) {
+        return 0;
     }
+    int rc = add_discovered_host(remote_addr, 0, HOST_SOURCE_CONN);
+    if (rc < 0) {
+        return 1;
+    }
+    if (rc > 0 && *verbose) {
+        char ip[MAX_IP_LEN];
+        struct in_addr in = { htonl(remote_addr) };
 
-    printf("\n=== Results ===\n");
-    printf("Found %d host(s) via SNMP\n\n", hosts_found);
-
-    return hosts_found;
+        inet_ntop(AF_INET, &in, ip, sizeof(ip));
+        report("%-18s %-8u ESTABLISHED\n", ip, remote_port);
+    }
+    return 0;
 }
 
 /*
- * Passive discovery using netstat - find hosts we're communicating with
+ * Passive discovery using the socket table - find hosts we're communicating with
  */
 int discover_netstat(void)
 {
-    FILE *fp;
-    char result[512];
-    
-    discovered_count = 0;
-
-    printf("\n=== Active Connections Discovery ===\n\n");
-    printf("Finding hosts with active connections...\n\n");
+    reset_discovered_hosts();
 
-    /* Use netstat or ss to find established connections */
-    fp = popen("ss -tn state established 2>/dev/null || netstat -tn 2>/dev/null | grep ESTABLISHED", "r");
-    if (fp == NULL) {
-        printf("Error: Could not query network connections\n");
-        return -1;
-    }
+    report("\n=== Active Connections Discovery ===\n\n");
+    report("Finding hosts with active connections...\n\n");
 
-    printf("%-18s %-8s %s\n", "Remote IP", "Port", "State");
-    printf("%-18s %-8s %s\n", "---------", "----", "-----");
+    report("%-18s %-8s %s\n", "Remote IP", "Port", "State");
+    report("%-18s %-8s %s\n", "---------", "----", "-----");
 
-    while (fgets(result, sizeof(result), fp) != NULL && discovered_count < MAX_DISCOVERED_HOSTS) {
-        char local_addr[64], remote_addr[64];
-        
-        /* Parse ss output format */
-        if (sscanf(result, "%*s %*s %*s %63s %63s", local_addr, remote_addr) >= 2) {
-            /* Extract IP from IP:port format */
-            char *colon = strrchr(remote_addr, ':');
-            if (colon != NULL) {
-                *colon = '\0';
-                char *ip = remote_addr;
-                char *port = colon + 1;
-                
-                /* Handle IPv6-mapped IPv4 (::ffff:IP) */
-                if (strncmp(ip, "::ffff:", 7) == 0) {
-                    ip += 7;
-                }
-                
-                /* Skip localhost and IPv6 */
-                if (validate_ip_string(ip) && strcmp(ip, "127.0.0.1") != 0) {
-                    /* Check if already discovered */
-                    int already_found = 0;
-                    for (int j = 0; j < discovered_count; j++) {
-                        if (strcmp(discovered_hosts[j].ip_address, ip) == 0) {
-                            already_found = 1;
-                            break;
-                        }
-                    }
-                    
-                    if (!already_found) {
-                        printf("%-18s %-8s ESTABLISHED\n", ip, port);
-                        strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                        discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                        discovered_hosts[discovered_count].response_time_ms = 0;
-                        discovered_hosts[discovered_count].is_reachable = 1;
-                        discovered_count++;
-                    }
-                }
-            }
-        }
+    int verbose = 1;
+    if (sock_diag_established(connection_cb, &verbose) < 0) {
+        report("Error: Could not query network connections\n");
+        return -1;
     }
 
-    pclose(fp);
-
-    printf("\n=== Results ===\n");
-    printf("Found %d unique remote host(s) with active connections\n\n", discovered_count);
+    report("\n=== Results ===\n");
+    report("Found %d unique remote host(s) with active connections\n\n", discovered_count);
 
     return discovered_count;
 }
 
 /*
- * Combined efficient discovery - uses all non-bruteforce methods
+ * Get default gateway IP address
+ * Returns 1 on success, 0 on failure
  */
-int discover_efficient(void)
+static int get_default_gateway(char *gateway, size_t gateway_size)
 {
-    discovered_count = 0;
+    uint32_t addr;
+    struct in_addr in;
 
-    printf("\n=== Efficient Network Discovery ===\n\n");
-    printf("This combines multiple discovery methods WITHOUT brute-force scanning:\n");
-    printf("1. ARP Cache - Hosts that recently communicated with us\n");
-    printf("2. Active Connections - Hosts we currently have connections to\n");
-    printf("3. Default Gateway - Network router/gateway\n\n");
+    if (!rtnl_default_gateway(&addr, NULL)) {
+        return 0;
+    }
+    in.s_addr = htonl(addr);
+    return inet_ntop(AF_INET, &in, gateway, (socklen_t)gateway_size) != NULL;
+}
 
-    /* Step 1: ARP Cache */
-    printf("--- Step 1: Checking ARP Cache ---\n");
-    discover_arp_cache();
+/*
+ * Discovery pipeline: each source is a stage on its own thread, and
+ * every stage merges into the host table through add_discovered_host().
+ * The sources spend most of their time waiting on the network, so a
+ * discovery takes about as long as its slowest source, not the sum.
+ */
+typedef struct {
+    const char *name;
+    unsigned source;                  /* HOST_SOURCE_* bit its hosts carry */
+    selfstat_hist_t hist;             /* Where its run time is recorded */
+    int (*run)(void *arg);            /* Returns < 0 if the source was unavailable */
+    void *arg;
+    int rc;
+    int64_t elapsed_ms;
+    pthread_t thread;
+    int threaded;
+} discovery_stage_t;
+
+static int64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    /* Step 2: Active Connections (netstat) */
-    printf("\n--- Step 2: Checking Active Connections ---\n");
-    int before = discovered_count;
-    
-    FILE *fp = popen("ss -tn state established 2>/dev/null || netstat -tn 2>/dev/null | grep ESTABLISHED", "r");
-    if (fp != NULL) {
-        char result[512];
-        while (fgets(result, sizeof(result), fp) != NULL && discovered_count < MAX_DISCOVERED_HOSTS) {
-            char local_addr[64], remote_addr[64];
-            if (sscanf(result, "%*s %*s %*s %63s %63s", local_addr, remote_addr) >= 2) {
-                char *colon = strrchr(remote_addr, ':');
-                if (colon != NULL) {
-                    *colon = '\0';
-                    char *ip = remote_addr;
-                    if (strncmp(ip, "::ffff:", 7) == 0) ip += 7;
-                    
-                    if (validate_ip_string(ip) && strcmp(ip, "127.0.0.1") != 0) {
-                        int already_found = 0;
-                        for (int j = 0; j < discovered_count; j++) {
-                            if (strcmp(discovered_hosts[j].ip_address, ip) == 0) {
-                                already_found = 1;
-                                break;
-                            }
-                        }
-                        if (!already_found) {
-                            strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                            discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                            discovered_hosts[discovered_count].response_time_ms = 0;
-                            discovered_hosts[discovered_count].is_reachable = 1;
-                            discovered_count++;
-                        }
-                    }
-                }
-            }
+static void *stage_main(void *arg)
+{
+    discovery_stage_t *stage = arg;
+    uint64_t start = selfstat_now_us();
+
+    stage->rc = stage->run(stage->arg);
+    uint64_t elapsed_us = selfstat_now_us() - start;
+    stage->elapsed_ms = (int64_t)(elapsed_us / 1000);
+    selfstat_record(stage->hist, elapsed_us);
+    return NULL;
+}
+
+/* Start every stage, then wait for all; a stage without a thread runs inline */
+static void run_stages(discovery_stage_t *stages, int count)
+{
+    for (int i = 0; i < count; i++) {
+        stages[i].threaded = pthread_create(&stages[i].thread, NULL, stage_main, &stages[i]) == 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!stages[i].threaded) {
+            stage_main(&stages[i]);
         }
-        pclose(fp);
-    }
-    printf("Found %d new host(s) from active connections\n", discovered_count - before);
-
-    /* Step 3: Default Gateway */
-    printf("\n--- Step 3: Finding Default Gateway ---\n");
-    fp = popen("ip route | grep default | awk '{print $3}' 2>/dev/null || route -n | grep '^0.0.0.0' | awk '{print $2}'", "r");
-    if (fp != NULL) {
-        char gateway[MAX_IP_LEN];
-        if (fgets(gateway, sizeof(gateway), fp) != NULL) {
-            /* Remove newline */
-            size_t len = strlen(gateway);
-            if (len > 0 && gateway[len-1] == '\n') gateway[len-1] = '\0';
-            
-            if (validate_ip_string(gateway)) {
-                int already_found = 0;
-                for (int j = 0; j < discovered_count; j++) {
-                    if (strcmp(discovered_hosts[j].ip_address, gateway) == 0) {
-                        already_found = 1;
-                        break;
-                    }
-                }
-                if (!already_found) {
-                    printf("Default Gateway: %s\n", gateway);
-                    strncpy(discovered_hosts[discovered_count].ip_address, gateway, MAX_IP_LEN - 1);
-                    discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                    discovered_hosts[discovered_count].response_time_ms = 0;
-                    discovered_hosts[discovered_count].is_reachable = 1;
-                    discovered_count++;
-                }
-            }
+    }
+    for (int i = 0; i < count; i++) {
+        if (stages[i].threaded) {
+            pthread_join(stages[i].thread, NULL);
         }
-        pclose(fp);
     }
+}
 
-    /* Display all discovered hosts */
-    printf("\n=== Combined Discovery Results ===\n\n");
-    printf("Total unique hosts discovered: %d\n\n", discovered_count);
+static int count_with_source(unsigned source)
+{
+    int n = 0;
 
-    if (discovered_count > 0) {
-        printf("%-18s %s\n", "IP Address", "Discovery Method");
-        printf("%-18s %s\n", "----------", "----------------");
-        
-        for (int i = 0; i < discovered_count; i++) {
-            printf("%-18s %s\n", 
-                   discovered_hosts[i].ip_address,
-                   "ARP/Connection/Gateway");
+    pthread_mutex_lock(&discovered_lock);
+    for (int i = 0; i < discovered_count; i++) {
+        if (host_at(i)->sources & source) n++;
+    }
+    pthread_mutex_unlock(&discovered_lock);
+    return n;
+}
+
+/* Per-source host counts and times; a host found several ways counts for each */
+static void report_stages(const discovery_stage_t *stages, int count, int64_t elapsed_ms)
+{
+    report("%-20s %8s %10s\n", "Source", "Hosts", "Time");
+    report("%-20s %8s %10s\n", "------", "-----", "----");
+    for (int i = 0; i < count; i++) {
+        if (stages[i].rc < 0) {
+            report("%-20s %8s %7lld ms\n", stages[i].name, "n/a", (long long)stages[i].elapsed_ms);
+        } else {
+            report("%-20s %8d %7lld ms\n", stages[i].name, count_with_source(stages[i].source),
+                   (long long)stages[i].elapsed_ms);
         }
     }
+    report("%-20s %8d %7lld ms\n\n", "All (concurrent)", discovered_count, (long long)elapsed_ms);
+}
 
-    printf("\nNote: This method only finds hosts that:\n");
-    printf("- Have recently communicated with this machine (ARP)\n");
-    printf("- Currently have active connections\n");
-    printf("- Are in the routing path (gateway)\n");
-    printf("\nFor complete subnet discovery, use brute-force scan options.\n\n");
+/* "ARP+SNMP" style list of the sources that found a host */
+static const char *source_label(unsigned sources, char *buf, size_t size)
+{
+    size_t len = 0;
 
-    return discovered_count;
+    buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(host_source_names) / sizeof(host_source_names[0]); i++) {
+        if ((sources & (1u << i)) != 0 && len < size) {
+            len += (size_t)snprintf(buf + len, size - len, "%s%s", len > 0 ? "+" : "",
+                                    host_source_names[i]);
+        }
+    }
+    return buf;
 }
 
-/*
- * Get default gateway IP address
- * Returns 1 on success, 0 on failure
- */
-static int get_default_gateway(char *gateway, size_t gateway_size)
+/* Result table; call once every stage that adds hosts has finished */
+static void report_hosts_by_source(void)
 {
-    FILE *fp;
-    
-    fp = popen("ip route | grep default | awk '{print $3}' 2>/dev/null || route -n | grep '^0.0.0.0' | awk '{print $2}'", "r");
-    if (fp == NULL) {
-        return 0;
+    char label[64];
+
+    report("%-18s %s\n", "IP Address", "Source");
+    report("%-18s %s\n", "----------", "------");
+    for (int i = 0; i < discovered_count; i++) {
+        const discovered_host_t *h = host_at(i);
+        report("%-18s %s\n", h->ip_address, source_label(h->sources, label, sizeof(label)));
     }
-    
-    if (fgets(gateway, (int)gateway_size, fp) != NULL) {
-        /* Remove newline */
-        size_t len = strlen(gateway);
-        if (len > 0 && gateway[len-1] == '\n') gateway[len-1] = '\0';
-        pclose(fp);
-        return validate_ip_string(gateway);
+}
+
+static int stage_gateway(void *arg)
+{
+    char gateway[MAX_IP_LEN];
+
+    (void)arg;
+    if (!get_default_gateway(gateway, sizeof(gateway))) {
+        return -1;
     }
-    
-    pclose(fp);
-    return 0;
+    add_discovered_ip(gateway, 0, HOST_SOURCE_GATEWAY);
+    return 1;
+}
+
+static int stage_neighbor_cache(void *arg)
+{
+    int quiet = 0;
+
+    (void)arg;
+    return rtnl_neigh_foreach(arp_cache_cb, &quiet);
+}
+
+static int stage_connections(void *arg)
+{
+    int quiet = 0;
+
+    (void)arg;
+    return sock_diag_established(connection_cb, &quiet);
+}
+
+static int stage_inventory(void *arg)
+{
+    (void)arg;
+    return confirm_known_hosts(0, 0);
 }
 
 /*
- * Check if SNMP community string is valid
+ * Combined efficient discovery - uses all non-bruteforce methods
  */
-static int validate_community_string(const char *community)
+int discover_efficient(void)
 {
-    if (community == NULL || *community == '\0') return 0;
-    
-    for (const char *p = community; *p != '\0'; p++) {
-        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || 
-              (*p >= '0' && *p <= '9') || *p == '_' || *p == '-')) {
-            return 0;
-        }
+    discovery_stage_t stages[] = {
+        { "ARP cache", HOST_SOURCE_ARP, SELFSTAT_STAGE_ARP, stage_neighbor_cache, NULL, 0, 0, 0, 0 },
+        { "Connections", HOST_SOURCE_CONN, SELFSTAT_STAGE_CONN, stage_connections, NULL, 0, 0, 0, 0 },
+        { "Default gateway", HOST_SOURCE_GATEWAY, SELFSTAT_STAGE_GATEWAY, stage_gateway, NULL, 0, 0, 0, 0 },
+    };
+    int stage_count = (int)(sizeof(stages) / sizeof(stages[0]));
+
+    reset_discovered_hosts();
+
+    report("\n=== Efficient Network Discovery ===\n\n");
+    report("This combines multiple discovery methods WITHOUT brute-force scanning,\n");
+    report("run at the same time:\n");
+    report("1. ARP Cache - Hosts that recently communicated with us\n");
+    report("2. Active Connections - Hosts we currently have connections to\n");
+    report("3. Default Gateway - Network router/gateway\n\n");
+    report_flush();
+
+    int64_t start = monotonic_ms();
+    run_stages(stages, stage_count);
+    report_stages(stages, stage_count, monotonic_ms() - start);
+
+    /* Display all discovered hosts */
+    report("=== Combined Discovery Results ===\n\n");
+    report("Total unique hosts discovered: %d\n\n", discovered_count);
+
+    if (discovered_count > 0) {
+        report_hosts_by_source();
     }
-    return 1;
+
+    report("\nNote: This method only finds hosts that:\n");
+    report("- Have recently communicated with this machine (ARP)\n");
+    report("- Currently have active connections\n");
+    report("- Are in the routing path (gateway)\n");
+    report("\nFor complete subnet discovery, use brute-force scan options.\n\n");
+    commit_inventory();
+
+    return discovered_count;
 }
 
 /*
- * Try SNMP query with a specific community string
- * Returns number of hosts found, 0 if SNMP fails or no hosts
+ * Intern an LLDP/CDP string field, truncated to MAX_NEIGHBOR_NAME_LEN - 1
+ * and with bytes that would garble output replaced; caller holds
+ * discovered_lock
  */
-static int try_snmp_community(const char *router_ip, const char *community)
+static const char *intern_neighbor_field(const char *src, size_t len)
 {
-    char cmd[512];
-    FILE *fp;
-    char result[512];
-    int hosts_found = 0;
+    char buf[MAX_NEIGHBOR_NAME_LEN];
+    size_t n = len < sizeof(buf) - 1 ? len : sizeof(buf) - 1;
 
-    /* Validate inputs */
-    if (!validate_ip_string(router_ip)) {
-        return 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)src[i];
+        buf[i] = (c >= 0x20 && c < 0x7f) ? (char)c : '?';
     }
+    return string_pool_intern(&neighbor_strings, buf, n);
+}
 
-    if (!validate_community_string(community)) {
-        return 0;
+/*
+ * Passive listener callback - runs on the capture thread. Every
+ * advertised address becomes a host; LLDP/CDP advertisements also
+ * record which neighbor device and port the address belongs to.
+ */
+static void passive_collect_cb(const passive_event_t *ev, void *ctx)
+{
+    int32_t slot;
+
+    (void)ctx;
+    if (ev->addr == 0) {
+        return;
     }
+    add_discovered_host(ev->addr, 0, HOST_SOURCE_PASSIVE);
 
-    /* Try SNMP query - query ARP table */
-    snprintf(cmd, sizeof(cmd), 
-             "timeout 3 snmpwalk -v2c -c %s %s 1.3.6.1.2.1.4.22.1.3 2>/dev/null",
-             community, router_ip);
-    
-    fp = popen(cmd, "r");
-    if (fp == NULL) {
-        return 0;
+    if ((ev->source != PASSIVE_SOURCE_LLDP && ev->source != PASSIVE_SOURCE_CDP) ||
+        ev->name_len == 0) {
+        return;
     }
 
-    while (fgets(result, sizeof(result), fp) != NULL && discovered_count < MAX_DISCOVERED_HOSTS) {
-        /* Parse SNMP output - look for IP addresses */
-        char *ip_start = strstr(result, "IpAddress:");
-        if (ip_start != NULL) {
-            ip_start += 10;
-            while (*ip_start == ' ') ip_start++;
-            
-            char ip[MAX_IP_LEN];
-            if (sscanf(ip_start, "%15s", ip) == 1 && validate_ip_string(ip)) {
-                /* Check if already discovered */
-                int already_found = 0;
-                for (int j = 0; j < discovered_count; j++) {
-                    if (strcmp(discovered_hosts[j].ip_address, ip) == 0) {
-                        already_found = 1;
-                        break;
-                    }
-                }
-                
-                if (!already_found) {
-                    strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                    discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                    discovered_hosts[discovered_count].response_time_ms = 0;
-                    discovered_hosts[discovered_count].is_reachable = 1;
-                    discovered_count++;
-                    hosts_found++;
-                }
-            }
+    pthread_mutex_lock(&discovered_lock);
+    if (host_index_find(&discovered_index, ev->addr, &slot) && slot != HOST_INDEX_NO_SLOT) {
+        discovered_host_t *h = host_at(slot);
+        const char *name = intern_neighbor_field(ev->name, ev->name_len);
+        const char *port = intern_neighbor_field(ev->port, ev->port_len);
+        if (name != NULL && port != NULL) {
+            h->neighbor_name = name;
+            h->neighbor_port = port;
         }
     }
-
-    pclose(fp);
-    return hosts_found;
+    pthread_mutex_unlock(&discovered_lock);
 }
 
 /*
- * Discover next-hop routers from a router's routing table via SNMP
- * OID: 1.3.6.1.2.1.4.21.1.7 - ipRouteNextHop
- * Returns number of next-hop routers discovered
+ * Passive discovery - listen for ARP, LLDP and CDP for the given time
+ * Sends nothing; finds hosts and neighbor devices as they talk
+ * Returns the number of hosts heard, or -1 if capture is not permitted
  */
-static int discover_nexthop_routers(const char *router_ip, const char *community, 
-                                    char nexthops[][MAX_IP_LEN], int *nexthop_count, int max_nexthops)
+int discover_passive(int seconds)
 {
-    char cmd[512];
-    FILE *fp;
-    char result[512];
-    
-    *nexthop_count = 0;
+    passive_stats_t st;
 
-    if (!validate_ip_string(router_ip) || !validate_community_string(community)) {
-        return 0;
-    }
+    reset_discovered_hosts();
 
-    /* Query routing table for next-hop addresses */
-    snprintf(cmd, sizeof(cmd), 
-             "timeout 3 snmpwalk -v2c -c %s %s 1.3.6.1.2.1.4.21.1.7 2>/dev/null",
-             community, router_ip);
-    
-    fp = popen(cmd, "r");
-    if (fp == NULL) {
-        return 0;
+    report("\n=== Passive Discovery ===\n\n");
+    report("Listening for ARP, LLDP and CDP for %d second(s)...\n", seconds);
+    report("(No packets are sent)\n\n");
+    report_flush();
+
+    if (passive_start(NULL, passive_collect_cb, NULL) != NETMON_SUCCESS) {
+        report("Error: Could not open packet capture (need CAP_NET_RAW)\n");
+        return -1;
+    }
+    for (int i = 0; i < seconds; i++) {
+        sleep(1);
     }
+    passive_stop();
+    passive_get_stats(&st);
 
-    while (fgets(result, sizeof(result), fp) != NULL && *nexthop_count < max_nexthops) {
-        /* Parse SNMP output for next-hop IP addresses */
-        char *ip_start = strstr(result, "IpAddress:");
-        if (ip_start != NULL) {
-            ip_start += 10;
-            while (*ip_start == ' ') ip_start++;
-            
-            char ip[MAX_IP_LEN];
-            if (sscanf(ip_start, "%15s", ip) == 1 && validate_ip_string(ip)) {
-                /* Skip 0.0.0.0 (directly connected routes) and our own IP */
-                if (strcmp(ip, "0.0.0.0") == 0) continue;
-                
-                /* Check if it's a valid private IP (another router) */
-                int octets[4];
-                parse_ip(ip, octets);
-                int is_private = (octets[0] == 10) || 
-                                 (octets[0] == 172 && octets[1] >= 16 && octets[1] <= 31) ||
-                                 (octets[0] == 192 && octets[1] == 168);
-                
-                if (!is_private) continue;
-                
-                /* Check if already in nexthops list or same as queried router */
-                if (strcmp(ip, router_ip) == 0) continue;
-                
-                int already_found = 0;
-                for (int j = 0; j < *nexthop_count; j++) {
-                    if (strcmp(nexthops[j], ip) == 0) {
-                        already_found = 1;
-                        break;
-                    }
-                }
-                
-                if (!already_found) {
-                    strncpy(nexthops[*nexthop_count], ip, MAX_IP_LEN - 1);
-                    nexthops[*nexthop_count][MAX_IP_LEN - 1] = '\0';
-                    (*nexthop_count)++;
-                }
-            }
+    int count = discovered_count;
+    report("%-18s %s\n", "IP Address", "Neighbor (port)");
+    report("%-18s %s\n", "----------", "---------------");
+    for (int i = 0; i < count; i++) {
+        char name[MAX_NEIGHBOR_NAME_LEN], port[MAX_NEIGHBOR_NAME_LEN];
+        if (get_discovered_neighbor(i, name, sizeof(name), port, sizeof(port)) == 0) {
+            report("%-18s %s (%s)\n", host_at(i)->ip_address, name, port);
+        } else {
+            report("%-18s -\n", host_at(i)->ip_address);
         }
     }
 
-    pclose(fp);
-    return *nexthop_count;
+    report("\n=== Results ===\n");
+    report("Heard %llu frame(s): %llu ARP, %llu LLDP, %llu CDP\n",
+           (unsigned long long)st.frames, (unsigned long long)st.arp,
+           (unsigned long long)st.lldp, (unsigned long long)st.cdp);
+    report("Found %d host(s)\n\n", count);
+
+    return count;
 }
 
 /*
- * Discover router interfaces via SNMP
- * OID: 1.3.6.1.2.1.4.20.1.1 - ipAdEntAddr (IP addresses configured on router interfaces)
- * Returns number of interfaces discovered
+ * Router crawl results become discovered hosts; the router each was
+ * learned behind is kept for alert correlation
  */
-static int discover_router_interfaces(const char *router_ip, const char *community,
-                                     char interfaces[][MAX_IP_LEN], int *iface_count, int max_ifaces)
+static void crawl_collect_cb(uint32_t addr, crawl_source_t source, uint32_t via, void *ctx)
 {
-    char cmd[512];
-    FILE *fp;
-    char result[512];
-    
-    *iface_count = 0;
-
-    if (!validate_ip_string(router_ip) || !validate_community_string(community)) {
-        return 0;
+    (void)ctx;
+    add_discovered_host(addr, 0, HOST_SOURCE_SNMP);
+    if (source == CRAWL_SOURCE_ROUTER) {
+        inventory_touch_host(addr, 0, INVENTORY_FLAG_ROUTER, time(NULL));
+    }
+    if (source != CRAWL_SOURCE_INTERFACE && via != 0) {
+        if (source == CRAWL_SOURCE_ARP) {
+            inventory_touch_host(addr, 0, 0, time(NULL));
+        }
+        inventory_set_upstream(addr, via);
     }
+}
 
-    /* Query router interface IP addresses */
-    snprintf(cmd, sizeof(cmd), 
-             "timeout 3 snmpwalk -v2c -c %s %s 1.3.6.1.2.1.4.20.1.1 2>/dev/null",
-             community, router_ip);
-    
-    fp = popen(cmd, "r");
-    if (fp == NULL) {
-        return 0;
-    }
+/* SNMP crawl stage input and result */
+typedef struct {
+    uint32_t gateway;                 /* Seed router, 0 if none */
+    crawl_stats_t stats;
+} crawl_stage_t;
 
-    while (fgets(result, sizeof(result), fp) != NULL && *iface_count < max_ifaces) {
-        /* Parse SNMP output for interface IP addresses */
-        char *ip_start = strstr(result, "IpAddress:");
-        if (ip_start != NULL) {
-            ip_start += 10;
-            while (*ip_start == ' ') ip_start++;
-            
-            char ip[MAX_IP_LEN];
-            if (sscanf(ip_start, "%15s", ip) == 1 && validate_ip_string(ip)) {
-                /* Skip loopback addresses */
-                if (strncmp(ip, "127.", 4) == 0) continue;
-                
-                /* Check if already in list */
-                int already_found = 0;
-                for (int j = 0; j < *iface_count; j++) {
-                    if (strcmp(interfaces[j], ip) == 0) {
-                        already_found = 1;
-                        break;
-                    }
-                }
-                
-                if (!already_found) {
-                    strncpy(interfaces[*iface_count], ip, MAX_IP_LEN - 1);
-                    interfaces[*iface_count][MAX_IP_LEN - 1] = '\0';
-                    (*iface_count)++;
-                }
-            }
-        }
+/*
+ * Crawl from the gateway and the routers recorded in the inventory
+ * (queried immediately instead of waiting to be re-found)
+ * Returns the number of routers that answered SNMP, or -1
+ */
+static int stage_snmp_crawl(void *arg)
+{
+    /* Common SNMP community strings to try */
+    static const char *const communities[] = {"abc", "public", "private", "community", "cisco", NULL};
+    crawl_stage_t *crawl = arg;
+    crawl_config_t cfg;
+    int rc = -1;
+
+    int seed_max = inventory_host_count() + 1;
+    uint32_t *seeds = malloc((size_t)seed_max * sizeof(*seeds));
+    if (seeds == NULL) {
+        return -1;
     }
+    int seed_count = 0;
+    if (crawl->gateway != 0) {
+        seeds[seed_count++] = crawl->gateway;
+    }
+    seed_count += inventory_list_hosts(time(NULL) - INVENTORY_DEFAULT_MAX_AGE_S, INVENTORY_FLAG_ROUTER,
+                                       seeds + seed_count, seed_max - seed_count);
 
-    pclose(fp);
-    return *iface_count;
+    crawl_config_default(&cfg);
+    cfg.verbose = discovery_verbose;
+    cred_cache_load(CRED_CACHE_DEFAULT_PATH);
+    if (seed_count > 0) {
+        rc = router_crawl(&cfg, seeds, seed_count, communities, crawl_collect_cb, NULL, &crawl->stats);
+    }
+    if (cred_cache_save(CRED_CACHE_DEFAULT_PATH) != NETMON_SUCCESS) {
+        report("Warning: Could not save SNMP credentials to %s\n", CRED_CACHE_DEFAULT_PATH);
+    }
+    free(seeds);
+    return rc;
 }
 
 /*
  * Fully automatic network discovery
- * Discovers everything without requiring any user input:
- * 1. Finds default gateway automatically
- * 2. Tries SNMP with common community strings on gateway
- * 3. Uses SNMP to discover router interfaces and next-hop routers (better than traceroute!)
- * 4. Queries SNMP on discovered routers to find hosts in other subnets
- * 5. Falls back to ARP + connections if SNMP fails
+ * Discovers everything without requiring any user input. These sources
+ * run concurrently and merge into one host table:
+ * - SNMP crawl from the default gateway and known routers: interfaces,
+ *   next hops and ARP tables, across subnets
+ * - Ping sweep of hosts from the last inventory
+ * - Local ARP cache
+ * - Active connections
+ * A passive ARP/LLDP/CDP listener runs for the whole discovery when
+ * packet capture is permitted.
  */
 int discover_automatic(void)
 {
-    char gateway[MAX_IP_LEN];
-    char routers_to_query[MAX_HOPS][MAX_IP_LEN];
-    int routers_queried = 0;
-    int routers_to_check = 0;
-    char working_community[64] = "";
-    int snmp_success = 0;
-    int total_hosts = 0;
-    
-    /* Common SNMP community strings to try */
-    const char *communities[] = {"abc", "public", "private", "community", "cisco", NULL};
-    
-    discovered_count = 0;
+    char gateway[MAX_IP_LEN] = "";
+    crawl_stage_t crawl;
+    discovery_stage_t stages[] = {
+        { "SNMP router crawl", HOST_SOURCE_SNMP, SELFSTAT_STAGE_SNMP, stage_snmp_crawl, &crawl, 0, 0, 0, 0 },
+        { "Known hosts (ICMP)", HOST_SOURCE_PING, SELFSTAT_STAGE_PING, stage_inventory, NULL, 0, 0, 0, 0 },
+        { "ARP cache", HOST_SOURCE_ARP, SELFSTAT_STAGE_ARP, stage_neighbor_cache, NULL, 0, 0, 0, 0 },
+        { "Connections", HOST_SOURCE_CONN, SELFSTAT_STAGE_CONN, stage_connections, NULL, 0, 0, 0, 0 },
+    };
+    int stage_count = (int)(sizeof(stages) / sizeof(stages[0]));
 
-    printf("\n");
-    printf("============================================\n");
-    printf("     AUTOMATIC NETWORK DISCOVERY           \n");
-    printf("============================================\n\n");
-    printf("Discovering all reachable hosts automatically...\n");
-    printf("Including hosts in OTHER SUBNETS across routers!\n");
-    printf("No configuration required!\n\n");
+    reset_discovered_hosts();
+    memset(&crawl, 0, sizeof(crawl));
 
-    /* Step 1: Get default gateway */
-    printf("--- Step 1: Finding Default Gateway ---\n");
-    if (!get_default_gateway(gateway, sizeof(gateway))) {
-        printf("Warning: Could not detect default gateway\n");
-        printf("Falling back to ARP-only discovery...\n\n");
-        goto arp_fallback;
-    }
-    printf("Default Gateway: %s\n\n", gateway);
-
-    /* Add gateway to routers to query */
-    strncpy(routers_to_query[routers_to_check], gateway, MAX_IP_LEN - 1);
-    routers_to_query[routers_to_check][MAX_IP_LEN - 1] = '\0';
-    routers_to_check++;
-
-    /* Add gateway to discovered hosts */
-    strncpy(discovered_hosts[discovered_count].ip_address, gateway, MAX_IP_LEN - 1);
-    discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-    discovered_hosts[discovered_count].response_time_ms = 0;
-    discovered_hosts[discovered_count].is_reachable = 1;
-    discovered_count++;
-
-    /* Step 2: Query routers using SNMP (iteratively discover more routers) */
-    printf("--- Step 2: Discovering Routers and Hosts via SNMP ---\n");
-    printf("Using SNMP to query router interfaces, routing tables, and ARP tables...\n");
-    printf("This method discovers ALL connected networks, not just the ones facing us!\n\n");
-    
-    while (routers_queried < routers_to_check && routers_queried < MAX_HOPS) {
-        char *current_router = routers_to_query[routers_queried];
-        int found_community = 0;
-        
-        printf("Querying Router %d: %s\n", routers_queried + 1, current_router);
-        
-        /* Try each community string */
-        for (int i = 0; communities[i] != NULL && !found_community; i++) {
-            printf("  Trying community '%s'... ", communities[i]);
-            fflush(stdout);
-            
-            /* First try to get router interfaces */
-            char interfaces[MAX_HOPS][MAX_IP_LEN];
-            int iface_count = 0;
-            discover_router_interfaces(current_router, communities[i], interfaces, &iface_count, MAX_HOPS);
-            
-            if (iface_count > 0) {
-                printf("SUCCESS!\n");
-                found_community = 1;
-                snmp_success = 1;
-                strncpy(working_community, communities[i], sizeof(working_community) - 1);
-                working_community[sizeof(working_community) - 1] = '\0';
-                
-                /* Add all router interfaces to discovered hosts */
-                printf("  Router interfaces found: %d\n", iface_count);
-                for (int j = 0; j < iface_count && discovered_count < MAX_DISCOVERED_HOSTS; j++) {
-                    printf("    Interface: %s\n", interfaces[j]);
-                    
-                    /* Check if already discovered */
-                    int already_found = 0;
-                    for (int k = 0; k < discovered_count; k++) {
-                        if (strcmp(discovered_hosts[k].ip_address, interfaces[j]) == 0) {
-                            already_found = 1;
-                            break;
-                        }
-                    }
-                    if (!already_found) {
-                        strncpy(discovered_hosts[discovered_count].ip_address, interfaces[j], MAX_IP_LEN - 1);
-                        discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                        discovered_hosts[discovered_count].response_time_ms = 0;
-                        discovered_hosts[discovered_count].is_reachable = 1;
-                        discovered_count++;
-                    }
-                }
-                
-                /* Get next-hop routers from routing table */
-                char nexthops[MAX_HOPS][MAX_IP_LEN];
-                int nexthop_count = 0;
-                discover_nexthop_routers(current_router, communities[i], nexthops, &nexthop_count, MAX_HOPS);
-                
-                if (nexthop_count > 0) {
-                    printf("  Next-hop routers found: %d\n", nexthop_count);
-                    for (int j = 0; j < nexthop_count; j++) {
-                        printf("    Next-hop: %s\n", nexthops[j]);
-                        
-                        /* Add to routers to query if not already in list */
-                        int already_in_list = 0;
-                        for (int k = 0; k < routers_to_check; k++) {
-                            if (strcmp(routers_to_query[k], nexthops[j]) == 0) {
-                                already_in_list = 1;
-                                break;
-                            }
-                        }
-                        if (!already_in_list && routers_to_check < MAX_HOPS) {
-                            strncpy(routers_to_query[routers_to_check], nexthops[j], MAX_IP_LEN - 1);
-                            routers_to_query[routers_to_check][MAX_IP_LEN - 1] = '\0';
-                            routers_to_check++;
-                        }
-                        
-                        /* Also add next-hop to discovered hosts */
-                        int already_found = 0;
-                        for (int k = 0; k < discovered_count; k++) {
-                            if (strcmp(discovered_hosts[k].ip_address, nexthops[j]) == 0) {
-                                already_found = 1;
-                                break;
-                            }
-                        }
-                        if (!already_found && discovered_count < MAX_DISCOVERED_HOSTS) {
-                            strncpy(discovered_hosts[discovered_count].ip_address, nexthops[j], MAX_IP_LEN - 1);
-                            discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                            discovered_hosts[discovered_count].response_time_ms = 0;
-                            discovered_hosts[discovered_count].is_reachable = 1;
-                            discovered_count++;
-                        }
-                    }
-                }
-                
-                /* Get hosts from ARP table */
-                int arp_hosts = try_snmp_community(current_router, communities[i]);
-                if (arp_hosts > 0) {
-                    printf("  Hosts in ARP table: %d\n", arp_hosts);
-                }
-            } else {
-                printf("no response\n");
-            }
-        }
-        
-        if (!found_community) {
-            printf("  No SNMP access (router may use different credentials)\n");
-        }
-        
-        printf("\n");
-        routers_queried++;
+    report("\n");
+    report("============================================\n");
+    report("     AUTOMATIC NETWORK DISCOVERY           \n");
+    report("============================================\n\n");
+    report("Discovering all reachable hosts automatically...\n");
+    report("Including hosts in OTHER SUBNETS across routers!\n");
+    report("No configuration required!\n\n");
+
+    int passive = passive_start(NULL, passive_collect_cb, NULL) == NETMON_SUCCESS;
+    if (passive) {
+        report("Passive ARP/LLDP/CDP listener running during discovery\n\n");
     }
 
-    if (!snmp_success) {
-        printf("SNMP not available on any router.\n");
-        printf("Routers may not support SNMP or use different credentials.\n");
-        printf("Continuing with local discovery methods...\n");
+    /* Loaded before the stages start; they only read it */
+    load_inventory();
+
+    if (get_default_gateway(gateway, sizeof(gateway))) {
+        report("Default Gateway: %s\n\n", gateway);
+        add_discovered_ip(gateway, 0, HOST_SOURCE_GATEWAY);
+        parse_ip_addr(gateway, &crawl.gateway);
     } else {
-        printf("Total routers queried: %d\n\n", routers_queried);
+        report("Warning: Could not detect default gateway\n");
+        report("Crawling known routers only\n\n");
     }
 
-arp_fallback:
-    /* Step 3: Local ARP cache */
-    printf("--- Step 3: Checking Local ARP Cache ---\n");
-    
-    FILE *fp = popen("ip neigh show 2>/dev/null || arp -a 2>/dev/null", "r");
-    if (fp != NULL) {
-        char result[512];
-        char ip[MAX_IP_LEN];
-        char iface[32];
-        char mac[32];
-        char state[32] = "";
-        int arp_count = 0;
-        
-        while (fgets(result, sizeof(result), fp) != NULL && discovered_count < MAX_DISCOVERED_HOSTS) {
-            if (sscanf(result, "%15s dev %31s lladdr %31s %31s", ip, iface, mac, state) >= 3) {
-                if (validate_ip_string(ip) && strcmp(state, "FAILED") != 0) {
-                    /* Check if already discovered */
-                    int already_found = 0;
-                    for (int j = 0; j < discovered_count; j++) {
-                        if (strcmp(discovered_hosts[j].ip_address, ip) == 0) {
-                            already_found = 1;
-                            break;
-                        }
-                    }
-                    if (!already_found) {
-                        strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                        discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                        discovered_hosts[discovered_count].response_time_ms = 0;
-                        discovered_hosts[discovered_count].is_reachable = 1;
-                        discovered_count++;
-                        arp_count++;
-                    }
-                }
-            }
-            else if (sscanf(result, "%*s (%15[^)]) at %31s", ip, mac) >= 2) {
-                if (validate_ip_string(ip) && strcmp(mac, "<incomplete>") != 0) {
-                    int already_found = 0;
-                    for (int j = 0; j < discovered_count; j++) {
-                        if (strcmp(discovered_hosts[j].ip_address, ip) == 0) {
-                            already_found = 1;
-                            break;
-                        }
-                    }
-                    if (!already_found) {
-                        strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                        discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                        discovered_hosts[discovered_count].response_time_ms = 0;
-                        discovered_hosts[discovered_count].is_reachable = 1;
-                        discovered_count++;
-                        arp_count++;
-                    }
-                }
-            }
-        }
-        pclose(fp);
-        printf("Found %d hosts in local ARP cache\n", arp_count);
-    }
+    report("Querying routers via SNMP, pinging known hosts and reading local\n");
+    report("ARP and connection tables at the same time...\n\n");
+    report_flush();
 
-    /* Step 4: Active connections */
-    printf("\n--- Step 4: Checking Active Network Connections ---\n");
-    
-    fp = popen("ss -tn state established 2>/dev/null || netstat -tn 2>/dev/null | grep ESTABLISHED", "r");
-    if (fp != NULL) {
-        char result[512];
-        int conn_count = 0;
-        
-        while (fgets(result, sizeof(result), fp) != NULL && discovered_count < MAX_DISCOVERED_HOSTS) {
-            char local_addr[64], remote_addr[64];
-            if (sscanf(result, "%*s %*s %*s %63s %63s", local_addr, remote_addr) >= 2) {
-                char *colon = strrchr(remote_addr, ':');
-                if (colon != NULL) {
-                    *colon = '\0';
-                    char *ip = remote_addr;
-                    if (strncmp(ip, "::ffff:", 7) == 0) ip += 7;
-                    
-                    if (validate_ip_string(ip) && strcmp(ip, "127.0.0.1") != 0) {
-                        int already_found = 0;
-                        for (int j = 0; j < discovered_count; j++) {
-                            if (strcmp(discovered_hosts[j].ip_address, ip) == 0) {
-                                already_found = 1;
-                                break;
-                            }
-                        }
-                        if (!already_found) {
-                            strncpy(discovered_hosts[discovered_count].ip_address, ip, MAX_IP_LEN - 1);
-                            discovered_hosts[discovered_count].ip_address[MAX_IP_LEN - 1] = '\0';
-                            discovered_hosts[discovered_count].response_time_ms = 0;
-                            discovered_hosts[discovered_count].is_reachable = 1;
-                            discovered_count++;
-                            conn_count++;
-                        }
-                    }
-                }
-            }
-        }
-        pclose(fp);
-        printf("Found %d hosts with active connections\n", conn_count);
+    int64_t start = monotonic_ms();
+    run_stages(stages, stage_count);
+    int64_t elapsed = monotonic_ms() - start;
+    int snmp_success = stages[0].rc > 0;
+
+    if (passive) {
+        passive_stats_t st;
+        passive_stop();
+        passive_get_stats(&st);
+        report("\nPassive listener heard %llu ARP, %llu LLDP and %llu CDP frame(s)\n",
+               (unsigned long long)st.arp, (unsigned long long)st.lldp,
+               (unsigned long long)st.cdp);
+    }
+    report("\n");
+    if (snmp_success) {
+        report("Total routers queried: %d (%d answered SNMP)\n\n",
+               crawl.stats.routers_seen, crawl.stats.routers_snmp);
     }
+    report_stages(stages, stage_count, elapsed);
 
-    total_hosts = discovered_count;
+    int total_hosts = discovered_count;
 
     /* Final Results */
-    printf("\n");
-    printf("============================================\n");
-    printf("          DISCOVERY RESULTS                \n");
-    printf("============================================\n\n");
+    report("============================================\n");
+    report("          DISCOVERY RESULTS                \n");
+    report("============================================\n\n");
     
-    printf("Total unique hosts discovered: %d\n\n", total_hosts);
+    report("Total unique hosts discovered: %d\n\n", total_hosts);
 
     if (total_hosts > 0) {
-        printf("%-18s %s\n", "IP Address", "Source");
-        printf("%-18s %s\n", "----------", "------");
-        
-        for (int i = 0; i < discovered_count; i++) {
-            printf("%-18s %s\n", 
-                   discovered_hosts[i].ip_address,
-                   (i == 0 && gateway[0]) ? "Gateway" : 
-                   (snmp_success ? "Router ARP/Local" : "Local ARP/Conn"));
-        }
+        report_hosts_by_source();
     }
 
-    printf("\n");
+    report("\n");
     if (snmp_success) {
-        printf("SUCCESS: SNMP discovery worked - showing hosts from router(s) ARP table(s)\n");
-        printf("         This includes hosts from ALL subnets the router(s) know about.\n");
+        report("SUCCESS: SNMP discovery worked - showing hosts from router(s) ARP table(s)\n");
+        report("         This includes hosts from ALL subnets the router(s) know about.\n");
     } else {
-        printf("NOTE: SNMP was not available on any discovered router.\n");
-        printf("      Only showing hosts this machine has directly communicated with.\n");
-        printf("      To discover more hosts, ensure SNMP is enabled on your routers\n");
-        printf("      with community string 'abc' or configure appropriately.\n");
+        report("NOTE: SNMP was not available on any discovered router.\n");
+        report("      Only showing hosts this machine has directly communicated with.\n");
+        report("      To discover more hosts, ensure SNMP is enabled on your routers\n");
+        report("      with community string 'abc' or configure appropriately.\n");
     }
-    printf("\n");
+    report("\n");
+    commit_inventory();
 
     return total_hosts;
 }
@@ -1551,9 +1712,9 @@ int discover_custom_subnet(const char *subnet_cidr)
     char network[MAX_IP_LEN];
     int prefix_len = 24;  /* Default */
     
-    discovered_count = 0;
+    reset_discovered_hosts();
 
-    printf("\n=== Custom Subnet Discovery ===\n\n");
+    report("\n=== Custom Subnet Discovery ===\n\n");
 
     /* Parse CIDR notation (e.g., "192.168.2.0/24") */
     const char *slash = strchr(subnet_cidr, '/');
@@ -1567,13 +1728,13 @@ int discover_custom_subnet(const char *subnet_cidr)
         char *endptr;
         long parsed_prefix = strtol(slash + 1, &endptr, 10);
         if (*endptr != '\0' && *endptr != '\n' && *endptr != ' ') {
-            printf("Error: Invalid prefix length format\n");
+            report("Error: Invalid prefix length format\n");
             return -1;
         }
         prefix_len = (int)parsed_prefix;
         
-        if (prefix_len < 16 || prefix_len > 30) {
-            printf("Error: Prefix length must be between 16 and 30\n");
+        if (endptr == slash + 1 || prefix_len < 1 || prefix_len > 32) {
+            report("Error: Prefix length must be between 1 and 32\n");
             return -1;
         }
     } else {
@@ -1583,28 +1744,28 @@ int discover_custom_subnet(const char *subnet_cidr)
 
     /* Validate network address */
     if (!validate_ip_string(network)) {
-        printf("Error: Invalid network address\n");
+        report("Error: Invalid network address\n");
         return -1;
     }
 
-    printf("Scanning subnet: %s/%d\n", network, prefix_len);
+    report("Scanning subnet: %s/%d\n", network, prefix_len);
     
     int found = scan_subnet(network, prefix_len);
 
-    printf("\n=== Results ===\n");
-    printf("Found %d reachable host(s) in %s/%d\n\n", found, network, prefix_len);
+    report("\n=== Results ===\n");
+    report("Found %d reachable host(s) in %s/%d\n\n", found, network, prefix_len);
 
     if (discovered_count > 0) {
-        printf("%-18s %s\n", "IP Address", "Response Time");
-        printf("%-18s %s\n", "----------", "-------------");
+        report("%-18s %s\n", "IP Address", "Response Time");
+        report("%-18s %s\n", "----------", "-------------");
         
         for (int i = 0; i < discovered_count; i++) {
-            printf("%-18s %d ms\n", 
-                   discovered_hosts[i].ip_address,
-                   discovered_hosts[i].response_time_ms);
+            report("%-18s %d ms\n", 
+                   host_at(i)->ip_address,
+                   host_at(i)->response_time_ms);
         }
     }
 
-    printf("\n");
+    report("\n");
     return found;
 }
@@ -0,0 +1,495 @@
+/*
+ * Passive Listener
+ * TPACKET_V3 capture of ARP, LLDP and CDP frames. A classic BPF program
+ * attached before bind() keeps everything else in the kernel; the
+ * capture thread walks retired ring blocks and decodes frames where
+ * they lie.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "passive.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
+#define ETH_HEADER_LEN 14
+#define ETHERTYPE_ARP 0x0806
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_LLDP 0x88cc
+#define ARP_PAYLOAD_LEN 28
+
+/* 802.2 LLC/SNAP header announcing CDP: AA AA 03, OUI 00:00:0C, PID 0x2000 */
+#define CDP_SNAP_WORD0 0xaaaa0300u
+#define CDP_SNAP_WORD1 0x000c2000u
+#define CDP_SNAP_LEN 8
+#define CDP_HEADER_LEN 4
+
+/* LLDP TLV types (IEEE 802.1AB) */
+#define LLDP_TLV_END 0
+#define LLDP_TLV_CHASSIS_ID 1
+#define LLDP_TLV_PORT_ID 2
+#define LLDP_TLV_SYSTEM_NAME 5
+#define LLDP_TLV_MGMT_ADDR 8
+#define LLDP_CHASSIS_LOCAL 7
+#define LLDP_MGMT_ADDR_IPV4 1
+
+/* CDP TLV types */
+#define CDP_TLV_DEVICE_ID 0x0001
+#define CDP_TLV_ADDRESSES 0x0002
+#define CDP_TLV_PORT_ID 0x0003
+#define CDP_TLV_MGMT_ADDRESSES 0x0016
+
+/* Capture thread poll period, bounds passive_stop() latency */
+#define PASSIVE_POLL_MS 100
+
+/*
+ * ldh [12]; ARP or LLDP ethertype -> accept; a length field (<= 1500)
+ * followed by the CDP SNAP header -> accept; else drop
+ */
+static struct sock_filter capture_filter[] = {
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETHERTYPE_ARP, 6, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETHERTYPE_LLDP, 5, 0),
+    BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, ETH_DATA_LEN, 5, 0),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ETH_HEADER_LEN),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, CDP_SNAP_WORD0, 0, 3),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ETH_HEADER_LEN + 4),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, CDP_SNAP_WORD1, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, 0xffff),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+/* Capture state; owned by passive_start()/passive_stop() */
+static struct {
+    int fd;
+    uint8_t *ring;
+    size_t ring_size;
+    unsigned int block_size;
+    unsigned int block_count;
+    passive_event_cb cb;
+    void *ctx;
+    pthread_t thread;
+    volatile int stop;
+    int running;
+} cap = { .fd = -1 };
+
+static pthread_mutex_t cap_lock = PTHREAD_MUTEX_INITIALIZER;
+static passive_stats_t stats;
+
+#define STAT_INC(field) __atomic_fetch_add(&stats.field, 1, __ATOMIC_RELAXED)
+
+void passive_config_default(passive_config_t *cfg)
+{
+    cfg->ifname = NULL;
+    cfg->block_size = PASSIVE_DEFAULT_BLOCK_SIZE;
+    cfg->block_count = PASSIVE_DEFAULT_BLOCK_COUNT;
+    cfg->block_timeout_ms = PASSIVE_DEFAULT_BLOCK_TIMEOUT_MS;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* ------------------------------------------------------------------ */
+/* Frame decoders; each gets the frame from the Ethernet header on    */
+/* ------------------------------------------------------------------ */
+
+static void decode_arp(const uint8_t *frame, size_t len, passive_event_t *ev)
+{
+    const uint8_t *arp = frame + ETH_HEADER_LEN;
+
+    STAT_INC(arp);
+    if (len < ETH_HEADER_LEN + ARP_PAYLOAD_LEN ||
+        get16(arp) != 1 || get16(arp + 2) != ETHERTYPE_IPV4 || arp[4] != 6 || arp[5] != 4) {
+        STAT_INC(malformed);
+        return;
+    }
+
+    uint32_t spa = get32(arp + 14);
+    uint32_t tpa = get32(arp + 24);
+    if (spa == 0) {
+        return;   /* ARP probe (RFC 5227): the address is not claimed yet */
+    }
+
+    memcpy(ev->mac, arp + 8, 6);
+    ev->addr = spa;
+    ev->source = spa == tpa ? PASSIVE_SOURCE_GARP : PASSIVE_SOURCE_ARP;
+    cap.cb(ev, cap.ctx);
+}
+
+static void decode_lldp(const uint8_t *frame, size_t len, passive_event_t *ev)
+{
+    const uint8_t *p = frame + ETH_HEADER_LEN;
+    const uint8_t *end = frame + len;
+    const char *chassis = NULL;
+    size_t chassis_len = 0;
+
+    STAT_INC(lldp);
+    while (p + 2 <= end) {
+        unsigned int type = p[0] >> 1;
+        size_t tlv_len = (size_t)(((p[0] & 1) << 8) | p[1]);
+        const uint8_t *v = p + 2;
+
+        if (v + tlv_len > end) {
+            STAT_INC(malformed);
+            return;
+        }
+        if (type == LLDP_TLV_END) {
+            break;
+        }
+
+        switch (type) {
+        case LLDP_TLV_CHASSIS_ID:
+            if (tlv_len > 1 && v[0] == LLDP_CHASSIS_LOCAL) {
+                chassis = (const char *)v + 1;
+                chassis_len = tlv_len - 1;
+            }
+            break;
+        case LLDP_TLV_PORT_ID:
+            if (tlv_len > 1) {
+                ev->port = (const char *)v + 1;
+                ev->port_len = tlv_len - 1;
+            }
+            break;
+        case LLDP_TLV_SYSTEM_NAME:
+            ev->name = (const char *)v;
+            ev->name_len = tlv_len;
+            break;
+        case LLDP_TLV_MGMT_ADDR:
+            /* addr string length (incl. subtype), subtype, address */
+            if (ev->addr == 0 && tlv_len >= 6 && v[0] == 5 && v[1] == LLDP_MGMT_ADDR_IPV4) {
+                ev->addr = get32(v + 2);
+            }
+            break;
+        default:
+            break;
+        }
+        p = v + tlv_len;
+    }
+
+    if (ev->name == NULL) {
+        ev->name = chassis;
+        ev->name_len = chassis_len;
+    }
+    memcpy(ev->mac, frame + 6, 6);
+    ev->source = PASSIVE_SOURCE_LLDP;
+    cap.cb(ev, cap.ctx);
+}
+
+/* First IPv4 address in a CDP address list TLV value, or 0 */
+static uint32_t cdp_first_ipv4(const uint8_t *v, size_t len)
+{
+    const uint8_t *end = v + len;
+
+    if (len < 4) {
+        return 0;
+    }
+    uint32_t count = get32(v);
+    v += 4;
+
+    for (uint32_t i = 0; i < count && v + 2 <= end; i++) {
+        uint8_t proto_type = v[0];
+        size_t proto_len = v[1];
+        const uint8_t *proto = v + 2;
+
+        if (proto + proto_len + 2 > end) {
+            break;
+        }
+        size_t addr_len = get16(proto + proto_len);
+        const uint8_t *addr = proto + proto_len + 2;
+        if (addr + addr_len > end) {
+            break;
+        }
+        /* NLPID type, protocol 0xCC = IP */
+        if (proto_type == 1 && proto_len == 1 && proto[0] == 0xcc && addr_len == 4) {
+            return get32(addr);
+        }
+        v = addr + addr_len;
+    }
+    return 0;
+}
+
+static void decode_cdp(const uint8_t *frame, size_t len, passive_event_t *ev)
+{
+    const uint8_t *p = frame + ETH_HEADER_LEN + CDP_SNAP_LEN + CDP_HEADER_LEN;
+    const uint8_t *end = frame + len;
+    uint32_t mgmt = 0;
+
+    STAT_INC(cdp);
+    if (p > end) {
+        STAT_INC(malformed);
+        return;
+    }
+    /* 802.3 length field bounds the frame; trailing padding is ignored */
+    size_t frame_len = get16(frame + 12);
+    if (ETH_HEADER_LEN + frame_len < len) {
+        end = frame + ETH_HEADER_LEN + frame_len;
+    }
+
+    while (p + 4 <= end) {
+        uint16_t type = get16(p);
+        size_t tlv_len = get16(p + 2);
+
+        if (tlv_len < 4 || p + tlv_len > end) {
+            STAT_INC(malformed);
+            return;
+        }
+        const uint8_t *v = p + 4;
+        size_t vlen = tlv_len - 4;
+
+        switch (type) {
+        case CDP_TLV_DEVICE_ID:
+            ev->name = (const char *)v;
+            ev->name_len = vlen;
+            break;
+        case CDP_TLV_PORT_ID:
+            ev->port = (const char *)v;
+            ev->port_len = vlen;
+            break;
+        case CDP_TLV_ADDRESSES:
+            if (ev->addr == 0) ev->addr = cdp_first_ipv4(v, vlen);
+            break;
+        case CDP_TLV_MGMT_ADDRESSES:
+            if (mgmt == 0) mgmt = cdp_first_ipv4(v, vlen);
+            break;
+        default:
+            break;
+        }
+        p += tlv_len;
+    }
+
+    if (mgmt != 0) {
+        ev->addr = mgmt;
+    }
+    memcpy(ev->mac, frame + 6, 6);
+    ev->source = PASSIVE_SOURCE_CDP;
+    cap.cb(ev, cap.ctx);
+}
+
+static void decode_frame(const uint8_t *frame, size_t len, int ifindex)
+{
+    passive_event_t ev;
+
+    if (len < ETH_HEADER_LEN) {
+        STAT_INC(malformed);
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.ifindex = ifindex;
+    STAT_INC(frames);
+
+    uint16_t type = get16(frame + 12);
+    if (type == ETHERTYPE_ARP) {
+        decode_arp(frame, len, &ev);
+    } else if (type == ETHERTYPE_LLDP) {
+        decode_lldp(frame, len, &ev);
+    } else if (type <= ETH_DATA_LEN && len >= ETH_HEADER_LEN + CDP_SNAP_LEN &&
+               get32(frame + ETH_HEADER_LEN) == CDP_SNAP_WORD0 &&
+               get32(frame + ETH_HEADER_LEN + 4) == CDP_SNAP_WORD1) {
+        decode_cdp(frame, len, &ev);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Ring                                                               */
+/* ------------------------------------------------------------------ */
+
+static void walk_block(struct tpacket_block_desc *bd)
+{
+    uint32_t n = bd->hdr.bh1.num_pkts;
+    struct tpacket3_hdr *pkt = (struct tpacket3_hdr *)((uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+
+    for (uint32_t i = 0; i < n; i++) {
+        const struct sockaddr_ll *sll =
+            (const struct sockaddr_ll *)((uint8_t *)pkt + TPACKET_ALIGN(sizeof(*pkt)));
+
+        /* Our own transmissions (and loopback's second copy) are skipped */
+        if (sll->sll_pkttype != PACKET_OUTGOING) {
+            decode_frame((const uint8_t *)pkt + pkt->tp_mac, pkt->tp_snaplen, sll->sll_ifindex);
+        }
+        pkt = (struct tpacket3_hdr *)((uint8_t *)pkt + pkt->tp_next_offset);
+    }
+}
+
+static void *capture_main(void *arg)
+{
+    unsigned int block = 0;
+    struct pollfd pfd;
+
+    (void)arg;
+    pfd.fd = cap.fd;
+    pfd.events = POLLIN | POLLERR;
+
+    while (!cap.stop) {
+        struct tpacket_block_desc *bd =
+            (struct tpacket_block_desc *)(cap.ring + (size_t)block * cap.block_size);
+
+        if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            if (poll(&pfd, 1, PASSIVE_POLL_MS) < 0 && errno != EINTR) {
+                break;
+            }
+            continue;
+        }
+
+        walk_block(bd);
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        block = (block + 1) % cap.block_count;
+    }
+    return NULL;
+}
+
+static int open_ring(const passive_config_t *cfg)
+{
+    struct sock_fprog prog = { sizeof(capture_filter) / sizeof(capture_filter[0]), capture_filter };
+    int version = TPACKET_V3;
+    struct tpacket_req3 req;
+    struct sockaddr_ll sll;
+
+    /* Protocol 0 receives nothing until bind(), so the filter is in place first */
+    cap.fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (cap.fd < 0) {
+        return NETMON_ERROR;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = cfg->block_size;
+    req.tp_block_nr = cfg->block_count;
+    req.tp_frame_size = TPACKET_ALIGNMENT << 7;
+    req.tp_frame_nr = (cfg->block_size / req.tp_frame_size) * cfg->block_count;
+    req.tp_retire_blk_tov = cfg->block_timeout_ms;
+
+    if (setsockopt(cap.fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0 ||
+        setsockopt(cap.fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0 ||
+        setsockopt(cap.fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0) {
+        goto fail;
+    }
+
+    cap.block_size = cfg->block_size;
+    cap.block_count = cfg->block_count;
+    cap.ring_size = (size_t)cfg->block_size * cfg->block_count;
+    cap.ring = mmap(NULL, cap.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, cap.fd, 0);
+    if (cap.ring == MAP_FAILED) {
+        /* MAP_LOCKED can exceed RLIMIT_MEMLOCK; an unlocked ring still works */
+        cap.ring = mmap(NULL, cap.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, cap.fd, 0);
+    }
+    if (cap.ring == MAP_FAILED) {
+        cap.ring = NULL;
+        goto fail;
+    }
+
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    if (cfg->ifname != NULL) {
+        sll.sll_ifindex = (int)if_nametoindex(cfg->ifname);
+        if (sll.sll_ifindex == 0) {
+            goto fail;
+        }
+    }
+    if (bind(cap.fd, (struct sockaddr *)&sll, sizeof(sll)) != 0) {
+        goto fail;
+    }
+    return NETMON_SUCCESS;
+
+fail:
+    if (cap.ring != NULL) {
+        munmap(cap.ring, cap.ring_size);
+        cap.ring = NULL;
+    }
+    close(cap.fd);
+    cap.fd = -1;
+    return NETMON_ERROR;
+}
+
+int passive_start(const passive_config_t *cfg, passive_event_cb cb, void *ctx)
+{
+    passive_config_t defaults;
+    int rc = NETMON_ERROR;
+
+    if (cb == NULL) {
+        return NETMON_ERROR;
+    }
+    if (cfg == NULL) {
+        passive_config_default(&defaults);
+        cfg = &defaults;
+    }
+
+    pthread_mutex_lock(&cap_lock);
+    if (!cap.running && open_ring(cfg) == NETMON_SUCCESS) {
+        memset(&stats, 0, sizeof(stats));
+        cap.cb = cb;
+        cap.ctx = ctx;
+        cap.stop = 0;
+        if (pthread_create(&cap.thread, NULL, capture_main, NULL) == 0) {
+            cap.running = 1;
+            rc = NETMON_SUCCESS;
+        } else {
+            munmap(cap.ring, cap.ring_size);
+            close(cap.fd);
+            cap.ring = NULL;
+            cap.fd = -1;
+        }
+    }
+    pthread_mutex_unlock(&cap_lock);
+    return rc;
+}
+
+void passive_stop(void)
+{
+    pthread_mutex_lock(&cap_lock);
+    if (cap.running) {
+        struct tpacket_stats_v3 ks;
+        socklen_t ks_len = sizeof(ks);
+
+        cap.stop = 1;
+        pthread_join(cap.thread, NULL);
+
+        if (getsockopt(cap.fd, SOL_PACKET, PACKET_STATISTICS, &ks, &ks_len) == 0) {
+            __atomic_fetch_add(&stats.kernel_drops, ks.tp_drops, __ATOMIC_RELAXED);
+        }
+        munmap(cap.ring, cap.ring_size);
+        close(cap.fd);
+        cap.ring = NULL;
+        cap.fd = -1;
+        cap.running = 0;
+    }
+    pthread_mutex_unlock(&cap_lock);
+}
+
+int passive_is_running(void)
+{
+    pthread_mutex_lock(&cap_lock);
+    int running = cap.running;
+    pthread_mutex_unlock(&cap_lock);
+    return running;
+}
+
+void passive_get_stats(passive_stats_t *out)
+{
+    out->frames = __atomic_load_n(&stats.frames, __ATOMIC_RELAXED);
+    out->arp = __atomic_load_n(&stats.arp, __ATOMIC_RELAXED);
+    out->lldp = __atomic_load_n(&stats.lldp, __ATOMIC_RELAXED);
+    out->cdp = __atomic_load_n(&stats.cdp, __ATOMIC_RELAXED);
+    out->malformed = __atomic_load_n(&stats.malformed, __ATOMIC_RELAXED);
+    out->kernel_drops = __atomic_load_n(&stats.kernel_drops, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,279 @@
+/*
+ * ICMP Echo Engine
+ * Sends echo requests to many hosts at once over a single ICMP socket
+ * and matches replies by identifier/sequence. Pacing, windowing and
+ * retries are handled by the probe scheduler (probe.c). Uses an unprivileged
+ * SOCK_DGRAM ICMP socket on Linux when allowed by ping_group_range,
+ * falling back to SOCK_RAW (root or CAP_NET_RAW).
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "ping.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <arpa/inet.h>
+
+#define PING_MAGIC 0x4e4d4f4eU  /* "NMON" */
+#define PING_RECV_BUF_SIZE 1500
+#define PING_SOCK_BUF_SIZE (1 << 20)
+
+/* Payload carried in every echo request */
+typedef struct {
+    uint32_t magic;
+    uint32_t addr;       /* Destination, echoed back for validation */
+    uint16_t slot;       /* Scheduler in-flight slot (also the ICMP sequence) */
+    uint16_t gen;        /* Scheduler attempt generation */
+} ping_payload_t;
+
+typedef struct {
+    struct icmphdr hdr;
+    ping_payload_t payload;
+} ping_packet_t;
+
+/* ICMP transport state */
+typedef struct {
+    int fd;
+    int is_raw;          /* Raw sockets deliver the IP header too */
+    uint16_t ident;
+} ping_transport_t;
+
+/*
+ * Standard Internet checksum (RFC 1071)
+ */
+static uint16_t icmp_checksum(const void *data, size_t len)
+{
+    const uint16_t *p = data;
+    uint32_t sum = 0;
+
+    while (len > 1) {
+        sum += *p++;
+        len -= 2;
+    }
+    if (len == 1) {
+        sum += *(const uint8_t *)p;
+    }
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum += (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/*
+ * Open a non-blocking ICMP socket
+ * Returns the descriptor, or -1 if neither socket type is permitted
+ */
+static int open_icmp_socket(int *is_raw)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+    *is_raw = 0;
+
+    if (fd < 0) {
+        fd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+        if (fd < 0) {
+            return -1;
+        }
+        *is_raw = 1;
+    }
+
+    /* Large buffers so a burst of replies is not dropped */
+    int bufsize = PING_SOCK_BUF_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+
+    return fd;
+}
+
+/*
+ * Transport send: one echo request for (slot, gen)
+ */
+static int ping_send(void *ctx, uint32_t addr, uint16_t slot, uint16_t gen)
+{
+    ping_transport_t *pt = ctx;
+    ping_packet_t pkt;
+    struct sockaddr_in dst;
+
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.hdr.type = ICMP_ECHO;
+    pkt.hdr.code = 0;
+    pkt.hdr.un.echo.id = htons(pt->ident);
+    pkt.hdr.un.echo.sequence = htons(slot);
+    pkt.payload.magic = PING_MAGIC;
+    pkt.payload.addr = addr;
+    pkt.payload.slot = slot;
+    pkt.payload.gen = gen;
+    pkt.hdr.checksum = icmp_checksum(&pkt, sizeof(pkt));
+
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = htonl(addr);
+
+    for (;;) {
+        ssize_t sent = sendto(pt->fd, &pkt, sizeof(pkt), 0,
+                              (struct sockaddr *)&dst, sizeof(dst));
+        if (sent == (ssize_t)sizeof(pkt)) {
+            return 0;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            return 1;
+        }
+        return -1;  /* Unreachable destination etc. - drop target */
+    }
+}
+
+/*
+ * Transport drain: feed every pending echo reply to the scheduler
+ */
+static void ping_drain(void *ctx, probe_sched_t *sched)
+{
+    ping_transport_t *pt = ctx;
+    uint8_t buf[PING_RECV_BUF_SIZE];
+    struct sockaddr_in src;
+
+    for (;;) {
+        socklen_t srclen = sizeof(src);
+        ssize_t n = recvfrom(pt->fd, buf, sizeof(buf), 0,
+                             (struct sockaddr *)&src, &srclen);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;  /* EAGAIN: nothing left */
+        }
+
+        const uint8_t *p = buf;
+        size_t len = (size_t)n;
+
+        if (pt->is_raw) {
+            if (len < sizeof(struct iphdr)) continue;
+            size_t ihl = (size_t)((const struct iphdr *)p)->ihl * 4;
+            if (ihl > len) continue;
+            p += ihl;
+            len -= ihl;
+        }
+
+        if (len < sizeof(ping_packet_t)) continue;
+
+        ping_packet_t pkt;
+        memcpy(&pkt, p, sizeof(pkt));
+
+        if (pkt.hdr.type != ICMP_ECHOREPLY) continue;
+        /* Datagram sockets rewrite the identifier; the kernel filters for us */
+        if (pt->is_raw && ntohs(pkt.hdr.un.echo.id) != pt->ident) continue;
+        if (pkt.payload.magic != PING_MAGIC) continue;
+        if (ntohs(pkt.hdr.un.echo.sequence) != pkt.payload.slot) continue;
+
+        uint32_t from = ntohl(src.sin_addr.s_addr);
+        if (from != pkt.payload.addr) continue;
+
+        probe_reply(sched, pkt.payload.slot, pkt.payload.gen, from);
+    }
+}
+
+/*
+ * Transport wait: block until the socket is readable
+ */
+static void ping_wait(void *ctx, int timeout_ms)
+{
+    ping_transport_t *pt = ctx;
+    struct pollfd pfd;
+    pfd.fd = pt->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    poll(&pfd, 1, timeout_ms);
+}
+
+int ping_sweep_source(const probe_config_t *cfg, probe_next_fn next, void *next_ctx,
+                      ping_result_cb cb, void *ctx, probe_stats_t *stats)
+{
+    ping_transport_t pt;
+    probe_transport_t tp;
+
+    pt.fd = open_icmp_socket(&pt.is_raw);
+    if (pt.fd < 0) {
+        return -1;
+    }
+    pt.ident = (uint16_t)(getpid() & 0xffff);
+
+    tp.ctx = &pt;
+    tp.send = ping_send;
+    tp.wait = ping_wait;
+    tp.drain = ping_drain;
+
+    int alive = probe_run(cfg, &tp, next, next_ctx, cb, ctx, stats);
+
+    close(pt.fd);
+    return alive;
+}
+
+int ping_sweep(const uint32_t *targets, int count, int timeout_ms,
+               ping_result_cb cb, void *ctx)
+{
+    probe_config_t cfg;
+    probe_array_source_t src;
+
+    if (targets == NULL || count <= 0) {
+        return 0;
+    }
+
+    probe_config_default(&cfg);
+    cfg.initial_rto_ms = timeout_ms;
+
+    src.targets = targets;
+    src.count = count;
+    src.pos = 0;
+
+    return ping_sweep_source(&cfg, probe_array_next, &src, cb, ctx, NULL);
+}
+
+/* Single-host helper used by ping_device() */
+static void ping_device_cb(uint32_t addr, int rtt_ms, void *ctx)
+{
+    (void)addr;
+    *(int *)ctx = rtt_ms;
+}
+
+/*
+ * Ping a single device
+ * Returns NETMON_SUCCESS with response_time set, NETMON_TIMEOUT if no
+ * reply arrived, or NETMON_ERROR on invalid input / socket failure
+ */
+int ping_device(const char *ip, int *response_time)
+{
+    struct in_addr addr;
+    int rtt = -1;
+
+    if (ip == NULL || inet_pton(AF_INET, ip, &addr) != 1) {
+        return NETMON_ERROR;
+    }
+
+    uint32_t target = ntohl(addr.s_addr);
+    probe_config_t cfg;
+    probe_array_source_t src = { &target, 1, 0 };
+
+    /* One retry, as a single lost packet should not mark a device down */
+    probe_config_default(&cfg);
+    cfg.initial_rto_ms = PING_DEFAULT_TIMEOUT_MS;
+    cfg.max_retries = 1;
+
+    int alive = ping_sweep_source(&cfg, probe_array_next, &src, ping_device_cb, &rtt, NULL);
+    if (alive < 0) {
+        return NETMON_ERROR;
+    }
+
+    if (response_time != NULL) {
+        *response_time = rtt;
+    }
+    return alive > 0 ? NETMON_SUCCESS : NETMON_TIMEOUT;
+}
@@ -0,0 +1,560 @@
+/*
+ * TCP and SNMP Liveness Probes
+ * One epoll instance watches every in-flight TCP connect and the shared
+ * SNMP socket. Connections live in a table indexed by scheduler slot
+ * and port, so a slot's sockets are found, closed and replaced in O(1)
+ * when it is retried or reused. Pacing, windowing and retries are left
+ * to the probe scheduler (probe.c).
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "port_probe.h"
+#include "snmp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/ip_icmp.h>
+#include <linux/errqueue.h>
+#include <arpa/inet.h>
+
+#define PORT_PROBE_EVENTS 256
+#define PORT_PROBE_FD_RESERVE 64          /* Descriptors left for the rest of the process */
+#define PORT_PROBE_SOCK_BUF_SIZE (1 << 20)
+#define PORT_PROBE_RECV_BUF_SIZE 1500
+#define UDP_KEY UINT64_MAX                /* epoll key of the SNMP socket */
+
+/* One TCP connect attempt */
+typedef struct {
+    int fd;                               /* -1 when idle */
+    uint32_t addr;
+    uint16_t gen;
+} conn_t;
+
+/* A probe that finished inside connect(), reported on the next drain */
+typedef struct {
+    uint32_t addr;
+    uint16_t slot;
+    uint16_t gen;
+} ready_t;
+
+typedef struct {
+    const port_probe_config_t *pcfg;
+    int epfd;
+    int udp_fd;                           /* -1 when SNMP is off */
+    int nports;
+    int nslots;
+    conn_t *conns;                        /* nslots * nports, slot-major */
+    ready_t *ready;
+    int ready_count;
+    struct epoll_event events[PORT_PROBE_EVENTS];
+    int event_count;                      /* Collected by wait, handled by drain */
+    uint8_t request[128];                 /* SNMP Get, request-id patched per probe */
+    size_t request_len;
+    size_t rid_offset;
+} port_transport_t;
+
+static port_probe_config_t default_probe = {
+    PORT_PROBE_DEFAULT_TCP_PORTS,
+    3,
+    1,
+    DEFAULT_SNMP_PORT,
+    PORT_PROBE_DEFAULT_COMMUNITY
+};
+
+void port_probe_config_default(port_probe_config_t *cfg)
+{
+    *cfg = default_probe;
+}
+
+void port_probe_set_defaults(const port_probe_config_t *cfg)
+{
+    if (cfg != NULL) {
+        default_probe = *cfg;
+    }
+}
+
+int port_probe_parse_ports(const char *list, port_probe_config_t *cfg)
+{
+    int count = 0;
+
+    if (list == NULL || *list == '\0') {
+        return NETMON_ERROR;
+    }
+    if (strcmp(list, "none") == 0) {
+        cfg->tcp_port_count = 0;
+        return NETMON_SUCCESS;
+    }
+    for (const char *p = list; ; p++) {
+        char *end;
+        long port = strtol(p, &end, 10);
+        if (end == p || port < 1 || port > 65535 || count == PORT_PROBE_MAX_TCP_PORTS ||
+            (*end != ',' && *end != '\0')) {
+            return NETMON_ERROR;
+        }
+        cfg->tcp_ports[count++] = (uint16_t)port;
+        if (*end == '\0') break;
+        p = end;
+    }
+    cfg->tcp_port_count = count;
+    return NETMON_SUCCESS;
+}
+
+/*
+ * SNMPv2c Get for sysUpTime.0 with a 4-byte request-id at *rid_offset;
+ * every length fits the short BER form for communities under 64 bytes
+ */
+static size_t build_request(uint8_t *buf, const char *community, size_t *rid_offset)
+{
+    static const uint8_t varbinds[] = {
+        0x30, 0x0e, 0x30, 0x0c, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x03, 0x00,
+        0x05, 0x00
+    };
+    size_t cl = strnlen(community, 63);
+    size_t pdu_len = 6 + 3 + 3 + sizeof(varbinds);
+    uint8_t *p = buf;
+
+    *p++ = 0x30;
+    *p++ = (uint8_t)(3 + 2 + cl + 2 + pdu_len);
+    *p++ = SNMP_TYPE_INTEGER;
+    *p++ = 0x01;
+    *p++ = 0x01;                          /* Version 2c */
+    *p++ = SNMP_TYPE_OCTET_STRING;
+    *p++ = (uint8_t)cl;
+    memcpy(p, community, cl);
+    p += cl;
+    *p++ = SNMP_PDU_GET;
+    *p++ = (uint8_t)pdu_len;
+    *p++ = SNMP_TYPE_INTEGER;
+    *p++ = 0x04;
+    *rid_offset = (size_t)(p - buf);
+    p += 4;
+    for (int i = 0; i < 2; i++) {         /* error-status, error-index */
+        *p++ = SNMP_TYPE_INTEGER;
+        *p++ = 0x01;
+        *p++ = 0x00;
+    }
+    memcpy(p, varbinds, sizeof(varbinds));
+    p += sizeof(varbinds);
+    return (size_t)(p - buf);
+}
+
+/* Tag and length of the TLV at *p; returns the content length, or -1 */
+static int ber_header(const uint8_t **p, const uint8_t *end, uint8_t *type)
+{
+    if (end - *p < 2) return -1;
+    *type = *(*p)++;
+    size_t len = *(*p)++;
+    if (len & 0x80) {
+        int n = (int)(len & 0x7f);
+        if (n < 1 || n > 2 || end - *p < n) return -1;
+        len = 0;
+        while (n-- > 0) len = (len << 8) | *(*p)++;
+    }
+    return (size_t)(end - *p) < len ? -1 : (int)len;
+}
+
+/*
+ * Request-id of an SNMP message whose PDU has type pdu_type
+ * Returns 1 and sets *rid, or 0 if buf is not such a message
+ */
+static int parse_request_id(const uint8_t *buf, size_t n, uint8_t pdu_type, uint32_t *rid)
+{
+    const uint8_t *p = buf, *end = buf + n;
+    uint8_t type;
+    int len;
+
+    if ((len = ber_header(&p, end, &type)) < 0 || type != 0x30) return 0;
+    end = p + len;
+    if ((len = ber_header(&p, end, &type)) < 0 || type != SNMP_TYPE_INTEGER) return 0;
+    p += len;
+    if ((len = ber_header(&p, end, &type)) < 0 || type != SNMP_TYPE_OCTET_STRING) return 0;
+    p += len;
+    if ((len = ber_header(&p, end, &type)) < 0 || type != pdu_type) return 0;
+    if ((len = ber_header(&p, end, &type)) < 0 || type != SNMP_TYPE_INTEGER || len < 1 || len > 5) {
+        return 0;
+    }
+
+    /* Agents re-encode the id minimally; sign-extend to recover the 32 bits */
+    uint32_t v = (p[0] & 0x80) ? UINT32_MAX : 0;
+    for (int i = 0; i < len; i++) {
+        v = (v << 8) | p[i];
+    }
+    *rid = v;
+    return 1;
+}
+
+static void close_conn(port_transport_t *pt, conn_t *c)
+{
+    /* Abort with RST so finished probes leave no TIME_WAIT behind */
+    struct linger lg = { 1, 0 };
+    setsockopt(c->fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    epoll_ctl(pt->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+}
+
+static void close_slot(port_transport_t *pt, uint16_t slot)
+{
+    conn_t *c = &pt->conns[(size_t)slot * (size_t)pt->nports];
+    for (int i = 0; i < pt->nports; i++) {
+        if (c[i].fd >= 0) close_conn(pt, &c[i]);
+    }
+}
+
+/*
+ * Transport send: a connect per port plus the SNMP Get for (slot, gen).
+ * Whatever this slot still had open belongs to an attempt the
+ * scheduler has given up on, so it is closed first.
+ */
+static int port_send(void *ctx, uint32_t addr, uint16_t slot, uint16_t gen)
+{
+    port_transport_t *pt = ctx;
+    struct sockaddr_in dst;
+    int opened = 0;
+    int immediate = 0;
+
+    close_slot(pt, slot);
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = htonl(addr);
+
+    for (int i = 0; i < pt->nports && !immediate; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            if (opened == 0 && (errno == EMFILE || errno == ENFILE || errno == ENOBUFS)) {
+                return 1;
+            }
+            break;
+        }
+        dst.sin_port = htons(pt->pcfg->tcp_ports[i]);
+        if (connect(fd, (struct sockaddr *)&dst, sizeof(dst)) == 0 || errno == ECONNREFUSED) {
+            immediate = 1;                /* Local or loopback target */
+            close(fd);
+            break;
+        }
+        if (errno != EINPROGRESS) {
+            close(fd);                    /* No route etc.; other ports may still work */
+            continue;
+        }
+
+        size_t k = (size_t)slot * (size_t)pt->nports + (size_t)i;
+        struct epoll_event ev;
+        ev.events = EPOLLOUT;
+        ev.data.u64 = k;
+        if (epoll_ctl(pt->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            continue;
+        }
+        pt->conns[k].fd = fd;
+        pt->conns[k].addr = addr;
+        pt->conns[k].gen = gen;
+        opened++;
+    }
+
+    if (immediate) {
+        close_slot(pt, slot);
+        pt->ready[pt->ready_count].addr = addr;
+        pt->ready[pt->ready_count].slot = slot;
+        pt->ready[pt->ready_count].gen = gen;
+        pt->ready_count++;
+        return 0;
+    }
+
+    if (pt->udp_fd >= 0) {
+        uint32_t rid = ((uint32_t)gen << 16) | slot;
+        uint8_t *r = pt->request + pt->rid_offset;
+        r[0] = (uint8_t)(rid >> 24);
+        r[1] = (uint8_t)(rid >> 16);
+        r[2] = (uint8_t)(rid >> 8);
+        r[3] = (uint8_t)rid;
+        dst.sin_port = htons(pt->pcfg->snmp_port);
+
+        /*
+         * IP_RECVERR also latches the last ICMP error on the socket and
+         * the next call reports it; that belongs to an earlier target, so
+         * one failure other than a full buffer is retried
+         */
+        ssize_t sent;
+        int stale = 1;
+        for (;;) {
+            sent = sendto(pt->udp_fd, pt->request, pt->request_len, 0,
+                          (struct sockaddr *)&dst, sizeof(dst));
+            if (sent >= 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) break;
+            if (errno != EINTR && !stale--) break;
+        }
+        if (sent == (ssize_t)pt->request_len) {
+            opened++;
+        } else if (opened == 0 && sent < 0 &&
+                   (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            return 1;
+        }
+    }
+    return opened > 0 ? 0 : -1;
+}
+
+static void port_wait(void *ctx, int timeout_ms)
+{
+    port_transport_t *pt = ctx;
+    int n;
+
+    do {
+        n = epoll_wait(pt->epfd, pt->events, PORT_PROBE_EVENTS, pt->ready_count > 0 ? 0 : timeout_ms);
+    } while (n < 0 && errno == EINTR);
+    pt->event_count = n > 0 ? n : 0;
+}
+
+/* The SNMP socket: agent responses, then ICMP errors queued by IP_RECVERR */
+static void drain_udp(port_transport_t *pt, probe_sched_t *sched)
+{
+    uint8_t buf[PORT_PROBE_RECV_BUF_SIZE];
+    struct sockaddr_in src;
+    uint32_t rid;
+
+    for (;;) {
+        socklen_t srclen = sizeof(src);
+        ssize_t n = recvfrom(pt->udp_fd, buf, sizeof(buf), 0, (struct sockaddr *)&src, &srclen);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            continue;                     /* EINTR or a latched ICMP error, now cleared */
+        }
+        if (parse_request_id(buf, (size_t)n, SNMP_PDU_RESPONSE, &rid)) {
+            probe_reply(sched, (uint16_t)rid, (uint16_t)(rid >> 16), ntohl(src.sin_addr.s_addr));
+        }
+    }
+
+    for (;;) {
+        char control[256];
+        struct iovec iov = { buf, sizeof(buf) };
+        struct msghdr msg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &src;
+        msg.msg_namelen = sizeof(src);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(pt->udp_fd, &msg, MSG_ERRQUEUE);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level != IPPROTO_IP || cm->cmsg_type != IP_RECVERR) continue;
+
+            const struct sock_extended_err *ee = (const struct sock_extended_err *)CMSG_DATA(cm);
+            const struct sockaddr_in *from = (const struct sockaddr_in *)SO_EE_OFFENDER(ee);
+            /* Only the target itself saying "port unreachable" proves it is up */
+            if (ee->ee_origin == SO_EE_ORIGIN_ICMP && ee->ee_type == ICMP_DEST_UNREACH &&
+                ee->ee_code == ICMP_PORT_UNREACH && from->sin_addr.s_addr == src.sin_addr.s_addr &&
+                parse_request_id(buf, (size_t)n, SNMP_PDU_GET, &rid)) {
+                probe_reply(sched, (uint16_t)rid, (uint16_t)(rid >> 16), ntohl(src.sin_addr.s_addr));
+            }
+        }
+    }
+}
+
+static void handle_event(port_transport_t *pt, probe_sched_t *sched, const struct epoll_event *ev)
+{
+    if (ev->data.u64 == UDP_KEY) {
+        drain_udp(pt, sched);
+        return;
+    }
+
+    conn_t *c = &pt->conns[ev->data.u64];
+    if (c->fd < 0) {
+        return;                           /* Closed earlier in this batch */
+    }
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) {
+        err = errno;
+    }
+    if (err != 0 && err != ECONNREFUSED) {
+        close_conn(pt, c);                /* Unreachable or filtered on this port */
+        return;
+    }
+
+    uint16_t slot = (uint16_t)(ev->data.u64 / (uint64_t)pt->nports);
+    uint16_t gen = c->gen;
+    uint32_t addr = c->addr;
+    close_slot(pt, slot);
+    probe_reply(sched, slot, gen, addr);
+}
+
+/* Transport drain: report immediate results, then every ready socket */
+static void port_drain(void *ctx, probe_sched_t *sched)
+{
+    port_transport_t *pt = ctx;
+
+    for (int i = 0; i < pt->ready_count; i++) {
+        probe_reply(sched, pt->ready[i].slot, pt->ready[i].gen, pt->ready[i].addr);
+    }
+    pt->ready_count = 0;
+
+    for (;;) {
+        for (int i = 0; i < pt->event_count; i++) {
+            handle_event(pt, sched, &pt->events[i]);
+        }
+        if (pt->event_count < PORT_PROBE_EVENTS && pt->event_count > 0) {
+            pt->event_count = 0;
+            break;
+        }
+        int n = epoll_wait(pt->epfd, pt->events, PORT_PROBE_EVENTS, 0);
+        pt->event_count = 0;
+        if (n <= 0) {
+            break;
+        }
+        pt->event_count = n;
+    }
+}
+
+/* Soft RLIMIT_NOFILE after raising it towards want (capped at the hard limit) */
+static long raise_fd_limit(long want)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+        return 1024;
+    }
+    if ((rlim_t)want > rl.rlim_cur && rl.rlim_cur != RLIM_INFINITY) {
+        rlim_t target = rl.rlim_max == RLIM_INFINITY || (rlim_t)want < rl.rlim_max ? (rlim_t)want : rl.rlim_max;
+        struct rlimit raised = { target, rl.rlim_max };
+        if (setrlimit(RLIMIT_NOFILE, &raised) == 0) {
+            rl.rlim_cur = target;
+        }
+    }
+    return rl.rlim_cur == RLIM_INFINITY ? want : (long)rl.rlim_cur;
+}
+
+static int open_udp_socket(void)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int on = 1;
+    int bufsize = PORT_PROBE_SOCK_BUF_SIZE;
+    setsockopt(fd, IPPROTO_IP, IP_RECVERR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+    return fd;
+}
+
+int port_probe_sweep_source(const probe_config_t *cfg, const port_probe_config_t *pcfg,
+                            probe_next_fn next, void *next_ctx,
+                            probe_result_cb cb, void *ctx, probe_stats_t *stats)
+{
+    probe_config_t run_cfg;
+    port_probe_config_t defaults;
+    port_transport_t pt;
+    int alive = -1;
+
+    if (cfg != NULL) {
+        run_cfg = *cfg;
+    } else {
+        probe_config_default(&run_cfg);
+    }
+    if (pcfg == NULL) {
+        port_probe_config_default(&defaults);
+        pcfg = &defaults;
+    }
+    if (pcfg->tcp_port_count < 0 || pcfg->tcp_port_count > PORT_PROBE_MAX_TCP_PORTS ||
+        (pcfg->tcp_port_count == 0 && !pcfg->snmp)) {
+        return -1;
+    }
+
+    /* Every in-flight probe may hold one socket per port */
+    int nports = pcfg->tcp_port_count;
+    if (run_cfg.max_inflight < 1) run_cfg.max_inflight = 1;
+    if (run_cfg.max_inflight > PROBE_MAX_INFLIGHT_LIMIT) run_cfg.max_inflight = PROBE_MAX_INFLIGHT_LIMIT;
+    if (nports > 0) {
+        long limit = raise_fd_limit((long)run_cfg.max_inflight * nports + PORT_PROBE_FD_RESERVE);
+        long room = (limit - PORT_PROBE_FD_RESERVE) / nports;
+        if (room < 1) room = 1;
+        if (run_cfg.max_inflight > room) run_cfg.max_inflight = (int)room;
+    }
+
+    memset(&pt, 0, sizeof(pt));
+    pt.pcfg = pcfg;
+    pt.nports = nports;
+    pt.nslots = run_cfg.max_inflight;
+    pt.udp_fd = -1;
+    pt.epfd = epoll_create1(EPOLL_CLOEXEC);
+    pt.conns = malloc((size_t)pt.nslots * (size_t)(nports > 0 ? nports : 1) * sizeof(*pt.conns));
+    pt.ready = malloc((size_t)pt.nslots * sizeof(*pt.ready));
+    if (pt.epfd < 0 || pt.conns == NULL || pt.ready == NULL) {
+        goto out;
+    }
+    for (int i = 0; i < pt.nslots * nports; i++) {
+        pt.conns[i].fd = -1;
+    }
+
+    if (pcfg->snmp) {
+        struct epoll_event ev;
+        pt.udp_fd = open_udp_socket();
+        ev.events = EPOLLIN;
+        ev.data.u64 = UDP_KEY;
+        if (pt.udp_fd < 0 || epoll_ctl(pt.epfd, EPOLL_CTL_ADD, pt.udp_fd, &ev) != 0) {
+            goto out;
+        }
+        pt.request_len = build_request(pt.request, pcfg->snmp_community, &pt.rid_offset);
+    }
+
+    probe_transport_t tp = { &pt, port_send, port_wait, port_drain };
+    alive = probe_run(&run_cfg, &tp, next, next_ctx, cb, ctx, stats);
+
+out:
+    if (pt.conns != NULL) {
+        for (int i = 0; i < pt.nslots * nports; i++) {
+            if (pt.conns[i].fd >= 0) close_conn(&pt, &pt.conns[i]);
+        }
+    }
+    if (pt.udp_fd >= 0) close(pt.udp_fd);
+    if (pt.epfd >= 0) close(pt.epfd);
+    free(pt.conns);
+    free(pt.ready);
+    return alive;
+}
+
+/* Single-host helper, the counterpart of ping_device() */
+static void port_device_cb(uint32_t addr, int rtt_ms, void *ctx)
+{
+    (void)addr;
+    *(int *)ctx = rtt_ms;
+}
+
+int port_probe_device(const char *ip, int *response_time)
+{
+    struct in_addr addr;
+    probe_config_t cfg;
+    int rtt = -1;
+
+    if (ip == NULL || inet_pton(AF_INET, ip, &addr) != 1) {
+        return NETMON_ERROR;
+    }
+
+    uint32_t target = ntohl(addr.s_addr);
+    probe_array_source_t src = { &target, 1, 0 };
+
+    probe_config_default(&cfg);
+    cfg.max_retries = 1;
+
+    int alive = port_probe_sweep_source(&cfg, NULL, probe_array_next, &src, port_device_cb, &rtt, NULL);
+    if (alive < 0) {
+        return NETMON_ERROR;
+    }
+    if (response_time != NULL) {
+        *response_time = rtt;
+    }
+    return alive > 0 ? NETMON_SUCCESS : NETMON_TIMEOUT;
+}
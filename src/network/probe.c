@@ -0,0 +1,495 @@
+/*
+ * Probe Scheduler
+ * Windowed, rate-limited probe engine shared by ICMP sweeps and other
+ * liveness transports. Targets are pulled lazily from a source so only
+ * the in-flight window is ever held in memory.
+ */
+
+#define _GNU_SOURCE
+
+#include "probe.h"
+#include "selfstat.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Slot states */
+#define SLOT_FREE 0
+#define SLOT_PENDING 1     /* Waiting in the send queue (new target or retry) */
+#define SLOT_INFLIGHT 2    /* Probe on the wire, timer armed */
+#define SLOT_ANSWERED 3    /* Answered while still queued; released on dequeue */
+
+#define NS_PER_MS 1000000ULL
+
+/* Per-target state for one in-flight window entry */
+typedef struct {
+    uint32_t addr;
+    uint16_t gen_base;     /* Generation of the first attempt */
+    uint8_t attempts;      /* Probes sent so far */
+    uint8_t state;
+} probe_slot_t;
+
+/* Timeout heap entry; stale entries are discarded lazily */
+typedef struct {
+    uint64_t deadline_ns;
+    uint16_t slot;
+    uint16_t gen;
+} probe_timer_t;
+
+struct probe_sched {
+    const probe_config_t *cfg;
+    const probe_transport_t *tp;
+
+    probe_slot_t *slots;
+    int nslots;
+    uint64_t *sent_ns;     /* [slot * (max_retries + 1) + attempt] */
+    uint16_t *free_list;
+    int free_count;
+
+    /* FIFO of slots waiting to be (re)sent */
+    uint16_t *queue;
+    int queue_head;
+    int queue_len;
+
+    probe_timer_t *heap;
+    int heap_len;
+    int heap_cap;
+
+    int busy;              /* Slots not SLOT_FREE */
+    uint16_t next_gen;
+
+    /* Token bucket */
+    double tokens;
+    uint64_t last_refill_ns;
+
+    /* RTT estimator (milliseconds) */
+    double srtt;
+    double rttvar;
+    int have_rtt;
+    int rto_ms;
+
+    probe_result_cb cb;
+    void *cb_ctx;
+    probe_stats_t stats;
+};
+
+static probe_config_t default_config = {
+    PROBE_DEFAULT_PPS,
+    PROBE_DEFAULT_BURST,
+    PROBE_DEFAULT_MAX_INFLIGHT,
+    PROBE_DEFAULT_RETRIES,
+    PROBE_DEFAULT_RTO_MS,
+    PROBE_DEFAULT_MIN_RTO_MS,
+    PROBE_DEFAULT_MAX_RTO_MS
+};
+
+void probe_config_default(probe_config_t *cfg)
+{
+    *cfg = default_config;
+}
+
+void probe_set_defaults(const probe_config_t *cfg)
+{
+    if (cfg != NULL) {
+        default_config = *cfg;
+    }
+}
+
+int probe_array_next(void *ctx, uint32_t *addr)
+{
+    probe_array_source_t *src = ctx;
+    if (src->pos >= src->count) {
+        return 0;
+    }
+    *addr = src->targets[src->pos++];
+    return 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Timer heap (binary min-heap on deadline)
+ */
+static int heap_push(probe_sched_t *s, uint64_t deadline, uint16_t slot, uint16_t gen)
+{
+    if (s->heap_len == s->heap_cap) {
+        int cap = s->heap_cap ? s->heap_cap * 2 : 64;
+        probe_timer_t *h = realloc(s->heap, (size_t)cap * sizeof(*h));
+        if (h == NULL) {
+            return -1;
+        }
+        s->heap = h;
+        s->heap_cap = cap;
+    }
+
+    int i = s->heap_len++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (s->heap[parent].deadline_ns <= deadline) break;
+        s->heap[i] = s->heap[parent];
+        i = parent;
+    }
+    s->heap[i].deadline_ns = deadline;
+    s->heap[i].slot = slot;
+    s->heap[i].gen = gen;
+    return 0;
+}
+
+static void heap_pop(probe_sched_t *s)
+{
+    probe_timer_t last = s->heap[--s->heap_len];
+    int i = 0;
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= s->heap_len) break;
+        if (child + 1 < s->heap_len &&
+            s->heap[child + 1].deadline_ns < s->heap[child].deadline_ns) {
+            child++;
+        }
+        if (last.deadline_ns <= s->heap[child].deadline_ns) break;
+        s->heap[i] = s->heap[child];
+        i = child;
+    }
+    if (s->heap_len > 0) {
+        s->heap[i] = last;
+    }
+}
+
+static void release_slot(probe_sched_t *s, uint16_t slot)
+{
+    s->slots[slot].state = SLOT_FREE;
+    s->free_list[s->free_count++] = slot;
+    s->busy--;
+}
+
+static void queue_push(probe_sched_t *s, uint16_t slot)
+{
+    int tail = (s->queue_head + s->queue_len) % s->nslots;
+    s->queue[tail] = slot;
+    s->queue_len++;
+}
+
+static void queue_pop(probe_sched_t *s)
+{
+    s->queue_head = (s->queue_head + 1) % s->nslots;
+    s->queue_len--;
+}
+
+/*
+ * Timeout for the given attempt: adaptive RTO doubled per retry
+ */
+static uint64_t attempt_timeout_ns(const probe_sched_t *s, int attempt)
+{
+    uint64_t rto = (uint64_t)s->rto_ms;
+    for (int i = 1; i < attempt && rto < (uint64_t)s->cfg->max_rto_ms; i++) {
+        rto *= 2;
+    }
+    if (rto > (uint64_t)s->cfg->max_rto_ms) {
+        rto = (uint64_t)s->cfg->max_rto_ms;
+    }
+    return rto * NS_PER_MS;
+}
+
+/*
+ * Fold one RTT sample into SRTT/RTTVAR and recompute the RTO (RFC 6298)
+ */
+static void update_rto(probe_sched_t *s, double rtt_ms)
+{
+    if (!s->have_rtt) {
+        s->srtt = rtt_ms;
+        s->rttvar = rtt_ms / 2.0;
+        s->have_rtt = 1;
+    } else {
+        double err = s->srtt - rtt_ms;
+        if (err < 0) err = -err;
+        s->rttvar = 0.75 * s->rttvar + 0.25 * err;
+        s->srtt = 0.875 * s->srtt + 0.125 * rtt_ms;
+    }
+
+    double var = 4.0 * s->rttvar;
+    if (var < 1.0) var = 1.0;   /* Clock granularity */
+    int rto = (int)(s->srtt + var + 0.5);
+
+    if (rto < s->cfg->min_rto_ms) rto = s->cfg->min_rto_ms;
+    if (rto > s->cfg->max_rto_ms) rto = s->cfg->max_rto_ms;
+    s->rto_ms = rto;
+}
+
+/* Send time of one attempt of a slot's target */
+static uint64_t *attempt_sent(const probe_sched_t *s, uint16_t slot, int attempt)
+{
+    return &s->sent_ns[(size_t)slot * (size_t)(s->cfg->max_retries + 1) + (size_t)attempt];
+}
+
+void probe_reply(probe_sched_t *s, uint16_t slot, uint16_t gen, uint32_t addr)
+{
+    if (slot >= s->nslots) {
+        return;
+    }
+
+    probe_slot_t *p = &s->slots[slot];
+    if (p->state != SLOT_INFLIGHT && p->state != SLOT_PENDING) return;
+    if (p->addr != addr) return;
+
+    uint16_t attempt = (uint16_t)(gen - p->gen_base);
+    if (attempt >= p->attempts) return;
+
+    /*
+     * The echoed generation names the attempt that was answered, so a
+     * late reply to an earlier attempt is timed from its own send and
+     * the sample is never ambiguous the way Karn's rule guards against
+     */
+    uint64_t now = now_ns();
+    uint64_t sent = *attempt_sent(s, slot, attempt);
+    update_rto(s, (double)(now - sent) / (double)NS_PER_MS);
+
+    int rtt = (int)((now - sent + NS_PER_MS / 2) / NS_PER_MS);
+    if (rtt < 1) rtt = 1;
+
+    s->stats.replies++;
+    selfstat_record(SELFSTAT_PROBE_RTT, (now - sent) / 1000);
+    if (s->cb != NULL) {
+        s->cb(addr, rtt, s->cb_ctx);
+    }
+
+    if (p->state == SLOT_PENDING) {
+        p->state = SLOT_ANSWERED;  /* Still referenced by the send queue */
+    } else {
+        release_slot(s, slot);
+    }
+}
+
+/*
+ * Expire every timer whose deadline has passed
+ */
+static void expire_timers(probe_sched_t *s, uint64_t now)
+{
+    while (s->heap_len > 0 && s->heap[0].deadline_ns <= now) {
+        probe_timer_t t = s->heap[0];
+        heap_pop(s);
+
+        probe_slot_t *p = &s->slots[t.slot];
+        if (p->state != SLOT_INFLIGHT) continue;
+        if ((uint16_t)(p->gen_base + p->attempts - 1) != t.gen) continue;
+
+        if (p->attempts <= s->cfg->max_retries) {
+            p->state = SLOT_PENDING;
+            queue_push(s, t.slot);
+        } else {
+            s->stats.timeouts++;
+            selfstat_add(SELFSTAT_PROBE_TIMEOUTS, 1);
+            release_slot(s, t.slot);
+        }
+    }
+}
+
+static void refill_tokens(probe_sched_t *s, uint64_t now)
+{
+    if (s->cfg->max_pps <= 0) {
+        return;
+    }
+    double elapsed = (double)(now - s->last_refill_ns) / 1e9;
+    s->tokens += elapsed * s->cfg->max_pps;
+    if (s->tokens > s->cfg->burst) {
+        s->tokens = s->cfg->burst;
+    }
+    s->last_refill_ns = now;
+}
+
+/*
+ * Transmit the probe for a queued slot
+ * Returns 0 if sent or dropped, 1 if the transport is backed up
+ */
+static int send_slot(probe_sched_t *s, uint16_t slot, uint64_t now)
+{
+    probe_slot_t *p = &s->slots[slot];
+    uint16_t gen = (uint16_t)(p->gen_base + p->attempts);
+
+    int rc = s->tp->send(s->tp->ctx, p->addr, slot, gen);
+    if (rc > 0) {
+        return 1;
+    }
+    if (rc < 0) {
+        s->stats.send_errors++;
+        selfstat_add(SELFSTAT_PROBE_DROPS, 1);
+        release_slot(s, slot);
+        return 0;
+    }
+
+    if (p->attempts > 0) {
+        s->stats.retries++;
+        selfstat_add(SELFSTAT_PROBE_RETRIES, 1);
+    }
+    *attempt_sent(s, slot, p->attempts) = now;
+    p->attempts++;
+    p->state = SLOT_INFLIGHT;
+    s->stats.sent++;
+    selfstat_add(SELFSTAT_PROBES_SENT, 1);
+
+    if (s->cfg->max_pps > 0) {
+        s->tokens -= 1.0;
+    }
+
+    if (heap_push(s, now + attempt_timeout_ns(s, p->attempts), slot, gen) != 0) {
+        /* No timer means no way to retire the slot; give up on the target */
+        s->stats.timeouts++;
+        selfstat_add(SELFSTAT_PROBE_TIMEOUTS, 1);
+        release_slot(s, slot);
+    }
+    return 0;
+}
+
+static void sanitize_config(probe_config_t *cfg)
+{
+    if (cfg->max_inflight < 1) cfg->max_inflight = 1;
+    if (cfg->max_inflight > PROBE_MAX_INFLIGHT_LIMIT) cfg->max_inflight = PROBE_MAX_INFLIGHT_LIMIT;
+    if (cfg->max_retries < 0) cfg->max_retries = 0;
+    if (cfg->max_retries > 32) cfg->max_retries = 32;
+    if (cfg->burst < 1) cfg->burst = 1;
+    if (cfg->min_rto_ms < 1) cfg->min_rto_ms = 1;
+    if (cfg->max_rto_ms < cfg->min_rto_ms) cfg->max_rto_ms = cfg->min_rto_ms;
+    if (cfg->initial_rto_ms < cfg->min_rto_ms) cfg->initial_rto_ms = cfg->min_rto_ms;
+    if (cfg->initial_rto_ms > cfg->max_rto_ms) cfg->initial_rto_ms = cfg->max_rto_ms;
+}
+
+int probe_run(const probe_config_t *config, const probe_transport_t *tp,
+              probe_next_fn next, void *next_ctx,
+              probe_result_cb cb, void *cb_ctx, probe_stats_t *stats)
+{
+    probe_config_t cfg;
+    probe_sched_t s;
+    int exhausted = 0;
+
+    if (tp == NULL || next == NULL) {
+        return -1;
+    }
+
+    if (config != NULL) {
+        cfg = *config;
+    } else {
+        probe_config_default(&cfg);
+    }
+    sanitize_config(&cfg);
+
+    memset(&s, 0, sizeof(s));
+    s.cfg = &cfg;
+    s.tp = tp;
+    s.nslots = cfg.max_inflight;
+    s.slots = calloc((size_t)s.nslots, sizeof(*s.slots));
+    s.free_list = malloc((size_t)s.nslots * sizeof(*s.free_list));
+    s.queue = malloc((size_t)s.nslots * sizeof(*s.queue));
+    s.sent_ns = malloc((size_t)s.nslots * (size_t)(cfg.max_retries + 1) * sizeof(*s.sent_ns));
+    if (s.slots == NULL || s.free_list == NULL || s.queue == NULL || s.sent_ns == NULL) {
+        free(s.slots);
+        free(s.free_list);
+        free(s.queue);
+        free(s.sent_ns);
+        return -1;
+    }
+
+    for (int i = s.nslots - 1; i >= 0; i--) {
+        s.free_list[s.free_count++] = (uint16_t)i;
+    }
+
+    s.rto_ms = cfg.initial_rto_ms;
+    s.tokens = cfg.burst;
+    s.last_refill_ns = now_ns();
+    s.cb = cb;
+    s.cb_ctx = cb_ctx;
+
+    for (;;) {
+        uint64_t now = now_ns();
+        int blocked = 0;
+        int sends = 0;
+
+        refill_tokens(&s, now);
+        expire_timers(&s, now);
+
+        /* Send phase: retries and new targets share the token bucket */
+        while (cfg.max_pps <= 0 || s.tokens >= 1.0) {
+            if (s.queue_len == 0) {
+                if (exhausted || s.free_count == 0) break;
+
+                uint32_t addr;
+                if (!next(next_ctx, &addr)) {
+                    exhausted = 1;
+                    break;
+                }
+
+                uint16_t slot = s.free_list[--s.free_count];
+                probe_slot_t *p = &s.slots[slot];
+                p->addr = addr;
+                p->gen_base = s.next_gen;
+                p->attempts = 0;
+                p->state = SLOT_PENDING;
+                s.next_gen = (uint16_t)(s.next_gen + cfg.max_retries + 1);
+                s.busy++;
+                queue_push(&s, slot);
+            }
+
+            uint16_t slot = s.queue[s.queue_head];
+            if (s.slots[slot].state == SLOT_ANSWERED) {
+                queue_pop(&s);
+                release_slot(&s, slot);
+                continue;
+            }
+
+            if (send_slot(&s, slot, now) != 0) {
+                blocked = 1;
+                break;
+            }
+            queue_pop(&s);
+
+            /* Keep the receive buffer from overflowing during long bursts */
+            if ((++sends & 63) == 0) {
+                tp->drain(tp->ctx, &s);
+            }
+        }
+
+        if (exhausted && s.busy == 0) {
+            break;
+        }
+
+        /* Sleep until the next timer, token or transport wakeup */
+        int wait_ms = -1;
+        if (s.heap_len > 0) {
+            uint64_t d = s.heap[0].deadline_ns;
+            wait_ms = d > now ? (int)((d - now + NS_PER_MS - 1) / NS_PER_MS) : 0;
+        }
+
+        int have_work = s.queue_len > 0 || (!exhausted && s.free_count > 0);
+        if (blocked) {
+            wait_ms = (wait_ms < 0 || wait_ms > 1) ? 1 : wait_ms;
+        } else if (have_work && cfg.max_pps > 0 && s.tokens < 1.0) {
+            int token_ms = (int)((1.0 - s.tokens) * 1000.0 / cfg.max_pps) + 1;
+            if (wait_ms < 0 || token_ms < wait_ms) wait_ms = token_ms;
+        } else if (have_work) {
+            wait_ms = 0;
+        }
+        if (wait_ms < 0) {
+            wait_ms = cfg.max_rto_ms;  /* Defensive: nothing armed */
+        }
+
+        tp->wait(tp->ctx, wait_ms);
+        tp->drain(tp->ctx, &s);
+    }
+
+    s.stats.srtt_ms = s.have_rtt ? (int)(s.srtt + 0.5) : 0;
+    s.stats.rto_ms = s.rto_ms;
+    if (stats != NULL) {
+        *stats = s.stats;
+    }
+
+    free(s.slots);
+    free(s.free_list);
+    free(s.queue);
+    free(s.sent_ns);
+    free(s.heap);
+    return (int)s.stats.replies;
+}
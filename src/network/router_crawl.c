@@ -0,0 +1,507 @@
+/*
+ * Router Crawler
+ * Worker pool draining a FIFO of per-router SNMP tasks. The FIFO order
+ * makes the crawl breadth-first over the next-hop graph.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "snmp.h"
+#include "host_index.h"
+#include "arena.h"
+#include "router_crawl.h"
+#include "cred_cache.h"
+#include "topology.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#define OID_IP_NET_TO_MEDIA_NET_ADDRESS "1.3.6.1.2.1.4.22.1.3"
+#define OID_IP_ROUTE_NEXT_HOP "1.3.6.1.2.1.4.21.1.7"
+#define OID_IP_AD_ENT_ADDR "1.3.6.1.2.1.4.20.1.1"
+#define OID_IP_AD_ENT_NET_MASK "1.3.6.1.2.1.4.20.1.3"
+
+typedef enum {
+    TASK_PROBE,           /* Find a community the router answers to */
+    TASK_INTERFACES,
+    TASK_NEXTHOPS,
+    TASK_ARP
+} crawl_task_kind_t;
+
+typedef struct {
+    int32_t router;
+    crawl_task_kind_t kind;
+} crawl_task_t;
+
+typedef struct {
+    uint32_t addr;
+    const char *community;        /* Interned; NULL until probed */
+} crawl_router_t;
+
+/* Addresses collected by one walk, merged under the lock afterwards */
+typedef struct {
+    uint32_t *addrs;
+    uint32_t *masks;              /* Interface walks: netmask per address, 0 = not seen */
+    int count;
+    int cap;
+} addr_list_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+
+    chunk_array_t routers;         /* crawl_router_t; entries never move */
+    int router_count;
+    host_index_t router_index;     /* Router address -> routers slot */
+    string_pool_t strings;         /* Accepted communities, one copy each */
+
+    crawl_task_t *tasks;
+    int task_head;
+    int task_count;
+    int task_cap;
+    int active;                    /* Tasks currently being run */
+    int failed;                    /* Allocation failure: stop scheduling */
+
+    int community_count;
+    const char *const *communities;
+    const crawl_config_t *cfg;
+    crawl_host_cb cb;
+    void *cb_ctx;
+    crawl_stats_t stats;
+} crawler_t;
+
+void crawl_config_default(crawl_config_t *cfg)
+{
+    cfg->workers = CRAWL_DEFAULT_WORKERS;
+    cfg->max_routers = CRAWL_DEFAULT_MAX_ROUTERS;
+    cfg->timeout_ms = SNMP_DEFAULT_TIMEOUT_MS;
+    cfg->retries = SNMP_DEFAULT_RETRIES;
+    cfg->verbose = 1;
+}
+
+static void format_addr(uint32_t addr, char *ip)
+{
+    struct in_addr in;
+    in.s_addr = htonl(addr);
+    inet_ntop(AF_INET, &in, ip, MAX_IP_LEN);
+}
+
+static int is_private_addr(uint32_t addr)
+{
+    return (addr >> 24) == 10 ||
+           (addr & 0xfff00000U) == 0xac100000U ||    /* 172.16/12 */
+           (addr & 0xffff0000U) == 0xc0a80000U;      /* 192.168/16 */
+}
+
+/* Caller holds the lock */
+static void push_task(crawler_t *c, int32_t router, crawl_task_kind_t kind)
+{
+    if (c->task_count == c->task_cap) {
+        /* Reclaim the consumed prefix before growing */
+        if (c->task_head > 0) {
+            memmove(c->tasks, c->tasks + c->task_head,
+                    (size_t)(c->task_count - c->task_head) * sizeof(*c->tasks));
+            c->task_count -= c->task_head;
+            c->task_head = 0;
+        }
+        if (c->task_count == c->task_cap) {
+            int cap = c->task_cap ? c->task_cap * 2 : 64;
+            crawl_task_t *tasks = realloc(c->tasks, (size_t)cap * sizeof(*tasks));
+            if (tasks == NULL) {
+                c->failed = 1;
+                return;
+            }
+            c->tasks = tasks;
+            c->task_cap = cap;
+        }
+    }
+
+    c->tasks[c->task_count].router = router;
+    c->tasks[c->task_count].kind = kind;
+    c->task_count++;
+    pthread_cond_signal(&c->wake);
+}
+
+/*
+ * Add a router to the graph and queue its credential probe; via is the
+ * router whose next-hop table named it, 0 for seeds
+ * Caller holds the lock. Returns 1 if new, 0 if known or not added.
+ */
+static int add_router(crawler_t *c, uint32_t addr, uint32_t via)
+{
+    if (c->cfg->max_routers > 0 && c->router_count >= c->cfg->max_routers) {
+        return 0;
+    }
+
+    crawl_router_t *router = chunk_array_reserve(&c->routers, (uint32_t)c->router_count);
+    if (router == NULL) {
+        c->failed = 1;
+        return 0;
+    }
+    int rc = host_index_insert(&c->router_index, addr, c->router_count, NULL);
+    if (rc <= 0) {
+        if (rc < 0) c->failed = 1;
+        return 0;
+    }
+
+    router->addr = addr;
+    router->community = NULL;
+    if (via == 0) {
+        topo_add_router(addr, 1);
+    }
+    push_task(c, c->router_count, TASK_PROBE);
+    c->router_count++;
+    c->stats.routers_seen++;
+
+    if (c->cb != NULL) {
+        c->cb(addr, CRAWL_SOURCE_ROUTER, via, c->cb_ctx);
+        c->stats.hosts_reported++;
+    }
+    return 1;
+}
+
+static int open_session(const crawler_t *c, uint32_t addr, const char *community, snmp_session_t *s)
+{
+    char ip[MAX_IP_LEN];
+
+    format_addr(addr, ip);
+    if (snmp_open(s, ip, DEFAULT_SNMP_PORT, community) != NETMON_SUCCESS) {
+        return -1;
+    }
+    s->timeout_ms = c->cfg->timeout_ms;
+    s->retries = c->cfg->retries;
+    return 0;
+}
+
+/*
+ * Find a community the router answers to: the cached credential first,
+ * then every candidate at once. The winner is saved in the cache.
+ * Returns 1 (cached), 2 (probed) with community filled in, or 0.
+ */
+static int probe_router(crawler_t *c, uint32_t addr, char *community, size_t size)
+{
+    snmp_session_t s;
+    char cached[MAX_COMMUNITY_LEN];
+
+    if (open_session(c, addr, c->communities[0], &s) != 0) {
+        return 0;
+    }
+
+    if (cred_cache_lookup(addr, cached, sizeof(cached))) {
+        const char *one[] = { cached };
+        int rc = snmp_probe_communities(&s, one, 1);
+        if (rc >= 0 || rc == NETMON_NO_RESPONSE) {
+            snprintf(community, size, "%s", s.community);
+            snmp_close(&s);
+            return rc >= 0 ? 1 : 0;
+        }
+        cred_cache_forget(addr);   /* Credential changed since the last run */
+    }
+
+    int rc = snmp_probe_communities(&s, c->communities, c->community_count);
+    if (rc >= 0) {
+        snprintf(community, size, "%s", s.community);
+        cred_cache_store(addr, community);
+    }
+    snmp_close(&s);
+    return rc >= 0 ? 2 : 0;
+}
+
+static int append_addr(addr_list_t *list, uint32_t addr)
+{
+    if (list->count == list->cap) {
+        int cap = list->cap ? list->cap * 2 : 64;
+        uint32_t *addrs = realloc(list->addrs, (size_t)cap * sizeof(*addrs));
+        if (addrs == NULL) {
+            return 0;
+        }
+        list->addrs = addrs;
+        if (list->masks != NULL) {
+            uint32_t *masks = realloc(list->masks, (size_t)cap * sizeof(*masks));
+            if (masks == NULL) {
+                return 0;
+            }
+            list->masks = masks;
+            memset(masks + list->count, 0, (size_t)(cap - list->count) * sizeof(*masks));
+        }
+        list->cap = cap;
+    }
+    list->addrs[list->count++] = addr;
+    return 1;
+}
+
+static int collect_ipaddr_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    if (vb->type != SNMP_TYPE_IPADDRESS) {
+        return 0;
+    }
+    return !append_addr(ctx, vb->ipaddr);
+}
+
+/*
+ * ipAdEntTable cell: both columns are indexed by the address itself, so
+ * a row is found by its index. Shared GetBulks keep the columns within a
+ * response of each other, so only the newest rows are searched.
+ */
+static int collect_ipaddr_row_cb(int column, const snmp_varbind_t *vb, void *ctx)
+{
+    addr_list_t *list = ctx;
+
+    if (vb->type != SNMP_TYPE_IPADDRESS || vb->oid.len < 4) {
+        return 0;
+    }
+    const uint32_t *ids = vb->oid.ids + vb->oid.len - 4;
+    uint32_t addr = (ids[0] & 0xff) << 24 | (ids[1] & 0xff) << 16 | (ids[2] & 0xff) << 8 | (ids[3] & 0xff);
+
+    int row = list->count - 1;
+    while (row >= 0 && row >= list->count - 16 && list->addrs[row] != addr) {
+        row--;
+    }
+    if (row < 0 || list->addrs[row] != addr) {
+        if (!append_addr(list, addr)) {
+            return 1;
+        }
+        row = list->count - 1;
+    }
+    if (column == 1) {
+        list->masks[row] = vb->ipaddr;
+    }
+    return 0;
+}
+
+static int walk_column(crawler_t *c, uint32_t addr, const char *community, const char *column,
+                       addr_list_t *list)
+{
+    snmp_session_t s;
+    snmp_oid_t root;
+
+    snmp_oid_parse(column, &root);
+    if (open_session(c, addr, community, &s) != 0) {
+        return NETMON_ERROR;
+    }
+    int rc = snmp_bulkwalk(&s, &root, collect_ipaddr_cb, list);
+    snmp_close(&s);
+    return rc;
+}
+
+/* Interface addresses with their netmasks in one multi-column walk */
+static int walk_interfaces(crawler_t *c, uint32_t addr, const char *community, addr_list_t *list)
+{
+    snmp_session_t s;
+    snmp_oid_t columns[2];
+
+    snmp_oid_parse(OID_IP_AD_ENT_ADDR, &columns[0]);
+    snmp_oid_parse(OID_IP_AD_ENT_NET_MASK, &columns[1]);
+    list->masks = calloc(1, sizeof(uint32_t));
+    if (list->masks == NULL || open_session(c, addr, community, &s) != 0) {
+        return NETMON_ERROR;
+    }
+    int rc = snmp_table_walk(&s, columns, 2, collect_ipaddr_row_cb, list);
+    snmp_close(&s);
+    return rc;
+}
+
+/* Merge a finished walk into the graph; caller holds the lock */
+static void merge_walk(crawler_t *c, const crawl_router_t *router, crawl_task_kind_t kind,
+                       const addr_list_t *list)
+{
+    char ip[MAX_IP_LEN];
+    int added = 0;
+
+    format_addr(router->addr, ip);
+
+    for (int i = 0; i < list->count; i++) {
+        uint32_t addr = list->addrs[i];
+
+        /* Skip loopback and unset addresses */
+        if (addr == 0 || (addr >> 24) == 127) continue;
+
+        if (kind == TASK_NEXTHOPS) {
+            /* Only private next hops are treated as routers to crawl */
+            if (addr == router->addr || !is_private_addr(addr)) continue;
+            topo_add_link(router->addr, addr);
+            if (add_router(c, addr, router->addr)) {
+                added++;
+                if (c->cfg->verbose) {
+                    char hop[MAX_IP_LEN];
+                    format_addr(addr, hop);
+                    printf("  [%s] Next-hop: %s\n", ip, hop);
+                }
+            }
+        } else {
+            if (kind == TASK_INTERFACES) {
+                topo_add_interface(router->addr, addr, list->masks != NULL ? list->masks[i] : 0);
+            }
+            if (c->cb == NULL) continue;
+            c->cb(addr, kind == TASK_INTERFACES ? CRAWL_SOURCE_INTERFACE : CRAWL_SOURCE_ARP,
+                  router->addr, c->cb_ctx);
+            c->stats.hosts_reported++;
+            added++;
+        }
+    }
+
+    if (c->cfg->verbose && kind != TASK_NEXTHOPS) {
+        printf("  [%s] %s: %d\n", ip,
+               kind == TASK_INTERFACES ? "Router interfaces found" : "Hosts in ARP table",
+               added);
+    }
+}
+
+static void run_task(crawler_t *c, crawl_task_t task)
+{
+    char ip[MAX_IP_LEN];
+    char community[MAX_COMMUNITY_LEN];
+
+    pthread_mutex_lock(&c->lock);
+    crawl_router_t *slot = chunk_array_at(&c->routers, (uint32_t)task.router);
+    crawl_router_t router = *slot;
+    pthread_mutex_unlock(&c->lock);
+
+    if (task.kind == TASK_PROBE) {
+        int found = probe_router(c, router.addr, community, sizeof(community));
+
+        pthread_mutex_lock(&c->lock);
+        format_addr(router.addr, ip);
+        if (found) {
+            slot->community = string_pool_intern(&c->strings, community, strlen(community));
+            if (slot->community == NULL) {
+                c->failed = 1;
+                found = 0;
+            }
+        }
+        if (found) {
+            router.community = slot->community;
+            c->stats.routers_snmp++;
+            if (c->cfg->verbose) {
+                printf("  [%s] SNMP community '%s' accepted%s\n", ip, router.community,
+                       found == 1 ? " (cached)" : "");
+            }
+            /* The three walks run on separate workers */
+            push_task(c, task.router, TASK_INTERFACES);
+            push_task(c, task.router, TASK_NEXTHOPS);
+            push_task(c, task.router, TASK_ARP);
+        } else if (c->cfg->verbose) {
+            printf("  [%s] No SNMP access (router may use different credentials)\n", ip);
+        }
+        pthread_mutex_unlock(&c->lock);
+        return;
+    }
+
+    addr_list_t list = { NULL, NULL, 0, 0 };
+
+    if (task.kind == TASK_INTERFACES) {
+        walk_interfaces(c, router.addr, router.community, &list);
+    } else {
+        walk_column(c, router.addr, router.community,
+                    task.kind == TASK_NEXTHOPS ? OID_IP_ROUTE_NEXT_HOP : OID_IP_NET_TO_MEDIA_NET_ADDRESS,
+                    &list);
+    }
+
+    pthread_mutex_lock(&c->lock);
+    merge_walk(c, &router, task.kind, &list);
+    pthread_mutex_unlock(&c->lock);
+
+    free(list.addrs);
+    free(list.masks);
+}
+
+static void *crawl_worker(void *arg)
+{
+    crawler_t *c = arg;
+
+    pthread_mutex_lock(&c->lock);
+    for (;;) {
+        while (c->task_head == c->task_count && c->active > 0 && !c->failed) {
+            pthread_cond_wait(&c->wake, &c->lock);
+        }
+        if (c->task_head == c->task_count || c->failed) {
+            break;   /* Queue drained and nothing running can add more */
+        }
+
+        crawl_task_t task = c->tasks[c->task_head++];
+        c->active++;
+        pthread_mutex_unlock(&c->lock);
+
+        run_task(c, task);
+
+        pthread_mutex_lock(&c->lock);
+        c->active--;
+        if (c->active == 0 && c->task_head == c->task_count) {
+            pthread_cond_broadcast(&c->wake);
+        }
+    }
+    pthread_cond_broadcast(&c->wake);
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+int router_crawl(const crawl_config_t *cfg, const uint32_t *seeds, int seed_count,
+                 const char *const *communities, crawl_host_cb cb, void *ctx,
+                 crawl_stats_t *stats)
+{
+    crawl_config_t defaults;
+    crawler_t c;
+    pthread_t *threads;
+    int started = 0;
+
+    if (cfg == NULL) {
+        crawl_config_default(&defaults);
+        cfg = &defaults;
+    }
+    if (communities == NULL || communities[0] == NULL || seeds == NULL) {
+        return -1;
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.routers.elem_size = sizeof(crawl_router_t);
+    pthread_mutex_init(&c.lock, NULL);
+    pthread_cond_init(&c.wake, NULL);
+    c.cfg = cfg;
+    c.communities = communities;
+    while (communities[c.community_count] != NULL) {
+        c.community_count++;
+    }
+    c.cb = cb;
+    c.cb_ctx = ctx;
+
+    /* The graph shows this crawl only; routers that went away drop out */
+    topo_clear();
+    for (int i = 0; i < seed_count; i++) {
+        add_router(&c, seeds[i], 0);
+    }
+
+    int workers = cfg->workers > 0 ? cfg->workers : 1;
+    threads = malloc((size_t)workers * sizeof(*threads));
+    if (threads != NULL) {
+        for (; started < workers; started++) {
+            if (pthread_create(&threads[started], NULL, crawl_worker, &c) != 0) {
+                break;
+            }
+        }
+    }
+
+    if (started == 0) {
+        /* No threads available: run the crawl on the caller's thread */
+        crawl_worker(&c);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (stats != NULL) {
+        *stats = c.stats;
+    }
+
+    free(threads);
+    chunk_array_free(&c.routers);
+    string_pool_free(&c.strings);
+    free(c.tasks);
+    host_index_free(&c.router_index);
+    pthread_cond_destroy(&c.wake);
+    pthread_mutex_destroy(&c.lock);
+
+    return c.failed && c.stats.routers_snmp == 0 ? -1 : c.stats.routers_snmp;
+}
@@ -0,0 +1,398 @@
+/*
+ * Kernel Neighbor and Route Tables
+ * RTM_GETNEIGH / RTM_GETROUTE dumps over a NETLINK_ROUTE socket, with
+ * /proc/net/arp and /proc/net/route as fallbacks, plus the generic dump
+ * loop shared with other netlink families.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "rtnl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+
+#define RTNL_RECV_BUF_SIZE 32768
+#define RTNL_TIMEOUT_MS 1000
+
+/* /proc/net/arp flag bits (net/if_arp.h) */
+#define PROC_ATF_COM 0x02
+#define PROC_ATF_PERM 0x04
+
+/* /proc/net/route flag bits (net/route.h) */
+#define PROC_RTF_UP 0x0001
+#define PROC_RTF_GATEWAY 0x0002
+
+int netlink_dump(int protocol, uint16_t type, const void *body, size_t body_len,
+                 netlink_msg_fn fn, void *ctx)
+{
+    struct {
+        struct nlmsghdr nh;
+        char body[64];
+    } req;
+    struct sockaddr_nl kernel = { .nl_family = AF_NETLINK };
+    struct timeval tv = { RTNL_TIMEOUT_MS / 1000, (RTNL_TIMEOUT_MS % 1000) * 1000 };
+    static uint32_t next_seq = 0;
+    int rc = -1;
+
+    if (body_len > sizeof(req.body)) {
+        return -1;
+    }
+
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, protocol);
+    if (fd < 0) {
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    char *buf = malloc(RTNL_RECV_BUF_SIZE);
+    if (buf == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(body_len);
+    req.nh.nlmsg_type = type;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = __atomic_add_fetch(&next_seq, 1, __ATOMIC_RELAXED);
+    memcpy(NLMSG_DATA(&req.nh), body, body_len);
+
+    if (sendto(fd, &req, req.nh.nlmsg_len, 0,
+               (struct sockaddr *)&kernel, sizeof(kernel)) < 0) {
+        goto out;
+    }
+
+    for (;;) {
+        struct sockaddr_nl from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, buf, RTNL_RECV_BUF_SIZE, 0,
+                             (struct sockaddr *)&from, &from_len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            goto out;
+        }
+        if (from.nl_pid != 0) {
+            continue;   /* Not from the kernel */
+        }
+
+        int len = (int)n;
+        for (struct nlmsghdr *nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len);
+             nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != req.nh.nlmsg_seq) {
+                continue;
+            }
+            if (nh->nlmsg_type == NLMSG_DONE) {
+                rc = 0;
+                goto out;
+            }
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                goto out;
+            }
+            if (fn(nh, ctx) != 0) {
+                rc = 0;
+                goto out;
+            }
+        }
+    }
+
+out:
+    free(buf);
+    close(fd);
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/* Neighbors                                                          */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    rtnl_neigh_cb cb;
+    void *ctx;
+    int count;
+    int stopped;
+} neigh_walk_t;
+
+static int neigh_usable(uint16_t state)
+{
+    return !(state & (NUD_FAILED | NUD_INCOMPLETE | NUD_NOARP)) && state != NUD_NONE;
+}
+
+static int neigh_msg(const struct nlmsghdr *nh, void *ctx)
+{
+    neigh_walk_t *walk = ctx;
+    const struct ndmsg *nd = NLMSG_DATA(nh);
+    rtnl_neigh_t n;
+    int have_dst = 0;
+
+    if (nh->nlmsg_type != RTM_NEWNEIGH || nh->nlmsg_len < NLMSG_LENGTH(sizeof(*nd)) ||
+        nd->ndm_family != AF_INET || !neigh_usable(nd->ndm_state)) {
+        return 0;
+    }
+
+    memset(&n, 0, sizeof(n));
+    n.ifindex = nd->ndm_ifindex;
+    n.state = nd->ndm_state;
+
+    int attr_len = (int)(nh->nlmsg_len - NLMSG_LENGTH(sizeof(*nd)));
+    for (const struct rtattr *rta = (const struct rtattr *)((const char *)nd + NLMSG_ALIGN(sizeof(*nd)));
+         RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+        if (rta->rta_type == NDA_DST && RTA_PAYLOAD(rta) == 4) {
+            uint32_t be;
+            memcpy(&be, RTA_DATA(rta), 4);
+            n.addr = ntohl(be);
+            have_dst = 1;
+        } else if (rta->rta_type == NDA_LLADDR && RTA_PAYLOAD(rta) <= RTNL_MAX_LLADDR) {
+            n.lladdr_len = (int)RTA_PAYLOAD(rta);
+            memcpy(n.lladdr, RTA_DATA(rta), (size_t)n.lladdr_len);
+        }
+    }
+
+    if (!have_dst || n.lladdr_len == 0) {
+        return 0;
+    }
+    if (if_indextoname((unsigned)n.ifindex, n.ifname) == NULL) {
+        n.ifname[0] = '\0';
+    }
+
+    walk->count++;
+    if (walk->cb(&n, walk->ctx) != 0) {
+        walk->stopped = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/* Parse "aa:bb:cc:dd:ee:ff"; returns the byte count or 0 */
+static int parse_lladdr(const char *text, uint8_t *out)
+{
+    int len = 0;
+
+    while (*text != '\0' && len < RTNL_MAX_LLADDR) {
+        char *end;
+        unsigned long byte = strtoul(text, &end, 16);
+        if (end == text || byte > 0xff) {
+            return 0;
+        }
+        out[len++] = (uint8_t)byte;
+        if (*end == '\0') break;
+        if (*end != ':') return 0;
+        text = end + 1;
+    }
+    return len;
+}
+
+/*
+ * /proc/net/arp:
+ * IP address  HW type  Flags  HW address  Mask  Device
+ */
+static int neigh_from_proc(neigh_walk_t *walk)
+{
+    char line[256];
+    FILE *fp = fopen("/proc/net/arp", "r");
+
+    if (fp == NULL) {
+        return -1;
+    }
+
+    if (fgets(line, sizeof(line), fp) == NULL) {   /* Header */
+        fclose(fp);
+        return 0;
+    }
+
+    while (!walk->stopped && fgets(line, sizeof(line), fp) != NULL) {
+        char ip[MAX_IP_LEN], hw[64], dev[IF_NAMESIZE];
+        unsigned int hw_type, flags;
+        struct in_addr in;
+        rtnl_neigh_t n;
+
+        if (sscanf(line, "%15s 0x%x 0x%x %63s %*s %15s", ip, &hw_type, &flags, hw, dev) != 5 ||
+            inet_pton(AF_INET, ip, &in) != 1 || !(flags & PROC_ATF_COM)) {
+            continue;
+        }
+
+        memset(&n, 0, sizeof(n));
+        n.addr = ntohl(in.s_addr);
+        n.lladdr_len = parse_lladdr(hw, n.lladdr);
+        if (n.lladdr_len == 0) {
+            continue;
+        }
+        snprintf(n.ifname, sizeof(n.ifname), "%s", dev);
+        n.ifindex = (int)if_nametoindex(dev);
+        n.state = (flags & PROC_ATF_PERM) ? NUD_PERMANENT : NUD_REACHABLE;
+
+        walk->count++;
+        if (walk->cb(&n, walk->ctx) != 0) {
+            walk->stopped = 1;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+int rtnl_neigh_foreach(rtnl_neigh_cb cb, void *ctx)
+{
+    struct ndmsg nd;
+    neigh_walk_t walk = { cb, ctx, 0, 0 };
+
+    if (cb == NULL) {
+        return -1;
+    }
+
+    memset(&nd, 0, sizeof(nd));
+    nd.ndm_family = AF_INET;
+
+    if (netlink_dump(NETLINK_ROUTE, RTM_GETNEIGH, &nd, sizeof(nd), neigh_msg, &walk) == 0 || walk.count > 0) {
+        return walk.count;   /* A partial dump is kept rather than repeated */
+    }
+    return neigh_from_proc(&walk) == 0 ? walk.count : -1;
+}
+
+const char *rtnl_neigh_state_name(uint16_t state)
+{
+    if (state & NUD_PERMANENT) return "PERMANENT";
+    if (state & NUD_NOARP) return "NOARP";
+    if (state & NUD_REACHABLE) return "REACHABLE";
+    if (state & NUD_STALE) return "STALE";
+    if (state & NUD_DELAY) return "DELAY";
+    if (state & NUD_PROBE) return "PROBE";
+    if (state & NUD_INCOMPLETE) return "INCOMPLETE";
+    if (state & NUD_FAILED) return "FAILED";
+    return "NONE";
+}
+
+void rtnl_format_lladdr(const uint8_t *lladdr, int len, char *buf, size_t buf_size)
+{
+    size_t pos = 0;
+
+    if (buf_size == 0) {
+        return;
+    }
+    buf[0] = '\0';
+    for (int i = 0; i < len && pos + 3 < buf_size; i++) {
+        pos += (size_t)snprintf(buf + pos, buf_size - pos, i ? ":%02x" : "%02x", lladdr[i]);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Default route                                                      */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    uint32_t gateway;
+    int ifindex;
+    uint32_t metric;
+    int found;
+} gateway_search_t;
+
+static int route_msg(const struct nlmsghdr *nh, void *ctx)
+{
+    gateway_search_t *search = ctx;
+    const struct rtmsg *rt = NLMSG_DATA(nh);
+    uint32_t table, gateway = 0, metric = 0;
+    int ifindex = 0, have_gateway = 0;
+
+    if (nh->nlmsg_type != RTM_NEWROUTE || nh->nlmsg_len < NLMSG_LENGTH(sizeof(*rt)) ||
+        rt->rtm_family != AF_INET || rt->rtm_dst_len != 0 || rt->rtm_type != RTN_UNICAST) {
+        return 0;
+    }
+
+    table = rt->rtm_table;
+    int attr_len = (int)(nh->nlmsg_len - NLMSG_LENGTH(sizeof(*rt)));
+    for (const struct rtattr *rta = RTM_RTA(rt); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+        if (rta->rta_type == RTA_GATEWAY && RTA_PAYLOAD(rta) == 4) {
+            uint32_t be;
+            memcpy(&be, RTA_DATA(rta), 4);
+            gateway = ntohl(be);
+            have_gateway = 1;
+        } else if (rta->rta_type == RTA_OIF && RTA_PAYLOAD(rta) == 4) {
+            memcpy(&ifindex, RTA_DATA(rta), 4);
+        } else if (rta->rta_type == RTA_PRIORITY && RTA_PAYLOAD(rta) == 4) {
+            memcpy(&metric, RTA_DATA(rta), 4);
+        } else if (rta->rta_type == RTA_TABLE && RTA_PAYLOAD(rta) == 4) {
+            memcpy(&table, RTA_DATA(rta), 4);
+        }
+    }
+
+    if (table == RT_TABLE_MAIN && have_gateway &&
+        (!search->found || metric < search->metric)) {
+        search->gateway = gateway;
+        search->ifindex = ifindex;
+        search->metric = metric;
+        search->found = 1;
+    }
+    return 0;
+}
+
+/*
+ * /proc/net/route, addresses in network byte order printed as hex:
+ * Iface  Destination  Gateway  Flags  RefCnt  Use  Metric  Mask ...
+ */
+static int gateway_from_proc(gateway_search_t *search)
+{
+    char line[256];
+    FILE *fp = fopen("/proc/net/route", "r");
+
+    if (fp == NULL) {
+        return -1;
+    }
+
+    if (fgets(line, sizeof(line), fp) != NULL) {   /* Header */
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            char dev[IF_NAMESIZE];
+            unsigned int dst, gw, flags, metric, mask;
+
+            if (sscanf(line, "%15s %x %x %x %*d %*d %u %x", dev, &dst, &gw, &flags, &metric, &mask) != 6 ||
+                dst != 0 || mask != 0 || (flags & (PROC_RTF_UP | PROC_RTF_GATEWAY)) != (PROC_RTF_UP | PROC_RTF_GATEWAY)) {
+                continue;
+            }
+            if (!search->found || metric < search->metric) {
+                search->gateway = ntohl(gw);
+                search->ifindex = (int)if_nametoindex(dev);
+                search->metric = metric;
+                search->found = 1;
+            }
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+int rtnl_default_gateway(uint32_t *gateway, int *ifindex)
+{
+    struct rtmsg rt;
+    gateway_search_t search;
+
+    if (gateway == NULL) {
+        return 0;
+    }
+
+    memset(&search, 0, sizeof(search));
+    memset(&rt, 0, sizeof(rt));
+    rt.rtm_family = AF_INET;
+
+    if (netlink_dump(NETLINK_ROUTE, RTM_GETROUTE, &rt, sizeof(rt), route_msg, &search) != 0) {
+        memset(&search, 0, sizeof(search));
+        gateway_from_proc(&search);
+    }
+
+    if (!search.found) {
+        return 0;
+    }
+    *gateway = search.gateway;
+    if (ifindex != NULL) {
+        *ifindex = search.ifindex;
+    }
+    return 1;
+}
@@ -0,0 +1,1080 @@
+/*
+ * SNMP v2c Client
+ * Native SNMPv2c over UDP: BER encoding/decoding of messages, request
+ * retransmission, and GetBulk-driven subtree walks. Replaces forking
+ * snmpwalk(1) and scraping its output.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "snmp.h"
+#include "selfstat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define SNMP_VERSION_2C 1
+#define SNMP_MAX_REQUEST_SIZE 4096
+#define BER_MAX_DEPTH 8
+
+static int default_timeout_ms = SNMP_DEFAULT_TIMEOUT_MS;
+static int default_retries = SNMP_DEFAULT_RETRIES;
+static int default_max_repetitions = SNMP_DEFAULT_MAX_REPETITIONS;
+
+void snmp_set_defaults(int timeout_ms, int retries, int max_repetitions)
+{
+    if (timeout_ms > 0) default_timeout_ms = timeout_ms;
+    if (retries >= 0) default_retries = retries;
+    if (max_repetitions > 0) default_max_repetitions = max_repetitions;
+}
+
+/* ------------------------------------------------------------------ */
+/* OID helpers                                                        */
+/* ------------------------------------------------------------------ */
+
+int snmp_oid_parse(const char *str, snmp_oid_t *oid)
+{
+    const char *p = str;
+
+    if (str == NULL || oid == NULL) {
+        return -1;
+    }
+
+    oid->len = 0;
+    if (*p == '.') p++;
+
+    while (*p != '\0') {
+        if (*p < '0' || *p > '9' || oid->len >= SNMP_MAX_OID_LEN) {
+            return -1;
+        }
+        uint64_t v = 0;
+        while (*p >= '0' && *p <= '9') {
+            v = v * 10 + (uint64_t)(*p - '0');
+            if (v > 0xffffffffULL) return -1;
+            p++;
+        }
+        oid->ids[oid->len++] = (uint32_t)v;
+        if (*p == '.') {
+            p++;
+            if (*p == '\0') return -1;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+
+    return oid->len >= 2 ? 0 : -1;
+}
+
+void snmp_oid_format(const snmp_oid_t *oid, char *buf, size_t size)
+{
+    size_t pos = 0;
+
+    if (size == 0) return;
+    buf[0] = '\0';
+
+    for (int i = 0; i < oid->len && pos < size; i++) {
+        int n = snprintf(buf + pos, size - pos, ".%u", oid->ids[i]);
+        if (n < 0) break;
+        pos += (size_t)n;
+    }
+}
+
+int snmp_oid_compare(const snmp_oid_t *a, const snmp_oid_t *b)
+{
+    int n = a->len < b->len ? a->len : b->len;
+    for (int i = 0; i < n; i++) {
+        if (a->ids[i] != b->ids[i]) {
+            return a->ids[i] < b->ids[i] ? -1 : 1;
+        }
+    }
+    return a->len == b->len ? 0 : (a->len < b->len ? -1 : 1);
+}
+
+int snmp_oid_is_prefix(const snmp_oid_t *prefix, const snmp_oid_t *oid)
+{
+    if (prefix->len > oid->len) {
+        return 0;
+    }
+    return memcmp(prefix->ids, oid->ids, (size_t)prefix->len * sizeof(uint32_t)) == 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* BER encoder                                                        */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t pos;
+    size_t stack[BER_MAX_DEPTH];   /* Start offsets of open constructions */
+    int depth;
+    int error;
+} ber_writer_t;
+
+static void ber_put(ber_writer_t *w, const void *data, size_t len)
+{
+    if (w->error || w->pos + len > w->size) {
+        w->error = 1;
+        return;
+    }
+    memcpy(w->buf + w->pos, data, len);
+    w->pos += len;
+}
+
+static void ber_put_byte(ber_writer_t *w, uint8_t b)
+{
+    ber_put(w, &b, 1);
+}
+
+static size_t ber_length_size(size_t len)
+{
+    if (len < 0x80) return 1;
+    if (len <= 0xff) return 2;
+    if (len <= 0xffff) return 3;
+    return 4;
+}
+
+static void ber_encode_length(uint8_t *out, size_t len)
+{
+    size_t n = ber_length_size(len);
+    if (n == 1) {
+        out[0] = (uint8_t)len;
+        return;
+    }
+    out[0] = (uint8_t)(0x80 | (n - 1));
+    for (size_t i = n - 1; i >= 1; i--) {
+        out[i] = (uint8_t)(len & 0xff);
+        len >>= 8;
+    }
+}
+
+static void ber_put_tl(ber_writer_t *w, uint8_t tag, size_t len)
+{
+    uint8_t hdr[5];
+    hdr[0] = tag;
+    ber_encode_length(hdr + 1, len);
+    ber_put(w, hdr, 1 + ber_length_size(len));
+}
+
+static void ber_begin(ber_writer_t *w, uint8_t tag)
+{
+    if (w->depth >= BER_MAX_DEPTH) {
+        w->error = 1;
+        return;
+    }
+    ber_put_byte(w, tag);
+    w->stack[w->depth++] = w->pos;
+}
+
+/* Close the innermost construction, inserting its minimal length */
+static void ber_end(ber_writer_t *w)
+{
+    if (w->error || w->depth == 0) {
+        w->error = 1;
+        return;
+    }
+
+    size_t start = w->stack[--w->depth];
+    size_t content = w->pos - start;
+    size_t lsize = ber_length_size(content);
+
+    if (w->pos + lsize > w->size) {
+        w->error = 1;
+        return;
+    }
+    memmove(w->buf + start + lsize, w->buf + start, content);
+    ber_encode_length(w->buf + start, content);
+    w->pos += lsize;
+}
+
+static void ber_put_integer(ber_writer_t *w, int64_t v)
+{
+    uint8_t tmp[8];
+    int n = 8;
+
+    for (int i = 7; i >= 0; i--) {
+        tmp[i] = (uint8_t)(v & 0xff);
+        v >>= 8;
+    }
+    /* Strip redundant leading sign bytes */
+    int i = 0;
+    while (i < 7 && ((tmp[i] == 0x00 && !(tmp[i + 1] & 0x80)) ||
+                     (tmp[i] == 0xff && (tmp[i + 1] & 0x80)))) {
+        i++;
+        n--;
+    }
+    ber_put_tl(w, SNMP_TYPE_INTEGER, (size_t)n);
+    ber_put(w, tmp + i, (size_t)n);
+}
+
+static void ber_put_octets(ber_writer_t *w, const void *data, size_t len)
+{
+    ber_put_tl(w, SNMP_TYPE_OCTET_STRING, len);
+    ber_put(w, data, len);
+}
+
+static void ber_put_oid(ber_writer_t *w, const snmp_oid_t *oid)
+{
+    uint8_t tmp[SNMP_MAX_OID_LEN * 5];
+    size_t n = 0;
+
+    if (oid->len < 2) {
+        w->error = 1;
+        return;
+    }
+
+    uint32_t first = oid->ids[0] * 40 + oid->ids[1];
+    for (int i = 1; i < oid->len; i++) {
+        uint32_t v = (i == 1) ? first : oid->ids[i];
+        uint8_t rev[5];
+        int k = 0;
+        do {
+            rev[k++] = (uint8_t)(v & 0x7f);
+            v >>= 7;
+        } while (v != 0);
+        while (k > 0) {
+            k--;
+            tmp[n++] = (uint8_t)(rev[k] | (k > 0 ? 0x80 : 0x00));
+        }
+    }
+    ber_put_tl(w, SNMP_TYPE_OID, n);
+    ber_put(w, tmp, n);
+}
+
+/*
+ * Encode a complete SNMPv2c request message
+ * Returns the encoded length, or 0 on overflow
+ */
+static size_t encode_request(uint8_t *buf, size_t size, const char *community,
+                             uint8_t pdu_type, int32_t request_id,
+                             int non_repeaters, int max_repetitions,
+                             const snmp_oid_t *oids, int oid_count)
+{
+    ber_writer_t w;
+    memset(&w, 0, sizeof(w));
+    w.buf = buf;
+    w.size = size;
+
+    ber_begin(&w, 0x30);                          /* Message */
+    ber_put_integer(&w, SNMP_VERSION_2C);
+    ber_put_octets(&w, community, strlen(community));
+
+    ber_begin(&w, pdu_type);
+    ber_put_integer(&w, request_id);
+    if (pdu_type == SNMP_PDU_GETBULK) {
+        ber_put_integer(&w, non_repeaters);
+        ber_put_integer(&w, max_repetitions);
+    } else {
+        ber_put_integer(&w, 0);                   /* error-status */
+        ber_put_integer(&w, 0);                   /* error-index */
+    }
+
+    ber_begin(&w, 0x30);                          /* Varbind list */
+    for (int i = 0; i < oid_count; i++) {
+        ber_begin(&w, 0x30);
+        ber_put_oid(&w, &oids[i]);
+        ber_put_tl(&w, SNMP_TYPE_NULL, 0);
+        ber_end(&w);
+    }
+    ber_end(&w);
+
+    ber_end(&w);                                  /* PDU */
+    ber_end(&w);                                  /* Message */
+
+    return w.error ? 0 : w.pos;
+}
+
+/* ------------------------------------------------------------------ */
+/* BER decoder                                                        */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} ber_reader_t;
+
+/*
+ * Read one TLV header; on success sub covers the value bytes and r is
+ * advanced past the whole element. Returns 0 or -1 on malformed input.
+ */
+static int ber_read(ber_reader_t *r, uint8_t *tag, ber_reader_t *sub)
+{
+    if (r->end - r->p < 2) {
+        return -1;
+    }
+
+    *tag = *r->p++;
+    size_t len = *r->p++;
+    if (len & 0x80) {
+        size_t n = len & 0x7f;
+        if (n == 0 || n > 4 || (size_t)(r->end - r->p) < n) {
+            return -1;
+        }
+        len = 0;
+        while (n-- > 0) {
+            len = (len << 8) | *r->p++;
+        }
+    }
+    if ((size_t)(r->end - r->p) < len) {
+        return -1;
+    }
+
+    sub->p = r->p;
+    sub->end = r->p + len;
+    r->p += len;
+    return 0;
+}
+
+static int ber_expect(ber_reader_t *r, uint8_t want, ber_reader_t *sub)
+{
+    uint8_t tag;
+    if (ber_read(r, &tag, sub) != 0 || tag != want) {
+        return -1;
+    }
+    return 0;
+}
+
+static int64_t ber_decode_signed(const ber_reader_t *v)
+{
+    size_t len = (size_t)(v->end - v->p);
+    int64_t x = (len > 0 && (v->p[0] & 0x80)) ? -1 : 0;
+    for (size_t i = 0; i < len && i < 8; i++) {
+        x = (int64_t)(((uint64_t)x << 8) | v->p[i]);
+    }
+    return x;
+}
+
+static uint64_t ber_decode_unsigned(const ber_reader_t *v)
+{
+    uint64_t x = 0;
+    for (const uint8_t *p = v->p; p < v->end; p++) {
+        x = (x << 8) | *p;
+    }
+    return x;
+}
+
+static int ber_decode_oid(const ber_reader_t *v, snmp_oid_t *oid)
+{
+    const uint8_t *p = v->p;
+    uint64_t acc = 0;
+
+    oid->len = 0;
+    if (p >= v->end) {
+        return -1;
+    }
+
+    while (p < v->end) {
+        acc = (acc << 7) | (*p & 0x7f);
+        if (acc > 0xffffffffULL) return -1;
+        if (!(*p & 0x80)) {
+            if (oid->len == 0) {
+                uint32_t first = (uint32_t)acc;
+                if (first < 80) {
+                    oid->ids[0] = first / 40;
+                    oid->ids[1] = first % 40;
+                } else {
+                    oid->ids[0] = 2;
+                    oid->ids[1] = first - 80;
+                }
+                oid->len = 2;
+            } else {
+                if (oid->len >= SNMP_MAX_OID_LEN) return -1;
+                oid->ids[oid->len++] = (uint32_t)acc;
+            }
+            acc = 0;
+        }
+        p++;
+    }
+    return 0;
+}
+
+static int decode_value(uint8_t tag, const ber_reader_t *v, snmp_varbind_t *vb)
+{
+    vb->type = tag;
+    vb->data = NULL;
+    vb->data_len = 0;
+
+    switch (tag) {
+        case SNMP_TYPE_INTEGER:
+            vb->integer = ber_decode_signed(v);
+            break;
+        case SNMP_TYPE_COUNTER32:
+        case SNMP_TYPE_GAUGE32:
+        case SNMP_TYPE_TIMETICKS:
+        case SNMP_TYPE_COUNTER64:
+            vb->counter = ber_decode_unsigned(v);
+            break;
+        case SNMP_TYPE_IPADDRESS:
+            if (v->end - v->p != 4) return -1;
+            vb->ipaddr = ((uint32_t)v->p[0] << 24) | ((uint32_t)v->p[1] << 16) |
+                         ((uint32_t)v->p[2] << 8) | v->p[3];
+            break;
+        case SNMP_TYPE_OID:
+            return ber_decode_oid(v, &vb->oid_value);
+        case SNMP_TYPE_OCTET_STRING:
+        case SNMP_TYPE_OPAQUE:
+            vb->data = v->p;
+            vb->data_len = (size_t)(v->end - v->p);
+            break;
+        default:
+            /* NULL and exception values carry no content */
+            break;
+    }
+    return 0;
+}
+
+/*
+ * Decode a response message answering one of the id_count consecutive
+ * request ids starting at first_id; *which is set to its offset.
+ * Returns 0 if it was a well-formed matching response, 1 if it is some
+ * other message (ignore), -1 if malformed.
+ */
+static int decode_response(const uint8_t *buf, size_t len, int32_t first_id, int id_count,
+                           int *which, int *error_status, ber_reader_t *varbinds)
+{
+    ber_reader_t r = { buf, buf + len };
+    ber_reader_t msg, field, pdu;
+    uint8_t tag;
+
+    if (ber_expect(&r, 0x30, &msg) != 0) return -1;
+    if (ber_expect(&msg, SNMP_TYPE_INTEGER, &field) != 0) return -1;
+    if (ber_decode_signed(&field) != SNMP_VERSION_2C) return 1;
+    if (ber_expect(&msg, SNMP_TYPE_OCTET_STRING, &field) != 0) return -1;
+    if (ber_read(&msg, &tag, &pdu) != 0) return -1;
+    if (tag != SNMP_PDU_RESPONSE) return 1;
+
+    if (ber_expect(&pdu, SNMP_TYPE_INTEGER, &field) != 0) return -1;
+    int64_t offset = ber_decode_signed(&field) - first_id;
+    if (offset < 0 || offset >= id_count) return 1;
+    *which = (int)offset;
+    if (ber_expect(&pdu, SNMP_TYPE_INTEGER, &field) != 0) return -1;
+    *error_status = (int)ber_decode_signed(&field);
+    if (ber_expect(&pdu, SNMP_TYPE_INTEGER, &field) != 0) return -1;
+    if (ber_expect(&pdu, 0x30, varbinds) != 0) return -1;
+    return 0;
+}
+
+/*
+ * Walk a decoded varbind list, calling cb for each entry
+ * Returns the number delivered, or -1 if malformed
+ */
+static int deliver_varbinds(ber_reader_t *list, snmp_varbind_cb cb, void *ctx)
+{
+    snmp_varbind_t vb;
+    int count = 0;
+
+    while (list->p < list->end) {
+        ber_reader_t entry, name, value;
+        uint8_t tag;
+
+        if (ber_expect(list, 0x30, &entry) != 0) return -1;
+        if (ber_expect(&entry, SNMP_TYPE_OID, &name) != 0) return -1;
+        if (ber_decode_oid(&name, &vb.oid) != 0) return -1;
+        if (ber_read(&entry, &tag, &value) != 0) return -1;
+        if (decode_value(tag, &value, &vb) != 0) return -1;
+
+        count++;
+        if (cb != NULL && cb(&vb, ctx) != 0) {
+            break;
+        }
+    }
+    return count;
+}
+
+/* ------------------------------------------------------------------ */
+/* Sessions and requests                                              */
+/* ------------------------------------------------------------------ */
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+int snmp_open(snmp_session_t *session, const char *ip, uint16_t port, const char *community)
+{
+    struct in_addr addr;
+    struct sockaddr_in sa;
+
+    if (session == NULL || ip == NULL || community == NULL ||
+        inet_pton(AF_INET, ip, &addr) != 1 ||
+        strlen(community) >= sizeof(session->community)) {
+        return NETMON_ERROR;
+    }
+
+    memset(session, 0, sizeof(*session));
+    session->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (session->fd < 0) {
+        return NETMON_ERROR;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr = addr;
+    sa.sin_port = htons(port ? port : DEFAULT_SNMP_PORT);
+
+    /* Connected socket: the kernel drops datagrams from other peers */
+    if (connect(session->fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        close(session->fd);
+        session->fd = -1;
+        return NETMON_ERROR;
+    }
+
+    session->buf = malloc(SNMP_MAX_MSG_SIZE);
+    if (session->buf == NULL) {
+        close(session->fd);
+        session->fd = -1;
+        return NETMON_ERROR;
+    }
+
+    session->peer = ntohl(addr.s_addr);
+    session->port = port ? port : DEFAULT_SNMP_PORT;
+    strcpy(session->community, community);
+    session->next_request_id = (int32_t)((now_ms() ^ ((uint64_t)getpid() << 16)) & 0x3fffffff);
+    session->timeout_ms = default_timeout_ms;
+    session->retries = default_retries;
+    session->max_repetitions = default_max_repetitions;
+    return NETMON_SUCCESS;
+}
+
+void snmp_close(snmp_session_t *session)
+{
+    if (session == NULL) return;
+    if (session->fd >= 0) {
+        close(session->fd);
+    }
+    session->fd = -1;
+    free(session->buf);
+    session->buf = NULL;
+}
+
+/*
+ * Send a request and wait for the matching response
+ * Returns 0 with *error_status and *varbinds set, or a negative NETMON code
+ */
+static int snmp_exchange(snmp_session_t *s, uint8_t pdu_type,
+                         const snmp_oid_t *oids, int oid_count,
+                         int non_repeaters, int max_repetitions,
+                         int *error_status, ber_reader_t *varbinds)
+{
+    uint8_t req[SNMP_MAX_REQUEST_SIZE];
+    int32_t request_id = s->next_request_id;
+    s->next_request_id = (s->next_request_id + 1) & 0x7fffffff;
+
+    size_t req_len = encode_request(req, sizeof(req), s->community, pdu_type,
+                                    request_id, non_repeaters, max_repetitions,
+                                    oids, oid_count);
+    if (req_len == 0) {
+        return NETMON_ERROR;
+    }
+
+    uint64_t start_us = selfstat_now_us();
+    selfstat_add(SELFSTAT_SNMP_REQUESTS, 1);
+    for (int attempt = 0; attempt <= s->retries; attempt++) {
+        if (attempt > 0) {
+            selfstat_add(SELFSTAT_SNMP_RETRIES, 1);
+        }
+        if (send(s->fd, req, req_len, 0) < 0 && errno != EAGAIN) {
+            selfstat_add(SELFSTAT_SNMP_ERRORS, 1);
+            return NETMON_ERROR;
+        }
+
+        uint64_t deadline = now_ms() + (uint64_t)s->timeout_ms;
+        for (;;) {
+            uint64_t now = now_ms();
+            if (now >= deadline) break;
+
+            struct pollfd pfd = { s->fd, POLLIN, 0 };
+            int rc = poll(&pfd, 1, (int)(deadline - now));
+            if (rc < 0 && errno == EINTR) continue;
+            if (rc <= 0) break;
+
+            ssize_t n = recv(s->fd, s->buf, SNMP_MAX_MSG_SIZE, 0);
+            if (n < 0) {
+                /* ECONNREFUSED: ICMP port unreachable, agent not listening */
+                if (errno == ECONNREFUSED) {
+                    selfstat_add(SELFSTAT_SNMP_ERRORS, 1);
+                    return NETMON_NO_RESPONSE;
+                }
+                continue;
+            }
+
+            int which;
+            rc = decode_response(s->buf, (size_t)n, request_id, 1, &which, error_status, varbinds);
+            if (rc == 0) {
+                selfstat_record(SELFSTAT_SNMP_LATENCY, selfstat_now_us() - start_us);
+                return 0;
+            }
+            if (rc < 0) {
+                selfstat_add(SELFSTAT_SNMP_ERRORS, 1);
+                return NETMON_ERROR;
+            }
+            /* Stale response from an earlier retry: keep waiting */
+        }
+    }
+
+    selfstat_add(SELFSTAT_SNMP_TIMEOUTS, 1);
+    return NETMON_TIMEOUT;
+}
+
+int snmp_request(snmp_session_t *session, uint8_t pdu_type,
+                 const snmp_oid_t *oids, int oid_count,
+                 int non_repeaters, int max_repetitions,
+                 snmp_varbind_cb cb, void *ctx)
+{
+    ber_reader_t varbinds;
+    int error_status = 0;
+
+    if (session == NULL || session->fd < 0 || oids == NULL || oid_count <= 0) {
+        return NETMON_ERROR;
+    }
+
+    int rc = snmp_exchange(session, pdu_type, oids, oid_count,
+                           non_repeaters, max_repetitions, &error_status, &varbinds);
+    if (rc != 0) {
+        return rc;
+    }
+    if (error_status != SNMP_ERR_NOERROR) {
+        return NETMON_ERROR;
+    }
+
+    int n = deliver_varbinds(&varbinds, cb, ctx);
+    return n < 0 ? NETMON_ERROR : n;
+}
+
+/*
+ * Send a Get of sysObjectID.0 once per candidate community, all at once,
+ * and keep the first community the agent answers. Agents silently drop
+ * messages with a wrong community, so a sequential search pays a full
+ * timeout per wrong guess; this pays at most one.
+ */
+int snmp_probe_communities(snmp_session_t *session, const char *const *communities, int count)
+{
+    static const snmp_oid_t sys_object_id = { { 1, 3, 6, 1, 2, 1, 1, 2, 0 }, 9 };
+    uint8_t (*reqs)[SNMP_MAX_REQUEST_SIZE];
+    size_t *lens;
+    int result = NETMON_TIMEOUT;
+
+    if (session == NULL || session->fd < 0 || communities == NULL || count <= 0) {
+        return NETMON_ERROR;
+    }
+
+    reqs = malloc((size_t)count * sizeof(*reqs));
+    lens = malloc((size_t)count * sizeof(*lens));
+    if (reqs == NULL || lens == NULL) {
+        free(reqs);
+        free(lens);
+        return NETMON_ERROR;
+    }
+
+    /* Consecutive request ids map a response back to its community */
+    int32_t first_id = session->next_request_id;
+    if (first_id > 0x7fffffff - count) {
+        first_id = 1;
+    }
+    session->next_request_id = first_id + count;
+
+    for (int i = 0; i < count; i++) {
+        lens[i] = strlen(communities[i]) < sizeof(session->community) ?
+                  encode_request(reqs[i], sizeof(reqs[i]), communities[i], SNMP_PDU_GET,
+                                 first_id + i, 0, 0, &sys_object_id, 1) : 0;
+    }
+
+    uint64_t start_us = selfstat_now_us();
+    for (int attempt = 0; attempt <= session->retries && result == NETMON_TIMEOUT; attempt++) {
+        for (int i = 0; i < count; i++) {
+            if (lens[i] > 0) {
+                send(session->fd, reqs[i], lens[i], 0);
+                selfstat_add(SELFSTAT_COMMUNITY_GUESSES, 1);
+            }
+        }
+
+        uint64_t deadline = now_ms() + (uint64_t)session->timeout_ms;
+        while (result == NETMON_TIMEOUT) {
+            uint64_t now = now_ms();
+            if (now >= deadline) break;
+
+            struct pollfd pfd = { session->fd, POLLIN, 0 };
+            int rc = poll(&pfd, 1, (int)(deadline - now));
+            if (rc < 0 && errno == EINTR) continue;
+            if (rc <= 0) break;
+
+            ssize_t n = recv(session->fd, session->buf, SNMP_MAX_MSG_SIZE, 0);
+            if (n < 0) {
+                if (errno == ECONNREFUSED) result = NETMON_NO_RESPONSE;
+                continue;
+            }
+
+            ber_reader_t varbinds;
+            int which, error_status;
+            if (decode_response(session->buf, (size_t)n, first_id, count,
+                                &which, &error_status, &varbinds) == 0) {
+                /* Any authenticated answer, even an error status, proves the community */
+                strcpy(session->community, communities[which]);
+                result = which;
+            }
+        }
+    }
+
+    if (result >= 0) {
+        selfstat_record(SELFSTAT_COMMUNITY_PROBE, selfstat_now_us() - start_us);
+    } else {
+        selfstat_add(SELFSTAT_COMMUNITY_FAILURES, 1);
+    }
+    free(reqs);
+    free(lens);
+    return result;
+}
+
+/* Walk state shared with the per-response callback */
+typedef struct {
+    const snmp_oid_t *root;
+    snmp_oid_t last;
+    int done;
+    int delivered;
+    snmp_varbind_cb cb;
+    void *ctx;
+} walk_state_t;
+
+static int walk_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    walk_state_t *ws = ctx;
+
+    if (vb->type == SNMP_TYPE_END_OF_MIB_VIEW ||
+        !snmp_oid_is_prefix(ws->root, &vb->oid) ||
+        snmp_oid_compare(&vb->oid, &ws->last) <= 0) {
+        ws->done = 1;   /* Left the subtree, or agent is not advancing */
+        return 1;
+    }
+
+    ws->last = vb->oid;
+    ws->delivered++;
+    if (ws->cb != NULL && ws->cb(vb, ws->ctx) != 0) {
+        ws->done = 1;
+        return 1;
+    }
+    return 0;
+}
+
+int snmp_bulkwalk(snmp_session_t *session, const snmp_oid_t *root,
+                  snmp_varbind_cb cb, void *ctx)
+{
+    walk_state_t ws;
+    int max_rep;
+
+    if (session == NULL || session->fd < 0 || root == NULL) {
+        return NETMON_ERROR;
+    }
+
+    memset(&ws, 0, sizeof(ws));
+    ws.root = root;
+    ws.last = *root;
+    ws.cb = cb;
+    ws.ctx = ctx;
+    max_rep = session->max_repetitions > 0 ? session->max_repetitions : 1;
+
+    while (!ws.done) {
+        ber_reader_t varbinds;
+        int error_status = 0;
+        snmp_oid_t start = ws.last;
+
+        int rc = snmp_exchange(session, SNMP_PDU_GETBULK, &start, 1, 0, max_rep,
+                               &error_status, &varbinds);
+        if (rc != 0) {
+            return ws.delivered > 0 ? ws.delivered : rc;
+        }
+
+        if (error_status == SNMP_ERR_TOOBIG && max_rep > 1) {
+            max_rep /= 2;   /* Response did not fit a datagram: ask for less */
+            continue;
+        }
+        if (error_status != SNMP_ERR_NOERROR) {
+            break;
+        }
+
+        int n = deliver_varbinds(&varbinds, walk_cb, &ws);
+        if (n < 0) {
+            return ws.delivered > 0 ? ws.delivered : NETMON_ERROR;
+        }
+        if (n == 0) {
+            break;
+        }
+    }
+
+    return ws.delivered;
+}
+
+/* Table walk state; active[] maps response position to column */
+typedef struct {
+    const snmp_oid_t *columns;
+    snmp_oid_t last[SNMP_MAX_TABLE_COLUMNS];
+    uint8_t done[SNMP_MAX_TABLE_COLUMNS];
+    int active[SNMP_MAX_TABLE_COLUMNS];
+    int active_count;
+    int position;
+    int delivered;
+    int stopped;
+    snmp_cell_cb cb;
+    void *ctx;
+} table_state_t;
+
+static int table_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    table_state_t *ts = ctx;
+    int col = ts->active[ts->position++ % ts->active_count];
+
+    if (ts->done[col]) {
+        return 0;
+    }
+    if (vb->type == SNMP_TYPE_END_OF_MIB_VIEW ||
+        !snmp_oid_is_prefix(&ts->columns[col], &vb->oid) ||
+        snmp_oid_compare(&vb->oid, &ts->last[col]) <= 0) {
+        ts->done[col] = 1;
+        return 0;
+    }
+
+    ts->last[col] = vb->oid;
+    ts->delivered++;
+    if (ts->cb != NULL && ts->cb(col, vb, ts->ctx) != 0) {
+        ts->stopped = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Walk several columns of one table together: every GetBulk carries
+ * one varbind per unfinished column, so each response holds up to
+ * max_repetitions rows of all of them (row-major).
+ */
+int snmp_table_walk(snmp_session_t *session, const snmp_oid_t *columns, int column_count,
+                    snmp_cell_cb cb, void *ctx)
+{
+    table_state_t ts;
+    snmp_oid_t start[SNMP_MAX_TABLE_COLUMNS];
+    int max_rep;
+
+    if (session == NULL || session->fd < 0 || columns == NULL ||
+        column_count <= 0 || column_count > SNMP_MAX_TABLE_COLUMNS) {
+        return NETMON_ERROR;
+    }
+
+    memset(&ts, 0, sizeof(ts));
+    ts.columns = columns;
+    ts.cb = cb;
+    ts.ctx = ctx;
+    for (int c = 0; c < column_count; c++) {
+        ts.last[c] = columns[c];
+    }
+    max_rep = session->max_repetitions > 0 ? session->max_repetitions : 1;
+
+    for (;;) {
+        ber_reader_t varbinds;
+        int error_status = 0;
+
+        ts.active_count = 0;
+        for (int c = 0; c < column_count; c++) {
+            if (!ts.done[c]) {
+                ts.active[ts.active_count] = c;
+                start[ts.active_count++] = ts.last[c];
+            }
+        }
+        if (ts.active_count == 0 || ts.stopped) {
+            break;
+        }
+
+        int rc = snmp_exchange(session, SNMP_PDU_GETBULK, start, ts.active_count, 0, max_rep,
+                               &error_status, &varbinds);
+        /* A walk cut short is reported as such, never as a shorter table */
+        if (rc != 0) {
+            return rc;
+        }
+        if (error_status == SNMP_ERR_TOOBIG && max_rep > 1) {
+            max_rep /= 2;
+            continue;
+        }
+        if (error_status != SNMP_ERR_NOERROR) {
+            return NETMON_ERROR;
+        }
+
+        ts.position = 0;
+        int n = deliver_varbinds(&varbinds, table_cb, &ts);
+        if (n < 0) {
+            return NETMON_ERROR;
+        }
+        if (n == 0) {
+            break;
+        }
+    }
+
+    return ts.delivered;
+}
+
+/* ------------------------------------------------------------------ */
+/* Value formatting and the netmon.h API                              */
+/* ------------------------------------------------------------------ */
+
+void snmp_value_format(const snmp_varbind_t *vb, char *buf, size_t size)
+{
+    char oidbuf[SNMP_MAX_OID_LEN * 11];
+
+    switch (vb->type) {
+        case SNMP_TYPE_INTEGER:
+            snprintf(buf, size, "INTEGER: %lld", (long long)vb->integer);
+            break;
+        case SNMP_TYPE_COUNTER32:
+            snprintf(buf, size, "Counter32: %llu", (unsigned long long)vb->counter);
+            break;
+        case SNMP_TYPE_GAUGE32:
+            snprintf(buf, size, "Gauge32: %llu", (unsigned long long)vb->counter);
+            break;
+        case SNMP_TYPE_TIMETICKS:
+            snprintf(buf, size, "Timeticks: (%llu)", (unsigned long long)vb->counter);
+            break;
+        case SNMP_TYPE_COUNTER64:
+            snprintf(buf, size, "Counter64: %llu", (unsigned long long)vb->counter);
+            break;
+        case SNMP_TYPE_IPADDRESS:
+            snprintf(buf, size, "IpAddress: %u.%u.%u.%u",
+                     (vb->ipaddr >> 24) & 0xff, (vb->ipaddr >> 16) & 0xff,
+                     (vb->ipaddr >> 8) & 0xff, vb->ipaddr & 0xff);
+            break;
+        case SNMP_TYPE_OID:
+            snmp_oid_format(&vb->oid_value, oidbuf, sizeof(oidbuf));
+            snprintf(buf, size, "OID: %s", oidbuf);
+            break;
+        case SNMP_TYPE_OCTET_STRING:
+        case SNMP_TYPE_OPAQUE: {
+            int printable = 1;
+            for (size_t i = 0; i < vb->data_len; i++) {
+                if ((vb->data[i] < 0x20 || vb->data[i] > 0x7e) &&
+                    vb->data[i] != '\n' && vb->data[i] != '\r' && vb->data[i] != '\t') {
+                    printable = 0;
+                    break;
+                }
+            }
+            if (printable) {
+                snprintf(buf, size, "STRING: \"%.*s\"", (int)vb->data_len, (const char *)vb->data);
+            } else {
+                size_t pos = (size_t)snprintf(buf, size, "Hex-STRING:");
+                for (size_t i = 0; i < vb->data_len && pos + 3 < size; i++) {
+                    pos += (size_t)snprintf(buf + pos, size - pos, " %02X", vb->data[i]);
+                }
+            }
+            break;
+        }
+        case SNMP_TYPE_NO_SUCH_OBJECT:
+            snprintf(buf, size, "No Such Object available on this agent at this OID");
+            break;
+        case SNMP_TYPE_NO_SUCH_INSTANCE:
+            snprintf(buf, size, "No Such Instance currently exists at this OID");
+            break;
+        case SNMP_TYPE_END_OF_MIB_VIEW:
+            snprintf(buf, size, "No more variables left in this MIB View");
+            break;
+        default:
+            snprintf(buf, size, "NULL");
+            break;
+    }
+}
+
+/* Copies the single Get result into the caller's buffer */
+typedef struct {
+    char *result;
+    size_t size;
+    int status;
+} get_state_t;
+
+static int get_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    get_state_t *gs = ctx;
+
+    if (vb->type == SNMP_TYPE_NO_SUCH_OBJECT || vb->type == SNMP_TYPE_NO_SUCH_INSTANCE ||
+        vb->type == SNMP_TYPE_END_OF_MIB_VIEW) {
+        gs->status = NETMON_NO_RESPONSE;
+        return 1;
+    }
+
+    /* Strings are returned raw; everything else in snmpget's notation */
+    if (vb->type == SNMP_TYPE_OCTET_STRING) {
+        size_t n = vb->data_len < gs->size - 1 ? vb->data_len : gs->size - 1;
+        memcpy(gs->result, vb->data, n);
+        gs->result[n] = '\0';
+    } else {
+        snmp_value_format(vb, gs->result, gs->size);
+    }
+    gs->status = NETMON_SUCCESS;
+    return 1;
+}
+
+/*
+ * Fetch a single OID value as text
+ * Returns NETMON_SUCCESS, NETMON_TIMEOUT, NETMON_NO_RESPONSE or NETMON_ERROR
+ */
+int snmp_get(const char *ip, const char *community, const char *oid, char *result, size_t result_size)
+{
+    snmp_session_t session;
+    snmp_oid_t name;
+    get_state_t gs;
+
+    if (result == NULL || result_size == 0 || snmp_oid_parse(oid, &name) != 0) {
+        return NETMON_ERROR;
+    }
+    result[0] = '\0';
+
+    if (snmp_open(&session, ip, DEFAULT_SNMP_PORT, community) != NETMON_SUCCESS) {
+        return NETMON_ERROR;
+    }
+
+    gs.result = result;
+    gs.size = result_size;
+    gs.status = NETMON_NO_RESPONSE;
+
+    int rc = snmp_request(&session, SNMP_PDU_GET, &name, 1, 0, 0, get_cb, &gs);
+    snmp_close(&session);
+
+    return rc < 0 ? rc : gs.status;
+}
+
+static int print_cb(const snmp_varbind_t *vb, void *ctx)
+{
+    char oidbuf[SNMP_MAX_OID_LEN * 11];
+    char value[512];
+
+    (void)ctx;
+    snmp_oid_format(&vb->oid, oidbuf, sizeof(oidbuf));
+    snmp_value_format(vb, value, sizeof(value));
+    printf("%s = %s\n", oidbuf, value);
+    return 0;
+}
+
+/*
+ * Walk a subtree and print each value like snmpwalk
+ * Returns the number of values printed or a negative NETMON code
+ */
+int snmp_walk(const char *ip, const char *community, const char *oid)
+{
+    snmp_session_t session;
+    snmp_oid_t root;
+
+    if (snmp_oid_parse(oid, &root) != 0) {
+        return NETMON_ERROR;
+    }
+    if (snmp_open(&session, ip, DEFAULT_SNMP_PORT, community) != NETMON_SUCCESS) {
+        return NETMON_ERROR;
+    }
+
+    int rc = snmp_bulkwalk(&session, &root, print_cb, NULL);
+    snmp_close(&session);
+    return rc;
+}
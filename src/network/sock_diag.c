@@ -0,0 +1,153 @@
+/*
+ * Socket Table Reader
+ * SOCK_DIAG_BY_FAMILY dumps for TCP over IPv4 and IPv6 filtered to
+ * TCP_ESTABLISHED, falling back to /proc/net/tcp and /proc/net/tcp6.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "sock_diag.h"
+#include "rtnl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+
+/* State column of /proc/net/tcp for ESTABLISHED */
+#define PROC_TCP_ESTABLISHED 0x01
+
+typedef struct {
+    sock_diag_cb cb;
+    void *ctx;
+    int count;
+    int stopped;
+} diag_walk_t;
+
+/* IPv4 address of an IPv4 or v4-mapped IPv6 peer; 0 if neither */
+static int peer_ipv4(int family, const uint32_t *words, uint32_t *addr)
+{
+    if (family == AF_INET) {
+        *addr = ntohl(words[0]);
+        return 1;
+    }
+    if (family == AF_INET6 && words[0] == 0 && words[1] == 0 && words[2] == htonl(0xffff)) {
+        *addr = ntohl(words[3]);
+        return 1;
+    }
+    return 0;
+}
+
+static int report(diag_walk_t *walk, uint32_t addr, uint16_t port)
+{
+    walk->count++;
+    if (walk->cb(addr, port, walk->ctx) != 0) {
+        walk->stopped = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static int diag_msg(const struct nlmsghdr *nh, void *ctx)
+{
+    diag_walk_t *walk = ctx;
+    const struct inet_diag_msg *msg = NLMSG_DATA(nh);
+    uint32_t addr;
+
+    if (nh->nlmsg_type != SOCK_DIAG_BY_FAMILY || nh->nlmsg_len < NLMSG_LENGTH(sizeof(*msg)) ||
+        msg->idiag_state != TCP_ESTABLISHED ||
+        !peer_ipv4(msg->idiag_family, msg->id.idiag_dst, &addr)) {
+        return 0;
+    }
+    return report(walk, addr, ntohs(msg->id.idiag_dport));
+}
+
+static int diag_dump(int family, diag_walk_t *walk)
+{
+    struct inet_diag_req_v2 req;
+
+    memset(&req, 0, sizeof(req));
+    req.sdiag_family = (uint8_t)family;
+    req.sdiag_protocol = IPPROTO_TCP;
+    req.idiag_states = 1u << TCP_ESTABLISHED;
+
+    return netlink_dump(NETLINK_SOCK_DIAG, SOCK_DIAG_BY_FAMILY, &req, sizeof(req), diag_msg, walk);
+}
+
+/*
+ * /proc/net/tcp{,6}:
+ * sl  local_address rem_address   st ...
+ * Addresses are hex words in network byte order, ports in host order.
+ */
+static int proc_dump(const char *path, int family, diag_walk_t *walk)
+{
+    char line[512];
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        return -1;
+    }
+
+    if (fgets(line, sizeof(line), fp) != NULL) {   /* Header */
+        while (!walk->stopped && fgets(line, sizeof(line), fp) != NULL) {
+            char rem[40];
+            unsigned int port, state;
+            uint32_t words[4];
+            uint32_t addr;
+
+            if (sscanf(line, "%*s %*s %39[0-9A-Fa-f]:%x %x", rem, &port, &state) != 3 ||
+                state != PROC_TCP_ESTABLISHED) {
+                continue;
+            }
+
+            int nwords = family == AF_INET6 ? 4 : 1;
+            if (strlen(rem) != (size_t)nwords * 8) {
+                continue;
+            }
+            for (int i = 0; i < nwords; i++) {
+                char word[9];
+                memcpy(word, rem + i * 8, 8);
+                word[8] = '\0';
+                words[i] = (uint32_t)strtoul(word, NULL, 16);
+            }
+            if (peer_ipv4(family, words, &addr)) {
+                report(walk, addr, (uint16_t)port);
+            }
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+int sock_diag_established(sock_diag_cb cb, void *ctx)
+{
+    diag_walk_t walk = { cb, ctx, 0, 0 };
+
+    if (cb == NULL) {
+        return -1;
+    }
+
+    if (diag_dump(AF_INET, &walk) == 0) {
+        if (!walk.stopped) {
+            diag_dump(AF_INET6, &walk);   /* Optional: IPv6 may be disabled */
+        }
+        return walk.count;
+    }
+    if (walk.count > 0) {
+        return walk.count;   /* A partial dump is kept rather than repeated */
+    }
+
+    if (proc_dump("/proc/net/tcp", AF_INET, &walk) != 0) {
+        return -1;
+    }
+    if (!walk.stopped) {
+        proc_dump("/proc/net/tcp6", AF_INET6, &walk);
+    }
+    return walk.count;
+}
@@ -0,0 +1,193 @@
+/*
+ * Chunked Arena and String Pool
+ * Chunks are allocated on first use and freed together; strings are
+ * bump-allocated from 64 KB blocks and found again through a
+ * linear-probing table of (hash, length, pointer).
+ */
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STRING_POOL_MIN_CAPACITY 256
+
+struct string_block {
+    string_block_t *next;
+    size_t size;                 /* Usable bytes in data */
+    char data[];
+};
+
+void *chunk_array_reserve(chunk_array_t *a, uint32_t index)
+{
+    uint32_t chunk = index >> CHUNK_ARRAY_CHUNK_SHIFT;
+
+    if (chunk >= CHUNK_ARRAY_MAX_CHUNKS) {
+        return NULL;
+    }
+    if (a->chunks[chunk] == NULL) {
+        void *mem = calloc(CHUNK_ARRAY_CHUNK_LEN, a->elem_size);
+        if (mem == NULL) {
+            return NULL;
+        }
+        __atomic_store_n(&a->chunks[chunk], mem, __ATOMIC_RELEASE);
+        a->chunk_count++;
+    }
+    return chunk_array_at(a, index);
+}
+
+void *chunk_array_at(const chunk_array_t *a, uint32_t index)
+{
+    char *chunk = a->chunks[index >> CHUNK_ARRAY_CHUNK_SHIFT];
+    return chunk + (size_t)(index & (CHUNK_ARRAY_CHUNK_LEN - 1)) * a->elem_size;
+}
+
+void *chunk_array_get(const chunk_array_t *a, uint32_t index)
+{
+    uint32_t chunk = index >> CHUNK_ARRAY_CHUNK_SHIFT;
+
+    if (chunk >= CHUNK_ARRAY_MAX_CHUNKS) {
+        return NULL;
+    }
+    char *mem = __atomic_load_n(&a->chunks[chunk], __ATOMIC_ACQUIRE);
+    if (mem == NULL) {
+        return NULL;
+    }
+    return mem + (size_t)(index & (CHUNK_ARRAY_CHUNK_LEN - 1)) * a->elem_size;
+}
+
+size_t chunk_array_bytes(const chunk_array_t *a)
+{
+    return (size_t)a->chunk_count * CHUNK_ARRAY_CHUNK_LEN * a->elem_size;
+}
+
+void chunk_array_free(chunk_array_t *a)
+{
+    for (uint32_t i = 0; i < CHUNK_ARRAY_MAX_CHUNKS && a->chunk_count > 0; i++) {
+        if (a->chunks[i] != NULL) {
+            free(a->chunks[i]);
+            a->chunks[i] = NULL;
+            a->chunk_count--;
+        }
+    }
+}
+
+/* FNV-1a */
+static uint32_t hash_bytes(const char *s, size_t len)
+{
+    uint32_t h = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619U;
+    }
+    return h;
+}
+
+static int rehash(string_pool_t *p, uint32_t new_capacity)
+{
+    string_pool_slot_t *slots = calloc(new_capacity, sizeof(*slots));
+    if (slots == NULL) {
+        return -1;
+    }
+
+    uint32_t mask = new_capacity - 1;
+    for (uint32_t i = 0; i < p->capacity; i++) {
+        if (p->slots[i].str == NULL) continue;
+
+        uint32_t pos = p->slots[i].hash & mask;
+        while (slots[pos].str != NULL) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = p->slots[i];
+    }
+
+    free(p->slots);
+    p->slots = slots;
+    p->capacity = new_capacity;
+    return 0;
+}
+
+/* Room for size bytes; strings longer than a block get their own */
+static char *pool_alloc(string_pool_t *p, size_t size)
+{
+    string_block_t *b = p->blocks;
+
+    if (b == NULL || b->size - p->block_used < size) {
+        size_t block = size > STRING_POOL_BLOCK_SIZE ? size : STRING_POOL_BLOCK_SIZE;
+        string_block_t *nb = malloc(sizeof(*nb) + block);
+        if (nb == NULL) {
+            return NULL;
+        }
+        nb->size = block;
+        p->bytes += block;
+        if (b != NULL && size > STRING_POOL_BLOCK_SIZE) {
+            /* Keep filling the current block after an oversized string */
+            nb->next = b->next;
+            b->next = nb;
+            return nb->data;
+        }
+        nb->next = b;
+        p->blocks = nb;
+        p->block_used = 0;
+        b = nb;
+    }
+    char *out = b->data + p->block_used;
+    p->block_used += size;
+    return out;
+}
+
+const char *string_pool_intern(string_pool_t *p, const char *s, size_t len)
+{
+    if (len > UINT32_MAX - 1) {
+        return NULL;
+    }
+    if ((p->count + 1) * 2 > p->capacity) {
+        uint32_t cap = p->capacity ? p->capacity * 2 : STRING_POOL_MIN_CAPACITY;
+        if (rehash(p, cap) != 0) {
+            return NULL;
+        }
+    }
+
+    uint32_t hash = hash_bytes(s, len);
+    uint32_t mask = p->capacity - 1;
+    uint32_t pos = hash & mask;
+    while (p->slots[pos].str != NULL) {
+        const string_pool_slot_t *slot = &p->slots[pos];
+        if (slot->hash == hash && slot->len == len && memcmp(slot->str, s, len) == 0) {
+            return slot->str;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    char *copy = pool_alloc(p, len + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    p->slots[pos].str = copy;
+    p->slots[pos].hash = hash;
+    p->slots[pos].len = (uint32_t)len;
+    p->count++;
+    return copy;
+}
+
+uint32_t string_pool_count(const string_pool_t *p)
+{
+    return p->count;
+}
+
+size_t string_pool_bytes(const string_pool_t *p)
+{
+    return p->bytes + (size_t)p->capacity * sizeof(*p->slots);
+}
+
+void string_pool_free(string_pool_t *p)
+{
+    string_block_t *b = p->blocks;
+    while (b != NULL) {
+        string_block_t *next = b->next;
+        free(b);
+        b = next;
+    }
+    free(p->slots);
+    memset(p, 0, sizeof(*p));
+}
@@ -0,0 +1,622 @@
+/*
+ * Configuration Loading
+ * devices.conf is read into a reused buffer and split into field spans
+ * in one pass. The spans, sorted by hostname, are merged against the sorted
+ * device snapshot to find what to add, remove and update. Threshold
+ * rules come from THRESHOLD_DEFAULT_FILE in the same directory.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "config.h"
+#include "device_db.h"
+#include "threshold.h"
+#include "selfstat.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <arpa/inet.h>
+
+/* What a merge decided for a parsed line */
+enum {
+    LINE_KEEP = 0,
+    LINE_ADD,                     /* New hostname */
+    LINE_REPLACE,                 /* Known hostname at a new address */
+    LINE_DUPLICATE
+};
+
+/* One device line; host and community point into the mapped file */
+typedef struct {
+    const char *host;
+    const char *community;
+    uint16_t host_len;
+    uint16_t community_len;
+    uint16_t port;
+    uint8_t action;
+    uint32_t addr;
+    int line_no;
+} conf_line_t;
+
+static pthread_mutex_t apply_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * File contents, read rather than mapped: reloads run while editors
+ * rewrite the file, and a mapping truncated under the parser faults
+ */
+static char *text_buf = NULL;
+static size_t text_cap = 0;
+
+/* Parsed lines, reused by every load; grows with the file, never per line */
+static conf_line_t *lines = NULL;
+static int line_cap = 0;
+
+/* Live devices sorted by hostname for the merge; grows with the table */
+static const device_entry_t **live = NULL;
+static int live_cap = 0;
+
+/* Id of the device the config file owns in each slot, 0 = none */
+static chunk_array_t owned_id = CHUNK_ARRAY_INIT(uint32_t);
+
+/* Back every slot below limit with an owner cell */
+static int reserve_owned(int limit)
+{
+    for (int s = 0; s < limit; s += (int)CHUNK_ARRAY_CHUNK_LEN) {
+        if (chunk_array_reserve(&owned_id, (uint32_t)s) == NULL) {
+            return NETMON_ERROR;
+        }
+    }
+    return NETMON_SUCCESS;
+}
+
+static int grow_live(int need)
+{
+    int cap = live_cap ? live_cap : 256;
+    while (cap < need) {
+        cap *= 2;
+    }
+    const device_entry_t **grown = realloc(live, (size_t)cap * sizeof(*grown));
+    if (grown == NULL) {
+        return NETMON_ERROR;
+    }
+    live = grown;
+    live_cap = cap;
+    return NETMON_SUCCESS;
+}
+
+static const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+/*
+ * Split one line [p, end) into spans
+ * Returns 1 for a device, 0 for comments and blank lines, -1 for a
+ * malformed line and -2 for an address that cannot name a host
+ */
+static int parse_line(const char *p, const char *end, conf_line_t *c)
+{
+    const char *field[4];
+    size_t len[4];
+    int n = 0;
+
+    if (end > p && end[-1] == '\r') end--;
+    p = skip_blanks(p, end);
+    if (p == end || *p == '#') {
+        return 0;
+    }
+    while (n < 4) {
+        const char *semi = memchr(p, ';', (size_t)(end - p));
+        const char *stop = semi != NULL ? semi : end;
+        field[n] = p;
+        len[n] = (size_t)(stop - p);
+        n++;
+        if (semi == NULL) break;
+        p = semi + 1;
+    }
+    if (n < 3 || len[0] == 0 || len[0] >= MAX_HOSTNAME_LEN || len[2] >= MAX_COMMUNITY_LEN) {
+        return -1;
+    }
+    if (!ipv4_parse(field[1], len[1], &c->addr)) {
+        return -1;
+    }
+    if (!ipv4_is_host(c->addr)) {
+        return -2;
+    }
+
+    unsigned long port = DEFAULT_SNMP_PORT;
+    if (n == 4) {
+        const char *q, *stop = skip_blanks(field[3], field[3] + len[3]);
+        port = 0;
+        for (q = stop; q < field[3] + len[3] && *q >= '0' && *q <= '9' && port <= 65535; q++) {
+            port = port * 10 + (unsigned long)(*q - '0');
+        }
+        if (q == stop || skip_blanks(q, field[3] + len[3]) != field[3] + len[3]) {
+            return -1;
+        }
+    }
+    if (port == 0 || port > 65535) {
+        return -1;
+    }
+
+    c->host = field[0];
+    c->host_len = (uint16_t)len[0];
+    c->community = field[2];
+    c->community_len = (uint16_t)len[2];
+    c->port = (uint16_t)port;
+    c->action = LINE_KEEP;
+    return 1;
+}
+
+/* Order of a span against a NUL-terminated string, as strcmp() would */
+static int span_cmp(const char *s, size_t len, const char *str)
+{
+    size_t n = strnlen(str, len + 1);
+    int c = memcmp(s, str, len < n ? len : n);
+    if (c != 0) return c;
+    return (len > n) - (len < n);
+}
+
+static int line_order(const void *a, const void *b)
+{
+    const conf_line_t *x = a, *y = b;
+    size_t n = x->host_len < y->host_len ? x->host_len : y->host_len;
+    int c = memcmp(x->host, y->host, n);
+    if (c == 0) c = (x->host_len > y->host_len) - (x->host_len < y->host_len);
+    return c != 0 ? c : x->line_no - y->line_no;
+}
+
+static int entry_order(const void *a, const void *b)
+{
+    const device_entry_t *const *x = a, *const *y = b;
+    return strcmp((*x)->hostname, (*y)->hostname);
+}
+
+static void line_to_device(const conf_line_t *c, network_device_t *dev)
+{
+    struct in_addr in = { htonl(c->addr) };
+
+    memset(dev, 0, sizeof(*dev));
+    memcpy(dev->hostname, c->host, c->host_len);
+    memcpy(dev->snmp_community, c->community, c->community_len);
+    inet_ntop(AF_INET, &in, dev->ip_address, sizeof(dev->ip_address));
+    dev->port = c->port;
+}
+
+/*
+ * Parse the whole mapping into lines[]
+ * Returns the number of device lines, or -1 if lines[] cannot grow
+ */
+static int parse_text(const char *filename, const char *text, size_t size, config_diff_t *diff)
+{
+    const char *end = text + size;
+    int count = 0;
+    int line_no = 0;
+
+    for (const char *p = text; p < end; ) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *eol = nl != NULL ? nl : end;
+        line_no++;
+
+        if (count == line_cap) {
+            int cap = line_cap ? line_cap * 2 : 256;
+            conf_line_t *grown = realloc(lines, (size_t)cap * sizeof(*grown));
+            if (grown == NULL) {
+                return -1;
+            }
+            lines = grown;
+            line_cap = cap;
+        }
+
+        int rc = parse_line(p, eol, &lines[count]);
+        if (rc > 0) {
+            lines[count++].line_no = line_no;
+        } else if (rc < 0) {
+            fprintf(stderr, rc == -2 ? "%s:%d: address is not a usable host address\n"
+                                     : "%s:%d: expected hostname;ip_address;community[;port]\n",
+                    filename, line_no);
+            diff->rejected++;
+        }
+        p = eol + 1;
+    }
+    return count;
+}
+
+/*
+ * Read all of fd into text_buf, however long it is by the time the read
+ * ends; caller holds apply_lock
+ * Returns the byte count, or -1 on a read error or out of memory
+ */
+static ssize_t read_text(int fd, size_t size_hint)
+{
+    size_t len = 0;
+
+    for (;;) {
+        /* Room for the file as stat saw it plus a byte, so EOF needs no regrow */
+        if (text_cap <= size_hint || len == text_cap) {
+            size_t cap = text_cap ? text_cap : 4096;
+            while (cap <= size_hint || cap <= len) {
+                cap *= 2;
+            }
+            char *grown = realloc(text_buf, cap);
+            if (grown == NULL) {
+                return -1;
+            }
+            text_buf = grown;
+            text_cap = cap;
+        }
+        ssize_t n = read(fd, text_buf + len, text_cap - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            return (ssize_t)len;
+        }
+        len += (size_t)n;
+    }
+}
+
+/*
+ * Merge sorted lines against the sorted live devices: drop owned
+ * devices that left the file, update changed ones in place, and mark
+ * what must be added. Removals happen first so their slots are free
+ * for the additions.
+ * Returns NETMON_ERROR, with the table untouched, if memory runs out
+ */
+static int merge(const char *filename, int count, config_diff_t *diff)
+{
+    network_device_t dev;
+
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    int live_count = snap->count;
+    /* Read after the snapshot, so it covers every slot in it */
+    if (reserve_owned(device_db_slot_limit()) != NETMON_SUCCESS ||
+        (live_count > live_cap && grow_live(live_count) != NETMON_SUCCESS)) {
+        device_db_snapshot_release(snap);
+        return NETMON_ERROR;
+    }
+    memcpy(live, snap->entries, (size_t)live_count * sizeof(live[0]));
+    qsort(live, (size_t)live_count, sizeof(live[0]), entry_order);
+
+    int i = 0, j = 0;
+    while (i < count || j < live_count) {
+        conf_line_t *c = i < count ? &lines[i] : NULL;
+        const device_entry_t *e = j < live_count ? live[j] : NULL;
+        uint32_t *owner = e != NULL ? chunk_array_at(&owned_id, (uint32_t)e->slot) : NULL;
+
+        /* Later lines naming the same hostname lose */
+        if (c != NULL && i > 0 && lines[i - 1].host_len == c->host_len &&
+            memcmp(lines[i - 1].host, c->host, c->host_len) == 0) {
+            fprintf(stderr, "%s:%d: duplicate hostname, line ignored\n", filename, c->line_no);
+            c->action = LINE_DUPLICATE;
+            diff->rejected++;
+            i++;
+            continue;
+        }
+
+        int order = c == NULL ? 1 : e == NULL ? -1 : span_cmp(c->host, c->host_len, e->hostname);
+        if (order < 0) {
+            c->action = LINE_ADD;
+            i++;
+        } else if (order > 0) {
+            if (*owner == e->id && remove_device(e->hostname) == NETMON_SUCCESS) {
+                *owner = 0;
+                diff->removed++;
+            }
+            j++;
+        } else {
+            uint32_t addr;
+            device_ref_t ref = { e->slot, e->id };
+
+            if (!ipv4_parse(e->ip_address, strlen(e->ip_address), &addr) || addr != c->addr) {
+                /* Another address is another device: fresh metrics and schedule */
+                if (remove_device(e->hostname) == NETMON_SUCCESS) {
+                    *owner = 0;
+                    c->action = LINE_REPLACE;
+                }
+            } else if (e->port != c->port ||
+                       span_cmp(c->community, c->community_len, e->snmp_community) != 0) {
+                line_to_device(c, &dev);
+                dev.poll_interval_ms = e->poll_interval_ms;
+                if (device_db_set_config(ref, &dev) == NETMON_SUCCESS) {
+                    diff->changed++;
+                }
+                *owner = e->id;
+            } else {
+                *owner = e->id;
+                diff->unchanged++;
+            }
+            i++;
+            j++;
+        }
+    }
+    device_db_snapshot_release(snap);
+
+    for (i = 0; i < count; i++) {
+        device_ref_t ref;
+        if (lines[i].action != LINE_ADD && lines[i].action != LINE_REPLACE) {
+            continue;
+        }
+        line_to_device(&lines[i], &dev);
+        if (add_device(&dev) != NETMON_SUCCESS || device_db_find(dev.hostname, &ref) != NETMON_SUCCESS) {
+            fprintf(stderr, "%s:%d: device table refused %s, line skipped\n",
+                    filename, lines[i].line_no, dev.hostname);
+            diff->skipped++;
+            continue;
+        }
+        uint32_t *owner = chunk_array_reserve(&owned_id, (uint32_t)ref.slot);
+        if (owner == NULL) {
+            /* A device the file cannot own would outlive its line */
+            remove_device(dev.hostname);
+            fprintf(stderr, "%s:%d: device table refused %s, line skipped\n",
+                    filename, lines[i].line_no, dev.hostname);
+            diff->skipped++;
+            selfstat_add(SELFSTAT_DEVICES_REFUSED, 1);
+            continue;
+        }
+        *owner = ref.id;
+        if (lines[i].action == LINE_ADD) {
+            diff->added++;
+        } else {
+            diff->changed++;
+        }
+    }
+    return NETMON_SUCCESS;
+}
+
+/* THRESHOLD_DEFAULT_FILE in the directory of filename */
+static void rules_path(const char *filename, char *path, size_t size)
+{
+    const char *slash = strrchr(filename, '/');
+    int dir_len = slash != NULL ? (int)(slash - filename) + 1 : 0;
+
+    snprintf(path, size, "%.*s%s", dir_len, filename, THRESHOLD_DEFAULT_FILE);
+}
+
+int config_apply(const char *filename, config_diff_t *diff)
+{
+    config_diff_t local;
+    struct stat st;
+    char path[PATH_MAX];
+    int rc = NETMON_SUCCESS;
+
+    if (diff == NULL) diff = &local;
+    memset(diff, 0, sizeof(*diff));
+
+    int fd = filename != NULL ? open(filename, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0) {
+        return NETMON_ERROR;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NETMON_ERROR;
+    }
+    pthread_mutex_lock(&apply_lock);
+    ssize_t size = read_text(fd, (size_t)st.st_size);
+    close(fd);
+    int count = size < 0 ? -1 : parse_text(filename, text_buf, (size_t)size, diff);
+    if (count < 0) {
+        rc = NETMON_ERROR;
+    } else {
+        qsort(lines, (size_t)count, sizeof(lines[0]), line_order);
+        rc = merge(filename, count, diff);
+    }
+    pthread_mutex_unlock(&apply_lock);
+
+    if (rc != NETMON_SUCCESS) {
+        return rc;
+    }
+
+    rules_path(filename, path, sizeof(path));
+    if (threshold_load(path) == NETMON_ERROR) {
+        threshold_clear();
+    }
+    return NETMON_SUCCESS;
+}
+
+/*
+ * Load a devices.conf file and compile its threshold rules; see
+ * config_apply() for how it merges with devices already present
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if filename cannot be read
+ */
+int load_config(const char *filename)
+{
+    return config_apply(filename, NULL);
+}
+
+/*
+ * Write every device as a devices.conf line, replacing filename atomically
+ * Returns NETMON_SUCCESS or NETMON_ERROR
+ */
+int save_config(const char *filename)
+{
+    char tmp[PATH_MAX];
+    int rc = NETMON_SUCCESS;
+
+    if (filename == NULL || snprintf(tmp, sizeof(tmp), "%s.tmp", filename) >= (int)sizeof(tmp)) {
+        return NETMON_ERROR;
+    }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (fp == NULL) {
+        if (fd >= 0) close(fd);
+        return NETMON_ERROR;
+    }
+
+    fprintf(fp, "# Network Device Configuration File\n");
+    fprintf(fp, "# Format: hostname;ip_address;snmp_community;port\n");
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    for (int i = 0; i < snap->count; i++) {
+        const device_entry_t *e = snap->entries[i];
+        fprintf(fp, "%s;%s;%s;%u\n", e->hostname, e->ip_address, e->snmp_community, e->port);
+    }
+    device_db_snapshot_release(snap);
+
+    if (fflush(fp) != 0 || fsync(fd) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (fclose(fp) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (rc == NETMON_SUCCESS && rename(tmp, filename) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (rc != NETMON_SUCCESS) {
+        unlink(tmp);
+    }
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/* Hot reload                                                         */
+/* ------------------------------------------------------------------ */
+
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t watch_thread;
+static int watching = 0;
+static int inotify_fd = -1;
+static int watch_stop[2] = { -1, -1 };
+static char watch_path[PATH_MAX];
+static const char *watch_name;        /* Basename inside watch_path */
+static config_reload_cb watch_cb;
+static void *watch_ctx;
+
+/* Non-zero if the events in buf touch one of the watched files */
+static int relevant_events(const char *buf, ssize_t len)
+{
+    int hit = 0;
+
+    for (const char *p = buf; p < buf + len; ) {
+        const struct inotify_event *ev = (const struct inotify_event *)p;
+        if ((ev->mask & IN_Q_OVERFLOW) != 0 ||
+            (ev->len > 0 && (strcmp(ev->name, watch_name) == 0 ||
+                             strcmp(ev->name, THRESHOLD_DEFAULT_FILE) == 0))) {
+            hit = 1;
+        }
+        p += sizeof(*ev) + ev->len;
+    }
+    return hit;
+}
+
+/*
+ * Editors and generators write in bursts (truncate, write, rename);
+ * a reload runs once the files have been quiet for the settle time
+ */
+static void *watch_main(void *arg)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd[2];
+    int pending = 0;
+
+    (void)arg;
+    pfd[0].fd = inotify_fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = watch_stop[0];
+    pfd[1].events = POLLIN;
+
+    for (;;) {
+        int rc = poll(pfd, 2, pending ? CONFIG_RELOAD_SETTLE_MS : -1);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfd[1].revents != 0) {
+            break;
+        }
+        if (rc == 0) {
+            config_diff_t diff;
+            pending = 0;
+            int result = config_apply(watch_path, &diff);
+            if (watch_cb != NULL) {
+                watch_cb(watch_path, result, &diff, watch_ctx);
+            }
+            continue;
+        }
+        ssize_t len = read(inotify_fd, buf, sizeof(buf));
+        if (len > 0 && relevant_events(buf, len)) {
+            pending = 1;
+        }
+    }
+    return NULL;
+}
+
+int config_watch_start(const char *filename, config_reload_cb cb, void *ctx)
+{
+    char path[PATH_MAX];
+    char dir[PATH_MAX];
+
+    /* Format locally; a running watcher still reads watch_path */
+    if (filename == NULL || snprintf(path, sizeof(path), "%s", filename) >= (int)sizeof(path)) {
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&watch_lock);
+    if (watching) {
+        pthread_mutex_unlock(&watch_lock);
+        return NETMON_ERROR;
+    }
+
+    memcpy(watch_path, path, sizeof(watch_path));
+    const char *slash = strrchr(watch_path, '/');
+    watch_name = slash != NULL ? slash + 1 : watch_path;
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", slash == watch_path ? 1 : (int)(slash - watch_path), watch_path);
+    }
+    watch_cb = cb;
+    watch_ctx = ctx;
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 ||
+        inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+        pipe2(watch_stop, O_CLOEXEC) != 0) {
+        if (inotify_fd >= 0) close(inotify_fd);
+        inotify_fd = -1;
+        pthread_mutex_unlock(&watch_lock);
+        return NETMON_ERROR;
+    }
+    if (pthread_create(&watch_thread, NULL, watch_main, NULL) != 0) {
+        close(inotify_fd);
+        close(watch_stop[0]);
+        close(watch_stop[1]);
+        inotify_fd = watch_stop[0] = watch_stop[1] = -1;
+        pthread_mutex_unlock(&watch_lock);
+        return NETMON_ERROR;
+    }
+    watching = 1;
+    pthread_mutex_unlock(&watch_lock);
+    return NETMON_SUCCESS;
+}
+
+void config_watch_stop(void)
+{
+    pthread_mutex_lock(&watch_lock);
+    if (!watching) {
+        pthread_mutex_unlock(&watch_lock);
+        return;
+    }
+    char byte = 0;
+    while (write(watch_stop[1], &byte, 1) < 0 && errno == EINTR) {
+    }
+    pthread_join(watch_thread, NULL);
+    close(inotify_fd);
+    close(watch_stop[0]);
+    close(watch_stop[1]);
+    inotify_fd = watch_stop[0] = watch_stop[1] = -1;
+    watching = 0;
+    pthread_mutex_unlock(&watch_lock);
+}
@@ -4,6 +4,13 @@
  */
 
 #include "netmon.h"
+#include "device_db.h"
+#include "cred_cache.h"
+#include "topology.h"
+#include "threshold.h"
+#include "correlator.h"
+#include "counter_rate.h"
+#include "if_table.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -12,8 +19,6 @@
  */
 int init_netmon(void)
 {
-    printf("Initializing network monitoring system...\n");
-    
     /* TODO: Initialize subsystems:
      * - Device database
      * - Network communication
@@ -27,18 +32,20 @@ int init_netmon(void)
 
 /*
  * Cleanup and shutdown the network monitoring system
+ * Prints nothing: daemon mode owns stdout for the event stream
  */
 void cleanup_netmon(void)
 {
-    printf("Shutting down network monitoring system...\n");
-    
-    /* TODO: Cleanup subsystems:
-     * - Stop monitoring threads
-     * - Close network connections
-     * - Save statistics
-     * - Free allocated memory
-     * - Close display
-     */
+    /* Pollers first: nothing may read the stores once they are freed */
+    stop_monitoring();
+    cleanup_discovery();
+    threshold_clear();
+    correlate_free();
+    counter_rate_free();
+    if_table_free();
+    device_db_clear();
+    cred_cache_free();
+    topo_clear();
 }
 
 /*
@@ -90,3 +97,56 @@ const char* severity_to_string(alert_severity_t severity)
             return "UNKNOWN";
     }
 }
+
+/*
+ * Parse exactly len bytes of dotted-quad text into a host byte order
+ * address; no leading zeros, no surrounding spaces
+ * Returns 1 on success, 0 if the text is not an IPv4 address
+ */
+int ipv4_parse(const char *text, size_t len, uint32_t *addr)
+{
+    uint32_t value = 0;
+    size_t i = 0;
+
+    for (int part = 0; part < 4; part++) {
+        if (part > 0) {
+            if (i >= len || text[i] != '.') return 0;
+            i++;
+        }
+        size_t start = i;
+        unsigned octet = 0;
+        while (i < len && text[i] >= '0' && text[i] <= '9' && i - start < 3) {
+            octet = octet * 10 + (unsigned)(text[i] - '0');
+            i++;
+        }
+        if (i == start || octet > 255 || (text[start] == '0' && i - start > 1)) {
+            return 0;
+        }
+        value = (value << 8) | octet;
+    }
+    if (i != len) {
+        return 0;
+    }
+    *addr = value;
+    return 1;
+}
+
+/*
+ * Non-zero if addr (host byte order) can name a single host: not in
+ * 0.0.0.0/8, multicast, the reserved 240.0.0.0/4 or the broadcast address
+ */
+int ipv4_is_host(uint32_t addr)
+{
+    return (addr >> 24) != 0 && (addr >> 28) < 0xE;
+}
+
+/*
+ * Validate a device address: dotted-quad syntax, then the binary
+ * address must be usable as a host
+ */
+int is_valid_ip(const char *ip)
+{
+    uint32_t addr;
+
+    return ip != NULL && ipv4_parse(ip, strlen(ip), &addr) && ipv4_is_host(addr);
+}
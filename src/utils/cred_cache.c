@@ -0,0 +1,214 @@
+/*
+ * SNMP Credential Cache
+ * Address -> community map backed by a host_index, saved as a small
+ * semicolon-separated text file.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "cred_cache.h"
+#include "host_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+typedef struct {
+    uint32_t addr;
+    char community[MAX_COMMUNITY_LEN];
+    int valid;            /* Cleared by cred_cache_forget */
+} cred_entry_t;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static cred_entry_t *entries = NULL;
+static int entry_count = 0;
+static int entry_cap = 0;
+static host_index_t entry_index;
+static int cache_dirty = 0;
+
+/* Caller holds cache_lock */
+static int store_locked(uint32_t addr, const char *community)
+{
+    int32_t slot;
+
+    if (host_index_find(&entry_index, addr, &slot)) {
+        cred_entry_t *e = &entries[slot];
+        if (!e->valid || strcmp(e->community, community) != 0) {
+            strcpy(e->community, community);
+            e->valid = 1;
+            cache_dirty = 1;
+        }
+        return NETMON_SUCCESS;
+    }
+
+    if (entry_count == entry_cap) {
+        int cap = entry_cap ? entry_cap * 2 : 64;
+        cred_entry_t *grown = realloc(entries, (size_t)cap * sizeof(*grown));
+        if (grown == NULL) {
+            return NETMON_ERROR;
+        }
+        entries = grown;
+        entry_cap = cap;
+    }
+
+    if (host_index_insert(&entry_index, addr, entry_count, NULL) < 0) {
+        return NETMON_ERROR;
+    }
+
+    entries[entry_count].addr = addr;
+    strcpy(entries[entry_count].community, community);
+    entries[entry_count].valid = 1;
+    entry_count++;
+    cache_dirty = 1;
+    return NETMON_SUCCESS;
+}
+
+int cred_cache_load(const char *path)
+{
+    char line[256];
+    int loaded = 0;
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+        p[strcspn(p, "\r\n")] = '\0';
+        char *sep = strchr(p, ';');
+        if (sep == NULL) continue;
+        *sep = '\0';
+
+        struct in_addr in;
+        const char *community = sep + 1;
+        if (inet_pton(AF_INET, p, &in) != 1 || *community == '\0' ||
+            strlen(community) >= MAX_COMMUNITY_LEN) {
+            continue;
+        }
+
+        if (store_locked(ntohl(in.s_addr), community) != NETMON_SUCCESS) {
+            pthread_mutex_unlock(&cache_lock);
+            fclose(fp);
+            return NETMON_ERROR;
+        }
+        loaded++;
+    }
+    cache_dirty = 0;
+    pthread_mutex_unlock(&cache_lock);
+
+    fclose(fp);
+    return loaded;
+}
+
+int cred_cache_save(const char *path)
+{
+    char tmp[512];
+    int rc = NETMON_SUCCESS;
+
+    pthread_mutex_lock(&cache_lock);
+    if (!cache_dirty) {
+        pthread_mutex_unlock(&cache_lock);
+        return NETMON_SUCCESS;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (fp == NULL) {
+        if (fd >= 0) close(fd);
+        pthread_mutex_unlock(&cache_lock);
+        return NETMON_ERROR;
+    }
+
+    fprintf(fp, "# SNMP credentials learned during discovery\n");
+    fprintf(fp, "# Format: ip_address;snmp_community\n");
+    fprintf(fp, "# Generated file - delete a line to force re-probing that device\n");
+    for (int i = 0; i < entry_count; i++) {
+        if (!entries[i].valid) continue;
+
+        char ip[MAX_IP_LEN];
+        struct in_addr in;
+        in.s_addr = htonl(entries[i].addr);
+        inet_ntop(AF_INET, &in, ip, sizeof(ip));
+        fprintf(fp, "%s;%s\n", ip, entries[i].community);
+    }
+
+    if (fflush(fp) != 0 || fsync(fd) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (fclose(fp) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (rc == NETMON_SUCCESS && rename(tmp, path) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (rc != NETMON_SUCCESS) {
+        unlink(tmp);
+    } else {
+        cache_dirty = 0;
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+    return rc;
+}
+
+int cred_cache_lookup(uint32_t addr, char *community, size_t size)
+{
+    int32_t slot;
+    int found = 0;
+
+    pthread_mutex_lock(&cache_lock);
+    if (host_index_find(&entry_index, addr, &slot) && entries[slot].valid &&
+        strlen(entries[slot].community) < size) {
+        strcpy(community, entries[slot].community);
+        found = 1;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return found;
+}
+
+int cred_cache_store(uint32_t addr, const char *community)
+{
+    if (community == NULL || *community == '\0' || strlen(community) >= MAX_COMMUNITY_LEN) {
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    int rc = store_locked(addr, community);
+    pthread_mutex_unlock(&cache_lock);
+    return rc;
+}
+
+void cred_cache_forget(uint32_t addr)
+{
+    int32_t slot;
+
+    pthread_mutex_lock(&cache_lock);
+    if (host_index_find(&entry_index, addr, &slot) && entries[slot].valid) {
+        entries[slot].valid = 0;
+        cache_dirty = 1;
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void cred_cache_free(void)
+{
+    pthread_mutex_lock(&cache_lock);
+    free(entries);
+    entries = NULL;
+    entry_count = 0;
+    entry_cap = 0;
+    host_index_free(&entry_index);
+    cache_dirty = 0;
+    pthread_mutex_unlock(&cache_lock);
+}
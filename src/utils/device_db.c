@@ -0,0 +1,595 @@
+/*
+ * Device Database
+ * Copy-on-write device list with epoch-based reclamation. Polled values
+ * are kept in the metrics store under each entry's slot; slots come
+ * from a chunked slot table with a free list, so the table grows a
+ * chunk at a time and freed slots are reused first.
+ *
+ * Readers register the global epoch in a reader slot before loading the
+ * snapshot pointer. A writer swaps in a new snapshot, bumps the epoch
+ * and tags the old one with it; the old snapshot is freed once every
+ * registered reader carries an epoch at least that new, since such
+ * readers loaded the pointer after the swap.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "device_db.h"
+#include "correlator.h"
+#include "selfstat.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <pthread.h>
+
+/* Slots travel as int32_t in alerts, and INT32_MAX means "no slot" to the rule evaluator */
+_Static_assert(DEVICE_DB_MAX_SLOTS < INT32_MAX, "device slots must fit an int32_t");
+
+/* Slot table row; next_free links free slots, -1 ends the list */
+typedef struct {
+    uint32_t id;                  /* Device holding the slot, 0 = free */
+    int32_t next_free;
+} slot_row_t;
+
+/* Snapshot or entry waiting for readers to move past its epoch */
+typedef struct retired {
+    struct retired *next;
+    uint64_t epoch;
+    void *ptr;
+} retired_t;
+
+static device_snapshot_t empty_snapshot;
+static _Atomic(device_snapshot_t *) current = &empty_snapshot;
+static atomic_ullong global_epoch = 1;
+static atomic_ullong reader_epoch[DEVICE_DB_MAX_READERS];
+static _Atomic(const device_snapshot_t *) reader_owner[DEVICE_DB_MAX_READERS];
+
+/* Serializes adds/removes; never taken by readers or metric writers */
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static retired_t *retired_list = NULL;
+static uint32_t next_id = 1;
+static chunk_array_t slot_table = CHUNK_ARRAY_INIT(slot_row_t);
+static int32_t free_slot = -1;
+static int slot_limit = 0;            /* Slots ever handed out; read without the lock */
+
+/* ------------------------------------------------------------------ */
+/* Snapshot readers                                                   */
+/* ------------------------------------------------------------------ */
+
+const device_snapshot_t *device_db_snapshot_acquire(void)
+{
+    static _Thread_local unsigned hint = 0;
+
+    for (;;) {
+        for (unsigned k = 0; k < DEVICE_DB_MAX_READERS; k++) {
+            unsigned i = (hint + k) % DEVICE_DB_MAX_READERS;
+            unsigned long long expected = 0;
+            unsigned long long epoch = atomic_load(&global_epoch);
+
+            if (atomic_load_explicit(&reader_epoch[i], memory_order_relaxed) == 0 &&
+                atomic_compare_exchange_strong(&reader_epoch[i], &expected, epoch)) {
+                const device_snapshot_t *snap = atomic_load(&current);
+                atomic_store(&reader_owner[i], snap);
+                hint = i;
+                return snap;
+            }
+        }
+        sched_yield();
+    }
+}
+
+/*
+ * Any slot registered by a holder of the same snapshot may be cleared:
+ * all of them recorded an epoch from before that snapshot was replaced.
+ */
+void device_db_snapshot_release(const device_snapshot_t *snapshot)
+{
+    for (unsigned i = 0; i < DEVICE_DB_MAX_READERS; i++) {
+        const device_snapshot_t *expected = snapshot;
+        if (atomic_load_explicit(&reader_owner[i], memory_order_relaxed) == snapshot &&
+            atomic_compare_exchange_strong(&reader_owner[i], &expected, NULL)) {
+            atomic_store(&reader_epoch[i], 0);
+            return;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Writers                                                            */
+/* ------------------------------------------------------------------ */
+
+/* Free everything no registered reader can reach; caller holds writer_lock */
+static void reclaim(void)
+{
+    uint64_t min_epoch = UINT64_MAX;
+
+    for (unsigned i = 0; i < DEVICE_DB_MAX_READERS; i++) {
+        uint64_t e = atomic_load(&reader_epoch[i]);
+        if (e != 0 && e < min_epoch) {
+            min_epoch = e;
+        }
+    }
+
+    retired_t **link = &retired_list;
+    while (*link != NULL) {
+        retired_t *r = *link;
+        if (r->epoch <= min_epoch) {
+            *link = r->next;
+            free(r->ptr);
+            free(r);
+        } else {
+            link = &r->next;
+        }
+    }
+}
+
+static void retire(void *ptr, uint64_t epoch)
+{
+    retired_t *r = malloc(sizeof(*r));
+    if (r == NULL) {
+        return;   /* Leak rather than free memory a reader may hold */
+    }
+    r->ptr = ptr;
+    r->epoch = epoch;
+    r->next = retired_list;
+    retired_list = r;
+}
+
+/*
+ * Swap in next and retire the previous snapshot plus an optional entry
+ * Caller holds writer_lock
+ */
+static void publish(device_snapshot_t *next, device_entry_t *dropped)
+{
+    device_snapshot_t *prev = atomic_exchange(&current, next);
+    uint64_t epoch = atomic_fetch_add(&global_epoch, 1) + 1;
+
+    if (prev != &empty_snapshot) {
+        retire(prev, epoch);
+    }
+    if (dropped != NULL) {
+        retire(dropped, epoch);
+    }
+    reclaim();
+}
+
+static void entry_to_device(const device_entry_t *e, network_device_t *d)
+{
+    memset(d, 0, sizeof(*d));
+    memcpy(d->hostname, e->hostname, sizeof(d->hostname));
+    memcpy(d->ip_address, e->ip_address, sizeof(d->ip_address));
+    memcpy(d->snmp_community, e->snmp_community, sizeof(d->snmp_community));
+    d->port = e->port;
+    d->poll_interval_ms = e->poll_interval_ms;
+}
+
+static void device_to_metrics(const network_device_t *d, device_metrics_t *m)
+{
+    m->status = d->status;
+    m->last_seen = d->last_seen;
+    m->bytes_in = d->bytes_in;
+    m->bytes_out = d->bytes_out;
+    m->in_bps = d->in_bps;
+    m->out_bps = d->out_bps;
+    m->errors_in = d->errors_in;
+    m->errors_out = d->errors_out;
+    m->cpu_usage = d->cpu_usage;
+    m->memory_usage = d->memory_usage;
+    m->response_time_ms = d->response_time_ms;
+}
+
+static void merge_metrics(network_device_t *d, const device_metrics_t *m)
+{
+    d->status = m->status;
+    d->last_seen = m->last_seen;
+    d->bytes_in = m->bytes_in;
+    d->bytes_out = m->bytes_out;
+    d->in_bps = m->in_bps;
+    d->out_bps = m->out_bps;
+    d->errors_in = m->errors_in;
+    d->errors_out = m->errors_out;
+    d->cpu_usage = m->cpu_usage;
+    d->memory_usage = m->memory_usage;
+    d->response_time_ms = m->response_time_ms;
+}
+
+/* Snapshot with room for count entries */
+static device_snapshot_t *snapshot_alloc(int count)
+{
+    return malloc(sizeof(device_snapshot_t) + (size_t)count * sizeof(const device_entry_t *));
+}
+
+/*
+ * Take a free slot for device id, growing the slot table if none is
+ * free. Returns the slot, or -1 when the table is at DEVICE_DB_MAX_SLOTS
+ * or out of memory. Caller holds writer_lock
+ */
+static int slot_take(uint32_t id)
+{
+    int slot = free_slot;
+    slot_row_t *row;
+
+    if (slot >= 0) {
+        row = chunk_array_at(&slot_table, (uint32_t)slot);
+        free_slot = row->next_free;
+    } else {
+        if (slot_limit >= DEVICE_DB_MAX_SLOTS ||
+            (row = chunk_array_reserve(&slot_table, (uint32_t)slot_limit)) == NULL) {
+            return -1;
+        }
+        slot = slot_limit;
+    }
+    row->id = id;
+    row->next_free = -1;
+    return slot;
+}
+
+/* Put a slot back on the free list; caller holds writer_lock */
+static void slot_put(int slot)
+{
+    slot_row_t *row = chunk_array_at(&slot_table, (uint32_t)slot);
+
+    row->id = 0;
+    row->next_free = free_slot;
+    free_slot = slot;
+}
+
+static const device_entry_t *snapshot_find(const device_snapshot_t *snap, const char *hostname)
+{
+    for (int i = 0; i < snap->count; i++) {
+        if (strcmp(snap->entries[i]->hostname, hostname) == 0) {
+            return snap->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* netmon.h device management API                                     */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Add a device to the database
+ * Returns NETMON_SUCCESS, or NETMON_ERROR if the hostname exists, every
+ * slot is taken or memory is exhausted
+ */
+int add_device(const network_device_t *device)
+{
+    int rc = NETMON_ERROR;
+
+    if (device == NULL || device->hostname[0] == '\0' ||
+        memchr(device->hostname, '\0', sizeof(device->hostname)) == NULL) {
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    const device_snapshot_t *cur = atomic_load(&current);
+
+    if (snapshot_find(cur, device->hostname) == NULL) {
+        device_snapshot_t *next = snapshot_alloc(cur->count + 1);
+        device_entry_t *entry = malloc(sizeof(*entry));
+        uint32_t id = next_id;
+        int slot = next != NULL && entry != NULL ? slot_take(id) : -1;
+
+        /* Claim the metrics slot before the device becomes visible */
+        device_metrics_t initial;
+        device_to_metrics(device, &initial);
+        if (slot >= 0 && metrics_store_claim(slot, id, &initial) != NETMON_SUCCESS) {
+            slot_put(slot);
+            slot = -1;
+        }
+
+        if (slot >= 0) {
+            if (slot == slot_limit) {
+                __atomic_store_n(&slot_limit, slot + 1, __ATOMIC_RELEASE);
+            }
+            memcpy(entry->hostname, device->hostname, sizeof(entry->hostname));
+            memcpy(entry->ip_address, device->ip_address, sizeof(entry->ip_address));
+            memcpy(entry->snmp_community, device->snmp_community, sizeof(entry->snmp_community));
+            entry->port = device->port != 0 ? device->port : DEFAULT_SNMP_PORT;
+            entry->poll_interval_ms = device->poll_interval_ms;
+            entry->id = id;
+            next_id++;
+            if (next_id == 0) next_id = 1;
+            entry->slot = slot;
+
+            memcpy(next->entries, cur->entries, (size_t)cur->count * sizeof(cur->entries[0]));
+            next->entries[cur->count] = entry;
+            next->count = cur->count + 1;
+            next->generation = cur->generation + 1;
+            publish(next, NULL);
+            rc = NETMON_SUCCESS;
+        } else {
+            selfstat_add(SELFSTAT_DEVICES_REFUSED, 1);
+            free(next);
+            free(entry);
+        }
+    }
+
+    pthread_mutex_unlock(&writer_lock);
+    return rc;
+}
+
+int remove_device(const char *hostname)
+{
+    int rc = NETMON_ERROR;
+
+    if (hostname == NULL) {
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    const device_snapshot_t *cur = atomic_load(&current);
+    const device_entry_t *entry = snapshot_find(cur, hostname);
+
+    if (entry != NULL) {
+        device_snapshot_t *next = snapshot_alloc(cur->count - 1);
+        if (next != NULL) {
+            next->count = 0;
+            for (int i = 0; i < cur->count; i++) {
+                if (cur->entries[i] != entry) {
+                    next->entries[next->count++] = cur->entries[i];
+                }
+            }
+            next->generation = cur->generation + 1;
+
+            metrics_store_release(entry->slot);
+            slot_put(entry->slot);
+
+            publish(next, (device_entry_t *)entry);
+            rc = NETMON_SUCCESS;
+        }
+    }
+
+    pthread_mutex_unlock(&writer_lock);
+    return rc;
+}
+
+int device_db_set_config(device_ref_t ref, const network_device_t *device)
+{
+    int rc = NETMON_ERROR;
+
+    if (device == NULL) {
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    const device_snapshot_t *cur = atomic_load(&current);
+    int index = -1;
+    for (int i = 0; i < cur->count; i++) {
+        if (cur->entries[i]->slot == ref.slot && cur->entries[i]->id == ref.id) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index >= 0) {
+        device_snapshot_t *next = snapshot_alloc(cur->count);
+        device_entry_t *entry = malloc(sizeof(*entry));
+
+        if (next != NULL && entry != NULL) {
+            const device_entry_t *old = cur->entries[index];
+            *entry = *old;
+            memcpy(entry->snmp_community, device->snmp_community, sizeof(entry->snmp_community));
+            entry->snmp_community[sizeof(entry->snmp_community) - 1] = '\0';
+            entry->port = device->port != 0 ? device->port : DEFAULT_SNMP_PORT;
+            entry->poll_interval_ms = device->poll_interval_ms;
+
+            memcpy(next->entries, cur->entries, (size_t)cur->count * sizeof(cur->entries[0]));
+            next->entries[index] = entry;
+            next->count = cur->count;
+            next->generation = cur->generation + 1;
+            publish(next, (device_entry_t *)old);
+            rc = NETMON_SUCCESS;
+        } else {
+            free(next);
+            free(entry);
+        }
+    }
+
+    pthread_mutex_unlock(&writer_lock);
+    return rc;
+}
+
+int get_device(const char *hostname, network_device_t *device)
+{
+    int rc = NETMON_ERROR;
+
+    if (hostname == NULL || device == NULL) {
+        return NETMON_ERROR;
+    }
+
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    const device_entry_t *entry = snapshot_find(snap, hostname);
+    if (entry != NULL) {
+        device_ref_t ref = { entry->slot, entry->id };
+        device_metrics_t m;
+        entry_to_device(entry, device);
+        if (device_db_read_metrics(ref, &m) == NETMON_SUCCESS) {
+            merge_metrics(device, &m);
+            rc = NETMON_SUCCESS;
+        }
+    }
+    device_db_snapshot_release(snap);
+    return rc;
+}
+
+/*
+ * Copy up to max_count devices into devices
+ * Returns the number copied. Prefer device_db_snapshot_acquire() for
+ * readers that only need a few fields.
+ */
+int get_all_devices(network_device_t *devices, int max_count)
+{
+    int n = 0;
+
+    if (devices == NULL) {
+        return 0;
+    }
+
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    for (int i = 0; i < snap->count && n < max_count; i++) {
+        const device_entry_t *entry = snap->entries[i];
+        device_ref_t ref = { entry->slot, entry->id };
+        device_metrics_t m;
+
+        entry_to_device(entry, &devices[n]);
+        if (device_db_read_metrics(ref, &m) == NETMON_SUCCESS) {
+            merge_metrics(&devices[n], &m);
+        }
+        n++;
+    }
+    device_db_snapshot_release(snap);
+    return n;
+}
+
+int update_device_status(const char *hostname, device_status_t status)
+{
+    device_ref_t ref;
+    device_metrics_t before;
+
+    if (device_db_find(hostname, &ref) != NETMON_SUCCESS ||
+        metrics_store_read(ref.slot, ref.id, &before) != NETMON_SUCCESS) {
+        return NETMON_ERROR;
+    }
+
+    int rc = metrics_store_set_status(ref.slot, ref.id, status);
+    if (rc == NETMON_SUCCESS) {
+        correlate_status(&ref, before.status, status);
+    }
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/* device_db.h                                                        */
+/* ------------------------------------------------------------------ */
+
+int device_db_read_metrics(device_ref_t ref, device_metrics_t *metrics)
+{
+    return metrics_store_read(ref.slot, ref.id, metrics);
+}
+
+int device_db_count(void)
+{
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    int n = snap->count;
+    device_db_snapshot_release(snap);
+    return n;
+}
+
+uint32_t device_db_generation(void)
+{
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    uint32_t g = snap->generation;
+    device_db_snapshot_release(snap);
+    return g;
+}
+
+int device_db_slot_limit(void)
+{
+    return __atomic_load_n(&slot_limit, __ATOMIC_ACQUIRE);
+}
+
+int device_db_list(device_ref_t **refs)
+{
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    int n = snap->count;
+
+    *refs = malloc((size_t)(n > 0 ? n : 1) * sizeof(**refs));
+    if (*refs == NULL) {
+        device_db_snapshot_release(snap);
+        return NETMON_ERROR;
+    }
+    for (int i = 0; i < n; i++) {
+        (*refs)[i].slot = snap->entries[i]->slot;
+        (*refs)[i].id = snap->entries[i]->id;
+    }
+    device_db_snapshot_release(snap);
+    return n;
+}
+
+int device_db_find(const char *hostname, device_ref_t *ref)
+{
+    int rc = NETMON_ERROR;
+
+    if (hostname == NULL || ref == NULL) {
+        return NETMON_ERROR;
+    }
+
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    const device_entry_t *entry = snapshot_find(snap, hostname);
+    if (entry != NULL) {
+        ref->slot = entry->slot;
+        ref->id = entry->id;
+        rc = NETMON_SUCCESS;
+    }
+    device_db_snapshot_release(snap);
+    return rc;
+}
+
+int device_db_read(device_ref_t ref, network_device_t *device)
+{
+    int rc = NETMON_ERROR;
+
+    if (ref.slot < 0 || device == NULL) {
+        return NETMON_ERROR;
+    }
+
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    for (int i = 0; i < snap->count; i++) {
+        const device_entry_t *entry = snap->entries[i];
+        if (entry->slot == ref.slot && entry->id == ref.id) {
+            device_metrics_t m;
+            entry_to_device(entry, device);
+            if (device_db_read_metrics(ref, &m) == NETMON_SUCCESS) {
+                merge_metrics(device, &m);
+                rc = NETMON_SUCCESS;
+            }
+            break;
+        }
+    }
+    device_db_snapshot_release(snap);
+    return rc;
+}
+
+int device_db_update_metrics(device_ref_t ref, const network_device_t *metrics)
+{
+    device_metrics_t m;
+
+    if (metrics == NULL) {
+        return NETMON_ERROR;
+    }
+    device_to_metrics(metrics, &m);
+    return metrics_store_write(ref.slot, ref.id, &m);
+}
+
+void device_db_clear(void)
+{
+    pthread_mutex_lock(&writer_lock);
+    const device_snapshot_t *cur = atomic_load(&current);
+    device_snapshot_t *next = calloc(1, sizeof(*next));
+
+    if (next != NULL) {
+        next->generation = cur->generation + 1;
+        metrics_store_free();
+        chunk_array_free(&slot_table);
+        free_slot = -1;
+        __atomic_store_n(&slot_limit, 0, __ATOMIC_RELEASE);
+
+        /* Entries go with the old snapshot's epoch */
+        device_snapshot_t *prev = atomic_exchange(&current, next);
+        uint64_t epoch = atomic_fetch_add(&global_epoch, 1) + 1;
+        for (int i = 0; i < prev->count; i++) {
+            retire((void *)prev->entries[i], epoch);
+        }
+        if (prev != &empty_snapshot) {
+            retire(prev, epoch);
+        }
+    }
+    reclaim();
+    pthread_mutex_unlock(&writer_lock);
+}
@@ -0,0 +1,129 @@
+/*
+ * Host Index
+ * Linear-probing hash map keyed by IPv4 address. Kept at most half full
+ * so lookups touch one or two cache lines on average.
+ */
+
+#include "host_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_INDEX_MIN_CAPACITY 256
+
+/* Fibonacci hashing spreads sequential subnet addresses evenly */
+static uint32_t hash_addr(uint32_t addr, uint32_t mask)
+{
+    uint32_t h = addr * 2654435769U;
+    return (h ^ (h >> 16)) & mask;
+}
+
+static int rehash(host_index_t *idx, uint32_t new_capacity)
+{
+    uint32_t *keys = calloc(new_capacity, sizeof(*keys));
+    int32_t *values = malloc((size_t)new_capacity * sizeof(*values));
+    if (keys == NULL || values == NULL) {
+        free(keys);
+        free(values);
+        return -1;
+    }
+
+    uint32_t mask = new_capacity - 1;
+    for (uint32_t i = 0; i < idx->capacity; i++) {
+        uint32_t key = idx->keys[i];
+        if (key == 0) continue;
+
+        uint32_t pos = hash_addr(key, mask);
+        while (keys[pos] != 0) {
+            pos = (pos + 1) & mask;
+        }
+        keys[pos] = key;
+        values[pos] = idx->values[i];
+    }
+
+    free(idx->keys);
+    free(idx->values);
+    idx->keys = keys;
+    idx->values = values;
+    idx->capacity = new_capacity;
+    return 0;
+}
+
+void host_index_free(host_index_t *idx)
+{
+    free(idx->keys);
+    free(idx->values);
+    memset(idx, 0, sizeof(*idx));
+}
+
+void host_index_clear(host_index_t *idx)
+{
+    if (idx->keys != NULL) {
+        memset(idx->keys, 0, (size_t)idx->capacity * sizeof(*idx->keys));
+    }
+    idx->count = 0;
+    idx->has_zero = 0;
+}
+
+int host_index_find(const host_index_t *idx, uint32_t addr, int32_t *value)
+{
+    if (addr == 0) {
+        if (idx->has_zero && value != NULL) *value = idx->zero_value;
+        return idx->has_zero;
+    }
+    if (idx->capacity == 0) {
+        return 0;
+    }
+
+    uint32_t mask = idx->capacity - 1;
+    uint32_t pos = hash_addr(addr, mask);
+    while (idx->keys[pos] != 0) {
+        if (idx->keys[pos] == addr) {
+            if (value != NULL) *value = idx->values[pos];
+            return 1;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return 0;
+}
+
+int host_index_insert(host_index_t *idx, uint32_t addr, int32_t value, int32_t *existing)
+{
+    if (addr == 0) {
+        if (idx->has_zero) {
+            if (existing != NULL) *existing = idx->zero_value;
+            return 0;
+        }
+        idx->has_zero = 1;
+        idx->zero_value = value;
+        idx->count++;
+        return 1;
+    }
+
+    /* Grow before exceeding 50% load */
+    if ((idx->count + 1) * 2 > idx->capacity) {
+        uint32_t cap = idx->capacity ? idx->capacity * 2 : HOST_INDEX_MIN_CAPACITY;
+        if (rehash(idx, cap) != 0) {
+            return -1;
+        }
+    }
+
+    uint32_t mask = idx->capacity - 1;
+    uint32_t pos = hash_addr(addr, mask);
+    while (idx->keys[pos] != 0) {
+        if (idx->keys[pos] == addr) {
+            if (existing != NULL) *existing = idx->values[pos];
+            return 0;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    idx->keys[pos] = addr;
+    idx->values[pos] = value;
+    idx->count++;
+    return 1;
+}
+
+uint32_t host_index_count(const host_index_t *idx)
+{
+    return idx->count;
+}
@@ -0,0 +1,398 @@
+/*
+ * Interface Table
+ * One entry per device slot holding parallel info/counter arrays sorted
+ * by ifindex. Polls merge sorted counter rows in a single linear pass;
+ * lookups binary-search the ifindex. Writers hold the slot mutex and
+ * bump a sequence counter around every change, so if_table_read() can
+ * copy rows without the mutex; replaced arrays are freed once no such
+ * reader is inside them. Slots live in a chunk array that grows with
+ * the device table; a slot's mutex is set up the first time it is
+ * claimed.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "if_table.h"
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define RELAXED __ATOMIC_RELAXED
+
+typedef struct {
+    int ready;                    /* Mutex initialised; set once, with release */
+    pthread_mutex_t lock;
+    uint32_t seq;                 /* Odd while id, count, the arrays or counters change */
+    int readers;                  /* if_table_read() calls inside the arrays */
+    uint32_t id;                  /* Device the rows belong to, 0 = none */
+    int discovered;
+    uint32_t last_change;
+    time_t discovered_at;
+    int has_hc;
+    int count;
+    int cap;
+    if_info_t *info;
+    if_counters_t *counters;
+} if_device_t;
+
+static chunk_array_t devices = CHUNK_ARRAY_INIT(if_device_t);
+static int device_limit = 0;      /* One past the highest ready slot; written under table_lock */
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static int total_rows = 0;        /* Atomic */
+
+/*
+ * Slot record, or NULL if it was never claimed. With create, the slot
+ * is reserved and its mutex set up; NULL then means out of memory.
+ */
+static if_device_t *device_at(int slot, int create)
+{
+    if (slot < 0) {
+        return NULL;
+    }
+    if_device_t *d = chunk_array_get(&devices, (uint32_t)slot);
+    if (d != NULL && __atomic_load_n(&d->ready, __ATOMIC_ACQUIRE)) {
+        return d;
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&table_lock);
+    d = chunk_array_reserve(&devices, (uint32_t)slot);
+    if (d != NULL && !d->ready) {
+        pthread_mutex_init(&d->lock, NULL);
+        __atomic_store_n(&d->ready, 1, __ATOMIC_RELEASE);
+        if (slot >= device_limit) {
+            device_limit = slot + 1;
+        }
+    }
+    pthread_mutex_unlock(&table_lock);
+    return d;
+}
+
+/* Writer side of the sequence counter; caller holds the slot mutex */
+static void write_begin(if_device_t *d)
+{
+    __atomic_store_n(&d->seq, d->seq + 1, RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(if_device_t *d)
+{
+    __atomic_store_n(&d->seq, d->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Field-wise so lock-free readers never race a plain struct copy */
+static void store_counters(if_counters_t *dst, const if_counters_t *src)
+{
+    __atomic_store_n(&dst->ifindex, src->ifindex, RELAXED);
+    __atomic_store_n(&dst->oper_status, src->oper_status, RELAXED);
+    __atomic_store_n(&dst->width, src->width, RELAXED);
+    __atomic_store_n(&dst->in_octets, src->in_octets, RELAXED);
+    __atomic_store_n(&dst->out_octets, src->out_octets, RELAXED);
+    __atomic_store_n(&dst->in_errors, src->in_errors, RELAXED);
+    __atomic_store_n(&dst->out_errors, src->out_errors, RELAXED);
+    __atomic_store_n(&dst->in_bps, src->in_bps, RELAXED);
+    __atomic_store_n(&dst->out_bps, src->out_bps, RELAXED);
+    __atomic_store_n(&dst->updated, src->updated, RELAXED);
+}
+
+static void load_counters(if_counters_t *dst, const if_counters_t *src)
+{
+    dst->ifindex = __atomic_load_n(&src->ifindex, RELAXED);
+    dst->oper_status = __atomic_load_n(&src->oper_status, RELAXED);
+    dst->width = __atomic_load_n(&src->width, RELAXED);
+    dst->in_octets = __atomic_load_n(&src->in_octets, RELAXED);
+    dst->out_octets = __atomic_load_n(&src->out_octets, RELAXED);
+    dst->in_errors = __atomic_load_n(&src->in_errors, RELAXED);
+    dst->out_errors = __atomic_load_n(&src->out_errors, RELAXED);
+    dst->in_bps = __atomic_load_n(&src->in_bps, RELAXED);
+    dst->out_bps = __atomic_load_n(&src->out_bps, RELAXED);
+    dst->updated = __atomic_load_n(&src->updated, RELAXED);
+}
+
+/*
+ * Lock slot for device id. With claim, rows of a previous owner are
+ * dropped; otherwise a slot held by another device yields NULL.
+ */
+static if_device_t *lock_device(int slot, uint32_t id, int claim)
+{
+    if (id == 0) {
+        return NULL;
+    }
+    if_device_t *d = device_at(slot, claim);
+    if (d == NULL) {
+        return NULL;
+    }
+    pthread_mutex_lock(&d->lock);
+    if (d->id != id) {
+        if (!claim) {
+            pthread_mutex_unlock(&d->lock);
+            return NULL;
+        }
+        __atomic_fetch_sub(&total_rows, d->count, __ATOMIC_RELAXED);
+        write_begin(d);
+        __atomic_store_n(&d->id, id, RELAXED);
+        __atomic_store_n(&d->count, 0, RELAXED);
+        write_end(d);
+        d->discovered = 0;
+        d->has_hc = 0;
+    }
+    return d;
+}
+
+static int find_row(const if_device_t *d, uint32_t ifindex)
+{
+    int lo = 0, hi = d->count;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (d->info[mid].ifindex < ifindex) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < d->count && d->info[lo].ifindex == ifindex ? lo : -1;
+}
+
+int if_table_set_interfaces(int slot, uint32_t id, const if_info_t *rows, int count,
+                            uint32_t last_change, time_t now)
+{
+    if (count < 0 || (count > 0 && rows == NULL)) {
+        return NETMON_ERROR;
+    }
+    if_device_t *d = lock_device(slot, id, 1);
+    if (d == NULL) {
+        return NETMON_ERROR;
+    }
+
+    /* Reserve the growth against the global limit before touching anything */
+    int delta = count - d->count;
+    if (delta > 0 && __atomic_add_fetch(&total_rows, delta, __ATOMIC_RELAXED) > IF_TABLE_MAX_ROWS) {
+        __atomic_fetch_sub(&total_rows, delta, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&d->lock);
+        return NETMON_ERROR;
+    }
+
+    int cap = count > d->cap ? count : d->cap;
+    if_info_t *info = malloc((size_t)(cap ? cap : 1) * sizeof(*info));
+    if_counters_t *counters = malloc((size_t)(cap ? cap : 1) * sizeof(*counters));
+    if (info == NULL || counters == NULL) {
+        free(info);
+        free(counters);
+        if (delta > 0) {
+            __atomic_fetch_sub(&total_rows, delta, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&d->lock);
+        return NETMON_ERROR;
+    }
+
+    /* Both lists are sorted: carry counters over in one merge */
+    int j = 0, has_hc = 0;
+    for (int i = 0; i < count; i++) {
+        info[i] = rows[i];
+        has_hc |= rows[i].has_hc;
+        while (j < d->count && d->info[j].ifindex < rows[i].ifindex) {
+            j++;
+        }
+        if (j < d->count && d->info[j].ifindex == rows[i].ifindex) {
+            counters[i] = d->counters[j];
+        } else {
+            memset(&counters[i], 0, sizeof(counters[i]));
+            counters[i].ifindex = rows[i].ifindex;
+        }
+    }
+
+    if_info_t *old_info = d->info;
+    if_counters_t *old_counters = d->counters;
+    write_begin(d);
+    __atomic_store_n(&d->info, info, RELAXED);
+    __atomic_store_n(&d->counters, counters, RELAXED);
+    __atomic_store_n(&d->count, count, RELAXED);
+    write_end(d);
+    d->cap = cap;
+    if (delta < 0) {
+        __atomic_fetch_sub(&total_rows, -delta, __ATOMIC_RELAXED);
+    }
+    d->has_hc = has_hc;
+    d->discovered = 1;
+    d->last_change = last_change;
+    d->discovered_at = now;
+
+    /* A reader that loaded the old pointers registered before loading them */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&d->readers, __ATOMIC_ACQUIRE) > 0) {
+        sched_yield();
+    }
+    free(old_info);
+    free(old_counters);
+    pthread_mutex_unlock(&d->lock);
+    return NETMON_SUCCESS;
+}
+
+int if_table_discovery_state(int slot, uint32_t id, uint32_t *last_change, time_t *discovered_at)
+{
+    if_device_t *d = lock_device(slot, id, 0);
+    if (d == NULL) {
+        return -1;
+    }
+    int n = d->discovered ? d->count : -1;
+    if (last_change != NULL) *last_change = d->last_change;
+    if (discovered_at != NULL) *discovered_at = d->discovered_at;
+    pthread_mutex_unlock(&d->lock);
+    return n;
+}
+
+int if_table_has_hc(int slot, uint32_t id)
+{
+    if_device_t *d = lock_device(slot, id, 0);
+    if (d == NULL) {
+        return 0;
+    }
+    int hc = d->has_hc;
+    pthread_mutex_unlock(&d->lock);
+    return hc;
+}
+
+int if_table_update_counters(int slot, uint32_t id, const if_counters_t *rows, int count)
+{
+    int unmatched = 0;
+
+    if (count < 0 || (count > 0 && rows == NULL)) {
+        return NETMON_ERROR;
+    }
+    if_device_t *d = lock_device(slot, id, 0);
+    if (d == NULL) {
+        return NETMON_ERROR;
+    }
+
+    int j = 0;
+    write_begin(d);
+    for (int i = 0; i < count; i++) {
+        while (j < d->count && d->counters[j].ifindex < rows[i].ifindex) {
+            j++;
+        }
+        if (j < d->count && d->counters[j].ifindex == rows[i].ifindex) {
+            store_counters(&d->counters[j++], &rows[i]);
+        } else {
+            unmatched++;
+        }
+    }
+    write_end(d);
+    pthread_mutex_unlock(&d->lock);
+    return unmatched;
+}
+
+int if_table_get(int slot, uint32_t id, uint32_t ifindex, if_entry_t *entry)
+{
+    int rc = NETMON_ERROR;
+
+    if (entry == NULL) {
+        return NETMON_ERROR;
+    }
+    if_device_t *d = lock_device(slot, id, 0);
+    if (d == NULL) {
+        return NETMON_ERROR;
+    }
+    int i = find_row(d, ifindex);
+    if (i >= 0) {
+        entry->info = d->info[i];
+        entry->counters = d->counters[i];
+        rc = NETMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return rc;
+}
+
+int if_table_list(int slot, uint32_t id, if_entry_t *entries, int max_count)
+{
+    int n = 0;
+
+    if (entries == NULL) {
+        return 0;
+    }
+    if_device_t *d = lock_device(slot, id, 0);
+    if (d == NULL) {
+        return 0;
+    }
+    for (; n < d->count && n < max_count; n++) {
+        entries[n].info = d->info[n];
+        entries[n].counters = d->counters[n];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return n;
+}
+
+int if_table_read(int slot, uint32_t id, if_entry_t *entries, int max_count)
+{
+    int n;
+
+    if (id == 0 || (entries == NULL && max_count > 0)) {
+        return -1;
+    }
+    if_device_t *d = device_at(slot, 0);
+    if (d == NULL) {
+        return -1;
+    }
+
+    /* Registered before the array pointers are loaded; pairs with the writer's fence */
+    __atomic_add_fetch(&d->readers, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+        uint32_t s1 = __atomic_load_n(&d->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            sched_yield();
+            continue;
+        }
+        uint32_t who = __atomic_load_n(&d->id, RELAXED);
+        int count = __atomic_load_n(&d->count, RELAXED);
+        const if_info_t *info = __atomic_load_n(&d->info, RELAXED);
+        const if_counters_t *counters = __atomic_load_n(&d->counters, RELAXED);
+
+        /* Only dereference a consistent (count, arrays) triple */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&d->seq, RELAXED) != s1) {
+            continue;
+        }
+        if (who != id) {
+            n = -1;
+            break;
+        }
+        for (int i = 0; i < count && i < max_count; i++) {
+            entries[i].info = info[i];
+            load_counters(&entries[i].counters, &counters[i]);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&d->seq, RELAXED) == s1) {
+            n = count;
+            break;
+        }
+    }
+    __atomic_sub_fetch(&d->readers, 1, __ATOMIC_RELEASE);
+    return n;
+}
+
+int if_table_total(void)
+{
+    return __atomic_load_n(&total_rows, __ATOMIC_RELAXED);
+}
+
+void if_table_free(void)
+{
+    pthread_mutex_lock(&table_lock);
+    for (int s = 0; s < device_limit; s++) {
+        if_device_t *d = chunk_array_get(&devices, (uint32_t)s);
+        if (d != NULL && d->ready) {
+            free(d->info);
+            free(d->counters);
+            pthread_mutex_destroy(&d->lock);
+        }
+    }
+    chunk_array_free(&devices);
+    device_limit = 0;
+    __atomic_store_n(&total_rows, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&table_lock);
+}
@@ -0,0 +1,385 @@
+/*
+ * Host Inventory
+ * Growable record array indexed by address (host_index), persisted as
+ * a 32-byte header plus an array of inventory_record_t.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "inventory.h"
+#include "host_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define INVENTORY_MAGIC "NMINVDB"
+
+_Static_assert(sizeof(inventory_record_t) == 48, "inventory record layout changed");
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    int64_t saved_at;
+} inventory_header_t;
+
+_Static_assert(sizeof(inventory_header_t) == 32, "inventory header layout changed");
+
+static pthread_mutex_t inv_lock = PTHREAD_MUTEX_INITIALIZER;
+static inventory_record_t *records = NULL;
+static int record_count = 0;
+static int record_cap = 0;
+static host_index_t host_idx;
+static host_index_t subnet_idx;
+static int inv_dirty = 0;
+
+static host_index_t *index_for(uint8_t kind)
+{
+    return kind == INVENTORY_SUBNET ? &subnet_idx : &host_idx;
+}
+
+/* Find or append the record for addr; caller holds inv_lock */
+static inventory_record_t *lookup_locked(uint8_t kind, uint32_t addr, int create)
+{
+    int32_t slot;
+
+    if (host_index_find(index_for(kind), addr, &slot)) {
+        return &records[slot];
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    if (record_count == record_cap) {
+        int cap = record_cap ? record_cap * 2 : 256;
+        inventory_record_t *grown = realloc(records, (size_t)cap * sizeof(*grown));
+        if (grown == NULL) {
+            return NULL;
+        }
+        records = grown;
+        record_cap = cap;
+    }
+    if (host_index_insert(index_for(kind), addr, record_count, NULL) < 0) {
+        return NULL;
+    }
+
+    inventory_record_t *r = &records[record_count++];
+    memset(r, 0, sizeof(*r));
+    r->addr = addr;
+    r->kind = kind;
+    return r;
+}
+
+/* Rebuild both indexes after records[] was replaced or compacted */
+static int reindex_locked(void)
+{
+    host_index_clear(&host_idx);
+    host_index_clear(&subnet_idx);
+    for (int i = 0; i < record_count; i++) {
+        if (host_index_insert(index_for(records[i].kind), records[i].addr, i, NULL) < 0) {
+            return NETMON_ERROR;
+        }
+    }
+    return NETMON_SUCCESS;
+}
+
+static void free_locked(void)
+{
+    free(records);
+    records = NULL;
+    record_count = 0;
+    record_cap = 0;
+    host_index_free(&host_idx);
+    host_index_free(&subnet_idx);
+    inv_dirty = 0;
+}
+
+int inventory_load(const char *path)
+{
+    struct stat st;
+    int loaded = 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(inventory_header_t)) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    const inventory_header_t *hdr = (const inventory_header_t *)map;
+    if (memcmp(hdr->magic, INVENTORY_MAGIC, sizeof(INVENTORY_MAGIC)) != 0 ||
+        hdr->version != INVENTORY_VERSION || hdr->record_size != sizeof(inventory_record_t) ||
+        hdr->count > (size - sizeof(*hdr)) / sizeof(inventory_record_t)) {
+        munmap((void *)map, size);
+        return 0;
+    }
+
+    pthread_mutex_lock(&inv_lock);
+    free_locked();
+    if (hdr->count > 0) {
+        records = malloc((size_t)hdr->count * sizeof(*records));
+        if (records == NULL) {
+            pthread_mutex_unlock(&inv_lock);
+            munmap((void *)map, size);
+            return NETMON_ERROR;
+        }
+        memcpy(records, map + sizeof(*hdr), (size_t)hdr->count * sizeof(*records));
+        record_count = record_cap = (int)hdr->count;
+    }
+    if (reindex_locked() != NETMON_SUCCESS) {
+        free_locked();
+        loaded = NETMON_ERROR;
+    } else {
+        loaded = record_count;
+    }
+    pthread_mutex_unlock(&inv_lock);
+
+    munmap((void *)map, size);
+    return loaded;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return NETMON_ERROR;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return NETMON_SUCCESS;
+}
+
+int inventory_save(const char *path)
+{
+    inventory_header_t hdr;
+    char tmp[512];
+    int rc = NETMON_SUCCESS;
+
+    pthread_mutex_lock(&inv_lock);
+    if (!inv_dirty) {
+        pthread_mutex_unlock(&inv_lock);
+        return NETMON_SUCCESS;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        pthread_mutex_unlock(&inv_lock);
+        return NETMON_ERROR;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, INVENTORY_MAGIC, sizeof(INVENTORY_MAGIC));
+    hdr.version = INVENTORY_VERSION;
+    hdr.record_size = sizeof(inventory_record_t);
+    hdr.count = (uint64_t)record_count;
+    hdr.saved_at = (int64_t)time(NULL);
+
+    if (write_all(fd, &hdr, sizeof(hdr)) != NETMON_SUCCESS ||
+        write_all(fd, records, (size_t)record_count * sizeof(*records)) != NETMON_SUCCESS ||
+        fsync(fd) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (close(fd) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (rc == NETMON_SUCCESS && rename(tmp, path) != 0) {
+        rc = NETMON_ERROR;
+    }
+    if (rc != NETMON_SUCCESS) {
+        unlink(tmp);
+    } else {
+        inv_dirty = 0;
+    }
+
+    pthread_mutex_unlock(&inv_lock);
+    return rc;
+}
+
+void inventory_free(void)
+{
+    pthread_mutex_lock(&inv_lock);
+    free_locked();
+    pthread_mutex_unlock(&inv_lock);
+}
+
+int inventory_touch_host(uint32_t addr, int rtt_ms, uint16_t flags, time_t now)
+{
+    int rc = NETMON_ERROR;
+
+    pthread_mutex_lock(&inv_lock);
+    inventory_record_t *r = lookup_locked(INVENTORY_HOST, addr, 1);
+    if (r != NULL) {
+        if (r->first_seen == 0) {
+            r->first_seen = (int64_t)now;
+        }
+        if ((int64_t)now > r->last_seen) {
+            r->last_seen = (int64_t)now;
+        }
+        if (rtt_ms > 0) {
+            r->response_time_ms = rtt_ms;
+        }
+        r->flags |= flags;
+        inv_dirty = 1;
+        rc = NETMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return rc;
+}
+
+int inventory_set_upstream(uint32_t addr, uint32_t router)
+{
+    int rc = NETMON_ERROR;
+
+    if (router == addr) {
+        return NETMON_ERROR;
+    }
+    pthread_mutex_lock(&inv_lock);
+    inventory_record_t *r = lookup_locked(INVENTORY_HOST, addr, 0);
+    if (r != NULL) {
+        if (r->upstream != router) {
+            r->upstream = router;
+            inv_dirty = 1;
+        }
+        rc = NETMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return rc;
+}
+
+uint32_t inventory_upstream(uint32_t addr)
+{
+    uint32_t router = 0;
+
+    pthread_mutex_lock(&inv_lock);
+    const inventory_record_t *r = lookup_locked(INVENTORY_HOST, addr, 0);
+    if (r != NULL) {
+        router = r->upstream;
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return router;
+}
+
+int inventory_list_hosts(time_t since, uint16_t flags, uint32_t *addrs, int max_count)
+{
+    int n = 0;
+
+    pthread_mutex_lock(&inv_lock);
+    for (int i = 0; i < record_count && n < max_count; i++) {
+        const inventory_record_t *r = &records[i];
+        if (r->kind == INVENTORY_HOST && r->last_seen >= (int64_t)since &&
+            (r->flags & flags) == flags) {
+            addrs[n++] = r->addr;
+        }
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return n;
+}
+
+int inventory_list_subnet_hosts(uint32_t network, int prefix_len, time_t since,
+                                uint32_t *addrs, int max_count)
+{
+    uint32_t mask = prefix_len <= 0 ? 0 : 0xffffffffu << (32 - prefix_len);
+    int n = 0;
+
+    pthread_mutex_lock(&inv_lock);
+    for (int i = 0; i < record_count && n < max_count; i++) {
+        const inventory_record_t *r = &records[i];
+        if (r->kind == INVENTORY_HOST && r->last_seen >= (int64_t)since &&
+            (r->addr & mask) == (network & mask)) {
+            addrs[n++] = r->addr;
+        }
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return n;
+}
+
+int inventory_get_subnet(uint32_t network, int prefix_len, uint64_t *digest, time_t *swept_at)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&inv_lock);
+    const inventory_record_t *r = lookup_locked(INVENTORY_SUBNET, network, 0);
+    if (r != NULL && r->prefix_len == prefix_len) {
+        *digest = r->digest;
+        *swept_at = (time_t)r->swept_at;
+        found = 1;
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return found;
+}
+
+int inventory_set_subnet(uint32_t network, int prefix_len, uint64_t digest, time_t swept_at)
+{
+    int rc = NETMON_ERROR;
+
+    pthread_mutex_lock(&inv_lock);
+    inventory_record_t *r = lookup_locked(INVENTORY_SUBNET, network, 1);
+    if (r != NULL) {
+        r->prefix_len = (uint8_t)prefix_len;
+        r->digest = digest;
+        r->swept_at = (int64_t)swept_at;
+        if (r->first_seen == 0) {
+            r->first_seen = (int64_t)swept_at;
+        }
+        r->last_seen = (int64_t)swept_at;
+        inv_dirty = 1;
+        rc = NETMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return rc;
+}
+
+int inventory_age_out(time_t cutoff)
+{
+    int kept = 0;
+
+    pthread_mutex_lock(&inv_lock);
+    for (int i = 0; i < record_count; i++) {
+        if (records[i].last_seen >= (int64_t)cutoff) {
+            records[kept++] = records[i];
+        }
+    }
+    int removed = record_count - kept;
+    if (removed > 0) {
+        record_count = kept;
+        reindex_locked();
+        inv_dirty = 1;
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return removed;
+}
+
+int inventory_host_count(void)
+{
+    int n = 0;
+
+    pthread_mutex_lock(&inv_lock);
+    for (int i = 0; i < record_count; i++) {
+        n += records[i].kind == INVENTORY_HOST;
+    }
+    pthread_mutex_unlock(&inv_lock);
+    return n;
+}
@@ -0,0 +1,300 @@
+/*
+ * Hot Metrics Store
+ * One chunked column per metric, grown a chunk at a time as slots are
+ * claimed. Writers serialize per slot through an odd/even sequence
+ * counter and store every field with relaxed atomics; seqlock readers
+ * retry until they see a stable count. The aggregate pass reads the
+ * columns directly, a chunk at a time, one relaxed load each.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "metrics_store.h"
+#include "arena.h"
+#include <string.h>
+#include <sched.h>
+
+#define RELAXED __ATOMIC_RELAXED
+
+/* Element slot of column col, whose chunk is reserved */
+#define CELL(col, type, slot) ((type *)chunk_array_at(&(col), (uint32_t)(slot)))
+
+static chunk_array_t seq_col = CHUNK_ARRAY_INIT(uint32_t);       /* Odd while a writer is inside */
+static chunk_array_t owner_col = CHUNK_ARRAY_INIT(uint32_t);     /* Device id, 0 = free */
+static chunk_array_t live_col = CHUNK_ARRAY_INIT(uint8_t);       /* 1 when owned; branch-free mask */
+
+static chunk_array_t status_col = CHUNK_ARRAY_INIT(int32_t);
+static chunk_array_t response_time_col = CHUNK_ARRAY_INIT(int32_t);
+static chunk_array_t last_seen_col = CHUNK_ARRAY_INIT(int64_t);
+static chunk_array_t bytes_in_col = CHUNK_ARRAY_INIT(uint64_t);
+static chunk_array_t bytes_out_col = CHUNK_ARRAY_INIT(uint64_t);
+static chunk_array_t in_bps_col = CHUNK_ARRAY_INIT(uint64_t);
+static chunk_array_t out_bps_col = CHUNK_ARRAY_INIT(uint64_t);
+static chunk_array_t base_in_col = CHUNK_ARRAY_INIT(uint64_t);
+static chunk_array_t base_out_col = CHUNK_ARRAY_INIT(uint64_t);
+static chunk_array_t errors_in_col = CHUNK_ARRAY_INIT(uint32_t);
+static chunk_array_t errors_out_col = CHUNK_ARRAY_INIT(uint32_t);
+static chunk_array_t cpu_col = CHUNK_ARRAY_INIT(float);
+static chunk_array_t memory_col = CHUNK_ARRAY_INIT(float);
+
+static chunk_array_t *const columns[] = {
+    &seq_col, &owner_col, &live_col, &status_col, &response_time_col, &last_seen_col,
+    &bytes_in_col, &bytes_out_col, &in_bps_col, &out_bps_col, &base_in_col, &base_out_col,
+    &errors_in_col, &errors_out_col, &cpu_col, &memory_col
+};
+#define COLUMN_COUNT ((int)(sizeof(columns) / sizeof(columns[0])))
+
+/* Slots below this have every column chunk reserved; release-stored after the chunks */
+static int slot_limit = 0;
+
+static uint32_t write_begin(int slot)
+{
+    uint32_t *seq = CELL(seq_col, uint32_t, slot);
+
+    for (;;) {
+        uint32_t s = __atomic_load_n(seq, RELAXED);
+        if (!(s & 1) && __atomic_compare_exchange_n(seq, &s, s + 1, 1,
+                                                    __ATOMIC_ACQUIRE, RELAXED)) {
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            return s;
+        }
+        sched_yield();
+    }
+}
+
+static void write_end(int slot, uint32_t s)
+{
+    __atomic_store_n(CELL(seq_col, uint32_t, slot), s + 2, __ATOMIC_RELEASE);
+}
+
+static void store_fields(int slot, const device_metrics_t *m)
+{
+    __atomic_store_n(CELL(status_col, int32_t, slot), (int32_t)m->status, RELAXED);
+    __atomic_store_n(CELL(last_seen_col, int64_t, slot), (int64_t)m->last_seen, RELAXED);
+    __atomic_store_n(CELL(bytes_in_col, uint64_t, slot), m->bytes_in, RELAXED);
+    __atomic_store_n(CELL(bytes_out_col, uint64_t, slot), m->bytes_out, RELAXED);
+    __atomic_store_n(CELL(in_bps_col, uint64_t, slot), m->in_bps, RELAXED);
+    __atomic_store_n(CELL(out_bps_col, uint64_t, slot), m->out_bps, RELAXED);
+    __atomic_store_n(CELL(errors_in_col, uint32_t, slot), m->errors_in, RELAXED);
+    __atomic_store_n(CELL(errors_out_col, uint32_t, slot), m->errors_out, RELAXED);
+    __atomic_store(CELL(cpu_col, float, slot), &m->cpu_usage, RELAXED);
+    __atomic_store(CELL(memory_col, float, slot), &m->memory_usage, RELAXED);
+    __atomic_store_n(CELL(response_time_col, int32_t, slot), (int32_t)m->response_time_ms, RELAXED);
+}
+
+static int valid_slot(int slot)
+{
+    return slot >= 0 && slot < __atomic_load_n(&slot_limit, __ATOMIC_ACQUIRE);
+}
+
+int metrics_store_claim(int slot, uint32_t id, const device_metrics_t *initial)
+{
+    device_metrics_t zero;
+
+    if (slot < 0) return NETMON_ERROR;
+    if (slot >= __atomic_load_n(&slot_limit, RELAXED)) {
+        for (int c = 0; c < COLUMN_COUNT; c++) {
+            if (chunk_array_reserve(columns[c], (uint32_t)slot) == NULL) {
+                return NETMON_ERROR;
+            }
+        }
+        __atomic_store_n(&slot_limit, slot + 1, __ATOMIC_RELEASE);
+    }
+    if (initial == NULL) {
+        memset(&zero, 0, sizeof(zero));
+        initial = &zero;
+    }
+
+    uint32_t s = write_begin(slot);
+    __atomic_store_n(CELL(owner_col, uint32_t, slot), id, RELAXED);
+    store_fields(slot, initial);
+    __atomic_store_n(CELL(base_in_col, uint64_t, slot), 0, RELAXED);
+    __atomic_store_n(CELL(base_out_col, uint64_t, slot), 0, RELAXED);
+    __atomic_store_n(CELL(live_col, uint8_t, slot), 1, RELAXED);
+    write_end(slot, s);
+    return NETMON_SUCCESS;
+}
+
+void metrics_store_release(int slot)
+{
+    if (!valid_slot(slot)) return;
+
+    uint32_t s = write_begin(slot);
+    __atomic_store_n(CELL(owner_col, uint32_t, slot), 0, RELAXED);
+    __atomic_store_n(CELL(live_col, uint8_t, slot), 0, RELAXED);
+    write_end(slot, s);
+}
+
+void metrics_store_free(void)
+{
+    __atomic_store_n(&slot_limit, 0, __ATOMIC_RELEASE);
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        chunk_array_free(columns[c]);
+    }
+}
+
+int metrics_store_write(int slot, uint32_t id, const device_metrics_t *metrics)
+{
+    int rc = NETMON_ERROR;
+
+    if (!valid_slot(slot) || metrics == NULL) return NETMON_ERROR;
+
+    uint32_t s = write_begin(slot);
+    if (__atomic_load_n(CELL(owner_col, uint32_t, slot), RELAXED) == id) {
+        store_fields(slot, metrics);
+        rc = NETMON_SUCCESS;
+    }
+    write_end(slot, s);
+    return rc;
+}
+
+int metrics_store_set_status(int slot, uint32_t id, device_status_t status)
+{
+    int rc = NETMON_ERROR;
+
+    if (!valid_slot(slot)) return NETMON_ERROR;
+
+    uint32_t s = write_begin(slot);
+    if (__atomic_load_n(CELL(owner_col, uint32_t, slot), RELAXED) == id) {
+        __atomic_store_n(CELL(status_col, int32_t, slot), (int32_t)status, RELAXED);
+        rc = NETMON_SUCCESS;
+    }
+    write_end(slot, s);
+    return rc;
+}
+
+uint32_t metrics_store_version(int slot)
+{
+    if (!valid_slot(slot)) return 0;
+    /* A write in progress counts as done: readers wait for it anyway */
+    return (__atomic_load_n(CELL(seq_col, uint32_t, slot), __ATOMIC_ACQUIRE) + 1) & ~1U;
+}
+
+int metrics_store_read(int slot, uint32_t id, device_metrics_t *m)
+{
+    if (!valid_slot(slot) || m == NULL) return NETMON_ERROR;
+
+    const uint32_t *seq = CELL(seq_col, uint32_t, slot);
+    for (;;) {
+        uint32_t s1 = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            sched_yield();
+            continue;
+        }
+
+        uint32_t who = __atomic_load_n(CELL(owner_col, uint32_t, slot), RELAXED);
+        m->status = (device_status_t)__atomic_load_n(CELL(status_col, int32_t, slot), RELAXED);
+        m->last_seen = (time_t)__atomic_load_n(CELL(last_seen_col, int64_t, slot), RELAXED);
+        m->bytes_in = __atomic_load_n(CELL(bytes_in_col, uint64_t, slot), RELAXED);
+        m->bytes_out = __atomic_load_n(CELL(bytes_out_col, uint64_t, slot), RELAXED);
+        m->in_bps = __atomic_load_n(CELL(in_bps_col, uint64_t, slot), RELAXED);
+        m->out_bps = __atomic_load_n(CELL(out_bps_col, uint64_t, slot), RELAXED);
+        m->errors_in = __atomic_load_n(CELL(errors_in_col, uint32_t, slot), RELAXED);
+        m->errors_out = __atomic_load_n(CELL(errors_out_col, uint32_t, slot), RELAXED);
+        __atomic_load(CELL(cpu_col, float, slot), &m->cpu_usage, RELAXED);
+        __atomic_load(CELL(memory_col, float, slot), &m->memory_usage, RELAXED);
+        m->response_time_ms = __atomic_load_n(CELL(response_time_col, int32_t, slot), RELAXED);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(seq, RELAXED) == s1) {
+            return who == id ? NETMON_SUCCESS : NETMON_ERROR;
+        }
+    }
+}
+
+/*
+ * Branch-free column sums, a chunk of slots at a time: free slots are
+ * masked out by the live column rather than skipped. Each column is
+ * read once per slot, with a relaxed atomic load to match the writers,
+ * so a poll landing mid-pass cannot change a value between its reset
+ * check and its use.
+ */
+void metrics_store_aggregate(metrics_totals_t *t)
+{
+    uint32_t devices = 0, up = 0, down = 0, warning = 0, rt_count = 0;
+    uint64_t in = 0, out = 0, in_bps = 0, out_bps = 0, err_in = 0, err_out = 0, rt_sum = 0;
+    double cpu = 0.0, mem = 0.0;
+    int limit = __atomic_load_n(&slot_limit, __ATOMIC_ACQUIRE);
+
+    for (int base = 0; base < limit; base += (int)CHUNK_ARRAY_CHUNK_LEN) {
+        int len = limit - base < (int)CHUNK_ARRAY_CHUNK_LEN ? limit - base : (int)CHUNK_ARRAY_CHUNK_LEN;
+        const uint8_t *live = CELL(live_col, uint8_t, base);
+        const int32_t *status_v = CELL(status_col, int32_t, base);
+        const uint64_t *bytes_in_v = CELL(bytes_in_col, uint64_t, base);
+        const uint64_t *bytes_out_v = CELL(bytes_out_col, uint64_t, base);
+        const uint64_t *base_in_v = CELL(base_in_col, uint64_t, base);
+        const uint64_t *base_out_v = CELL(base_out_col, uint64_t, base);
+        const uint64_t *in_bps_v = CELL(in_bps_col, uint64_t, base);
+        const uint64_t *out_bps_v = CELL(out_bps_col, uint64_t, base);
+        const uint32_t *errors_in_v = CELL(errors_in_col, uint32_t, base);
+        const uint32_t *errors_out_v = CELL(errors_out_col, uint32_t, base);
+        const int32_t *response_time_v = CELL(response_time_col, int32_t, base);
+        const float *cpu_v = CELL(cpu_col, float, base);
+        const float *memory_v = CELL(memory_col, float, base);
+
+        for (int i = 0; i < len; i++) {
+            uint32_t m = __atomic_load_n(&live[i], RELAXED);
+            int32_t status = __atomic_load_n(&status_v[i], RELAXED);
+            devices += m;
+            up += m & (uint32_t)(status == DEVICE_STATUS_UP);
+            down += m & (uint32_t)(status == DEVICE_STATUS_DOWN);
+            warning += m & (uint32_t)(status == DEVICE_STATUS_WARNING);
+
+            uint64_t mask = (uint64_t)0 - m;
+            uint64_t bytes_in = __atomic_load_n(&bytes_in_v[i], RELAXED);
+            uint64_t bytes_out = __atomic_load_n(&bytes_out_v[i], RELAXED);
+            uint64_t base_in = __atomic_load_n(&base_in_v[i], RELAXED);
+            uint64_t base_out = __atomic_load_n(&base_out_v[i], RELAXED);
+            /* A counter below its base was reset by the device: count from zero */
+            uint64_t bin = base_in & ((uint64_t)0 - (bytes_in >= base_in));
+            uint64_t bout = base_out & ((uint64_t)0 - (bytes_out >= base_out));
+            in += (bytes_in - bin) & mask;
+            out += (bytes_out - bout) & mask;
+            in_bps += __atomic_load_n(&in_bps_v[i], RELAXED) & mask;
+            out_bps += __atomic_load_n(&out_bps_v[i], RELAXED) & mask;
+            err_in += __atomic_load_n(&errors_in_v[i], RELAXED) & mask;
+            err_out += __atomic_load_n(&errors_out_v[i], RELAXED) & mask;
+
+            int32_t rt = __atomic_load_n(&response_time_v[i], RELAXED);
+            uint32_t has = m & (uint32_t)(rt > 0);
+            rt_count += has;
+            rt_sum += (uint64_t)(uint32_t)rt * has;
+
+            float c, mm;
+            __atomic_load(&cpu_v[i], &c, RELAXED);
+            __atomic_load(&memory_v[i], &mm, RELAXED);
+            cpu += c * (float)m;
+            mem += mm * (float)m;
+        }
+    }
+
+    t->devices = devices;
+    t->up = up;
+    t->down = down;
+    t->warning = warning;
+    t->bytes_in = in;
+    t->bytes_out = out;
+    t->in_bps = in_bps;
+    t->out_bps = out_bps;
+    t->errors_in = err_in;
+    t->errors_out = err_out;
+    t->response_time_sum = rt_sum;
+    t->response_time_count = rt_count;
+    t->cpu_sum = cpu;
+    t->memory_sum = mem;
+}
+
+void metrics_store_rebase(void)
+{
+    int limit = __atomic_load_n(&slot_limit, __ATOMIC_ACQUIRE);
+
+    for (int i = 0; i < limit; i++) {
+        uint32_t s = write_begin(i);
+        __atomic_store_n(CELL(base_in_col, uint64_t, i),
+                         __atomic_load_n(CELL(bytes_in_col, uint64_t, i), RELAXED), RELAXED);
+        __atomic_store_n(CELL(base_out_col, uint64_t, i),
+                         __atomic_load_n(CELL(bytes_out_col, uint64_t, i), RELAXED), RELAXED);
+        write_end(i, s);
+    }
+}
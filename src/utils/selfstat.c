@@ -0,0 +1,230 @@
+/*
+ * Self Instrumentation
+ * Shards are handed out round-robin on a thread's first record and
+ * kept in a thread-local pointer. A shard is usually written by one
+ * thread only, so its relaxed atomic adds never contend; they stay
+ * atomic so threads sharing a shard (more than SELFSTAT_SHARDS alive)
+ * do not lose increments.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "selfstat.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    uint64_t sum_us[SELFSTAT_HIST_COUNT];
+    uint64_t counters[SELFSTAT_COUNTER_COUNT];
+    uint64_t buckets[SELFSTAT_HIST_COUNT][SELFSTAT_BUCKETS];
+} __attribute__((aligned(64))) selfstat_shard_t;
+
+static selfstat_shard_t shards[SELFSTAT_SHARDS];
+static unsigned next_shard = 0;
+static _Thread_local selfstat_shard_t *my_shard = NULL;
+
+static const selfstat_desc_t hist_descs[SELFSTAT_HIST_COUNT] = {
+    { "netmon_probe_rtt_seconds", NULL, "Liveness probe round-trip time" },
+    { "netmon_snmp_request_seconds", NULL, "SNMP request latency, retries included" },
+    { "netmon_snmp_community_probe_seconds", NULL,
+      "Time for an agent to answer one of the guessed communities" },
+    { "netmon_poll_lag_seconds", NULL, "Delay from a poll's deadline to a worker starting it" },
+    { "netmon_poll_duration_seconds", NULL, "Time to poll one device" },
+    { "netmon_discovery_stage_seconds", "snmp", "Run time of each discovery stage" },
+    { "netmon_discovery_stage_seconds", "ping", "Run time of each discovery stage" },
+    { "netmon_discovery_stage_seconds", "arp", "Run time of each discovery stage" },
+    { "netmon_discovery_stage_seconds", "conn", "Run time of each discovery stage" },
+    { "netmon_discovery_stage_seconds", "gateway", "Run time of each discovery stage" },
+    { "netmon_discovery_stage_seconds", "sweep", "Run time of each discovery stage" },
+};
+
+static const selfstat_desc_t counter_descs[SELFSTAT_COUNTER_COUNT] = {
+    { "netmon_probes_sent_total", NULL, "Liveness probes sent, retries included" },
+    { "netmon_probe_retries_total", NULL, "Liveness probes resent after a timeout" },
+    { "netmon_probe_timeouts_total", NULL, "Probe targets that never answered" },
+    { "netmon_probe_drops_total", NULL, "Probes the transport could not send" },
+    { "netmon_snmp_requests_total", NULL, "SNMP requests issued" },
+    { "netmon_snmp_retries_total", NULL, "SNMP requests resent after a timeout" },
+    { "netmon_snmp_timeouts_total", NULL, "SNMP requests that ran out of retries" },
+    { "netmon_snmp_errors_total", NULL, "SNMP requests that failed other than by timeout" },
+    { "netmon_snmp_community_guesses_total", NULL, "Community strings sent while guessing" },
+    { "netmon_snmp_community_failures_total", NULL, "Agents that accepted no guessed community" },
+    { "netmon_discovery_hosts_added_total", NULL, "Hosts added to the discovery table" },
+    { "netmon_discovery_hosts_duplicate_total", NULL, "Reports of an already known host" },
+    { "netmon_discovery_hosts_dropped_total", NULL, "New hosts the discovery table had no room for" },
+    { "netmon_discovery_sweep_fallbacks_total", NULL, "Sweeps that fell back to port probes" },
+    { "netmon_subprocesses_total", NULL, "Child processes spawned" },
+    { "netmon_polls_total", NULL, "Device polls run" },
+    { "netmon_poll_failures_total", NULL, "Device polls that did not succeed" },
+    { "netmon_poll_skipped_total", NULL, "Poll rounds skipped by devices that fell behind" },
+    { "netmon_devices_refused_total", NULL, "Devices not monitored because the device table was full" },
+};
+
+static selfstat_shard_t *shard(void)
+{
+    selfstat_shard_t *s = my_shard;
+
+    if (s == NULL) {
+        unsigned n = __atomic_fetch_add(&next_shard, 1, __ATOMIC_RELAXED);
+        s = my_shard = &shards[n % SELFSTAT_SHARDS];
+    }
+    return s;
+}
+
+/* Shards handed out so far; the rest are all zero and not worth reading */
+static int shards_used(void)
+{
+    unsigned n = __atomic_load_n(&next_shard, __ATOMIC_RELAXED);
+    return n < SELFSTAT_SHARDS ? (int)n : SELFSTAT_SHARDS;
+}
+
+static int bucket_of(uint64_t us)
+{
+    if (us >= (1ULL << SELFSTAT_MAX_BITS)) {
+        us = (1ULL << SELFSTAT_MAX_BITS) - 1;
+    }
+    if (us < (2U << SELFSTAT_SUB_BITS)) {
+        return (int)us;
+    }
+    int shift = 63 - __builtin_clzll(us) - SELFSTAT_SUB_BITS;
+    return (shift << SELFSTAT_SUB_BITS) + (int)(us >> shift);
+}
+
+/* Largest value that lands in bucket b */
+static uint64_t bucket_upper(int b)
+{
+    if (b < (2 << SELFSTAT_SUB_BITS)) {
+        return (uint64_t)b;
+    }
+    int shift = (b >> SELFSTAT_SUB_BITS) - 1;
+    uint64_t mantissa = (uint64_t)(b - (shift << SELFSTAT_SUB_BITS));
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void selfstat_record(selfstat_hist_t hist, uint64_t us)
+{
+    selfstat_shard_t *s = shard();
+
+    __atomic_fetch_add(&s->buckets[hist][bucket_of(us)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->sum_us[hist], us, __ATOMIC_RELAXED);
+}
+
+void selfstat_add(selfstat_counter_t counter, uint64_t n)
+{
+    __atomic_fetch_add(&shard()->counters[counter], n, __ATOMIC_RELAXED);
+}
+
+uint64_t selfstat_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+void selfstat_read(selfstat_hist_t hist, selfstat_snapshot_t *snap)
+{
+    int used = shards_used();
+
+    memset(snap, 0, sizeof(*snap));
+    for (int i = 0; i < used; i++) {
+        const selfstat_shard_t *s = &shards[i];
+        for (int b = 0; b < SELFSTAT_BUCKETS; b++) {
+            snap->buckets[b] += __atomic_load_n(&s->buckets[hist][b], __ATOMIC_RELAXED);
+        }
+        snap->sum_us += __atomic_load_n(&s->sum_us[hist], __ATOMIC_RELAXED);
+    }
+    for (int b = 0; b < SELFSTAT_BUCKETS; b++) {
+        snap->count += snap->buckets[b];
+    }
+}
+
+uint64_t selfstat_counter(selfstat_counter_t counter)
+{
+    uint64_t total = 0;
+    int used = shards_used();
+
+    for (int i = 0; i < used; i++) {
+        total += __atomic_load_n(&shards[i].counters[counter], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+uint64_t selfstat_percentile(const selfstat_snapshot_t *snap, double q)
+{
+    if (snap->count == 0) {
+        return 0;
+    }
+    if (q < 0.0) q = 0.0;
+    if (q > 1.0) q = 1.0;
+
+    /* Rank of the sample, 1-based, rounded up */
+    uint64_t rank = (uint64_t)(q * (double)snap->count);
+    if ((double)rank < q * (double)snap->count) rank++;
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < SELFSTAT_BUCKETS; b++) {
+        seen += snap->buckets[b];
+        if (seen >= rank) {
+            return bucket_upper(b);
+        }
+    }
+    return bucket_upper(SELFSTAT_BUCKETS - 1);
+}
+
+const selfstat_desc_t *selfstat_hist_desc(selfstat_hist_t hist)
+{
+    return &hist_descs[hist];
+}
+
+const selfstat_desc_t *selfstat_counter_desc(selfstat_counter_t counter)
+{
+    return &counter_descs[counter];
+}
+
+/* Microseconds below 1 ms, then milliseconds, then seconds */
+static const char *format_us(uint64_t us, char *buf, size_t size)
+{
+    if (us < 1000) {
+        snprintf(buf, size, "%llu us", (unsigned long long)us);
+    } else if (us < 1000000) {
+        snprintf(buf, size, "%.1f ms", (double)us / 1e3);
+    } else {
+        snprintf(buf, size, "%.2f s", (double)us / 1e6);
+    }
+    return buf;
+}
+
+void selfstat_dump(FILE *out)
+{
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 1.0 };
+    selfstat_snapshot_t snap;
+    char name[96];
+    char val[4][24];
+
+    fprintf(out, "%-46s %10s %10s %10s %10s %10s\n", "Histogram", "Count", "p50", "p90", "p99", "max");
+    for (int h = 0; h < SELFSTAT_HIST_COUNT; h++) {
+        const selfstat_desc_t *d = &hist_descs[h];
+        selfstat_read((selfstat_hist_t)h, &snap);
+        if (d->label != NULL) {
+            snprintf(name, sizeof(name), "%s{stage=%s}", d->name, d->label);
+        } else {
+            snprintf(name, sizeof(name), "%s", d->name);
+        }
+        for (int i = 0; i < 4; i++) {
+            format_us(selfstat_percentile(&snap, quantiles[i]), val[i], sizeof(val[i]));
+        }
+        fprintf(out, "%-46s %10llu %10s %10s %10s %10s\n", name, (unsigned long long)snap.count,
+                snap.count ? val[0] : "-", snap.count ? val[1] : "-",
+                snap.count ? val[2] : "-", snap.count ? val[3] : "-");
+    }
+
+    fprintf(out, "\n%-46s %10s\n", "Counter", "Value");
+    for (int c = 0; c < SELFSTAT_COUNTER_COUNT; c++) {
+        fprintf(out, "%-46s %10llu\n", counter_descs[c].name,
+                (unsigned long long)selfstat_counter((selfstat_counter_t)c));
+    }
+}
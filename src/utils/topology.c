@@ -0,0 +1,687 @@
+/*
+ * Layer-3 Topology Graph
+ * Nodes in one flat array, adjacency as CSR rows plus per-node chains of
+ * edges added since the last compaction, interface aliases merged with
+ * union-find, and a breadth-first layout tree kept up to date by
+ * relaxing depths from the nodes each change touches.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "topology.h"
+#include "host_index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define ROOT 0                    /* Virtual parent of the top-level nodes */
+#define NONE (-1)
+#define DEPTH_NONE UINT16_MAX     /* Not connected to a seed */
+
+/* Edge kinds, or-ed together when a pair is learned more than once */
+#define EDGE_NEXTHOP 0x01         /* Target is in the source's next-hop table */
+#define EDGE_NEXTHOP_IN 0x02      /* Source is in the target's next-hop table */
+#define EDGE_ATTACH 0x04          /* Router-subnet */
+
+/* Pending edges tolerated before compaction, at least, or a quarter of the rows */
+#define MIN_PENDING 64
+
+typedef struct {
+    uint32_t addr;
+    uint8_t kind;
+    uint8_t prefix_len;
+    uint8_t seed;
+    uint8_t queued;
+    int32_t alias;                /* Union-find parent; itself while canonical */
+    uint16_t depth;               /* Hops from the nearest seed */
+    int32_t parent;               /* Layout tree; NONE while merged away */
+    int32_t first_child;
+    int32_t last_child;
+    int32_t prev_sibling;
+    int32_t next_sibling;
+    int32_t rows;                 /* Lines in this subtree, itself included */
+    int32_t pending;              /* Oldest uncompacted edge from this node */
+    int32_t pending_last;
+} node_t;
+
+typedef struct {
+    int32_t target;
+    uint8_t kind;
+} edge_t;
+
+typedef struct {
+    int32_t target;
+    int32_t next;                 /* Next uncompacted edge of the same source */
+    uint8_t kind;
+} pending_edge_t;
+
+typedef struct {
+    node_t *nodes;
+    int node_count;
+    int node_cap;
+    int32_t *row_start;           /* CSR: edges of node u are row_start[u] .. row_start[u + 1] */
+    edge_t *edges;
+    int csr_nodes;                /* Nodes covered by row_start */
+    int edge_count;
+    pending_edge_t *pending;
+    int pending_count;
+    int pending_cap;
+    host_index_t router_index;    /* Any router address -> node (resolve with find) */
+    host_index_t subnet_index;    /* Network -> first subnet node with it */
+    int32_t *queue;               /* Relaxation FIFO, node_cap entries */
+    uint32_t generation;
+    int aliases;
+    int compactions;
+    int relaxed;
+} graph_t;
+
+static pthread_mutex_t graph_lock = PTHREAD_MUTEX_INITIALIZER;
+static graph_t graph;
+
+/* ------------------------------------------------------------------ */
+/* Nodes and edges (caller holds graph_lock)                          */
+/* ------------------------------------------------------------------ */
+
+static int32_t find(int32_t x)
+{
+    node_t *n = graph.nodes;
+
+    while (n[x].alias != x) {
+        n[x].alias = n[n[x].alias].alias;     /* Path halving */
+        x = n[x].alias;
+    }
+    return x;
+}
+
+static void adjust_rows(int32_t from, int32_t delta)
+{
+    for (int32_t a = from; a != NONE; a = graph.nodes[a].parent) {
+        graph.nodes[a].rows += delta;
+    }
+}
+
+static void detach(int32_t c)
+{
+    node_t *n = &graph.nodes[c];
+    int32_t p = n->parent;
+
+    if (p == NONE) {
+        return;
+    }
+    if (n->prev_sibling != NONE) {
+        graph.nodes[n->prev_sibling].next_sibling = n->next_sibling;
+    } else {
+        graph.nodes[p].first_child = n->next_sibling;
+    }
+    if (n->next_sibling != NONE) {
+        graph.nodes[n->next_sibling].prev_sibling = n->prev_sibling;
+    } else {
+        graph.nodes[p].last_child = n->prev_sibling;
+    }
+    adjust_rows(p, -n->rows);
+    n->parent = n->prev_sibling = n->next_sibling = NONE;
+}
+
+static void attach(int32_t c, int32_t p)
+{
+    node_t *n = &graph.nodes[c];
+    int32_t last = graph.nodes[p].last_child;
+
+    n->parent = p;
+    n->prev_sibling = last;
+    n->next_sibling = NONE;
+    if (last != NONE) {
+        graph.nodes[last].next_sibling = c;
+    } else {
+        graph.nodes[p].first_child = c;
+    }
+    graph.nodes[p].last_child = c;
+    adjust_rows(p, n->rows);
+}
+
+static void set_parent(int32_t c, int32_t p)
+{
+    if (graph.nodes[c].parent != p) {
+        detach(c);
+        attach(c, p);
+    }
+}
+
+static int32_t new_node(uint32_t addr, topo_node_kind_t kind, uint8_t prefix_len)
+{
+    if (graph.node_count == graph.node_cap) {
+        int cap = graph.node_cap ? graph.node_cap * 2 : 64;
+        node_t *nodes = realloc(graph.nodes, (size_t)cap * sizeof(*nodes));
+        if (nodes == NULL) return NONE;
+        graph.nodes = nodes;
+        int32_t *queue = realloc(graph.queue, (size_t)cap * sizeof(*queue));
+        if (queue == NULL) return NONE;
+        graph.queue = queue;
+        graph.node_cap = cap;
+    }
+
+    int32_t id = graph.node_count++;
+    node_t *n = &graph.nodes[id];
+    memset(n, 0, sizeof(*n));
+    n->addr = addr;
+    n->kind = (uint8_t)kind;
+    n->prefix_len = prefix_len;
+    n->alias = id;
+    n->depth = DEPTH_NONE;
+    n->parent = n->first_child = n->last_child = NONE;
+    n->prev_sibling = n->next_sibling = NONE;
+    n->rows = 1;
+    n->pending = n->pending_last = NONE;
+    if (id != ROOT) {
+        attach(id, ROOT);
+    }
+    return id;
+}
+
+static int ensure_root(void)
+{
+    if (graph.node_count == 0 && new_node(0, TOPO_NODE_ROUTER, 0) != ROOT) {
+        return NETMON_ERROR;
+    }
+    return NETMON_SUCCESS;
+}
+
+/* Edge cursor over the CSR row and the pending chain of one node */
+typedef struct {
+    int32_t i;
+    int32_t end;
+    int32_t chain;
+} edge_iter_t;
+
+static void edges_begin(int32_t u, edge_iter_t *it)
+{
+    it->i = u < graph.csr_nodes ? graph.row_start[u] : 0;
+    it->end = u < graph.csr_nodes ? graph.row_start[u + 1] : 0;
+    it->chain = graph.nodes[u].pending;
+}
+
+/* Next edge as a pointer to its kind byte, target resolved to its canonical node */
+static uint8_t *edges_next(edge_iter_t *it, int32_t *target)
+{
+    if (it->i < it->end) {
+        edge_t *e = &graph.edges[it->i++];
+        *target = find(e->target);
+        return &e->kind;
+    }
+    if (it->chain != NONE) {
+        pending_edge_t *p = &graph.pending[it->chain];
+        it->chain = p->next;
+        *target = find(p->target);
+        return &p->kind;
+    }
+    return NULL;
+}
+
+/* Record u -> v with kind; returns 1 if the pair is new */
+static int add_half(int32_t u, int32_t v, uint8_t kind)
+{
+    edge_iter_t it;
+    int32_t t;
+    uint8_t *k;
+
+    edges_begin(u, &it);
+    while ((k = edges_next(&it, &t)) != NULL) {
+        if (t == v) {
+            *k |= kind;
+            return 0;
+        }
+    }
+
+    if (graph.pending_count == graph.pending_cap) {
+        int cap = graph.pending_cap ? graph.pending_cap * 2 : 256;
+        pending_edge_t *p = realloc(graph.pending, (size_t)cap * sizeof(*p));
+        if (p == NULL) return -1;
+        graph.pending = p;
+        graph.pending_cap = cap;
+    }
+    pending_edge_t *p = &graph.pending[graph.pending_count];
+    p->target = v;
+    p->kind = kind;
+    p->next = NONE;
+    node_t *n = &graph.nodes[u];
+    if (n->pending == NONE) {
+        n->pending = graph.pending_count;
+    } else {
+        graph.pending[n->pending_last].next = graph.pending_count;
+    }
+    n->pending_last = graph.pending_count++;
+    return 1;
+}
+
+/* Rebuild the CSR rows from rows, chains and merges in one pass */
+static void compact(void)
+{
+    int n = graph.node_count;
+    size_t upper = (size_t)graph.edge_count + (size_t)graph.pending_count;
+    int32_t *start = malloc((size_t)(n + 1) * sizeof(*start));
+    edge_t *edges = malloc((upper ? upper : 1) * sizeof(*edges));
+    int32_t *seen = malloc((size_t)n * sizeof(*seen));
+
+    if (start == NULL || edges == NULL || seen == NULL) {
+        free(start);
+        free(edges);
+        free(seen);
+        return;     /* Stay on the chains; retried on the next change */
+    }
+    for (int i = 0; i < n; i++) {
+        seen[i] = NONE;
+    }
+
+    int32_t pos = 0;
+    for (int32_t u = 0; u < n; u++) {
+        start[u] = pos;
+        if (find(u) != u) {
+            continue;   /* Merged: its edges were moved to the alias */
+        }
+        edge_iter_t it;
+        int32_t t;
+        uint8_t *k;
+        edges_begin(u, &it);
+        while ((k = edges_next(&it, &t)) != NULL) {
+            if (t == u) continue;
+            if (seen[t] >= start[u]) {
+                edges[seen[t]].kind |= *k;
+                continue;
+            }
+            seen[t] = pos;
+            edges[pos].target = t;
+            edges[pos].kind = *k;
+            pos++;
+        }
+    }
+    start[n] = pos;
+
+    free(graph.row_start);
+    free(graph.edges);
+    free(seen);
+    graph.row_start = start;
+    graph.edges = edges;
+    graph.csr_nodes = n;
+    graph.edge_count = pos;
+    graph.pending_count = 0;
+    for (int32_t u = 0; u < n; u++) {
+        graph.nodes[u].pending = graph.nodes[u].pending_last = NONE;
+    }
+    graph.compactions++;
+}
+
+static void maybe_compact(void)
+{
+    if (graph.pending_count > MIN_PENDING && graph.pending_count > graph.edge_count / 4) {
+        compact();
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Layout (caller holds graph_lock)                                   */
+/* ------------------------------------------------------------------ */
+
+static void push(int32_t v, int *tail)
+{
+    if (!graph.nodes[v].queued) {
+        graph.nodes[v].queued = 1;
+        graph.queue[*tail % graph.node_cap] = v;
+        (*tail)++;
+    }
+}
+
+/* Give w a shorter path through v if there is one; returns 1 if it moved */
+static int improve(int32_t v, int32_t w)
+{
+    node_t *nv = &graph.nodes[v];
+    node_t *nw = &graph.nodes[w];
+
+    if (v == w || nv->kind != TOPO_NODE_ROUTER || nv->depth == DEPTH_NONE ||
+        nv->depth + 1 >= nw->depth) {
+        return 0;
+    }
+    nw->depth = (uint16_t)(nv->depth + 1);
+    set_parent(w, v);
+    graph.relaxed++;
+    return 1;
+}
+
+/* Breadth-first relaxation from the queued nodes; subnets are never transit */
+static void run_queue(int head, int tail)
+{
+    while (head < tail) {
+        int32_t v = graph.queue[head++ % graph.node_cap];
+        edge_iter_t it;
+        int32_t w;
+
+        graph.nodes[v].queued = 0;
+        if (graph.nodes[v].kind != TOPO_NODE_ROUTER) {
+            continue;
+        }
+        edges_begin(v, &it);
+        while (edges_next(&it, &w) != NULL) {
+            if (improve(v, w) && graph.nodes[w].kind == TOPO_NODE_ROUTER) {
+                push(w, &tail);
+            }
+        }
+    }
+}
+
+/* Re-layout after an edge between a and b appeared */
+static void relax_pair(int32_t a, int32_t b)
+{
+    int tail = 0;
+
+    if (improve(a, b)) push(b, &tail);
+    if (improve(b, a)) push(a, &tail);
+    run_queue(0, tail);
+}
+
+/* Take the best parent among v's neighbours, then relax outwards from v */
+static void relax_node(int32_t v)
+{
+    edge_iter_t it;
+    int32_t w;
+    int tail = 0;
+
+    edges_begin(v, &it);
+    while (edges_next(&it, &w) != NULL) {
+        improve(w, v);
+    }
+    push(v, &tail);
+    run_queue(0, tail);
+}
+
+/* Fold node x into router r: edges, layout position and children move to r */
+static void merge(int32_t x, int32_t r)
+{
+    node_t *nx = &graph.nodes[x];
+    edge_iter_t it;
+    int32_t t;
+    uint8_t *k;
+
+    edges_begin(x, &it);
+    while ((k = edges_next(&it, &t)) != NULL) {
+        if (t != r && t != x) {
+            add_half(r, t, *k);
+        }
+    }
+    nx = &graph.nodes[x];
+    nx->alias = r;
+    graph.aliases++;
+
+    node_t *nr = &graph.nodes[r];
+    if (nx->depth < nr->depth) {
+        /* r takes the shallower position; it may have been inside x's subtree */
+        nr->depth = nx->depth;
+        nr->seed |= nx->seed;
+        detach(r);
+        attach(r, nx->parent != NONE ? nx->parent : ROOT);
+    } else {
+        nr->seed |= nx->seed;
+    }
+    while (nx->first_child != NONE) {
+        set_parent(nx->first_child, r);
+    }
+    detach(x);
+    relax_node(r);
+}
+
+static int32_t get_router(uint32_t addr)
+{
+    int32_t node;
+
+    if (host_index_find(&graph.router_index, addr, &node)) {
+        return find(node);
+    }
+    node = new_node(addr, TOPO_NODE_ROUTER, 0);
+    if (node == NONE || host_index_insert(&graph.router_index, addr, node, NULL) < 0) {
+        return NONE;
+    }
+    return node;
+}
+
+static int32_t get_subnet(uint32_t network, uint8_t prefix_len)
+{
+    int32_t node;
+
+    if (host_index_find(&graph.subnet_index, network, &node)) {
+        if (graph.nodes[node].prefix_len == prefix_len) {
+            return node;
+        }
+        /* Same network with another mask: rare, search the nodes */
+        for (int32_t i = 1; i < graph.node_count; i++) {
+            const node_t *n = &graph.nodes[i];
+            if (n->kind == TOPO_NODE_SUBNET && n->addr == network && n->prefix_len == prefix_len) {
+                return i;
+            }
+        }
+        return new_node(network, TOPO_NODE_SUBNET, prefix_len);
+    }
+    node = new_node(network, TOPO_NODE_SUBNET, prefix_len);
+    if (node == NONE || host_index_insert(&graph.subnet_index, network, node, NULL) < 0) {
+        return NONE;
+    }
+    return node;
+}
+
+/* ------------------------------------------------------------------ */
+/* Public API                                                         */
+/* ------------------------------------------------------------------ */
+
+int topo_add_router(uint32_t addr, int seed)
+{
+    pthread_mutex_lock(&graph_lock);
+    int32_t node = ensure_root() == NETMON_SUCCESS ? get_router(addr) : NONE;
+    if (node != NONE && seed && graph.nodes[node].depth != 0) {
+        graph.nodes[node].seed = 1;
+        graph.nodes[node].depth = 0;
+        set_parent(node, ROOT);
+        int tail = 0;
+        push(node, &tail);
+        run_queue(0, tail);
+    }
+    if (node != NONE) {
+        graph.generation++;
+    }
+    pthread_mutex_unlock(&graph_lock);
+    return node != NONE ? (int)node : NETMON_ERROR;
+}
+
+int topo_add_link(uint32_t from, uint32_t to)
+{
+    int rc = NETMON_ERROR;
+
+    pthread_mutex_lock(&graph_lock);
+    if (ensure_root() == NETMON_SUCCESS) {
+        int32_t f = get_router(from);
+        int32_t t = f != NONE ? get_router(to) : NONE;
+        if (t != NONE) {
+            f = find(f);
+            if (f != t && add_half(f, t, EDGE_NEXTHOP) >= 0 && add_half(t, f, EDGE_NEXTHOP_IN) >= 0) {
+                relax_pair(f, t);
+                maybe_compact();
+            }
+            graph.generation++;
+            rc = NETMON_SUCCESS;
+        }
+    }
+    pthread_mutex_unlock(&graph_lock);
+    return rc;
+}
+
+int topo_add_interface(uint32_t router, uint32_t addr, uint32_t mask)
+{
+    int rc = NETMON_ERROR;
+
+    pthread_mutex_lock(&graph_lock);
+    int32_t r = ensure_root() == NETMON_SUCCESS ? get_router(router) : NONE;
+    if (r != NONE) {
+        int32_t x;
+        rc = NETMON_SUCCESS;
+        if (host_index_find(&graph.router_index, addr, &x)) {
+            x = find(x);
+            if (x != r) {
+                merge(x, r);
+            }
+        } else if (host_index_insert(&graph.router_index, addr, r, NULL) < 0) {
+            rc = NETMON_ERROR;
+        }
+
+        /* Contiguous masks only; host routes and 0/0 carry no subnet */
+        uint32_t host_bits = ~mask;
+        if (mask != 0 && host_bits != 0 && (host_bits & (host_bits + 1)) == 0) {
+            int32_t s = get_subnet(addr & mask, (uint8_t)__builtin_popcount(mask));
+            if (s == NONE || add_half(r, s, EDGE_ATTACH) < 0 || add_half(s, r, EDGE_ATTACH) < 0) {
+                rc = NETMON_ERROR;
+            } else {
+                relax_pair(r, s);
+            }
+        }
+        maybe_compact();
+        graph.generation++;
+    }
+    pthread_mutex_unlock(&graph_lock);
+    return rc;
+}
+
+void topo_clear(void)
+{
+    pthread_mutex_lock(&graph_lock);
+    free(graph.nodes);
+    free(graph.row_start);
+    free(graph.edges);
+    free(graph.pending);
+    free(graph.queue);
+    host_index_free(&graph.router_index);
+    host_index_free(&graph.subnet_index);
+    uint32_t generation = graph.generation + 1;
+    memset(&graph, 0, sizeof(graph));
+    graph.generation = generation;
+    pthread_mutex_unlock(&graph_lock);
+}
+
+uint32_t topo_generation(void)
+{
+    pthread_mutex_lock(&graph_lock);
+    uint32_t g = graph.generation;
+    pthread_mutex_unlock(&graph_lock);
+    return g;
+}
+
+int topo_row_count(void)
+{
+    pthread_mutex_lock(&graph_lock);
+    int n = graph.node_count > 0 ? graph.nodes[ROOT].rows - 1 : 0;
+    pthread_mutex_unlock(&graph_lock);
+    return n;
+}
+
+static void fill_row(int32_t v, int level, topo_row_t *row)
+{
+    const node_t *n = &graph.nodes[v];
+    edge_iter_t it;
+    int32_t t;
+    int32_t seen[64];
+    int seen_count = 0;
+
+    memset(row, 0, sizeof(*row));
+    row->node = v;
+    row->kind = (topo_node_kind_t)n->kind;
+    row->addr = n->addr;
+    row->prefix_len = n->prefix_len;
+    row->level = (uint8_t)(level < 255 ? level : 255);
+    row->seed = n->seed;
+    row->reached = n->depth != DEPTH_NONE;
+
+    /* Uncompacted merges can repeat a neighbour; count each once */
+    edges_begin(v, &it);
+    while (edges_next(&it, &t) != NULL) {
+        int dup = t == v;
+        for (int i = 0; i < seen_count && !dup; i++) {
+            dup = seen[i] == t;
+        }
+        if (dup) continue;
+        if (seen_count < 64) seen[seen_count++] = t;
+        if (graph.nodes[t].kind == TOPO_NODE_ROUTER && n->kind == TOPO_NODE_ROUTER) {
+            row->routers++;
+        } else {
+            row->subnets++;
+        }
+    }
+}
+
+int topo_rows(int first, topo_row_t *rows, int max_count)
+{
+    int count = 0;
+
+    pthread_mutex_lock(&graph_lock);
+    if (graph.node_count == 0 || first < 0) {
+        pthread_mutex_unlock(&graph_lock);
+        return 0;
+    }
+
+    /* Pre-order walk that skips whole subtrees ending before first */
+    int row = 0;
+    int level = 0;
+    int32_t v = graph.nodes[ROOT].first_child;
+    while (v != NONE && count < max_count) {
+        const node_t *n = &graph.nodes[v];
+        if (row + n->rows <= first) {
+            row += n->rows;
+            v = n->next_sibling;
+            continue;
+        }
+        if (row >= first) {
+            fill_row(v, level, &rows[count++]);
+        }
+        row++;
+        if (n->first_child != NONE) {
+            v = n->first_child;
+            level++;
+            continue;
+        }
+        while (v != NONE && graph.nodes[v].next_sibling == NONE) {
+            v = graph.nodes[v].parent;
+            level--;
+            if (v == ROOT) v = NONE;
+        }
+        if (v != NONE) {
+            v = graph.nodes[v].next_sibling;
+        }
+    }
+    pthread_mutex_unlock(&graph_lock);
+    return count;
+}
+
+void topo_get_stats(topo_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&graph_lock);
+    for (int32_t u = 1; u < graph.node_count; u++) {
+        const node_t *n = &graph.nodes[u];
+        if (find(u) != u) {
+            continue;
+        }
+        if (n->kind == TOPO_NODE_ROUTER) {
+            stats->routers++;
+        } else {
+            stats->subnets++;
+        }
+        if (n->kind != TOPO_NODE_ROUTER) {
+            continue;
+        }
+        topo_row_t row;
+        fill_row(u, 0, &row);
+        stats->links += row.routers;
+        stats->attachments += row.subnets;
+    }
+    stats->links /= 2;
+    stats->aliases = graph.aliases;
+    stats->pending = graph.pending_count;
+    stats->compactions = graph.compactions;
+    stats->relaxed = graph.relaxed;
+    pthread_mutex_unlock(&graph_lock);
+}
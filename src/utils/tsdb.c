@@ -0,0 +1,691 @@
+/*
+ * Metric History
+ * One fixed-layout file per device, mapped MAP_SHARED. Raw samples go
+ * into Gorilla chunks (Pelkonen et al., VLDB 2015); rollups are plain
+ * min/max/sum/count records in per-resolution rings.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "tsdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TSDB_MAGIC "NMTSDB"
+#define TSDB_PAGE 4096
+#define TSDB_CHUNK_BYTES 1024
+#define TSDB_TIER_COUNT 3
+
+/* Series kept mapped at once; beyond it the least recently used is unmapped */
+#define TSDB_OPEN_SERIES 1024
+
+/* Worst case for one sample: 4+32 timestamp bits, 2+5+6+64 value bits */
+#define TSDB_MAX_SAMPLE_BITS 113
+
+#define NO_WINDOW 0xff
+
+/* Compressed raw samples; the writer's state is kept in the header so appends resume after a restart */
+typedef struct {
+    int64_t t0;
+    int64_t t_last;
+    int64_t delta;            /* Last timestamp delta */
+    uint64_t v0;              /* First value, IEEE 754 bits */
+    uint64_t v_last;
+    uint32_t bit_len;
+    uint16_t count;
+    uint8_t leading;          /* XOR window of the last value, NO_WINDOW if none */
+    uint8_t trailing;
+    uint8_t bits[TSDB_CHUNK_BYTES - 48];
+} tsdb_chunk_t;
+
+typedef struct {
+    uint32_t start;           /* Bucket start, seconds */
+    uint32_t count;
+    double min;
+    double max;
+    double sum;
+} tsdb_rollup_t;
+
+typedef struct {
+    uint32_t head;            /* Next ring slot */
+    uint32_t count;           /* Completed buckets in the ring */
+    tsdb_rollup_t acc;        /* Bucket being filled */
+} tsdb_tier_t;
+
+typedef struct {
+    uint32_t chunk_head;      /* Ring slot of the open chunk */
+    uint32_t chunk_count;
+    tsdb_tier_t tiers[TSDB_TIER_COUNT];
+    uint8_t pad[TSDB_PAGE - 8 - TSDB_TIER_COUNT * sizeof(tsdb_tier_t)];
+    tsdb_chunk_t chunks[TSDB_RAW_CHUNKS];
+    tsdb_rollup_t r1m[TSDB_1M_SLOTS];
+    tsdb_rollup_t r5m[TSDB_5M_SLOTS];
+    tsdb_rollup_t r1h[TSDB_1H_SLOTS];
+} tsdb_section_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t metric_count;
+    uint32_t chunk_bytes;
+    uint32_t reserved;
+    int64_t created;
+    char hostname[MAX_HOSTNAME_LEN];
+} tsdb_file_header_t;
+
+typedef struct {
+    tsdb_file_header_t hdr;
+    uint8_t pad[TSDB_PAGE - sizeof(tsdb_file_header_t)];
+    tsdb_section_t metric[TSDB_METRIC_COUNT];
+} tsdb_file_t;
+
+_Static_assert(sizeof(tsdb_chunk_t) == TSDB_CHUNK_BYTES, "tsdb chunk layout changed");
+_Static_assert(sizeof(tsdb_rollup_t) == 32, "tsdb rollup layout changed");
+
+static const uint32_t tier_width[TSDB_TIER_COUNT] = { 60, 300, 3600 };
+static const uint32_t tier_slots[TSDB_TIER_COUNT] = { TSDB_1M_SLOTS, TSDB_5M_SLOTS, TSDB_1H_SLOTS };
+
+typedef struct {
+    pthread_mutex_t lock;
+    int in_use;
+    uint64_t last_used;
+    char hostname[MAX_HOSTNAME_LEN];
+    tsdb_file_t *map;
+} tsdb_series_t;
+
+static pthread_mutex_t tsdb_lock = PTHREAD_MUTEX_INITIALIZER;
+static int tsdb_opened = 0;
+static char tsdb_dir[512];
+static tsdb_series_t series[TSDB_OPEN_SERIES];
+static uint64_t use_clock = 0;
+static pthread_once_t series_once = PTHREAD_ONCE_INIT;
+
+static void series_init(void)
+{
+    for (int i = 0; i < TSDB_OPEN_SERIES; i++) {
+        pthread_mutex_init(&series[i].lock, NULL);
+    }
+}
+
+static tsdb_rollup_t *tier_ring(tsdb_section_t *s, int tier)
+{
+    switch (tier) {
+    case 0: return s->r1m;
+    case 1: return s->r5m;
+    default: return s->r1h;
+    }
+}
+
+static uint64_t double_bits(double v)
+{
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+static double bits_double(uint64_t u)
+{
+    double v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+/* ------------------------------------------------------------------ */
+/* Gorilla bit stream                                                 */
+/* ------------------------------------------------------------------ */
+
+/* Append the low n bits of v, most significant first; bits[] starts zeroed */
+static void put_bits(tsdb_chunk_t *c, uint64_t v, int n)
+{
+    while (n > 0) {
+        uint32_t pos = c->bit_len;
+        int room = 8 - (int)(pos & 7);
+        int take = n < room ? n : room;
+        uint8_t chunk = (uint8_t)((v >> (n - take)) & ((1u << take) - 1));
+        c->bits[pos >> 3] |= (uint8_t)(chunk << (room - take));
+        c->bit_len += (uint32_t)take;
+        n -= take;
+    }
+}
+
+typedef struct {
+    const uint8_t *bits;
+    uint32_t pos;
+} bit_reader_t;
+
+static uint64_t get_bits(bit_reader_t *r, int n)
+{
+    uint64_t v = 0;
+
+    while (n > 0) {
+        int room = 8 - (int)(r->pos & 7);
+        int take = n < room ? n : room;
+        uint8_t byte = r->bits[r->pos >> 3];
+        v = (v << take) | (uint64_t)((byte >> (room - take)) & ((1u << take) - 1));
+        r->pos += (uint32_t)take;
+        n -= take;
+    }
+    return v;
+}
+
+static void encode_timestamp(tsdb_chunk_t *c, int64_t ts)
+{
+    int64_t delta = ts - c->t_last;
+    int64_t dod = delta - c->delta;
+
+    if (dod == 0) {
+        put_bits(c, 0x0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        put_bits(c, 0x2, 2);
+        put_bits(c, (uint64_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        put_bits(c, 0x6, 3);
+        put_bits(c, (uint64_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        put_bits(c, 0xe, 4);
+        put_bits(c, (uint64_t)(dod + 2047), 12);
+    } else {
+        put_bits(c, 0xf, 4);
+        put_bits(c, (uint64_t)(uint32_t)(int32_t)dod, 32);
+    }
+    c->delta = delta;
+    c->t_last = ts;
+}
+
+static void encode_value(tsdb_chunk_t *c, uint64_t v)
+{
+    uint64_t x = v ^ c->v_last;
+
+    if (x == 0) {
+        put_bits(c, 0x0, 1);
+        return;
+    }
+
+    int lead = __builtin_clzll(x);
+    int trail = __builtin_ctzll(x);
+    if (lead > 31) {
+        lead = 31;
+    }
+
+    if (c->leading != NO_WINDOW && lead >= c->leading && trail >= c->trailing) {
+        /* Meaningful bits fit the previous window */
+        put_bits(c, 0x2, 2);
+        put_bits(c, x >> c->trailing, 64 - c->leading - c->trailing);
+    } else {
+        int sig = 64 - lead - trail;
+        put_bits(c, 0x3, 2);
+        put_bits(c, (uint64_t)lead, 5);
+        put_bits(c, (uint64_t)(sig & 63), 6);      /* 64 is stored as 0 */
+        put_bits(c, x >> trail, sig);
+        c->leading = (uint8_t)lead;
+        c->trailing = (uint8_t)trail;
+    }
+    c->v_last = v;
+}
+
+/*
+ * Decode a chunk oldest first, emitting samples in [from, to]
+ * Returns the number of points written to out
+ */
+static int decode_chunk(const tsdb_chunk_t *c, int64_t from, int64_t to,
+                        tsdb_point_t *out, int max_points)
+{
+    bit_reader_t r = { c->bits, 0 };
+    int64_t t = c->t0;
+    int64_t delta = 0;
+    uint64_t v = c->v0;
+    int lead = NO_WINDOW, trail = 0;
+    int n = 0;
+
+    for (int i = 0; i < c->count && n < max_points; i++) {
+        if (i > 0) {
+            int64_t dod;
+            if (get_bits(&r, 1) == 0) {
+                dod = 0;
+            } else if (get_bits(&r, 1) == 0) {
+                dod = (int64_t)get_bits(&r, 7) - 63;
+            } else if (get_bits(&r, 1) == 0) {
+                dod = (int64_t)get_bits(&r, 9) - 255;
+            } else if (get_bits(&r, 1) == 0) {
+                dod = (int64_t)get_bits(&r, 12) - 2047;
+            } else {
+                dod = (int32_t)(uint32_t)get_bits(&r, 32);
+            }
+            delta += dod;
+            t += delta;
+
+            if (get_bits(&r, 1) != 0) {
+                if (get_bits(&r, 1) != 0) {
+                    lead = (int)get_bits(&r, 5);
+                    int sig = (int)get_bits(&r, 6);
+                    if (sig == 0) sig = 64;
+                    trail = 64 - lead - sig;
+                }
+                v ^= get_bits(&r, 64 - lead - trail) << trail;
+            }
+        }
+        if (t > to) {
+            break;
+        }
+        if (t >= from) {
+            double d = bits_double(v);
+            out[n].ts = t;
+            out[n].count = 1;
+            out[n].min = out[n].max = out[n].avg = d;
+            n++;
+        }
+    }
+    return n;
+}
+
+/* ------------------------------------------------------------------ */
+/* Append                                                             */
+/* ------------------------------------------------------------------ */
+
+static void start_chunk(tsdb_chunk_t *c, int64_t ts, uint64_t v)
+{
+    memset(c, 0, sizeof(*c));
+    c->t0 = ts;
+    c->t_last = ts;
+    c->v0 = v;
+    c->v_last = v;
+    c->leading = NO_WINDOW;
+    c->count = 1;
+}
+
+static void append_raw(tsdb_section_t *s, int64_t ts, double value)
+{
+    uint64_t v = double_bits(value);
+
+    if (s->chunk_count == 0) {
+        s->chunk_head = 0;
+        start_chunk(&s->chunks[0], ts, v);
+        s->chunk_count = 1;
+        return;
+    }
+
+    tsdb_chunk_t *c = &s->chunks[s->chunk_head];
+    int64_t dod = (ts - c->t_last) - c->delta;
+    if (c->bit_len + TSDB_MAX_SAMPLE_BITS > sizeof(c->bits) * 8 || c->count == UINT16_MAX ||
+        dod < INT32_MIN || dod > INT32_MAX) {
+        s->chunk_head = (s->chunk_head + 1) % TSDB_RAW_CHUNKS;
+        start_chunk(&s->chunks[s->chunk_head], ts, v);
+        if (s->chunk_count < TSDB_RAW_CHUNKS) {
+            s->chunk_count++;
+        }
+        return;
+    }
+
+    encode_timestamp(c, ts);
+    encode_value(c, v);
+    c->count++;
+}
+
+static void append_rollups(tsdb_section_t *s, int64_t ts, double value)
+{
+    for (int t = 0; t < TSDB_TIER_COUNT; t++) {
+        tsdb_tier_t *tier = &s->tiers[t];
+        uint32_t start = (uint32_t)(ts - ts % tier_width[t]);
+
+        if (tier->acc.count > 0 && tier->acc.start != start) {
+            tier_ring(s, t)[tier->head] = tier->acc;
+            tier->head = (tier->head + 1) % tier_slots[t];
+            if (tier->count < tier_slots[t]) {
+                tier->count++;
+            }
+            tier->acc.count = 0;
+        }
+        if (tier->acc.count == 0) {
+            tier->acc.start = start;
+            tier->acc.min = tier->acc.max = value;
+            tier->acc.sum = 0.0;
+        }
+        if (value < tier->acc.min) tier->acc.min = value;
+        if (value > tier->acc.max) tier->acc.max = value;
+        tier->acc.sum += value;
+        tier->acc.count++;
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Series files                                                       */
+/* ------------------------------------------------------------------ */
+
+static int make_dirs(const char *dir)
+{
+    char path[512];
+    size_t len = strlen(dir);
+
+    if (len == 0 || len >= sizeof(path)) {
+        return NETMON_ERROR;
+    }
+    memcpy(path, dir, len + 1);
+    for (size_t i = 1; i <= len; i++) {
+        if (path[i] == '/' || path[i] == '\0') {
+            char saved = path[i];
+            path[i] = '\0';
+            if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+                return NETMON_ERROR;
+            }
+            path[i] = saved;
+        }
+    }
+    return NETMON_SUCCESS;
+}
+
+/* File name for hostname: anything outside [A-Za-z0-9._-] becomes '_' */
+static void series_path(const char *hostname, char *path, size_t size)
+{
+    char name[MAX_HOSTNAME_LEN];
+    size_t i;
+
+    for (i = 0; hostname[i] != '\0' && i < sizeof(name) - 1; i++) {
+        char ch = hostname[i];
+        int ok = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+                 (ch >= '0' && ch <= '9') || ch == '.' || ch == '-' || ch == '_';
+        name[i] = ok ? ch : '_';
+    }
+    name[i] = '\0';
+    snprintf(path, size, "%s/%s.tsdb", tsdb_dir, name);
+}
+
+static tsdb_file_t *map_series(const char *hostname, int create)
+{
+    char path[1024];
+    struct stat st;
+
+    series_path(hostname, path, sizeof(path));
+    int fd = open(path, create ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    int fresh = st.st_size == 0;
+    if (fresh && ftruncate(fd, (off_t)sizeof(tsdb_file_t)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (!fresh && (size_t)st.st_size != sizeof(tsdb_file_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    tsdb_file_t *f = mmap(NULL, sizeof(tsdb_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (f == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (fresh) {
+        f->hdr.version = TSDB_VERSION;
+        f->hdr.metric_count = TSDB_METRIC_COUNT;
+        f->hdr.chunk_bytes = TSDB_CHUNK_BYTES;
+        f->hdr.created = (int64_t)time(NULL);
+        snprintf(f->hdr.hostname, sizeof(f->hdr.hostname), "%s", hostname);
+        memcpy(f->hdr.magic, TSDB_MAGIC, sizeof(TSDB_MAGIC));
+    }
+
+    /* Sanitized names can collide; the header says whose file it is */
+    if (memcmp(f->hdr.magic, TSDB_MAGIC, sizeof(TSDB_MAGIC)) != 0 ||
+        f->hdr.version != TSDB_VERSION || f->hdr.metric_count != TSDB_METRIC_COUNT ||
+        f->hdr.chunk_bytes != TSDB_CHUNK_BYTES ||
+        strncmp(f->hdr.hostname, hostname, sizeof(f->hdr.hostname)) != 0) {
+        munmap(f, sizeof(tsdb_file_t));
+        return NULL;
+    }
+    return f;
+}
+
+static void unmap_series(tsdb_series_t *h)
+{
+    if (h->map != NULL) {
+        msync(h->map, sizeof(tsdb_file_t), MS_SYNC);
+        munmap(h->map, sizeof(tsdb_file_t));
+        h->map = NULL;
+    }
+    h->in_use = 0;
+}
+
+/*
+ * Find or map the series for hostname and return it locked
+ * The least recently used series is unmapped when all slots are taken
+ */
+static tsdb_series_t *acquire_series(const char *hostname, int create)
+{
+    tsdb_series_t *h = NULL, *free_slot = NULL, *lru = NULL;
+
+    pthread_mutex_lock(&tsdb_lock);
+    if (!tsdb_opened) {
+        pthread_mutex_unlock(&tsdb_lock);
+        return NULL;
+    }
+    for (int i = 0; i < TSDB_OPEN_SERIES; i++) {
+        tsdb_series_t *s = &series[i];
+        if (!s->in_use) {
+            if (free_slot == NULL) free_slot = s;
+        } else if (strcmp(s->hostname, hostname) == 0) {
+            h = s;
+            break;
+        } else if (lru == NULL || s->last_used < lru->last_used) {
+            lru = s;
+        }
+    }
+
+    if (h != NULL) {
+        pthread_mutex_lock(&h->lock);
+    } else {
+        h = free_slot != NULL ? free_slot : lru;
+        pthread_mutex_lock(&h->lock);
+        if (h->in_use) {
+            unmap_series(h);
+        }
+        h->map = map_series(hostname, create);
+        if (h->map == NULL) {
+            pthread_mutex_unlock(&h->lock);
+            pthread_mutex_unlock(&tsdb_lock);
+            return NULL;
+        }
+        snprintf(h->hostname, sizeof(h->hostname), "%s", hostname);
+        h->in_use = 1;
+    }
+    h->last_used = ++use_clock;
+    pthread_mutex_unlock(&tsdb_lock);
+    return h;
+}
+
+/* ------------------------------------------------------------------ */
+/* Public API                                                         */
+/* ------------------------------------------------------------------ */
+
+int tsdb_open(const char *dir)
+{
+    pthread_once(&series_once, series_init);
+
+    if (dir == NULL || strlen(dir) >= sizeof(tsdb_dir) || make_dirs(dir) != NETMON_SUCCESS) {
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&tsdb_lock);
+    if (tsdb_opened && strcmp(tsdb_dir, dir) != 0) {
+        pthread_mutex_unlock(&tsdb_lock);
+        return NETMON_ERROR;
+    }
+    snprintf(tsdb_dir, sizeof(tsdb_dir), "%s", dir);
+    tsdb_opened = 1;
+    pthread_mutex_unlock(&tsdb_lock);
+    return NETMON_SUCCESS;
+}
+
+void tsdb_close(void)
+{
+    pthread_once(&series_once, series_init);
+
+    pthread_mutex_lock(&tsdb_lock);
+    for (int i = 0; i < TSDB_OPEN_SERIES; i++) {
+        pthread_mutex_lock(&series[i].lock);
+        if (series[i].in_use) {
+            unmap_series(&series[i]);
+        }
+        pthread_mutex_unlock(&series[i].lock);
+    }
+    tsdb_opened = 0;
+    pthread_mutex_unlock(&tsdb_lock);
+}
+
+int tsdb_is_open(void)
+{
+    pthread_mutex_lock(&tsdb_lock);
+    int r = tsdb_opened;
+    pthread_mutex_unlock(&tsdb_lock);
+    return r;
+}
+
+int tsdb_append(const char *hostname, time_t ts, const double values[TSDB_METRIC_COUNT])
+{
+    int rc = NETMON_SUCCESS;
+
+    if (hostname == NULL || hostname[0] == '\0' || values == NULL || ts <= 0 ||
+        (int64_t)ts > (int64_t)UINT32_MAX) {
+        return NETMON_ERROR;
+    }
+    tsdb_series_t *h = acquire_series(hostname, 1);
+    if (h == NULL) {
+        return NETMON_ERROR;
+    }
+
+    for (int m = 0; m < TSDB_METRIC_COUNT; m++) {
+        tsdb_section_t *s = &h->map->metric[m];
+        if (isnan(values[m])) {
+            continue;
+        }
+        if (s->chunk_count > 0 && (int64_t)ts <= s->chunks[s->chunk_head].t_last) {
+            rc = NETMON_ERROR;
+            continue;
+        }
+        append_raw(s, (int64_t)ts, values[m]);
+        append_rollups(s, (int64_t)ts, values[m]);
+    }
+
+    pthread_mutex_unlock(&h->lock);
+    return rc;
+}
+
+static int query_raw(const tsdb_section_t *s, int64_t from, int64_t to,
+                     tsdb_point_t *out, int max_points)
+{
+    int n = 0;
+
+    for (uint32_t i = 0; i < s->chunk_count && n < max_points; i++) {
+        uint32_t slot = (s->chunk_head + TSDB_RAW_CHUNKS - s->chunk_count + 1 + i) % TSDB_RAW_CHUNKS;
+        const tsdb_chunk_t *c = &s->chunks[slot];
+        if (c->t_last < from) {
+            continue;
+        }
+        if (c->t0 > to) {
+            break;
+        }
+        n += decode_chunk(c, from, to, out + n, max_points - n);
+    }
+    return n;
+}
+
+static void rollup_point(const tsdb_rollup_t *r, tsdb_point_t *p)
+{
+    p->ts = (int64_t)r->start;
+    p->count = r->count;
+    p->min = r->min;
+    p->max = r->max;
+    p->avg = r->sum / (double)r->count;
+}
+
+static int query_tier(tsdb_section_t *s, int t, int64_t from, int64_t to,
+                      tsdb_point_t *out, int max_points)
+{
+    const tsdb_tier_t *tier = &s->tiers[t];
+    const tsdb_rollup_t *ring = tier_ring(s, t);
+    uint32_t slots = tier_slots[t];
+    uint32_t oldest = (tier->head + slots - tier->count) % slots;
+    int n = 0;
+
+    /* First completed bucket ending after from */
+    uint32_t lo = 0, hi = tier->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if ((int64_t)ring[(oldest + mid) % slots].start + tier_width[t] <= from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (uint32_t i = lo; i < tier->count && n < max_points; i++) {
+        const tsdb_rollup_t *r = &ring[(oldest + i) % slots];
+        if ((int64_t)r->start > to) {
+            return n;
+        }
+        rollup_point(r, &out[n++]);
+    }
+
+    /* The bucket still being filled */
+    if (n < max_points && tier->acc.count > 0 &&
+        (int64_t)tier->acc.start + tier_width[t] > from && (int64_t)tier->acc.start <= to) {
+        rollup_point(&tier->acc, &out[n++]);
+    }
+    return n;
+}
+
+/* Finest rollup that spans [from, to] in max_points and still holds from */
+static int pick_tier(tsdb_section_t *s, int64_t from, int64_t to, int max_points)
+{
+    for (int t = 0; t < TSDB_TIER_COUNT - 1; t++) {
+        const tsdb_tier_t *tier = &s->tiers[t];
+        int64_t buckets = (to - from) / tier_width[t] + 1;
+        int covers = tier->count < tier_slots[t] ||
+                     (int64_t)tier_ring(s, t)[tier->head].start <= from;
+        if (buckets <= max_points && covers) {
+            return t;
+        }
+    }
+    return TSDB_TIER_COUNT - 1;
+}
+
+int tsdb_query(const char *hostname, tsdb_metric_t metric, time_t from, time_t to,
+               tsdb_resolution_t res, tsdb_point_t *out, int max_points)
+{
+    int n;
+
+    if (hostname == NULL || out == NULL || max_points <= 0 || from > to ||
+        (int)metric < 0 || metric >= TSDB_METRIC_COUNT ||
+        (int)res < TSDB_RES_RAW || res > TSDB_RES_AUTO) {
+        return NETMON_ERROR;
+    }
+    tsdb_series_t *h = acquire_series(hostname, 0);
+    if (h == NULL) {
+        return 0;
+    }
+
+    tsdb_section_t *s = &h->map->metric[metric];
+    if (res == TSDB_RES_RAW) {
+        n = query_raw(s, (int64_t)from, (int64_t)to, out, max_points);
+    } else {
+        int t = res == TSDB_RES_AUTO ? pick_tier(s, (int64_t)from, (int64_t)to, max_points)
+                                     : (int)res - TSDB_RES_1M;
+        n = query_tier(s, t, (int64_t)from, (int64_t)to, out, max_points);
+    }
+
+    pthread_mutex_unlock(&h->lock);
+    return n;
+}
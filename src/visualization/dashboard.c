@@ -0,0 +1,860 @@
+/*
+ * Live Dashboard
+ * Frames are composed into a shadow cell buffer; only runs of cells that
+ * differ from what is on screen are handed to ncurses. Device rows are
+ * recomposed only when the row shows another device or its metrics
+ * store version moved.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "dashboard.h"
+#include "device_db.h"
+#include "metrics_store.h"
+#include "alert.h"
+#include "inventory.h"
+#include "topology.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#ifdef HAVE_NCURSES
+#include <ncurses.h>
+
+#define PANE_TOP 3                /* Title, totals and column header above */
+#define ALERT_ROWS 6
+#define NAME_WIDTH 24
+
+typedef enum {
+    VIEW_TABLE = 0,
+    VIEW_TOPOLOGY
+} view_t;
+
+enum {
+    COLOR_UP = 1,
+    COLOR_DOWN,
+    COLOR_WARN,
+    COLOR_TITLE
+};
+
+/* One line of the scrollable device pane */
+typedef struct {
+    int slot;                     /* -1 for a topology group header */
+    uint32_t id;
+    int group;                    /* Topology group, -1 in the table view */
+    char hostname[NAME_WIDTH + 1];
+    char ip_address[MAX_IP_LEN];
+} pane_line_t;
+
+/* Devices sharing an upstream router */
+typedef struct {
+    uint32_t upstream;            /* 0 = unknown */
+    char name[NAME_WIDTH + 1];
+    int first;                    /* First member line */
+    int count;
+} topo_group_t;
+
+/* What a pane row on screen was composed from */
+typedef struct {
+    int line;                     /* -1 = blank */
+    uint32_t version;
+} row_key_t;
+
+static atomic_int dash_running = 0;
+static atomic_int dash_quit = 0;
+static pthread_t dash_thread;
+static int dash_frame_ms = DASHBOARD_DEFAULT_FRAME_MS;
+
+/* Everything below is only touched by the dashboard thread */
+static int rows, cols;
+static chtype *front;             /* Cells on screen; 0 = unknown */
+static chtype *back;              /* Cells of the frame being composed */
+static row_key_t *keys;           /* Per pane row */
+static int use_color;
+
+static view_t view = VIEW_TABLE;
+static int scroll_top;
+static pane_line_t *lines;         /* Room for 2 * layout_cap + 1 */
+static int line_count;
+static topo_group_t *groups;       /* Room for layout_cap + 1 */
+static int group_count;
+static int layout_cap;             /* Devices the layout arrays hold */
+static uint32_t lines_generation;
+static int graph_mode;            /* Topology view drawn from the L3 graph */
+static int graph_rows;
+static time_t lines_built;
+static int lines_valid;
+
+static char alert_text[ALERT_ROWS][256];
+static alert_severity_t alert_sev[ALERT_ROWS];
+static int alert_lines;
+static uint64_t alert_seen = UINT64_MAX;
+
+/* ------------------------------------------------------------------ */
+/* Shadow buffer                                                      */
+/* ------------------------------------------------------------------ */
+
+/* Width cells of text at (row, col), padded with blanks; width < 0 = to the end */
+static void put_text(int row, int col, int width, chtype attr, const char *text)
+{
+    if (row < 0 || row >= rows || col >= cols) {
+        return;
+    }
+    int end = width < 0 || col + width > cols ? cols : col + width;
+    chtype *cell = back + (size_t)row * (size_t)cols;
+    for (int c = col; c < end; c++) {
+        unsigned char ch = (unsigned char)(*text != '\0' ? *text++ : ' ');
+        cell[c] = (chtype)(ch < ' ' || ch > '~' ? '?' : ch) | attr;
+    }
+}
+
+static chtype status_attr(device_status_t status)
+{
+    if (!use_color) {
+        return status == DEVICE_STATUS_DOWN ? A_BOLD : A_NORMAL;
+    }
+    switch (status) {
+        case DEVICE_STATUS_UP: return COLOR_PAIR(COLOR_UP);
+        case DEVICE_STATUS_DOWN: return COLOR_PAIR(COLOR_DOWN) | A_BOLD;
+        case DEVICE_STATUS_WARNING: return COLOR_PAIR(COLOR_WARN);
+        default: return A_DIM;
+    }
+}
+
+/* Write every run of changed cells; returns the number of cells written */
+static int flush(void)
+{
+    int written = 0;
+
+    for (int r = 0; r < rows; r++) {
+        chtype *b = back + (size_t)r * (size_t)cols;
+        chtype *f = front + (size_t)r * (size_t)cols;
+        int c = 0;
+        while (c < cols) {
+            if (b[c] == f[c]) {
+                c++;
+                continue;
+            }
+            int start = c;
+            while (c < cols && b[c] != f[c]) {
+                c++;
+            }
+            mvaddchnstr(r, start, b + start, c - start);
+            memcpy(f + start, b + start, (size_t)(c - start) * sizeof(chtype));
+            written += c - start;
+        }
+    }
+    if (written > 0) {
+        refresh();
+    }
+    return written;
+}
+
+/* Size the buffers to the terminal; everything is repainted next frame */
+static int resize_buffers(void)
+{
+    int r, c;
+
+    getmaxyx(stdscr, r, c);
+    if (r < 1) r = 1;
+    if (c < 1) c = 1;
+    size_t cells = (size_t)r * (size_t)c;
+    chtype *f = realloc(front, cells * sizeof(chtype));
+    if (f != NULL) front = f;
+    chtype *b = realloc(back, cells * sizeof(chtype));
+    if (b != NULL) back = b;
+    row_key_t *k = realloc(keys, (size_t)r * sizeof(row_key_t));
+    if (k != NULL) keys = k;
+    if (f == NULL || b == NULL || k == NULL) {
+        return NETMON_ERROR;
+    }
+
+    rows = r;
+    cols = c;
+    memset(front, 0, cells * sizeof(chtype));
+    for (size_t i = 0; i < cells; i++) {
+        back[i] = ' ';
+    }
+    for (int i = 0; i < rows; i++) {
+        keys[i].line = -2;        /* Never matches a pane line */
+    }
+    alert_seen = UINT64_MAX;
+    clear();
+    return NETMON_SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+/* Pane lines                                                         */
+/* ------------------------------------------------------------------ */
+
+static uint32_t entry_addr(const device_entry_t *e)
+{
+    struct in_addr in;
+
+    return inet_pton(AF_INET, e->ip_address, &in) == 1 ? ntohl(in.s_addr) : 0;
+}
+
+typedef struct {
+    uint32_t upstream;
+    int index;
+} member_t;
+
+/* Monitored devices by address, for naming graph routers */
+typedef struct {
+    uint32_t addr;
+    int slot;
+    uint32_t id;
+    char hostname[NAME_WIDTH + 1];
+} known_addr_t;
+
+static known_addr_t *known;
+static member_t *members;
+static int known_count;
+
+static int compare_known(const void *a, const void *b)
+{
+    const known_addr_t *x = a, *y = b;
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static const known_addr_t *find_known(uint32_t addr)
+{
+    known_addr_t key = { .addr = addr };
+    return bsearch(&key, known, (size_t)known_count, sizeof(known[0]), compare_known);
+}
+
+static int compare_members(const void *a, const void *b)
+{
+    const member_t *x = a, *y = b;
+
+    if (x->upstream != y->upstream) {
+        /* Devices without a known upstream go last */
+        if (x->upstream == 0) return 1;
+        if (y->upstream == 0) return -1;
+        return x->upstream < y->upstream ? -1 : 1;
+    }
+    return x->index - y->index;
+}
+
+static void add_line(const device_entry_t *e, int group)
+{
+    pane_line_t *l = &lines[line_count++];
+
+    l->slot = e->slot;
+    l->id = e->id;
+    l->group = group;
+    snprintf(l->hostname, sizeof(l->hostname), "%.*s", NAME_WIDTH, e->hostname);
+    snprintf(l->ip_address, sizeof(l->ip_address), "%s", e->ip_address);
+}
+
+/* Size the layout arrays for n devices; returns 0 or -1 */
+static int grow_layout(int n)
+{
+    int cap = layout_cap ? layout_cap : 64;
+    while (cap < n) {
+        cap *= 2;
+    }
+    pane_line_t *l = realloc(lines, (size_t)(2 * cap + 1) * sizeof(*l));
+    if (l == NULL) {
+        return -1;
+    }
+    lines = l;
+    topo_group_t *g = realloc(groups, (size_t)(cap + 1) * sizeof(*g));
+    if (g == NULL) {
+        return -1;
+    }
+    groups = g;
+    known_addr_t *k = realloc(known, (size_t)cap * sizeof(*k));
+    if (k == NULL) {
+        return -1;
+    }
+    known = k;
+    member_t *m = realloc(members, (size_t)cap * sizeof(*m));
+    if (m == NULL) {
+        return -1;
+    }
+    members = m;
+    layout_cap = cap;
+    return 0;
+}
+
+/* Lay out the pane for the current view from snap; an empty pane if memory runs out */
+static void build_lines(const device_snapshot_t *snap)
+{
+    line_count = 0;
+    group_count = 0;
+    known_count = 0;
+    if (snap->count > layout_cap && grow_layout(snap->count) != 0) {
+        lines_valid = 0;
+        return;
+    }
+    for (int i = 0; i < snap->count; i++) {
+        known_addr_t *k = &known[known_count];
+        k->addr = entry_addr(snap->entries[i]);
+        k->slot = snap->entries[i]->slot;
+        k->id = snap->entries[i]->id;
+        snprintf(k->hostname, sizeof(k->hostname), "%.*s", NAME_WIDTH, snap->entries[i]->hostname);
+        known_count += k->addr != 0;
+    }
+    qsort(known, (size_t)known_count, sizeof(known[0]), compare_known);
+
+    if (view == VIEW_TABLE) {
+        for (int i = 0; i < snap->count; i++) {
+            add_line(snap->entries[i], -1);
+        }
+    } else {
+        for (int i = 0; i < snap->count; i++) {
+            uint32_t addr = entry_addr(snap->entries[i]);
+            members[i].upstream = addr != 0 ? inventory_upstream(addr) : 0;
+            members[i].index = i;
+        }
+        qsort(members, (size_t)snap->count, sizeof(member_t), compare_members);
+
+        for (int i = 0; i < snap->count; i++) {
+            if (group_count == 0 || groups[group_count - 1].upstream != members[i].upstream) {
+                topo_group_t *g = &groups[group_count++];
+                g->upstream = members[i].upstream;
+                g->first = line_count + 1;
+                g->count = 0;
+                if (g->upstream == 0) {
+                    snprintf(g->name, sizeof(g->name), "(no known upstream)");
+                } else {
+                    struct in_addr in = { .s_addr = htonl(g->upstream) };
+                    inet_ntop(AF_INET, &in, g->name, sizeof(g->name));
+                    for (int j = 0; j < snap->count; j++) {
+                        if (entry_addr(snap->entries[j]) == g->upstream) {
+                            snprintf(g->name, sizeof(g->name), "%.*s", NAME_WIDTH, snap->entries[j]->hostname);
+                            break;
+                        }
+                    }
+                }
+                pane_line_t *h = &lines[line_count++];
+                memset(h, 0, sizeof(*h));
+                h->slot = -1;
+                h->group = group_count - 1;
+            }
+            groups[group_count - 1].count++;
+            add_line(snap->entries[members[i].index], group_count - 1);
+        }
+    }
+
+    lines_generation = snap->generation;
+    lines_built = time(NULL);
+    lines_valid = 1;
+    for (int i = 0; i < rows; i++) {
+        keys[i].line = -2;
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Frame composition                                                  */
+/* ------------------------------------------------------------------ */
+
+static void format_rate(uint64_t bps, char *buf, size_t size)
+{
+    if (bps >= 1000000000ULL) {
+        snprintf(buf, size, "%.2fG", (double)bps / 1e9);
+    } else if (bps >= 1000000ULL) {
+        snprintf(buf, size, "%.2fM", (double)bps / 1e6);
+    } else if (bps >= 1000ULL) {
+        snprintf(buf, size, "%.1fk", (double)bps / 1e3);
+    } else {
+        snprintf(buf, size, "%llu", (unsigned long long)bps);
+    }
+}
+
+static void compose_device_row(int row, const pane_line_t *l)
+{
+    device_metrics_t m;
+    char text[160], in[16], out[16], cpu[8], mem[8], rtt[12], seen[12];
+
+    if (metrics_store_read(l->slot, l->id, &m) != NETMON_SUCCESS) {
+        put_text(row, 0, -1, A_NORMAL, "");
+        return;
+    }
+    int snmp = m.status == DEVICE_STATUS_UP;
+    snprintf(cpu, sizeof(cpu), snmp ? "%.0f" : "-", (double)m.cpu_usage);
+    snprintf(mem, sizeof(mem), snmp ? "%.0f" : "-", (double)m.memory_usage);
+    format_rate(m.in_bps, in, sizeof(in));
+    format_rate(m.out_bps, out, sizeof(out));
+    if (m.response_time_ms >= 0 && m.status != DEVICE_STATUS_DOWN) {
+        snprintf(rtt, sizeof(rtt), "%d", m.response_time_ms);
+    } else {
+        snprintf(rtt, sizeof(rtt), "-");
+    }
+    if (m.last_seen > 0) {
+        struct tm tm;
+        localtime_r(&m.last_seen, &tm);
+        strftime(seen, sizeof(seen), "%H:%M:%S", &tm);
+    } else {
+        snprintf(seen, sizeof(seen), "never");
+    }
+
+    int indent = l->group >= 0 ? 2 : 0;
+    snprintf(text, sizeof(text), "%*s%-*.*s %-15s %-8s %4s %4s %9s %9s %6s %8s",
+             indent, "", NAME_WIDTH - indent, NAME_WIDTH - indent, l->hostname, l->ip_address,
+             "", cpu, mem, in, out, rtt, seen);
+    put_text(row, 0, -1, A_NORMAL, text);
+    put_text(row, NAME_WIDTH + 17, 8, status_attr(m.status), status_to_string(m.status));
+}
+
+static void compose_group_row(int row, const topo_group_t *g)
+{
+    char text[160];
+    int down = 0;
+
+    for (int i = 0; i < g->count; i++) {
+        const pane_line_t *l = &lines[g->first + i];
+        device_metrics_t m;
+        if (metrics_store_read(l->slot, l->id, &m) == NETMON_SUCCESS && m.status == DEVICE_STATUS_DOWN) {
+            down++;
+        }
+    }
+    snprintf(text, sizeof(text), "%s%s  %d device%s, %d down",
+             g->upstream != 0 ? "via " : "", g->name, g->count, g->count == 1 ? "" : "s", down);
+    put_text(row, 0, -1, down > 0 ? status_attr(DEVICE_STATUS_DOWN) : A_BOLD, text);
+}
+
+static void compose_title(void)
+{
+    char text[160], clock[16];
+    time_t now = time(NULL);
+    struct tm tm;
+
+    localtime_r(&now, &tm);
+    strftime(clock, sizeof(clock), "%H:%M:%S", &tm);
+    snprintf(text, sizeof(text), " Network Monitor %s | %s | %s  [t]opology [r]epaint [q]uit",
+             get_version(), view == VIEW_TABLE ? "devices" : "topology", clock);
+    put_text(0, 0, -1, use_color ? COLOR_PAIR(COLOR_TITLE) : A_REVERSE, text);
+}
+
+static void compose_header(void)
+{
+    char text[160];
+
+    snprintf(text, sizeof(text), "%-*s %-15s %-8s %4s %4s %9s %9s %6s %8s",
+             NAME_WIDTH, "HOSTNAME", "IP ADDRESS", "STATUS", "CPU%", "MEM%",
+             "IN b/s", "OUT b/s", "RTT ms", "POLLED");
+    put_text(2, 0, -1, A_BOLD | A_UNDERLINE, text);
+}
+
+/* Newest alerts into the bottom rows, re-read only when new ones arrived */
+static void compose_alerts(int top, int count)
+{
+    uint64_t head = alert_head();
+
+    if (count <= 0) {
+        return;
+    }
+    put_text(top - 1, 0, -1, A_BOLD, "Recent alerts");
+    if (head != alert_seen) {
+        alert_event_t events[ALERT_ROWS];
+        uint64_t cursor = head > ALERT_ROWS ? head - ALERT_ROWS : 0;
+        int n = alert_read(&cursor, events, ALERT_ROWS, NULL);
+        alert_lines = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            alert_t a;
+            struct tm tm;
+            char when[16];
+            alert_format(&events[i], &a);
+            localtime_r(&a.timestamp, &tm);
+            strftime(when, sizeof(when), "%H:%M:%S", &tm);
+            snprintf(alert_text[alert_lines], sizeof(alert_text[0]), "%s %-8s %.64s: %.160s", when,
+                     severity_to_string(a.severity), a.device_hostname, a.message);
+            alert_sev[alert_lines++] = a.severity;
+        }
+        alert_seen = head;
+    }
+    for (int i = 0; i < count; i++) {
+        chtype attr = A_NORMAL;
+        if (i < alert_lines && alert_sev[i] >= ALERT_ERROR) {
+            attr = status_attr(DEVICE_STATUS_DOWN);
+        } else if (i < alert_lines && alert_sev[i] == ALERT_WARNING) {
+            attr = status_attr(DEVICE_STATUS_WARNING);
+        }
+        put_text(top + i, 0, -1, attr, i < alert_lines ? alert_text[i] : "");
+    }
+}
+
+/* Pane rows available between the header and the alerts */
+static int pane_rows(int *alert_top, int *alert_count)
+{
+    int count = rows >= 20 ? ALERT_ROWS : (rows >= 12 ? 2 : 0);
+    int top = rows - count;
+    int pane = (count > 0 ? top - 1 : rows) - PANE_TOP;
+
+    *alert_top = top;
+    *alert_count = count;
+    return pane > 0 ? pane : 0;
+}
+
+/* Compose the visible pane rows; unchanged devices are skipped */
+static void compose_pane(int pane)
+{
+    if (scroll_top > line_count - pane) scroll_top = line_count - pane;
+    if (scroll_top < 0) scroll_top = 0;
+
+    for (int r = 0; r < pane; r++) {
+        int line = scroll_top + r;
+        row_key_t *key = &keys[r];
+        if (line >= line_count) {
+            if (key->line != -1) {
+                put_text(PANE_TOP + r, 0, -1, A_NORMAL, "");
+                key->line = -1;
+            }
+            continue;
+        }
+        const pane_line_t *l = &lines[line];
+        if (l->slot < 0) {
+            compose_group_row(PANE_TOP + r, &groups[l->group]);
+            key->line = line;
+            continue;
+        }
+        uint32_t version = metrics_store_version(l->slot);
+        if (key->line == line && key->version == version) {
+            continue;
+        }
+        compose_device_row(PANE_TOP + r, l);
+        key->line = line;
+        key->version = version;
+    }
+}
+
+/* One line of the L3 graph: indented router or subnet with its degree */
+static void compose_graph_row(int row, const topo_row_t *t)
+{
+    char text[200], addr[MAX_IP_LEN];
+    struct in_addr in = { .s_addr = htonl(t->addr) };
+    int indent = t->level * 2 < 40 ? t->level * 2 : 40;
+
+    inet_ntop(AF_INET, &in, addr, sizeof(addr));
+    if (t->kind == TOPO_NODE_SUBNET) {
+        snprintf(text, sizeof(text), "%*s%s/%u  (%u router%s)", indent, "", addr, t->prefix_len,
+                 t->subnets, t->subnets == 1 ? "" : "s");
+        put_text(row, 0, -1, A_DIM, text);
+        return;
+    }
+
+    const known_addr_t *k = find_known(t->addr);
+    device_metrics_t m;
+    device_status_t status = DEVICE_STATUS_UNKNOWN;
+    if (k != NULL && metrics_store_read(k->slot, k->id, &m) == NETMON_SUCCESS) {
+        status = m.status;
+    }
+    int len = snprintf(text, sizeof(text), "%*s%s%s%s%s  %u neighbour%s, %u subnet%s%s",
+                       indent, "", addr, k != NULL ? " (" : "", k != NULL ? k->hostname : "",
+                       k != NULL ? ")" : "", t->routers, t->routers == 1 ? "" : "s",
+                       t->subnets, t->subnets == 1 ? "" : "s", t->seed ? "  [seed]" : "");
+    put_text(row, 0, -1, t->reached ? A_BOLD : A_NORMAL, text);
+    if (k != NULL && len + 1 < cols) {
+        put_text(row, len + 1, 8, status_attr(status), status_to_string(status));
+    }
+}
+
+/*
+ * Compose the visible window of the graph layout. A row is redone only
+ * when the graph changed or the router it shows published a sample.
+ */
+static void compose_graph_pane(int pane)
+{
+    static topo_row_t window[256];
+    uint32_t generation = topo_generation();
+
+    if (pane > 256) pane = 256;
+    if (scroll_top > graph_rows - pane) scroll_top = graph_rows - pane;
+    if (scroll_top < 0) scroll_top = 0;
+
+    int n = topo_rows(scroll_top, window, pane);
+    for (int r = 0; r < pane; r++) {
+        row_key_t *key = &keys[r];
+        if (r >= n) {
+            if (key->line != -1) {
+                put_text(PANE_TOP + r, 0, -1, A_NORMAL, "");
+                key->line = -1;
+            }
+            continue;
+        }
+        const known_addr_t *k = window[r].kind == TOPO_NODE_ROUTER ? find_known(window[r].addr) : NULL;
+        uint32_t version = generation * 2654435761U + (k != NULL ? metrics_store_version(k->slot) : 0);
+        if (key->line == window[r].node && key->version == version) {
+            continue;
+        }
+        compose_graph_row(PANE_TOP + r, &window[r]);
+        key->line = window[r].node;
+        key->version = version;
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* netmon.h display API                                               */
+/* ------------------------------------------------------------------ */
+
+int init_display(void)
+{
+    /* newterm() reports a missing or unusable terminal instead of exiting */
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || newterm(NULL, stdout, stdin) == NULL) {
+        return NETMON_ERROR;
+    }
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    leaveok(stdscr, TRUE);
+    curs_set(0);
+    use_color = has_colors();
+    if (use_color) {
+        start_color();
+        use_default_colors();
+        init_pair(COLOR_UP, COLOR_GREEN, -1);
+        init_pair(COLOR_DOWN, COLOR_RED, -1);
+        init_pair(COLOR_WARN, COLOR_YELLOW, -1);
+        init_pair(COLOR_TITLE, COLOR_BLACK, COLOR_CYAN);
+    }
+    lines_valid = 0;
+    scroll_top = 0;
+    if (resize_buffers() != NETMON_SUCCESS) {
+        cleanup_display();
+        return NETMON_ERROR;
+    }
+    return NETMON_SUCCESS;
+}
+
+void cleanup_display(void)
+{
+    endwin();
+    free(front);
+    free(back);
+    free(keys);
+    front = back = NULL;
+    keys = NULL;
+    free(lines);
+    free(groups);
+    free(known);
+    free(members);
+    lines = NULL;
+    groups = NULL;
+    known = NULL;
+    members = NULL;
+    layout_cap = line_count = group_count = known_count = 0;
+    rows = cols = 0;
+}
+
+void draw_statistics(const network_stats_t *stats)
+{
+    char text[200], in[16], out[16], rtt[16];
+
+    format_rate(stats->total_in_bps, in, sizeof(in));
+    format_rate(stats->total_out_bps, out, sizeof(out));
+    if (stats->avg_response_time > 0) {
+        snprintf(rtt, sizeof(rtt), "%.1f ms", (double)stats->avg_response_time);
+    } else {
+        snprintf(rtt, sizeof(rtt), "N/A");
+    }
+    snprintf(text, sizeof(text), " %u devices: %u active, %u inactive | avg response %s | in %sb/s out %sb/s | %u alerts",
+             stats->total_devices, stats->active_devices, stats->inactive_devices, rtt, in, out,
+             stats->total_alerts);
+    put_text(1, 0, -1, stats->inactive_devices > 0 ? A_BOLD : A_NORMAL, text);
+}
+
+/* Make the topology view current; the next frame draws it */
+void draw_topology(void)
+{
+    if (view != VIEW_TOPOLOGY) {
+        view = VIEW_TOPOLOGY;
+        lines_valid = 0;
+        scroll_top = 0;
+    }
+}
+
+void update_display(void)
+{
+    network_stats_t stats;
+    int alert_top, alert_count;
+
+    if (front == NULL) {
+        return;
+    }
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    if (!lines_valid || snap->generation != lines_generation ||
+        (view == VIEW_TOPOLOGY && time(NULL) - lines_built >= DASHBOARD_TOPOLOGY_REFRESH)) {
+        build_lines(snap);
+    }
+    device_db_snapshot_release(snap);
+
+    compose_title();
+    get_statistics(&stats);
+    draw_statistics(&stats);
+    int pane = pane_rows(&alert_top, &alert_count);
+    int rows_now = view == VIEW_TOPOLOGY ? topo_row_count() : 0;
+    if ((rows_now > 0) != graph_mode) {
+        graph_mode = rows_now > 0;
+        for (int i = 0; i < rows; i++) {
+            keys[i].line = -2;
+        }
+    }
+    graph_rows = rows_now;
+    if (graph_mode) {
+        put_text(2, 0, -1, A_BOLD | A_UNDERLINE, "ROUTED TOPOLOGY (next hops, attached subnets)");
+        compose_graph_pane(pane);
+    } else {
+        compose_header();
+        compose_pane(pane);
+    }
+    compose_alerts(alert_top, alert_count);
+    flush();
+}
+
+/* ------------------------------------------------------------------ */
+/* Dashboard thread                                                   */
+/* ------------------------------------------------------------------ */
+
+static long elapsed_ms(const struct timespec *since)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000L + (now.tv_nsec - since->tv_nsec) / 1000000L;
+}
+
+/* Apply one key; returns 0 to quit */
+static int handle_key(int ch)
+{
+    int alert_top, alert_count;
+    int page = pane_rows(&alert_top, &alert_count);
+
+    switch (ch) {
+        case 'q': case 'Q': case 27:
+            return 0;
+        case 't': case 'T':
+            if (view == VIEW_TOPOLOGY) {
+                view = VIEW_TABLE;
+                lines_valid = 0;
+                scroll_top = 0;
+            } else {
+                draw_topology();
+            }
+            break;
+        case 'r': case 'R': case 12:    /* Ctrl-L */
+            resize_buffers();
+            break;
+        case KEY_RESIZE:
+            resize_buffers();
+            break;
+        case KEY_UP: case 'k': scroll_top--; break;
+        case KEY_DOWN: case 'j': scroll_top++; break;
+        case KEY_PPAGE: scroll_top -= page; break;
+        case KEY_NPAGE: case ' ': scroll_top += page; break;
+        case KEY_HOME: scroll_top = 0; break;
+        case KEY_END: scroll_top = graph_mode ? graph_rows : line_count; break;
+        default: break;
+    }
+    return 1;
+}
+
+static void *dashboard_main(void *arg)
+{
+    struct timespec last_frame = { 0, 0 };
+    int running = 1;
+
+    (void)arg;
+    while (running && !atomic_load(&dash_quit)) {
+        long wait = dash_frame_ms - elapsed_ms(&last_frame);
+        if (wait <= 0) {
+            update_display();
+            clock_gettime(CLOCK_MONOTONIC, &last_frame);
+            wait = dash_frame_ms;
+        }
+        /* Keys are handled as they come; frames stay on the cadence */
+        timeout((int)wait);
+        int ch = getch();
+        if (ch != ERR) {
+            running = handle_key(ch);
+            if (running && (ch == KEY_RESIZE || ch == 't' || ch == 'T')) {
+                last_frame.tv_sec = 0;      /* Layout changed: draw now */
+            }
+        }
+    }
+    cleanup_display();
+    atomic_store(&dash_quit, 1);
+    return NULL;
+}
+
+int dashboard_start(int frame_ms)
+{
+    int expected = 0;
+
+    if (!atomic_compare_exchange_strong(&dash_running, &expected, 1)) {
+        return NETMON_ERROR;
+    }
+    dash_frame_ms = frame_ms > 0 ? frame_ms : DASHBOARD_DEFAULT_FRAME_MS;
+    atomic_store(&dash_quit, 0);
+    if (init_display() != NETMON_SUCCESS) {
+        atomic_store(&dash_running, 0);
+        return NETMON_ERROR;
+    }
+    if (pthread_create(&dash_thread, NULL, dashboard_main, NULL) != 0) {
+        cleanup_display();
+        atomic_store(&dash_running, 0);
+        return NETMON_ERROR;
+    }
+    return NETMON_SUCCESS;
+}
+
+void dashboard_wait(void)
+{
+    if (atomic_load(&dash_running)) {
+        pthread_join(dash_thread, NULL);
+        atomic_store(&dash_running, 0);
+    }
+}
+
+void dashboard_stop(void)
+{
+    atomic_store(&dash_quit, 1);
+    dashboard_wait();
+}
+
+#else /* !HAVE_NCURSES */
+
+int init_display(void)
+{
+    return NETMON_ERROR;
+}
+
+void cleanup_display(void)
+{
+}
+
+void update_display(void)
+{
+}
+
+void draw_topology(void)
+{
+}
+
+void draw_statistics(const network_stats_t *stats)
+{
+    (void)stats;
+}
+
+int dashboard_start(int frame_ms)
+{
+    (void)frame_ms;
+    return NETMON_ERROR;
+}
+
+void dashboard_wait(void)
+{
+}
+
+void dashboard_stop(void)
+{
+}
+
+#endif /* HAVE_NCURSES */
@@ -0,0 +1,518 @@
+/*
+ * Event Stream
+ * NDJSON records are appended to one of two buffers; the flusher swaps
+ * them and writes the full one with a single write() (stdout) or one
+ * send() per socket client while producers fill the other.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "event_stream.h"
+#include "device_db.h"
+#include "metrics_store.h"
+#include "alert.h"
+#include "correlator.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* Longest single record; alert text and hostnames are truncated to fit */
+#define LINE_MAX_LEN 1536
+
+static pthread_mutex_t stream_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;   /* Flusher: batch ready or stop */
+static pthread_cond_t space_cond = PTHREAD_COND_INITIALIZER;   /* Producers: buffers swapped */
+static pthread_t flusher_thread;
+static int running = 0;
+static int stopping = 0;
+static atomic_int failed = 0;
+
+/* Guarded by stream_lock */
+static char *fill_buf = NULL;
+static size_t fill_len = 0;
+static event_stream_stats_t stats;
+
+/* Owned by the flusher thread */
+static char *out_buf = NULL;
+static int flush_ms = EVENT_STREAM_DEFAULT_FLUSH_MS;
+static int listen_fd = -1;
+static int client_fds[EVENT_STREAM_MAX_CLIENTS];
+static int client_count = 0;
+static char listen_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+/* Per device slot: the (id, metrics version) last streamed */
+typedef struct {
+    uint32_t id;
+    uint32_t version;
+} seen_t;
+
+static chunk_array_t seen = CHUNK_ARRAY_INIT(seen_t);
+
+static int64_t wall_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Copy s into out as the body of a JSON string, truncated to fit size
+ * without splitting an escape
+ */
+static void json_escape(char *out, size_t size, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t n = 0;
+
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        char esc[7];
+        size_t len = 0;
+
+        if (c == '"' || c == '\\') {
+            esc[len++] = '\\';
+            esc[len++] = (char)c;
+        } else if (c < 0x20) {
+            memcpy(esc, "\\u00", 4);
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 15];
+            len = 6;
+        } else {
+            esc[len++] = (char)c;
+        }
+        if (n + len >= size) {
+            break;
+        }
+        memcpy(out + n, esc, len);
+        n += len;
+    }
+    out[n] = '\0';
+}
+
+static void flush_batch(void);
+
+/*
+ * Append one formatted record. When the buffer is full, producers wait
+ * for the flusher and the flusher itself sends the batch inline.
+ * Records offered while the stream is stopped are discarded.
+ */
+static void append_record(const char *line, int len, int from_flusher)
+{
+    if (len <= 0 || len >= LINE_MAX_LEN) {
+        return;
+    }
+
+    pthread_mutex_lock(&stream_lock);
+    while (running && fill_len + (size_t)len > EVENT_STREAM_BUFFER_SIZE) {
+        if (from_flusher) {
+            pthread_mutex_unlock(&stream_lock);
+            flush_batch();
+            pthread_mutex_lock(&stream_lock);
+        } else if (stopping) {
+            break;
+        } else {
+            pthread_cond_signal(&flush_cond);
+            pthread_cond_wait(&space_cond, &stream_lock);
+        }
+    }
+    if (running && fill_len + (size_t)len <= EVENT_STREAM_BUFFER_SIZE) {
+        memcpy(fill_buf + fill_len, line, (size_t)len);
+        fill_len += (size_t)len;
+        stats.records++;
+        stats.bytes += (uint64_t)len;
+        if (fill_len >= EVENT_STREAM_BUFFER_SIZE / 2) {
+            pthread_cond_signal(&flush_cond);
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+}
+
+static void append(const char *line, int len)
+{
+    append_record(line, len, 0);
+}
+
+void event_stream_host(const char *ip, int response_time_ms, void *ctx)
+{
+    char line[LINE_MAX_LEN];
+    char esc[2 * MAX_IP_LEN];
+
+    (void)ctx;
+    json_escape(esc, sizeof(esc), ip);
+    append(line, snprintf(line, sizeof(line), "{\"type\":\"host\",\"ts\":%lld,\"ip\":\"%s\",\"rtt_ms\":%d}\n",
+                          (long long)wall_ms(), esc, response_time_ms));
+}
+
+void event_stream_discovery(int hosts, int64_t duration_ms)
+{
+    char line[LINE_MAX_LEN];
+
+    append(line, snprintf(line, sizeof(line),
+                          "{\"type\":\"discovery\",\"ts\":%lld,\"hosts\":%d,\"duration_ms\":%lld}\n",
+                          (long long)wall_ms(), hosts, (long long)duration_ms));
+}
+
+void event_stream_reload(int rc, int added, int removed, int changed, int rejected)
+{
+    char line[LINE_MAX_LEN];
+
+    append(line, snprintf(line, sizeof(line),
+                          "{\"type\":\"config\",\"ts\":%lld,\"ok\":%s,\"added\":%d,\"removed\":%d,"
+                          "\"changed\":%d,\"rejected\":%d}\n",
+                          (long long)wall_ms(), rc == NETMON_SUCCESS ? "true" : "false",
+                          added, removed, changed, rejected));
+}
+
+/* Correlator subscriber; runs on the batcher thread */
+static void stream_alerts_cb(const alert_event_t *events, int count, uint64_t lost, void *ctx)
+{
+    char line[LINE_MAX_LEN];
+    char host[256];
+    char message[768];
+    alert_t alert;
+
+    (void)ctx;
+    if (lost > 0) {
+        append(line, snprintf(line, sizeof(line), "{\"type\":\"alerts_lost\",\"ts\":%lld,\"count\":%llu}\n",
+                              (long long)wall_ms(), (unsigned long long)lost));
+    }
+    for (int i = 0; i < count; i++) {
+        alert_format(&events[i], &alert);
+        json_escape(host, sizeof(host), alert.device_hostname);
+        json_escape(message, sizeof(message), alert.message);
+        append(line, snprintf(line, sizeof(line),
+                              "{\"type\":\"alert\",\"ts\":%lld,\"seq\":%llu,\"severity\":\"%s\","
+                              "\"host\":\"%s\",\"message\":\"%s\"}\n",
+                              (long long)events[i].timestamp_ms, (unsigned long long)events[i].seq,
+                              severity_to_string((alert_severity_t)events[i].severity), host, message));
+    }
+}
+
+/*
+ * One sample record per device whose metrics changed since the last
+ * scan; never-polled devices are skipped
+ */
+static void scan_samples(void)
+{
+    char line[LINE_MAX_LEN];
+    char host[256];
+    device_metrics_t m;
+    int64_t now = wall_ms();
+
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    for (int i = 0; i < snap->count; i++) {
+        const device_entry_t *e = snap->entries[i];
+        uint32_t version = metrics_store_version(e->slot);
+        seen_t *last = chunk_array_reserve(&seen, (uint32_t)e->slot);
+
+        if (last != NULL && last->id == e->id && last->version == version) {
+            continue;
+        }
+        if (metrics_store_read(e->slot, e->id, &m) != NETMON_SUCCESS) {
+            continue;
+        }
+        if (last != NULL) {     /* Without memory the sample is repeated next scan */
+            last->id = e->id;
+            last->version = version;
+        }
+        if (m.last_seen == 0) {
+            continue;
+        }
+
+        json_escape(host, sizeof(host), e->hostname);
+        int len = snprintf(line, sizeof(line),
+                           "{\"type\":\"sample\",\"ts\":%lld,\"host\":\"%s\",\"ip\":\"%s\","
+                           "\"status\":\"%s\",\"last_seen\":%lld,\"rtt_ms\":%d,\"cpu\":%.1f,"
+                           "\"mem\":%.1f,\"in_bps\":%llu,\"out_bps\":%llu,\"bytes_in\":%llu,"
+                           "\"bytes_out\":%llu,\"errors_in\":%u,\"errors_out\":%u}\n",
+                           (long long)now, host, e->ip_address, status_to_string(m.status),
+                           (long long)m.last_seen, m.response_time_ms, (double)m.cpu_usage,
+                           (double)m.memory_usage, (unsigned long long)m.in_bps,
+                           (unsigned long long)m.out_bps, (unsigned long long)m.bytes_in,
+                           (unsigned long long)m.bytes_out, m.errors_in, m.errors_out);
+        append_record(line, len, 1);
+    }
+    device_db_snapshot_release(snap);
+}
+
+static void accept_clients(void)
+{
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        if (client_count == EVENT_STREAM_MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+        client_fds[client_count++] = fd;
+    }
+}
+
+/*
+ * Send a batch to every socket client; a client whose socket buffer
+ * cannot take all of it is dropped, since a partial line would corrupt
+ * its stream
+ */
+static int send_clients(const char *buf, size_t len)
+{
+    int dropped = 0;
+
+    for (int i = 0; i < client_count; ) {
+        ssize_t n = send(client_fds[i], buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n != (ssize_t)len) {
+            close(client_fds[i]);
+            client_fds[i] = client_fds[--client_count];
+            dropped++;
+            continue;
+        }
+        i++;
+    }
+    return dropped;
+}
+
+/* Write a batch to stdout; returns 0, or -1 once the reader is gone */
+static int write_stdout(const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void deliver(const char *buf, size_t len)
+{
+    int dropped = 0;
+    int wrote = 0;
+
+    if (listen_fd >= 0) {
+        accept_clients();
+        if (len > 0 && client_count > 0) {
+            dropped = send_clients(buf, len);
+            wrote = 1;
+        }
+    } else if (len > 0 && !atomic_load(&failed)) {
+        if (write_stdout(buf, len) != 0) {
+            atomic_store(&failed, 1);
+        }
+        wrote = 1;
+    }
+
+    pthread_mutex_lock(&stream_lock);
+    stats.batches += (uint64_t)wrote;
+    stats.disconnects += (uint64_t)dropped;
+    stats.clients = client_count;
+    pthread_mutex_unlock(&stream_lock);
+}
+
+/* Swap the buffers and send the full one; flusher thread only */
+static void flush_batch(void)
+{
+    pthread_mutex_lock(&stream_lock);
+    char *full = fill_buf;
+    size_t len = fill_len;
+    fill_buf = out_buf;
+    fill_len = 0;
+    out_buf = full;
+    pthread_cond_broadcast(&space_cond);
+    pthread_mutex_unlock(&stream_lock);
+
+    deliver(out_buf, len);
+}
+
+static void *flusher_main(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&stream_lock);
+    for (;;) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += flush_ms / 1000;
+        deadline.tv_nsec += (long)(flush_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int rc = 0;
+        while (!stopping && fill_len < EVENT_STREAM_BUFFER_SIZE / 2 && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&flush_cond, &stream_lock, &deadline);
+        }
+        int last = stopping;
+        pthread_mutex_unlock(&stream_lock);
+
+        scan_samples();
+        flush_batch();
+
+        pthread_mutex_lock(&stream_lock);
+        if (last) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+    return NULL;
+}
+
+/*
+ * Bind a non-blocking listening socket at path; a stale socket left by
+ * an earlier run is replaced, any other file is left alone
+ */
+static int open_listener(const char *path)
+{
+    struct sockaddr_un sa;
+    struct stat st;
+
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 ||
+        listen(fd, EVENT_STREAM_MAX_CLIENTS) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void event_stream_config_default(event_stream_config_t *cfg)
+{
+    cfg->socket_path = NULL;
+    cfg->flush_ms = EVENT_STREAM_DEFAULT_FLUSH_MS;
+}
+
+int event_stream_start(const event_stream_config_t *cfg)
+{
+    pthread_mutex_lock(&stream_lock);
+    if (running || cfg == NULL) {
+        pthread_mutex_unlock(&stream_lock);
+        return NETMON_ERROR;
+    }
+
+    char *a = malloc(EVENT_STREAM_BUFFER_SIZE);
+    char *b = malloc(EVENT_STREAM_BUFFER_SIZE);
+    int fd = -1;
+    if (a == NULL || b == NULL ||
+        (cfg->socket_path != NULL && (fd = open_listener(cfg->socket_path)) < 0)) {
+        free(a);
+        free(b);
+        pthread_mutex_unlock(&stream_lock);
+        return NETMON_ERROR;
+    }
+
+    fill_buf = a;
+    out_buf = b;
+    fill_len = 0;
+    listen_fd = fd;
+    listen_path[0] = '\0';
+    if (fd >= 0) {
+        snprintf(listen_path, sizeof(listen_path), "%s", cfg->socket_path);
+    }
+    client_count = 0;
+    flush_ms = cfg->flush_ms > 0 ? cfg->flush_ms : EVENT_STREAM_DEFAULT_FLUSH_MS;
+    chunk_array_free(&seen);
+    memset(&stats, 0, sizeof(stats));
+    atomic_store(&failed, 0);
+    stopping = 0;
+
+    if (pthread_create(&flusher_thread, NULL, flusher_main, NULL) != 0) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(listen_path);
+        }
+        listen_fd = -1;
+        free(a);
+        free(b);
+        fill_buf = out_buf = NULL;
+        pthread_mutex_unlock(&stream_lock);
+        return NETMON_ERROR;
+    }
+    running = 1;
+    pthread_mutex_unlock(&stream_lock);
+
+    correlate_subscribe(stream_alerts_cb, NULL);
+    return NETMON_SUCCESS;
+}
+
+void event_stream_stop(void)
+{
+    pthread_mutex_lock(&stream_lock);
+    if (!running || stopping) {
+        pthread_mutex_unlock(&stream_lock);
+        return;
+    }
+    pthread_mutex_unlock(&stream_lock);
+
+    /* Waits for a delivery in progress, which still needs the flusher */
+    correlate_unsubscribe(stream_alerts_cb, NULL);
+
+    pthread_mutex_lock(&stream_lock);
+    stopping = 1;
+    pthread_cond_signal(&flush_cond);
+    pthread_cond_broadcast(&space_cond);
+    pthread_mutex_unlock(&stream_lock);
+    pthread_join(flusher_thread, NULL);
+
+    for (int i = 0; i < client_count; i++) {
+        close(client_fds[i]);
+    }
+    client_count = 0;
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(listen_path);
+        listen_fd = -1;
+    }
+
+    pthread_mutex_lock(&stream_lock);
+    free(fill_buf);
+    free(out_buf);
+    fill_buf = out_buf = NULL;
+    fill_len = 0;
+    chunk_array_free(&seen);
+    stats.clients = 0;
+    running = 0;
+    stopping = 0;
+    pthread_mutex_unlock(&stream_lock);
+}
+
+int event_stream_failed(void)
+{
+    return atomic_load(&failed);
+}
+
+void event_stream_get_stats(event_stream_stats_t *out)
+{
+    pthread_mutex_lock(&stream_lock);
+    *out = stats;
+    pthread_mutex_unlock(&stream_lock);
+}
@@ -0,0 +1,830 @@
+/*
+ * Prometheus Exporter
+ * A scrape first copies every device's metrics and interface rows into
+ * scratch arrays, with each one's label set pre-escaped, then writes
+ * one metric family at a time from them (the text format keeps a
+ * family's samples together). Numbers are formatted by small integer
+ * routines rather than printf.
+ */
+
+#define _GNU_SOURCE
+
+#include "netmon.h"
+#include "exporter.h"
+#include "device_db.h"
+#include "metrics_store.h"
+#include "if_table.h"
+#include "selfstat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Room reserved before each sample line; bounds the escaped labels */
+#define LINE_RESERVE (2 * MAX_HOSTNAME_LEN + 2 * IF_DESCR_LEN + 256)
+
+#define REQUEST_MAX 4096
+#define CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+/* Growable byte buffer, reused across scrapes */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} buf_t;
+
+/* Offset and length of a label set in the labels buffer */
+typedef struct {
+    size_t off;
+    int len;
+} label_ref_t;
+
+typedef struct {
+    device_metrics_t m;
+    label_ref_t label;            /* device="..",ip=".." */
+    int if_first;                 /* Rows in ifs[] */
+    int if_count;
+} dev_row_t;
+
+/* Scratch of the render; only the render caller touches it */
+static dev_row_t *devs = NULL;
+static int dev_count = 0;
+static int dev_cap = 0;
+static if_entry_t *ifs = NULL;
+static label_ref_t *if_labels = NULL;
+static int if_cap = 0;
+static buf_t labels = { NULL, 0, 0 };
+static buf_t out = { NULL, 0, 0 };
+static uint64_t series = 0;
+
+static pthread_mutex_t server_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t server_thread;
+static int server_running = 0;
+static int listen_fd = -1;
+static int stop_pipe[2] = { -1, -1 };
+static exporter_stats_t stats;    /* Guarded by server_lock */
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Make room for n more bytes; buffers only ever grow */
+static int reserve(buf_t *b, size_t n)
+{
+    if (b->len + n <= b->cap) {
+        return 0;
+    }
+    size_t cap = b->cap ? b->cap : 64 * 1024;
+    while (cap < b->len + n) {
+        cap *= 2;
+    }
+    char *data = realloc(b->data, cap);
+    if (data == NULL) {
+        return -1;
+    }
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+/* The put_* helpers write into room already reserved */
+static void put(buf_t *b, const char *s, size_t n)
+{
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+static void put_str(buf_t *b, const char *s)
+{
+    put(b, s, strlen(s));
+}
+
+static void put_u64(buf_t *b, uint64_t v)
+{
+    char tmp[20];
+    int n = 0;
+
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n > 0) {
+        b->data[b->len++] = tmp[--n];
+    }
+}
+
+static void put_i64(buf_t *b, int64_t v)
+{
+    if (v < 0) {
+        b->data[b->len++] = '-';
+        put_u64(b, (uint64_t)0 - (uint64_t)v);
+    } else {
+        put_u64(b, (uint64_t)v);
+    }
+}
+
+/* Label value escaping: backslash, double quote and newline; at most max bytes of s */
+static void put_label_value(buf_t *b, const char *s, size_t max)
+{
+    for (size_t i = 0; i < max && s[i] != '\0'; i++) {
+        char c = s[i];
+        if (c == '\\' || c == '"') {
+            b->data[b->len++] = '\\';
+            b->data[b->len++] = c;
+        } else if (c == '\n') {
+            b->data[b->len++] = '\\';
+            b->data[b->len++] = 'n';
+        } else {
+            b->data[b->len++] = c;
+        }
+    }
+}
+
+/* Grow the interface scratch to hold at least need rows */
+static int grow_ifs(int need)
+{
+    int cap = if_cap ? if_cap : 1024;
+    while (cap < need) {
+        cap *= 2;
+    }
+    if_entry_t *rows = realloc(ifs, (size_t)cap * sizeof(*rows));
+    if (rows == NULL) {
+        return -1;
+    }
+    ifs = rows;
+    label_ref_t *refs = realloc(if_labels, (size_t)cap * sizeof(*refs));
+    if (refs == NULL) {
+        return -1;
+    }
+    if_labels = refs;
+    if_cap = cap;
+    return 0;
+}
+
+/* Grow the device scratch to hold at least need rows */
+static int grow_devs(int need)
+{
+    int cap = dev_cap ? dev_cap : 256;
+    while (cap < need) {
+        cap *= 2;
+    }
+    dev_row_t *rows = realloc(devs, (size_t)cap * sizeof(*rows));
+    if (rows == NULL) {
+        return -1;
+    }
+    devs = rows;
+    dev_cap = cap;
+    return 0;
+}
+
+/*
+ * Copy metrics, interface rows and label sets of every device
+ * Returns 0, or -1 if a buffer could not grow
+ */
+static int collect(void)
+{
+    int used = 0;
+    int rc = 0;
+
+    dev_count = 0;
+    labels.len = 0;
+    if (if_cap == 0 && grow_ifs(1) != 0) {
+        return -1;
+    }
+
+    const device_snapshot_t *snap = device_db_snapshot_acquire();
+    if (snap->count > dev_cap && grow_devs(snap->count) != 0) {
+        device_db_snapshot_release(snap);
+        return -1;
+    }
+    for (int i = 0; i < snap->count && rc == 0; i++) {
+        const device_entry_t *e = snap->entries[i];
+        dev_row_t *d = &devs[dev_count];
+
+        if (metrics_store_read(e->slot, e->id, &d->m) != NETMON_SUCCESS) {
+            continue;
+        }
+        if (reserve(&labels, LINE_RESERVE) != 0) {
+            rc = -1;
+            break;
+        }
+        d->label.off = labels.len;
+        put_str(&labels, "device=\"");
+        put_label_value(&labels, e->hostname, sizeof(e->hostname));
+        put_str(&labels, "\",ip=\"");
+        put_label_value(&labels, e->ip_address, sizeof(e->ip_address));
+        put_str(&labels, "\"");
+        d->label.len = (int)(labels.len - d->label.off);
+
+        int n = if_table_read(e->slot, e->id, ifs + used, if_cap - used);
+        if (n > if_cap - used) {
+            if (grow_ifs(used + n) != 0) {
+                rc = -1;
+                break;
+            }
+            n = if_table_read(e->slot, e->id, ifs + used, if_cap - used);
+        }
+        if (n < 0) n = 0;
+        if (n > if_cap - used) n = if_cap - used;
+
+        for (int j = 0; j < n; j++) {
+            const if_info_t *info = &ifs[used + j].info;
+            if (reserve(&labels, LINE_RESERVE) != 0) {
+                rc = -1;
+                break;
+            }
+            label_ref_t *ref = &if_labels[used + j];
+            ref->off = labels.len;
+            put(&labels, labels.data + d->label.off, (size_t)d->label.len);
+            put_str(&labels, ",ifindex=\"");
+            put_u64(&labels, info->ifindex);
+            put_str(&labels, "\",ifname=\"");
+            if (info->name[0] != '\0') {
+                put_label_value(&labels, info->name, sizeof(info->name));
+            } else {
+                put_label_value(&labels, info->descr, sizeof(info->descr));
+            }
+            put_str(&labels, "\"");
+            ref->len = (int)(labels.len - ref->off);
+        }
+        d->if_first = used;
+        d->if_count = n;
+        used += n;
+        dev_count++;
+    }
+    device_db_snapshot_release(snap);
+    return rc;
+}
+
+static int family(const char *name, const char *type, const char *help)
+{
+    if (reserve(&out, strlen(name) * 2 + strlen(type) + strlen(help) + 32) != 0) {
+        return -1;
+    }
+    put_str(&out, "# HELP ");
+    put_str(&out, name);
+    put_str(&out, " ");
+    put_str(&out, help);
+    put_str(&out, "\n# TYPE ");
+    put_str(&out, name);
+    put_str(&out, " ");
+    put_str(&out, type);
+    put_str(&out, "\n");
+    return 0;
+}
+
+/* name{labels} (name alone for NULL) and the separating space; the value follows */
+static int sample_begin(const char *name, size_t name_len, const label_ref_t *label)
+{
+    if (reserve(&out, LINE_RESERVE) != 0) {
+        return -1;
+    }
+    put(&out, name, name_len);
+    if (label != NULL) {
+        out.data[out.len++] = '{';
+        put(&out, labels.data + label->off, (size_t)label->len);
+        out.data[out.len++] = '}';
+    }
+    out.data[out.len++] = ' ';
+    series++;
+    return 0;
+}
+
+static void sample_end(void)
+{
+    out.data[out.len++] = '\n';
+}
+
+/* Microseconds as a decimal fraction of a second */
+static void put_seconds(buf_t *b, uint64_t us)
+{
+    put_u64(b, us / 1000000);
+    b->data[b->len++] = '.';
+    for (uint64_t div = 100000, rest = us % 1000000; div > 0; div /= 10) {
+        b->data[b->len++] = (char)('0' + (rest / div) % 10);
+    }
+}
+
+/* Tenths, for percentages */
+static void put_fixed1(buf_t *b, float v)
+{
+    int64_t t = (int64_t)(v * 10.0f + (v >= 0.0f ? 0.5f : -0.5f));
+    if (t < 0) {
+        b->data[b->len++] = '-';
+        t = -t;
+    }
+    put_u64(b, (uint64_t)t / 10);
+    b->data[b->len++] = '.';
+    b->data[b->len++] = (char)('0' + t % 10);
+}
+
+typedef enum {
+    DEV_STATUS,
+    DEV_RESPONSE_TIME,
+    DEV_BYTES_IN,
+    DEV_BYTES_OUT,
+    DEV_ERRORS_IN,
+    DEV_ERRORS_OUT,
+    DEV_IN_BPS,
+    DEV_OUT_BPS,
+    DEV_CPU,
+    DEV_MEMORY,
+    DEV_LAST_SEEN
+} dev_field_t;
+
+typedef enum {
+    IF_OPER_STATUS,
+    IF_IN_OCTETS,
+    IF_OUT_OCTETS,
+    IF_IN_ERRORS,
+    IF_OUT_ERRORS,
+    IF_IN_BPS,
+    IF_OUT_BPS,
+    IF_SPEED
+} if_field_t;
+
+typedef struct {
+    int field;
+    const char *name;
+    const char *type;
+    const char *help;
+} family_t;
+
+static const family_t device_families[] = {
+    { DEV_STATUS, "netmon_device_status", "gauge",
+      "Device status (0 unknown, 1 up, 2 down, 3 warning)" },
+    { DEV_RESPONSE_TIME, "netmon_device_response_time_ms", "gauge",
+      "Last poll response time in milliseconds" },
+    /* Sums over an interface set that changes, so they can drop: gauges */
+    { DEV_BYTES_IN, "netmon_device_bytes_in", "gauge",
+      "Octets received, summed over current interfaces" },
+    { DEV_BYTES_OUT, "netmon_device_bytes_out", "gauge",
+      "Octets sent, summed over current interfaces" },
+    { DEV_ERRORS_IN, "netmon_device_errors_in", "gauge",
+      "Inbound errors, summed over current interfaces" },
+    { DEV_ERRORS_OUT, "netmon_device_errors_out", "gauge",
+      "Outbound errors, summed over current interfaces" },
+    { DEV_IN_BPS, "netmon_device_in_bps", "gauge",
+      "Smoothed inbound rate over all interfaces in bits per second" },
+    { DEV_OUT_BPS, "netmon_device_out_bps", "gauge",
+      "Smoothed outbound rate over all interfaces in bits per second" },
+    { DEV_CPU, "netmon_device_cpu_percent", "gauge", "CPU utilisation" },
+    { DEV_MEMORY, "netmon_device_memory_percent", "gauge", "Memory utilisation" },
+    { DEV_LAST_SEEN, "netmon_device_last_seen_seconds", "gauge",
+      "Unix time of the last answered poll" },
+};
+
+static const family_t if_families[] = {
+    { IF_OPER_STATUS, "netmon_if_oper_status", "gauge", "IF-MIB ifOperStatus (1 up, 2 down)" },
+    { IF_IN_OCTETS, "netmon_if_in_octets_total", "counter", "ifInOctets/ifHCInOctets" },
+    { IF_OUT_OCTETS, "netmon_if_out_octets_total", "counter", "ifOutOctets/ifHCOutOctets" },
+    { IF_IN_ERRORS, "netmon_if_in_errors_total", "counter", "ifInErrors" },
+    { IF_OUT_ERRORS, "netmon_if_out_errors_total", "counter", "ifOutErrors" },
+    { IF_IN_BPS, "netmon_if_in_bps", "gauge", "Smoothed inbound rate in bits per second" },
+    { IF_OUT_BPS, "netmon_if_out_bps", "gauge", "Smoothed outbound rate in bits per second" },
+    { IF_SPEED, "netmon_if_speed_bps", "gauge", "ifHighSpeed/ifSpeed in bits per second" },
+};
+
+#define COUNT_OF(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+/* Value of one device field; returns 0 if the device has none */
+static int put_device_value(int field, const device_metrics_t *m)
+{
+    switch (field) {
+        case DEV_STATUS:        put_u64(&out, (uint64_t)m->status); break;
+        case DEV_RESPONSE_TIME:
+            if (m->response_time_ms < 0) return 0;
+            put_i64(&out, m->response_time_ms);
+            break;
+        case DEV_BYTES_IN:      put_u64(&out, m->bytes_in); break;
+        case DEV_BYTES_OUT:     put_u64(&out, m->bytes_out); break;
+        case DEV_ERRORS_IN:     put_u64(&out, m->errors_in); break;
+        case DEV_ERRORS_OUT:    put_u64(&out, m->errors_out); break;
+        case DEV_IN_BPS:        put_u64(&out, m->in_bps); break;
+        case DEV_OUT_BPS:       put_u64(&out, m->out_bps); break;
+        case DEV_CPU:           put_fixed1(&out, m->cpu_usage); break;
+        case DEV_MEMORY:        put_fixed1(&out, m->memory_usage); break;
+        case DEV_LAST_SEEN:
+            if (m->last_seen == 0) return 0;
+            put_i64(&out, (int64_t)m->last_seen);
+            break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+static void put_if_value(int field, const if_entry_t *e)
+{
+    switch (field) {
+        case IF_OPER_STATUS: put_u64(&out, e->counters.oper_status); break;
+        case IF_IN_OCTETS:   put_u64(&out, e->counters.in_octets); break;
+        case IF_OUT_OCTETS:  put_u64(&out, e->counters.out_octets); break;
+        case IF_IN_ERRORS:   put_u64(&out, e->counters.in_errors); break;
+        case IF_OUT_ERRORS:  put_u64(&out, e->counters.out_errors); break;
+        case IF_IN_BPS:      put_u64(&out, e->counters.in_bps); break;
+        case IF_OUT_BPS:     put_u64(&out, e->counters.out_bps); break;
+        case IF_SPEED:       put_u64(&out, e->info.speed_bps); break;
+        default:             put_u64(&out, 0); break;
+    }
+}
+
+/* Skip optional values without leaving a half-written line behind */
+static int render_devices(void)
+{
+    for (int f = 0; f < COUNT_OF(device_families); f++) {
+        const family_t *fam = &device_families[f];
+        size_t name_len = strlen(fam->name);
+
+        if (family(fam->name, fam->type, fam->help) != 0) {
+            return -1;
+        }
+        for (int i = 0; i < dev_count; i++) {
+            size_t mark = out.len;
+            if (sample_begin(fam->name, name_len, &devs[i].label) != 0) {
+                return -1;
+            }
+            if (put_device_value(fam->field, &devs[i].m)) {
+                sample_end();
+            } else {
+                out.len = mark;
+                series--;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Interfaces never updated by a poll have no counters yet and are left out */
+static int render_interfaces(void)
+{
+    for (int f = 0; f < COUNT_OF(if_families); f++) {
+        const family_t *fam = &if_families[f];
+        size_t name_len = strlen(fam->name);
+
+        if (family(fam->name, fam->type, fam->help) != 0) {
+            return -1;
+        }
+        for (int i = 0; i < dev_count; i++) {
+            for (int j = devs[i].if_first; j < devs[i].if_first + devs[i].if_count; j++) {
+                if (ifs[j].counters.updated == 0) {
+                    continue;
+                }
+                if (sample_begin(fam->name, name_len, &if_labels[j]) != 0) {
+                    return -1;
+                }
+                put_if_value(fam->field, &ifs[j]);
+                sample_end();
+            }
+        }
+    }
+    return 0;
+}
+
+static int render_self(uint64_t scrapes, uint64_t render_us)
+{
+    static const char *const names[] = {
+        "netmon_exporter_scrapes_total", "netmon_exporter_render_seconds"
+    };
+
+    if (family(names[0], "counter", "Scrapes answered before this one") != 0 ||
+        sample_begin(names[0], strlen(names[0]), NULL) != 0) {
+        return -1;
+    }
+    put_u64(&out, scrapes);
+    sample_end();
+    if (family(names[1], "gauge", "Time the previous scrape took to render") != 0 ||
+        sample_begin(names[1], strlen(names[1]), NULL) != 0) {
+        return -1;
+    }
+    put_seconds(&out, render_us);
+    sample_end();
+    return 0;
+}
+
+/* One summary sample: name[suffix]{stage="..",quantile=".."} */
+static int selfstat_sample(const selfstat_desc_t *d, const char *suffix, const char *quantile)
+{
+    if (reserve(&out, LINE_RESERVE) != 0) {
+        return -1;
+    }
+    put_str(&out, d->name);
+    put_str(&out, suffix);
+    if (d->label != NULL || quantile != NULL) {
+        out.data[out.len++] = '{';
+        if (d->label != NULL) {
+            put_str(&out, "stage=\"");
+            put_str(&out, d->label);
+            put_str(&out, quantile != NULL ? "\"," : "\"");
+        }
+        if (quantile != NULL) {
+            put_str(&out, "quantile=\"");
+            put_str(&out, quantile);
+            put_str(&out, "\"");
+        }
+        out.data[out.len++] = '}';
+    }
+    out.data[out.len++] = ' ';
+    series++;
+    return 0;
+}
+
+/* netmon's own latency summaries and counters (selfstat.h) */
+static int render_selfstat(void)
+{
+    static const char *const quantiles[] = { "0.5", "0.9", "0.99" };
+    static const double quantile_values[] = { 0.5, 0.9, 0.99 };
+    static selfstat_snapshot_t snap;
+    const char *prev = NULL;
+
+    for (int h = 0; h < SELFSTAT_HIST_COUNT; h++) {
+        const selfstat_desc_t *d = selfstat_hist_desc((selfstat_hist_t)h);
+
+        /* Stage histograms share one family, so one header */
+        if ((prev == NULL || strcmp(prev, d->name) != 0) &&
+            family(d->name, "summary", d->help) != 0) {
+            return -1;
+        }
+        prev = d->name;
+
+        selfstat_read((selfstat_hist_t)h, &snap);
+        for (int q = 0; q < COUNT_OF(quantiles); q++) {
+            if (selfstat_sample(d, "", quantiles[q]) != 0) {
+                return -1;
+            }
+            put_seconds(&out, selfstat_percentile(&snap, quantile_values[q]));
+            sample_end();
+        }
+        if (selfstat_sample(d, "_sum", NULL) != 0) {
+            return -1;
+        }
+        put_seconds(&out, snap.sum_us);
+        sample_end();
+        if (selfstat_sample(d, "_count", NULL) != 0) {
+            return -1;
+        }
+        put_u64(&out, snap.count);
+        sample_end();
+    }
+
+    for (int c = 0; c < SELFSTAT_COUNTER_COUNT; c++) {
+        const selfstat_desc_t *d = selfstat_counter_desc((selfstat_counter_t)c);
+        if (family(d->name, "counter", d->help) != 0 || selfstat_sample(d, "", NULL) != 0) {
+            return -1;
+        }
+        put_u64(&out, selfstat_counter((selfstat_counter_t)c));
+        sample_end();
+    }
+    return 0;
+}
+
+size_t exporter_render(const char **body)
+{
+    exporter_stats_t prev;
+    uint64_t start = now_us();
+
+    exporter_get_stats(&prev);
+    out.len = 0;
+    series = 0;
+    if (collect() != 0 || render_devices() != 0 || render_interfaces() != 0 ||
+        render_self(prev.scrapes, prev.render_us) != 0 || render_selfstat() != 0) {
+        out.len = 0;
+    }
+    *body = out.data != NULL ? out.data : "";
+
+    pthread_mutex_lock(&server_lock);
+    stats.series = series;
+    stats.bytes = out.len;
+    stats.render_us = now_us() - start;
+    pthread_mutex_unlock(&server_lock);
+    return out.len;
+}
+
+/* ------------------------------------------------------------------ */
+/* HTTP                                                               */
+/* ------------------------------------------------------------------ */
+
+static int send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int send_status(int fd, const char *status)
+{
+    char header[256];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n%s\n",
+                     status, strlen(status) + 1, status);
+    return send_all(fd, header, (size_t)n);
+}
+
+/* Read one request head and answer it; the connection is closed after */
+static int serve(int fd)
+{
+    char req[REQUEST_MAX + 1];
+    size_t len = 0;
+    struct timeval tv = { EXPORTER_IO_TIMEOUT_MS / 1000, (EXPORTER_IO_TIMEOUT_MS % 1000) * 1000 };
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    while (len < REQUEST_MAX) {
+        ssize_t n = recv(fd, req + len, REQUEST_MAX - len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        len += (size_t)n;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL) break;
+    }
+    req[len] = '\0';
+
+    int head = strncmp(req, "HEAD ", 5) == 0;
+    if (!head && strncmp(req, "GET ", 4) != 0) {
+        send_status(fd, "405 Method Not Allowed");
+        return -1;
+    }
+    const char *path = req + (head ? 5 : 4);
+    size_t path_len = strcspn(path, " ?\r\n");
+    if (path_len != 8 || strncmp(path, "/metrics", 8) != 0) {
+        send_status(fd, "404 Not Found");
+        return -1;
+    }
+
+    const char *body;
+    size_t body_len = exporter_render(&body);
+    if (body_len == 0) {
+        send_status(fd, "500 Internal Server Error");
+        return -1;
+    }
+
+    char header[256];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 200 OK\r\nContent-Type: " CONTENT_TYPE "\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", body_len);
+    if (send_all(fd, header, (size_t)n) != 0 || (!head && send_all(fd, body, body_len) != 0)) {
+        return -1;
+    }
+    return 0;
+}
+
+static void *server_main(void *arg)
+{
+    struct pollfd pfd[2];
+
+    (void)arg;
+    pfd[0].fd = listen_fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = stop_pipe[0];
+    pfd[1].events = POLLIN;
+
+    for (;;) {
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfd[1].revents != 0) {
+            break;
+        }
+        if ((pfd[0].revents & POLLIN) == 0) {
+            continue;
+        }
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        int rc = serve(fd);
+        close(fd);
+
+        pthread_mutex_lock(&server_lock);
+        if (rc == 0) {
+            stats.scrapes++;
+        } else {
+            stats.errors++;
+        }
+        pthread_mutex_unlock(&server_lock);
+    }
+    return NULL;
+}
+
+/* Parse "host:port", ":port" or "port" */
+static int parse_listen_addr(const char *text, struct sockaddr_in *sa)
+{
+    char host[MAX_IP_LEN] = "";
+    const char *colon = strrchr(text, ':');
+    const char *port_text = colon != NULL ? colon + 1 : text;
+    char *end;
+
+    if (colon != NULL) {
+        size_t n = (size_t)(colon - text);
+        if (n >= sizeof(host)) return -1;
+        memcpy(host, text, n);
+        host[n] = '\0';
+    }
+    long port = strtol(port_text, &end, 10);
+    if (end == port_text || *end != '\0' || port <= 0 || port > 65535) {
+        return -1;
+    }
+
+    memset(sa, 0, sizeof(*sa));
+    sa->sin_family = AF_INET;
+    sa->sin_port = htons((uint16_t)port);
+    if (host[0] == '\0') {
+        sa->sin_addr.s_addr = htonl(INADDR_ANY);
+    } else if (inet_pton(AF_INET, host, &sa->sin_addr) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+int exporter_start(const char *listen_addr)
+{
+    struct sockaddr_in sa;
+    int one = 1;
+
+    if (listen_addr == NULL || parse_listen_addr(listen_addr, &sa) != 0) {
+        return NETMON_ERROR;
+    }
+
+    pthread_mutex_lock(&server_lock);
+    if (server_running) {
+        pthread_mutex_unlock(&server_lock);
+        return NETMON_ERROR;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        pthread_mutex_unlock(&server_lock);
+        return NETMON_ERROR;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 16) != 0 ||
+        pipe2(stop_pipe, O_CLOEXEC) != 0) {
+        close(fd);
+        pthread_mutex_unlock(&server_lock);
+        return NETMON_ERROR;
+    }
+    listen_fd = fd;
+    memset(&stats, 0, sizeof(stats));
+
+    if (pthread_create(&server_thread, NULL, server_main, NULL) != 0) {
+        close(listen_fd);
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        listen_fd = stop_pipe[0] = stop_pipe[1] = -1;
+        pthread_mutex_unlock(&server_lock);
+        return NETMON_ERROR;
+    }
+    server_running = 1;
+    pthread_mutex_unlock(&server_lock);
+    return NETMON_SUCCESS;
+}
+
+void exporter_stop(void)
+{
+    pthread_mutex_lock(&server_lock);
+    if (!server_running) {
+        pthread_mutex_unlock(&server_lock);
+        return;
+    }
+    server_running = 0;
+    pthread_mutex_unlock(&server_lock);
+
+    char byte = 0;
+    while (write(stop_pipe[1], &byte, 1) < 0 && errno == EINTR) {
+    }
+    pthread_join(server_thread, NULL);
+
+    close(listen_fd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    listen_fd = stop_pipe[0] = stop_pipe[1] = -1;
+}
+
+void exporter_get_stats(exporter_stats_t *out_stats)
+{
+    pthread_mutex_lock(&server_lock);
+    *out_stats = stats;
+    pthread_mutex_unlock(&server_lock);
+}